@@ -28,6 +28,7 @@
  * the other grades */
 struct memory_grade {
     struct page_refs *hot_pages;
+    struct page_refs *warm_pages;   /* to the slow node, only for slide with warm_threshold */
     struct page_refs *cold_pages;
 };
 
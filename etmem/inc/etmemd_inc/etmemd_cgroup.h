@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for cgroup v2 tasks.
+ ******************************************************************************/
+
+#ifndef ETMEMD_CGROUP_H
+#define ETMEMD_CGROUP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "etmemd_task.h"
+
+#define CGROUP2_ROOT                "/sys/fs/cgroup"
+#define CGROUP_PATH_MAX_LEN         256
+#define CGROUP_PIDS_INIT_NUM        64
+#define CGROUP_WATCH_POLL_MS        1000
+
+/* memory counters of the cgroup in KB, refreshed once per interval */
+struct cgroup_mem {
+    unsigned long current;      /* memory.current */
+    unsigned long file;         /* file of memory.stat */
+    unsigned long swap;         /* memory.swap.current, 0 if swap is not accounted */
+    bool valid;
+};
+
+struct cgroup_task {
+    char *path;                 /* absolute path of the cgroup directory */
+    bool recursive;             /* also manage the processes of descendant cgroups */
+    int current_fd;
+    int stat_fd;
+    int swap_fd;
+    int events_wd;              /* inotify watch of cgroup.events, -1 if not watched */
+    struct cgroup_mem mem;
+    unsigned long cold_sum;     /* cold pages of all members in the last interval */
+    size_t nr_pids;
+};
+
+int etmemd_cgroup_task_init(struct task *tk);
+void etmemd_cgroup_task_free(struct task *tk);
+bool etmemd_cgroup_path_valid(const char *path);
+
+int etmemd_cgroup_get_pids(const struct cgroup_task *cg, unsigned int **pids, size_t *nr);
+void etmemd_cgroup_roll_cold(struct task *tk);
+int etmemd_cgroup_refresh(struct task *tk);
+int etmemd_cgroup_mem_usage(const struct cgroup_task *cg, unsigned long *rss, unsigned long *swap);
+unsigned long etmemd_cgroup_share(const struct task_pid *tk_pid, unsigned long need_pages);
+
+/* refresh the pids of the task as soon as cgroup.events is changed */
+void etmemd_cgroup_watch_add(struct task *tk);
+void etmemd_cgroup_watch_del(struct task *tk);
+
+#endif
@@ -20,15 +20,18 @@
 #include <stdbool.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/types.h>
 
 #define PROC_PATH                       "/proc/"
 #define STATUS_FILE                     "/status"
 #define PROC_MEMINFO                    "meminfo"
+#define MEMINFO_FILE                    "/proc/meminfo"
 #define SWAPIN                          "SwapIN"
 #define VMRSS                           "VmRSS"
 #define VMSWAP                          "VmSwap"
 
 #define FILE_LINE_MAX_LEN               1024
+#define PROC_FILE_MAX_LEN               8192
 #define KEY_VALUE_MAX_LEN               64
 #define DECIMAL_RADIX                   10
 #define ETMEMD_MAX_PARAMETER_NUM        6
@@ -50,11 +53,41 @@
 
 #define PIPE_FD_LEN                     2
 
+#define MSEC_PER_SEC                    1000
+#define NSEC_PER_MSEC                   1000000
+#define USEC_PER_MSEC                   1000
+#define USEC_PER_SEC                    1000000
+#define NSEC_PER_USEC                   1000
+
 struct ioctl_para {
     unsigned long ioctl_cmd;
     unsigned int ioctl_parameter;
 };
 
+/* key to look up in a "Key:   value kB" or "key value" formatted proc file */
+struct proc_mem_key {
+    const char *key;
+    unsigned long *value;
+    bool found;
+};
+
+/*
+ * memory counters of one pid and of the system, sampled at most once per
+ * scan cycle and shared by all checks of that cycle.
+ * status_fd stays open across cycles, and is only valid if status_opened.
+ * */
+struct mem_snapshot {
+    int status_fd;
+    bool status_opened;
+    bool sys_valid;
+    bool pid_valid;
+    unsigned long mem_total;
+    unsigned long mem_free;
+    unsigned long swap_cached;
+    unsigned long vm_rss;
+    unsigned long vm_swap;
+};
+
 /*
  * function: parse cmdline passed to etmemd server.
  *
@@ -75,11 +108,25 @@ int get_unsigned_long_value(const char *val, unsigned long *value);
 void etmemd_safe_free(void **ptr);
 
 FILE *etmemd_get_proc_file(const char *pid, const char *file, const char *mode);
+/* open the proc file with flags that fopen modes cannot tell, return the fd or -1 */
+int etmemd_open_proc_file(const char *pid, const char *file, int flags);
 int etmemd_send_ioctl_cmd(FILE *fp, struct ioctl_para *request);
 
 unsigned long get_pagesize(void);
 int get_mem_from_proc_file(const char *pid, const char *file_name, unsigned long *data, const char *cmpstr);
 
+int etmemd_open_proc_fd(const char *pid, const char *file_name);
+ssize_t etmemd_pread_file(int fd, char *buf, size_t buf_len);
+int get_mem_from_proc_buf(const char *buf, struct proc_mem_key *keys, int key_num);
+int get_mem_from_proc_fd(int fd, struct proc_mem_key *keys, int key_num);
+int get_mem_from_meminfo(struct proc_mem_key *keys, int key_num);
+int get_ulong_from_fd(int fd, unsigned long *value);
+
+void etmemd_mem_snapshot_invalidate(struct mem_snapshot *snap);
+int etmemd_mem_snapshot_sys(struct mem_snapshot *snap);
+int etmemd_mem_snapshot_pid(struct mem_snapshot *snap, unsigned int pid);
+void etmemd_mem_snapshot_release(struct mem_snapshot *snap);
+
 int dprintf_all(int fd, const char *format, ...);
 
 int get_swap_threshold_inKB(const char *string, unsigned long *value);
@@ -16,10 +16,31 @@
 #ifndef ETMEMD_DAMON_H
 #define ETMEMD_DAMON_H
 
+#include <stdint.h>
 #include "etmemd_project.h"
 
+/* access frequency of an address range of a process, sampled by damon */
+struct damon_region {
+    uint64_t start;
+    uint64_t end;
+    unsigned int nr_accesses;   /* in [0, max_nr_accesses] of the last aggregation */
+    unsigned int age;           /* aggregations since the access frequency changed */
+};
+
+struct damon_regions {
+    struct damon_region *region;    /* sorted by address */
+    int num;
+    unsigned int max_nr_accesses;
+};
+
 int etmemd_start_damon(struct project *proj);
-int etmemd_stop_damon(void);
+int etmemd_stop_damon(struct project *proj);
 int fill_engine_type_damon(struct engine *eng, GKeyFile *config);
 
+/* monitor the pids of a page scan project, whose region snapshots replace the idle_pages walk */
+int etmemd_damon_monitor_start(struct project *proj);
+void etmemd_damon_monitor_stop(struct project *proj);
+int etmemd_damon_get_regions(const struct project *proj, unsigned int pid, struct damon_regions *regions);
+void etmemd_damon_free_regions(struct damon_regions *regions);
+
 #endif
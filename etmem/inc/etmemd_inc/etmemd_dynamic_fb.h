@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for dynamic feedback engine.
+ ******************************************************************************/
+
+#ifndef ETMEMD_DYNAMIC_FB_H
+#define ETMEMD_DYNAMIC_FB_H
+
+#include <time.h>
+#include "etmemd_engine.h"
+#include "etmemd_slide.h"
+
+#define DYNAMIC_FB_DEFAULT_STEP         5
+#define DYNAMIC_FB_DEFAULT_MIN_DRAM     10
+
+/* counter used to measure swap-in of a pid, probed in this order */
+enum swapin_source {
+    SWAPIN_SRC_NONE = 0,
+    SWAPIN_SRC_STATUS,      /* SwapIN of /proc/<pid>/status */
+    SWAPIN_SRC_CGROUP,      /* workingset refault of the cgroup v2 memory.stat of the pid */
+    SWAPIN_SRC_VMSTAT,      /* system wide pswpin of /proc/vmstat, only reported, not used to tune */
+};
+
+struct dynamic_fb_params {
+    struct task_executor *executor;
+    struct slide_params slide;      /* initial T, dram_percent and swap_threshold of every pid */
+    unsigned long swapin_target;    /* max swap-in pages per second of one pid */
+    int tune_step;
+    int min_dram_percent;
+};
+
+struct dynamic_fb_pid_params {
+    struct slide_params slide;      /* values tuned by the feedback of this pid */
+    enum swapin_source source;
+    int stat_fd;                    /* memory.stat or vmstat kept open, status uses mem_snap */
+    unsigned long last_swapin;
+    struct timespec last_time;
+    bool sampled;
+};
+
+int fill_engine_type_dynamic_fb(struct engine *eng, GKeyFile *config);
+
+#endif
@@ -42,6 +42,7 @@ struct page_refs {
                                   time of visit*/
 
     struct page_refs *next;     /* point to next page */
+    int dirty;                  /* count of the loops the page is seen dirty in */
 };
 
 struct page_sort {
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for historical feedback engine.
+ ******************************************************************************/
+
+#ifndef ETMEMD_HISTORICAL_FB_H
+#define ETMEMD_HISTORICAL_FB_H
+
+#include <stdint.h>
+#include <linux/limits.h>
+#include "etmemd_engine.h"
+#include "etmemd_slide.h"
+
+#define HISTORY_DEFAULT_DIR         "/var/lib/etmem/history"
+#define HISTORY_FILE_SUFFIX         ".hist"
+#define HISTORY_MAGIC               0x53485445  /* "ETHS" */
+#define HISTORY_VERSION             2
+#define HISTORY_REGION_SHIFT        21          /* 2M region */
+#define HISTORY_MAX_REGIONS         (1 << 18)
+#define HISTORY_HOURS               24
+#define HISTORY_SCORE_MAX           255
+#define HISTORY_DEFAULT_PREDICT     50
+
+/* header of the history file of one pid */
+struct history_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t region_shift;
+    uint64_t start_time;        /* start time of the pid in jiffies, to detect pid reuse */
+    uint32_t nr_regions;
+    int32_t cur_hour;
+    int64_t hour_stamp;         /* hours since the epoch of cur_hour, to decay the hours not watched */
+};
+
+/* access score of one region in each hour of the day, 32 bytes on disk followed by the touched flags */
+struct history_region {
+    uint64_t addr;
+    uint8_t score[HISTORY_HOURS];
+};
+
+struct history_table {
+    struct history_header header;
+    struct history_region *regions;     /* sorted by addr */
+    bool *touched;                      /* region is accessed in current hour */
+    uint32_t capacity;
+};
+
+struct historical_fb_params {
+    struct task_executor *executor;
+    struct slide_params slide;
+    char history_dir[PATH_MAX];
+    int predict_threshold;      /* percentage of HISTORY_SCORE_MAX to predict a region to be used */
+};
+
+struct historical_fb_pid_params {
+    struct history_table table;
+    bool dirty;
+};
+
+int fill_engine_type_historical_fb(struct engine *eng, GKeyFile *config);
+
+#endif
@@ -17,13 +17,28 @@
 #ifndef ETMEMD_MEMDCD_H
 #define ETMEMD_MEMDCD_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include "etmemd_engine.h"
 
 #define MAX_SOCK_PATH_LENGTH 108
 
 struct memdcd_params {
-	    struct task_executor *executor;
-	        char memdcd_socket[MAX_SOCK_PATH_LENGTH];
+    struct task_executor *executor;
+    char memdcd_socket[MAX_SOCK_PATH_LENGTH];
+
+    /* connection to memdcd kept across scans, shared by the executors of all pids of the task */
+    pthread_mutex_t conn_lock;
+    int sock_fd;
+    uint32_t seq;       /* seq of the last frame sent */
+    uint32_t acked;     /* seq of the last frame acknowledged by memdcd */
+
+    /* shared memory ring to memdcd instead of the socket, the socket only carries the acks then */
+    bool use_ring;
+    struct memdcd_ring *ring;
+    uint64_t ring_head;
+    int event_fd;
 };
 
 int fill_engine_type_memdcd(struct engine *eng, GKeyFile *config);
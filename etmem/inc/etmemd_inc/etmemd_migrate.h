@@ -26,7 +26,16 @@
 #define SWAP_LIMIT      200
 #define SWAP_ADDR_LEN   20
 
+/* count of pages moved to or queried on the slow node by one move_pages call */
+#define MOVE_PAGES_BATCH    512
+
+struct slide_params;
+
 int etmemd_grade_migrate(const char* pid, const struct memory_grade *memory_grade);
-int etmemd_reclaim_swapcache(const struct task_pid *tk_pid);
-unsigned long check_should_migrate(const struct task_pid *tk_pid);
+int etmemd_migrate_node(unsigned int pid, struct page_refs *page_refs_list, int node);
+int etmemd_take_node_pages(unsigned int pid, struct page_refs **page_refs_list, int node,
+                           struct page_refs **on_node);
+int etmemd_node_free_mem(int node, unsigned long *free_kb);
+int etmemd_reclaim_swapcache(struct task_pid *tk_pid);
+unsigned long check_should_migrate(struct task_pid *tk_pid, const struct slide_params *slide_params);
 #endif
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for the /proc process snapshot.
+ ******************************************************************************/
+
+#ifndef ETMEMD_PROC_H
+#define ETMEMD_PROC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PROC_COMM_LEN               16      /* TASK_COMM_LEN of kernel */
+#define PROC_SNAPSHOT_TTL_MS        1000    /* a snapshot younger than this is shared by all tasks */
+
+struct proc_entry {
+    unsigned int pid;
+    unsigned int ppid;
+    char comm[PROC_COMM_LEN];
+};
+
+struct proc_child {
+    unsigned int ppid;
+    unsigned int pid;
+};
+
+/* one walk of /proc, the arrays are read only after the snapshot is built */
+struct proc_snapshot {
+    struct proc_entry *entries;     /* sorted by pid */
+    struct proc_child *children;    /* sorted by ppid, then pid */
+    struct proc_entry **by_name;    /* entries sorted by comm, then pid */
+    size_t nr;
+    struct timespec time;
+    int refs;
+};
+
+struct proc_snapshot *etmemd_proc_snapshot_get(void);
+void etmemd_proc_snapshot_put(struct proc_snapshot *snap);
+void etmemd_proc_snapshot_invalidate(void);
+
+int etmemd_proc_snapshot_find_name(const struct proc_snapshot *snap, const char *name, unsigned int *pid);
+size_t etmemd_proc_snapshot_children(const struct proc_snapshot *snap, unsigned int ppid,
+                                     const struct proc_child **children);
+
+#endif
@@ -0,0 +1,38 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for process lifecycle events.
+ ******************************************************************************/
+
+#ifndef ETMEMD_PROC_EVENT_H
+#define ETMEMD_PROC_EVENT_H
+
+#include <stdbool.h>
+#include "etmemd_task.h"
+
+#define PROC_WATCH_HASH_SIZE        1024
+#define PROC_EVENT_POLL_MS          1000    /* also the interval to check stop of the listener */
+#define PROC_EVENT_KICK_MS          1000    /* pids of tasks are refreshed at most once in this interval */
+#define PROC_EVENT_KICK_MAX         64
+
+/* pids in task lists are watched, so the listener can find them by pid */
+void etmemd_proc_watch_add(struct task_pid *tk_pid);
+void etmemd_proc_watch_del(struct task_pid *tk_pid);
+/* tasks of name type are refreshed when a process gets the name */
+void etmemd_proc_watch_task(struct task *tk);
+void etmemd_proc_watch_forget_task(const struct task *tk);
+
+/* the netlink proc connector listener is shared by projects, it is refcounted */
+int etmemd_proc_event_start(void);
+void etmemd_proc_event_stop(void);
+
+#endif
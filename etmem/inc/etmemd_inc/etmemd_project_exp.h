@@ -24,10 +24,19 @@ enum scan_type {
     REGION_SCAN,
 };
 
+/* where the access of pages is read from in a page scan project */
+enum scan_source {
+    SCAN_SRC_IDLE_PAGES = 0,
+    SCAN_SRC_DAMON,             /* region snapshots of damon, idle_pages for the pids not monitored */
+    SCAN_SRC_PAGE_IDLE,         /* pagemap with the page_idle bitmap, for kernels without etmem_scan */
+};
+
 struct page_scan {
     int interval;
     int loop;
     int sleep;
+    enum scan_source source;
+    void *monitor;              /* damon monitor of the started project */
 };
 
 struct region_scan {
@@ -36,8 +45,11 @@ struct region_scan {
     unsigned long update_interval;
     unsigned long min_nr_regions;
     unsigned long max_nr_regions;
+    enum scan_source source;    /* read by the userspace sampler when damon is not in the kernel */
 };
 
+struct project_rank;
+
 struct project {
     char *name;
     enum scan_type type;
@@ -45,6 +57,10 @@ struct project {
     int sysmem_threshold;
     int swapcache_high_wmark;
     int swapcache_low_wmark;
+    bool proc_event;
+    bool proc_event_started;
+    int global_dram_percent;    /* 0 if the pages of each pid are ranked alone */
+    struct project_rank *rank;
     bool start;
     bool wmark_set;
     struct engine *engs;
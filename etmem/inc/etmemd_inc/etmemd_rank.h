@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for project wide cold ranking.
+ ******************************************************************************/
+
+#ifndef ETMEMD_RANK_H
+#define ETMEMD_RANK_H
+
+#include <pthread.h>
+#include "etmemd_task.h"
+#include "etmemd_project_exp.h"
+
+#define RANK_BIN_NUM        101     /* possibility of being visited in percent, [0, 100] */
+
+/* hotness histogram in KB of one pid, the latest one published */
+struct rank_pid {
+    unsigned long hist[RANK_BIN_NUM];
+    unsigned long rss;
+    unsigned long swap;
+};
+
+/* sum of the latest histograms of all pids in the project */
+struct project_rank {
+    pthread_mutex_t lock;
+    unsigned long hist[RANK_BIN_NUM];
+    unsigned long rss;
+    unsigned long swap;
+};
+
+/* pages colder than bin are swapped, and fraction of the pages in bin */
+struct rank_cutoff {
+    int bin;
+    double fraction;
+};
+
+int etmemd_rank_init(struct project *proj);
+void etmemd_rank_free(struct project *proj);
+
+int etmemd_rank_bin(double possibility);
+int etmemd_rank_publish(struct task_pid *tk_pid, const unsigned long *hist, unsigned long rss, unsigned long swap);
+void etmemd_rank_pid_release(struct task_pid *tk_pid);
+void etmemd_rank_cutoff(struct project *proj, struct rank_cutoff *cutoff);
+
+#endif
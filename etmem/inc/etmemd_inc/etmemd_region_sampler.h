@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the function declaration for the userspace region sampler.
+ ******************************************************************************/
+
+#ifndef ETMEMD_REGION_SAMPLER_H
+#define ETMEMD_REGION_SAMPLER_H
+
+#include "etmemd_project_exp.h"
+#include "etmemd_damon.h"
+
+#define SAMPLER_MERGE_THRES_DIV     10  /* regions within max_nr_accesses / 10 are merged */
+#define SAMPLER_SPLIT_MAX_SUBS      3
+#define SAMPLER_SPLIT_RAND_MAX      10  /* a region is split at a random tenth of it */
+
+struct region_sampler;
+
+/* called by the sampler thread with the regions of a pid at the end of each aggregation */
+typedef void (*region_aggr_fn)(void *arg, unsigned int pid, const struct damon_regions *regions);
+
+/*
+ * monitor the pids like the vaddr operations of damon, but in userspace: one page of each region is
+ * checked through the backend of attrs->source every sample_interval, so the overhead is bounded by
+ * the count of regions.
+ */
+struct region_sampler *region_sampler_start(const struct region_scan *attrs, const unsigned int *pids, int nr_pids,
+                                            region_aggr_fn aggr_fn, void *arg);
+void region_sampler_stop(struct region_sampler *sampler);
+
+#endif
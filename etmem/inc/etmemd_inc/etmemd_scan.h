@@ -21,6 +21,7 @@
 #include "etmemd_task.h"
 #include "etmemd_scan_exp.h"
 #include "etmemd_common.h"
+#include "etmemd_project_exp.h"
 
 #define VMA_SEG_CNT_MAX         6
 #define VMA_PERMS_STR_LEN       5
@@ -35,10 +36,15 @@
 #define SMAPS_FILE              "/smaps"
 #define VMFLAG_HEAD             "VmFlags"
 
+/* number of possibility intervals of sort_by_possibility */
+#define PAGE_SORT_NUM           5
+
 #define IDLE_SCAN_MAGIC         0x66
 #define IDLE_SCAN_ADD_FLAGS     _IOW(IDLE_SCAN_MAGIC, 0x0, unsigned int)
 #define VMA_SCAN_ADD_FLAGS      _IOW(IDLE_SCAN_MAGIC, 0x2, unsigned int)
 #define ALL_SCAN_FLAGS          (SCAN_AS_HUGE | SCAN_IGN_HOST | VMA_SCAN_FLAG)
+/* not an ioctl flag, etmem_scan reports PTE_DIRTY and PMD_DIRTY to the readers opened with O_NOATIME */
+#define SCAN_DIRTY_PAGE         O_NOATIME
 
 enum page_idle_type {
     PTE_ACCESS = 0,     /* 4k page */
@@ -68,16 +74,39 @@ struct walk_address {
     uint64_t last_walk_end;             /* last walk address end */
 };
 
-/* the caller need to judge value returned by etmemd_do_scan(), NULL means fail. */
-struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task *tk);
+/* the pages of one process built from damon regions */
+struct region_walk {
+    int pagemap_fd;                     /* pages not present are skipped, -1 to take all pages as present */
+    unsigned long budget;               /* page_refs left to build, from the rss of the process */
+    enum page_type type;                /* size of the pages built, the page size of the vmas walked */
+};
+
+/*
+ * the caller need to judge value returned by etmemd_do_scan(), NULL means fail.
+ * scan_flags are added to the flags of the scan, SCAN_DIRTY_PAGE to count the loops pages are dirty in.
+ */
+struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task *tk, unsigned int scan_flags);
 
 /* free vma list struct */
 void free_vmas(struct vmas *vmas);
 
 int sort_by_possibility(double p);
-struct page_refs **walk_vmas(int fd, struct walk_address *walk_address, struct page_refs **pf, unsigned long *use_rss, int loop_index, int loop_end);
+struct scan_backend;
+struct page_refs **walk_vmas(struct scan_backend *backend, struct walk_address *walk_address, struct page_refs **pf,
+                             unsigned long *use_rss, int loop_index, int loop_end);
+
+/* 1 if the page at addr is accessed since the last read of it, the region sampler checks one page a time */
+int sample_page_access(struct scan_backend *backend, uint64_t addr);
+
+struct damon_regions;
+/* build page_refs from the damon regions within walk_address instead of reading idle_pages */
+void region_walk_open(struct region_walk *walk, const char *pid, enum page_type type);
+void region_walk_close(struct region_walk *walk);
+struct page_refs **walk_regions(const struct damon_regions *regions, int *cursor, const struct walk_address *walk_address,
+                                int max_count, struct region_walk *walk, struct page_refs **pf);
 int get_page_refs(const struct vmas *vmas, const char *pid, struct page_refs **page_refs,
-                  unsigned long *use_rss, struct ioctl_para *ioctl_para, int loop_idx, int loop_end);
+                  unsigned long *use_rss, struct ioctl_para *ioctl_para, enum scan_source source,
+                  int loop_idx, int loop_end);
 
 int split_vmflags(char ***vmflags_array, char *vmflags);
 struct vmas *get_vmas_with_flags(const char *pid, char **vmflags_array, int vmflags_num, bool is_anon_only);
@@ -88,7 +117,10 @@ void clean_memory_grade_unexpected(void *arg);
 
 void clean_page_sort_unexpected(void *arg);
 struct page_sort *alloc_page_sort(const struct task_pid *tk_pid);
-struct page_sort *sort_page_refs(struct page_refs **page_refs, const struct task_pid *tk_pid);
+struct slide_params;
+/* bin the pages by the eviction cost of slide_params when only the coldest of them are swapped out */
+struct page_sort *sort_page_refs(struct page_refs **page_refs, const struct task_pid *tk_pid,
+                                 const struct slide_params *slide_params);
 
 struct page_refs *add_page_refs_into_memory_grade(struct page_refs *page_refs, struct page_refs **list);
 int init_g_page_size(void);
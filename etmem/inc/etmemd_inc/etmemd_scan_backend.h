@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a header file of the backends which read the access of pages for scan.
+ ******************************************************************************/
+
+#ifndef ETMEMD_SCAN_BACKEND_H
+#define ETMEMD_SCAN_BACKEND_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "etmemd_common.h"
+#include "etmemd_project_exp.h"
+
+#define PAGEMAP_FILE            "/pagemap"
+#define PAGE_IDLE_BITMAP        "/sys/kernel/mm/page_idle/bitmap"
+
+#define PAGEMAP_PRESENT         (1ULL << 63)
+#define PAGEMAP_PFN_MASK        ((1ULL << 55) - 1)
+#define PAGE_IDLE_BATCH         512     /* pages of one pmd, the pagemap entries read at once */
+#define PAGE_IDLE_WORD_BITS     64      /* the bitmap is only accessed in 8-byte words */
+
+struct scan_backend;
+
+struct scan_backend_ops {
+    const char *name;
+    int (*open)(struct scan_backend *backend, const char *pid, struct ioctl_para *ioctl_para);
+    /*
+     * fill buf with the access of the pages from addr in the format of idle_pages, a buffer of size
+     * covers size * 8 pages at most. the access is cleared for the pages reported.
+     * return the bytes filled, or -1 on failure.
+     */
+    ssize_t (*read)(struct scan_backend *backend, uint64_t addr, unsigned char *buf, size_t size);
+    void (*close)(struct scan_backend *backend);
+};
+
+struct scan_backend {
+    const struct scan_backend_ops *ops;
+    void *priv;
+};
+
+/*
+ * idle_pages is read for SCAN_SRC_IDLE_PAGES and SCAN_SRC_DAMON, the pagemap of the pid with
+ * the page_idle bitmap for SCAN_SRC_PAGE_IDLE, which works on kernels without the etmem_scan module.
+ */
+int scan_backend_open(struct scan_backend *backend, enum scan_source source,
+                      const char *pid, struct ioctl_para *ioctl_para);
+void scan_backend_close(struct scan_backend *backend);
+
+static inline ssize_t scan_backend_read(struct scan_backend *backend, uint64_t addr,
+                                        unsigned char *buf, size_t size)
+{
+    return backend->ops->read(backend, addr, buf, size);
+}
+
+#endif
@@ -24,6 +24,13 @@ struct slide_params {
     int t;          /* watermark */
     unsigned long swap_threshold;
     uint8_t dram_percent;
+    int warm_t;     /* pages in [t, warm_t) go to slow_node, 0 if there is no slow node */
+    int slow_node;
+    int dirty_weight;   /* percent added to the eviction cost of a page seen dirty in every loop */
+    /* hooks of engines built on slide, NULL for slide engine itself,
+     * scan_hook is called in every loop, grade_hook only if pages are to be migrated */
+    void (*scan_hook)(struct task_pid *tk_pid, const struct page_refs *page_refs);
+    void (*grade_hook)(struct task_pid *tk_pid, struct memory_grade *memory_grade);
 };
 
 enum swap_type {
@@ -33,4 +40,16 @@ enum swap_type {
 
 int fill_engine_type_slide(struct engine *eng, GKeyFile *config);
 
+/* parse T, swap_threshold and dram_percent of a task into params */
+int slide_fill_params(GKeyFile *config, struct slide_params *params);
+
+/*
+ * the cost of evicting a page, its possibility of being visited plus the share of the loops it is
+ * dirty in weighted by dirty_weight, in [0, 1]. it is the possibility alone if dirty_weight is 0.
+ */
+double slide_evict_cost(const struct page_refs *page_refs, const struct slide_params *params, int loop);
+
+/* run one scan and swap out cycle of slide for tk_pid with params, return 0 if cold pages are migrated */
+int slide_do_executor(struct task_pid *tk_pid, const struct slide_params *params);
+
 #endif
@@ -21,12 +21,22 @@
 #include <glib.h>
 #include "etmemd_threadpool.h"
 #include "etmemd_threadtimer.h"
+#include "etmemd_common.h"
 #include "etmemd_task_exp.h"
 
 struct task_pid {
     unsigned int pid;
     float rt_swapin_rate;   /* real time swapin rate */
     void *params;           /* pid personal parameter */
+    struct mem_snapshot mem_snap;   /* memory counters shared by checks of one cycle */
+    int pidfd;              /* readable when the process exits, -1 if pidfd is not supported */
+    bool exited;            /* set by the proc event listener */
+    bool root;              /* the pid of task, not one of its children */
+    bool watched;
+    struct task_pid *watch_next;    /* hash chain of proc event watchers */
+    unsigned long cold_pages;       /* cold pages found in this interval, used by cgroup task */
+    unsigned long cold_prev;        /* cold pages found in the last interval */
+    struct rank_pid *rank;  /* histogram published to the project rank */
     struct task *tk;        /* point to its task */
     struct task_pid *next;
 };
@@ -37,6 +47,10 @@ void etmemd_free_task_pids(struct task *tk);
 
 int get_pid_from_task_type(const struct task *tk, char *pid);
 
+int etmemd_task_pid_mem_usage(struct task_pid *tk_pid, unsigned long *rss, unsigned long *swap);
+bool etmemd_task_pid_exited(const struct task_pid *tk_pid);
+bool etmemd_task_pid_sleep(const struct task_pid *tk_pid, unsigned int seconds);
+
 void etmemd_free_task_struct(struct task **tk);
 
 void free_task_pid_mem(struct task_pid **tk_pid);
@@ -23,6 +23,7 @@ struct timer_thread_t;
 typedef struct timer_thread_t timer_thread;
 struct thread_pool_t;
 typedef struct thread_pool_t thread_pool;
+struct cgroup_task;
 
 struct task {
     char *type;
@@ -34,6 +35,7 @@ struct task {
     struct task_pid *pids;
     struct engine *eng;
     void *params;
+    struct cgroup_task *cgroup; /* only for the task of cgroup type */
     pthread_t task_pt;
     timer_thread *timer_inst;
     thread_pool *threadpool_inst;
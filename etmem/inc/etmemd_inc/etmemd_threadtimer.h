@@ -22,7 +22,10 @@ typedef struct timer_thread_t {
     pthread_mutex_t cond_mutex;
     pthread_cond_t cond;
     bool down;
+    bool kicked;
+    bool refresh;
     user_functional functor;
+    user_functional refresher;  /* called with user_param on refresh, NULL to ignore refresh */
     void *user_param;
     int expired_time;
     pthread_t pthread;
@@ -38,6 +41,21 @@ timer_thread* thread_timer_create(int seconds);
  * */
 int thread_timer_start(timer_thread* inst, void *(*executor)(void *arg), void *arg);
 
+/*
+ * Run the executor of timer thread instances now instead of waiting for the interval
+ * */
+void thread_timer_kick(timer_thread* inst);
+
+/*
+ * Set the light work done on refresh of timer thread instances, it must be set before start
+ * */
+void thread_timer_set_refresher(timer_thread* inst, void *(*refresher)(void *arg));
+
+/*
+ * Run the refresher of timer thread instances now, the executor still runs at its interval
+ * */
+void thread_timer_refresh(timer_thread* inst);
+
 /*
  * Stop timer thread instances
  * */
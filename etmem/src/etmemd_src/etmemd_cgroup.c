@@ -0,0 +1,553 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Manage all processes of a cgroup v2 with the memory counters of the cgroup.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_cgroup.h"
+
+#define CGROUP_PROCS_FILE           "cgroup.procs"
+#define CGROUP_EVENTS_FILE          "cgroup.events"
+#define CGROUP_CURRENT_FILE         "memory.current"
+#define CGROUP_STAT_FILE            "memory.stat"
+#define CGROUP_SWAP_FILE            "memory.swap.current"
+#define CGROUP_WATCH_MAX            256
+#define BYTE_TO_KB(s)               ((s) >> 10)
+
+struct cgroup_watch {
+    int wd;
+    struct task *tk;
+};
+
+static struct cgroup_watch g_cg_watches[CGROUP_WATCH_MAX];
+static int g_cg_watch_num = 0;
+static int g_cg_inotify_fd = -1;
+static pthread_t g_cg_watch_thread;
+static pthread_mutex_t g_cg_watch_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* the path is relative to the cgroup v2 root, "/" and ".." is not allowed to leave it */
+bool etmemd_cgroup_path_valid(const char *path)
+{
+    const char *c = NULL;
+    size_t len;
+
+    if (path == NULL) {
+        return false;
+    }
+
+    len = strlen(path);
+    if (len == 0 || len >= CGROUP_PATH_MAX_LEN || strstr(path, "..") != NULL) {
+        return false;
+    }
+
+    for (c = path; *c != '\0'; c++) {
+        if ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9')) {
+            continue;
+        }
+        if (strchr("._-/:@", *c) == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static char *get_cgroup_file_path(const char *dir, const char *file)
+{
+    size_t len = strlen(dir) + strlen(file) + 2;
+    char *path = NULL;
+
+    path = (char *)calloc(len, sizeof(char));
+    if (path == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for cgroup file path fail\n");
+        return NULL;
+    }
+
+    if (snprintf_s(path, len, len - 1, "%s/%s", dir, file) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for cgroup file %s/%s fail\n", dir, file);
+        free(path);
+        return NULL;
+    }
+
+    return path;
+}
+
+static int open_cgroup_file(const char *dir, const char *file)
+{
+    char *path = NULL;
+    int fd;
+
+    path = get_cgroup_file_path(dir, file);
+    if (path == NULL) {
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "open %s fail, errno: %d\n", path, errno);
+    }
+
+    free(path);
+    return fd;
+}
+
+int etmemd_cgroup_task_init(struct task *tk)
+{
+    struct cgroup_task *cg = NULL;
+    const char *rel = tk->value;
+    size_t len;
+
+    if (!etmemd_cgroup_path_valid(tk->value)) {
+        etmemd_log(ETMEMD_LOG_ERR, "invalid cgroup path %s\n", tk->value);
+        return -1;
+    }
+
+    cg = (struct cgroup_task *)calloc(1, sizeof(struct cgroup_task));
+    if (cg == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for cgroup task fail\n");
+        return -1;
+    }
+
+    /* both "/sys/fs/cgroup/a/b" and "a/b" stand for the same cgroup */
+    if (strncmp(rel, CGROUP2_ROOT, strlen(CGROUP2_ROOT)) == 0) {
+        rel += strlen(CGROUP2_ROOT);
+    }
+    while (*rel == '/') {
+        rel++;
+    }
+
+    len = strlen(CGROUP2_ROOT) + strlen(rel) + 2;
+    cg->path = (char *)calloc(len, sizeof(char));
+    if (cg->path == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for cgroup path fail\n");
+        free(cg);
+        return -1;
+    }
+    if (snprintf_s(cg->path, len, len - 1, "%s/%s", CGROUP2_ROOT, rel) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for cgroup path %s fail\n", rel);
+        free(cg->path);
+        free(cg);
+        return -1;
+    }
+
+    cg->current_fd = -1;
+    cg->stat_fd = -1;
+    cg->swap_fd = -1;
+    cg->events_wd = -1;
+    tk->cgroup = cg;
+    return 0;
+}
+
+static void close_cgroup_fds(struct cgroup_task *cg)
+{
+    if (cg->current_fd >= 0) {
+        close(cg->current_fd);
+        cg->current_fd = -1;
+    }
+    if (cg->stat_fd >= 0) {
+        close(cg->stat_fd);
+        cg->stat_fd = -1;
+    }
+    if (cg->swap_fd >= 0) {
+        close(cg->swap_fd);
+        cg->swap_fd = -1;
+    }
+}
+
+void etmemd_cgroup_task_free(struct task *tk)
+{
+    if (tk->cgroup == NULL) {
+        return;
+    }
+
+    close_cgroup_fds(tk->cgroup);
+    free(tk->cgroup->path);
+    free(tk->cgroup);
+    tk->cgroup = NULL;
+}
+
+static int add_pid(unsigned int **pids, size_t *nr, size_t *cap, unsigned int pid)
+{
+    unsigned int *tmp = NULL;
+    size_t new_cap;
+
+    if (*nr == *cap) {
+        new_cap = *cap == 0 ? CGROUP_PIDS_INIT_NUM : *cap * 2;
+        tmp = (unsigned int *)realloc(*pids, new_cap * sizeof(unsigned int));
+        if (tmp == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "realloc for cgroup pids fail\n");
+            return -1;
+        }
+        *pids = tmp;
+        *cap = new_cap;
+    }
+
+    (*pids)[(*nr)++] = pid;
+    return 0;
+}
+
+static int read_cgroup_procs(const char *dir, unsigned int **pids, size_t *nr, size_t *cap)
+{
+    char line[FILE_LINE_MAX_LEN] = {0};
+    char *path = NULL;
+    unsigned int pid;
+    FILE *fp = NULL;
+    int ret = 0;
+
+    path = get_cgroup_file_path(dir, CGROUP_PROCS_FILE);
+    if (path == NULL) {
+        return -1;
+    }
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "open %s fail, errno: %d\n", path, errno);
+        free(path);
+        return -1;
+    }
+    free(path);
+
+    while (fgets(line, FILE_LINE_MAX_LEN, fp) != NULL) {
+        if (line[strlen(line) - 1] == '\n') {
+            line[strlen(line) - 1] = '\0';
+        }
+        if (get_unsigned_int_value(line, &pid) != 0) {
+            continue;
+        }
+        if (add_pid(pids, nr, cap, pid) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+static int read_cgroup_tree(const char *dir, bool recursive, unsigned int **pids, size_t *nr, size_t *cap)
+{
+    struct dirent *dent = NULL;
+    char *child = NULL;
+    DIR *d = NULL;
+    int ret;
+
+    ret = read_cgroup_procs(dir, pids, nr, cap);
+    if (ret != 0 || !recursive) {
+        return ret;
+    }
+
+    d = opendir(dir);
+    if (d == NULL) {
+        return 0;
+    }
+
+    while ((dent = readdir(d)) != NULL) {
+        if (dent->d_type != DT_DIR || strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) {
+            continue;
+        }
+
+        child = get_cgroup_file_path(dir, dent->d_name);
+        if (child == NULL) {
+            ret = -1;
+            break;
+        }
+        /* the child cgroup may be removed while walking, it is not an error */
+        if (read_cgroup_tree(child, true, pids, nr, cap) != 0 && errno != ENOENT) {
+            etmemd_log(ETMEMD_LOG_DEBUG, "read procs of cgroup %s fail\n", child);
+        }
+        free(child);
+    }
+
+    closedir(d);
+    return ret;
+}
+
+static int pid_cmp(const void *a, const void *b)
+{
+    unsigned int pa = *(const unsigned int *)a;
+    unsigned int pb = *(const unsigned int *)b;
+
+    if (pa != pb) {
+        return pa < pb ? -1 : 1;
+    }
+    return 0;
+}
+
+/* pids of the cgroup in ascending order without duplicates, the caller frees *pids */
+int etmemd_cgroup_get_pids(const struct cgroup_task *cg, unsigned int **pids, size_t *nr)
+{
+    size_t cap = 0;
+    size_t i;
+    size_t j = 0;
+
+    *pids = NULL;
+    *nr = 0;
+    if (read_cgroup_tree(cg->path, cg->recursive, pids, nr, &cap) != 0) {
+        etmemd_safe_free((void **)pids);
+        *nr = 0;
+        return -1;
+    }
+
+    if (*nr == 0) {
+        return 0;
+    }
+
+    qsort(*pids, *nr, sizeof(unsigned int), pid_cmp);
+    for (i = 1; i < *nr; i++) {
+        if ((*pids)[i] != (*pids)[j]) {
+            (*pids)[++j] = (*pids)[i];
+        }
+    }
+    *nr = j + 1;
+    return 0;
+}
+
+static int refresh_cgroup_mem(struct cgroup_task *cg)
+{
+    unsigned long current;
+    unsigned long file = 0;
+    unsigned long swap = 0;
+    struct proc_mem_key key = {"file", &file, false};
+
+    cg->mem.valid = false;
+    if (cg->current_fd < 0) {
+        cg->current_fd = open_cgroup_file(cg->path, CGROUP_CURRENT_FILE);
+        cg->stat_fd = open_cgroup_file(cg->path, CGROUP_STAT_FILE);
+        /* memory.swap.current does not exist if swap is not accounted */
+        cg->swap_fd = open_cgroup_file(cg->path, CGROUP_SWAP_FILE);
+    }
+
+    if (get_ulong_from_fd(cg->current_fd, &current) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get %s of cgroup %s fail\n", CGROUP_CURRENT_FILE, cg->path);
+        /* the cgroup may be removed and created again, open files again next time */
+        close_cgroup_fds(cg);
+        return -1;
+    }
+    if (cg->stat_fd >= 0 && get_mem_from_proc_fd(cg->stat_fd, &key, 1) != 0) {
+        file = 0;
+    }
+    if (cg->swap_fd >= 0 && get_ulong_from_fd(cg->swap_fd, &swap) != 0) {
+        swap = 0;
+    }
+
+    cg->mem.current = BYTE_TO_KB(current);
+    cg->mem.file = BYTE_TO_KB(file);
+    cg->mem.swap = BYTE_TO_KB(swap);
+    cg->mem.valid = true;
+    return 0;
+}
+
+/*
+ * called once per interval before the pids are updated for the executors, the cold pages of members
+ * counted in the last interval are the weight to distribute the reclaim target of this interval.
+ */
+void etmemd_cgroup_roll_cold(struct task *tk)
+{
+    struct task_pid *tk_pid = NULL;
+
+    for (tk_pid = tk->pids; tk_pid != NULL; tk_pid = tk_pid->next) {
+        tk_pid->cold_prev = tk_pid->cold_pages;
+        tk_pid->cold_pages = 0;
+    }
+}
+
+/* called whenever the pids are updated, also between intervals, so the weight is only summed here */
+int etmemd_cgroup_refresh(struct task *tk)
+{
+    struct cgroup_task *cg = tk->cgroup;
+    struct task_pid *tk_pid = NULL;
+
+    cg->cold_sum = 0;
+    cg->nr_pids = 0;
+    for (tk_pid = tk->pids; tk_pid != NULL; tk_pid = tk_pid->next) {
+        cg->cold_sum += tk_pid->cold_prev;
+        cg->nr_pids++;
+    }
+
+    return refresh_cgroup_mem(cg);
+}
+
+/* usage of the cgroup in KB, page cache is not counted as it is not swapped by etmem */
+int etmemd_cgroup_mem_usage(const struct cgroup_task *cg, unsigned long *rss, unsigned long *swap)
+{
+    if (!cg->mem.valid) {
+        return -1;
+    }
+
+    *rss = cg->mem.current > cg->mem.file ? cg->mem.current - cg->mem.file : 0;
+    *swap = cg->mem.swap;
+    return 0;
+}
+
+/* the part of need_pages of the cgroup that tk_pid should reclaim */
+unsigned long etmemd_cgroup_share(const struct task_pid *tk_pid, unsigned long need_pages)
+{
+    const struct cgroup_task *cg = tk_pid->tk->cgroup;
+
+    if (cg->nr_pids == 0 || need_pages == 0) {
+        return 0;
+    }
+
+    /* no history in the first interval, distribute evenly */
+    if (cg->cold_sum == 0) {
+        return need_pages / cg->nr_pids + 1;
+    }
+
+    return (unsigned long)((double)need_pages * tk_pid->cold_prev / cg->cold_sum);
+}
+
+static void handle_cgroup_events(const char *buf, ssize_t len)
+{
+    const struct inotify_event *ev = NULL;
+    ssize_t off = 0;
+    int i;
+
+    pthread_mutex_lock(&g_cg_watch_mtx);
+    while (off + (ssize_t)sizeof(struct inotify_event) <= len) {
+        ev = (const struct inotify_event *)(buf + off);
+        for (i = 0; i < g_cg_watch_num; i++) {
+            if (g_cg_watches[i].wd == ev->wd) {
+                thread_timer_refresh(g_cg_watches[i].tk->timer_inst);
+            }
+        }
+        off += (ssize_t)sizeof(struct inotify_event) + ev->len;
+    }
+    pthread_mutex_unlock(&g_cg_watch_mtx);
+}
+
+static void *cgroup_watch_routine(void *arg)
+{
+    char buf[sizeof(struct inotify_event) * CGROUP_WATCH_MAX] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = g_cg_inotify_fd, .events = POLLIN };
+    ssize_t len;
+
+    for (;;) {
+        if (poll(&pfd, 1, CGROUP_WATCH_POLL_MS) <= 0 || (pfd.revents & POLLIN) == 0) {
+            continue;
+        }
+
+        len = read(g_cg_inotify_fd, buf, sizeof(buf));
+        if (len > 0) {
+            handle_cgroup_events(buf, len);
+        }
+    }
+
+    return NULL;
+}
+
+/* the watch thread is started by the first cgroup task and lives as long as etmemd, must hold g_cg_watch_mtx */
+static int start_cgroup_watch_thread(void)
+{
+    g_cg_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_cg_inotify_fd < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "inotify_init1 fail, errno: %d\n", errno);
+        return -1;
+    }
+
+    if (pthread_create(&g_cg_watch_thread, NULL, cgroup_watch_routine, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "create cgroup watch thread fail\n");
+        close(g_cg_inotify_fd);
+        g_cg_inotify_fd = -1;
+        return -1;
+    }
+    (void)pthread_detach(g_cg_watch_thread);
+
+    return 0;
+}
+
+void etmemd_cgroup_watch_add(struct task *tk)
+{
+    struct cgroup_task *cg = tk->cgroup;
+    char *path = NULL;
+
+    if (cg == NULL || tk->timer_inst == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_cg_watch_mtx);
+    if (g_cg_watch_num == CGROUP_WATCH_MAX) {
+        etmemd_log(ETMEMD_LOG_WARN, "too many cgroups are watched, %s is checked by interval\n", cg->path);
+        goto out;
+    }
+    if (g_cg_inotify_fd < 0 && start_cgroup_watch_thread() != 0) {
+        goto out;
+    }
+
+    path = get_cgroup_file_path(cg->path, CGROUP_EVENTS_FILE);
+    if (path == NULL) {
+        goto out;
+    }
+
+    cg->events_wd = inotify_add_watch(g_cg_inotify_fd, path, IN_MODIFY);
+    if (cg->events_wd < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "watch %s fail, errno: %d\n", path, errno);
+        free(path);
+        goto out;
+    }
+    free(path);
+
+    g_cg_watches[g_cg_watch_num].wd = cg->events_wd;
+    g_cg_watches[g_cg_watch_num].tk = tk;
+    g_cg_watch_num++;
+
+out:
+    pthread_mutex_unlock(&g_cg_watch_mtx);
+}
+
+/* called after the timer of task is stopped and before it is destroyed */
+void etmemd_cgroup_watch_del(struct task *tk)
+{
+    struct cgroup_task *cg = tk->cgroup;
+    bool shared = false;
+    int i;
+
+    if (cg == NULL || cg->events_wd < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_cg_watch_mtx);
+    for (i = 0; i < g_cg_watch_num; i++) {
+        if (g_cg_watches[i].tk == tk) {
+            g_cg_watches[i] = g_cg_watches[g_cg_watch_num - 1];
+            g_cg_watch_num--;
+            break;
+        }
+    }
+
+    /* tasks of the same cgroup share one watch descriptor */
+    for (i = 0; i < g_cg_watch_num; i++) {
+        if (g_cg_watches[i].wd == cg->events_wd) {
+            shared = true;
+            break;
+        }
+    }
+    /* the watch is already removed by kernel if the cgroup is removed */
+    if (!shared) {
+        (void)inotify_rm_watch(g_cg_inotify_fd, cg->events_wd);
+    }
+    cg->events_wd = -1;
+    pthread_mutex_unlock(&g_cg_watch_mtx);
+}
@@ -216,36 +216,6 @@ void etmemd_safe_free(void **ptr)
     *ptr = NULL;
 }
 
-static int get_status_num(char *getline, char *value, size_t value_len)
-{
-    size_t len = strlen(getline);
-    int start_cp_index = 0;
-    int end_cp_index = 0;
-    size_t i;
-
-    for (i = 0; i < len; i++) {
-        if (isdigit(getline[i])) {
-            start_cp_index = i;
-            end_cp_index = start_cp_index;
-            break;
-        }
-    }
-
-    for (; i < len; i++) {
-        if (!isdigit(getline[i])) {
-            end_cp_index = i - 1;
-            break;
-        }
-    }
-
-    if (strncpy_s(value, value_len, getline + start_cp_index, end_cp_index - start_cp_index + 1) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "strncpy_s for result failed.\n");
-        return -1;
-    }
-
-    return 0;
-}
-
 static char *etmemd_get_proc_file_str(const char *pid, const char *file)
 {
     char *file_name = NULL;
@@ -315,6 +285,30 @@ FILE *etmemd_get_proc_file(const char *pid, const char *file, const char *mode)
     return fp;
 }
 
+int etmemd_open_proc_file(const char *pid, const char *file, int flags)
+{
+    char *file_name = NULL;
+    int fd;
+
+    if (file == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "etmemd_open_proc_file file should not be NULL\n");
+        return -1;
+    }
+
+    file_name = etmemd_get_proc_file_str(pid, file);
+    if (file_name == NULL) {
+        return -1;
+    }
+
+    fd = open(file_name, flags);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open file %s fail\n", file_name);
+    }
+
+    free(file_name);
+    return fd;
+}
+
 static inline bool is_valid_char_for_value(const char *valid, char c)
 {
     return strchr(valid, c) != NULL;
@@ -427,44 +421,266 @@ int dprintf_all(int fd, const char *format, ...)
     return 0;
 }
 
-int get_mem_from_proc_file(const char *pid, const char *file_name, unsigned long *data, const char *cmpstr)
+int etmemd_open_proc_fd(const char *pid, const char *file_name)
 {
-    FILE *file = NULL;
-    char value[KEY_VALUE_MAX_LEN] = {};
-    char get_line[FILE_LINE_MAX_LEN] = {};
-    unsigned long val;
-    int ret = -1;
+    char *file_path = NULL;
+    int fd;
 
-    file = etmemd_get_proc_file(pid, file_name, "r");
-    if (file == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "cannot open %s for pid %s\n", file_name, pid);
-        return ret;
+    if (file_name == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "etmemd_open_proc_fd file should not be NULL\n");
+        return -1;
     }
 
-    while (fgets(get_line, FILE_LINE_MAX_LEN - 1, file) != NULL) {
-        if (strstr(get_line, cmpstr) == NULL) {
+    file_path = etmemd_get_proc_file_str(pid, file_name);
+    if (file_path == NULL) {
+        return -1;
+    }
+
+    fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "open %s fail, errno: %d\n", file_path, errno);
+    }
+
+    free(file_path);
+    return fd;
+}
+
+/* read the whole file from offset 0 without moving the file position, so the fd can be reused */
+ssize_t etmemd_pread_file(int fd, char *buf, size_t buf_len)
+{
+    size_t len = 0;
+    ssize_t ret;
+
+    if (fd < 0 || buf == NULL || buf_len == 0) {
+        return -1;
+    }
+
+    while (len < buf_len - 1) {
+        ret = pread(fd, buf + len, buf_len - 1 - len, (off_t)len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (ret == 0) {
+            break;
+        }
+        len += (size_t)ret;
+    }
+
+    buf[len] = '\0';
+    return (ssize_t)len;
+}
+
+static int match_proc_mem_key(const char *line, struct proc_mem_key *keys, int key_num)
+{
+    size_t key_len;
+    int i;
+
+    for (i = 0; i < key_num; i++) {
+        if (keys[i].found) {
             continue;
         }
+        key_len = strlen(keys[i].key);
+        /* "Key:  value" of proc status files, or "key value" of vmstat and cgroup memory.stat */
+        if (strncmp(line, keys[i].key, key_len) == 0 && (line[key_len] == ':' || line[key_len] == ' ')) {
+            return i;
+        }
+    }
 
-        if (get_status_num(get_line, value, KEY_VALUE_MAX_LEN) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "get mem from /proc/%s/%s fail\n", pid, file_name);
-            break;
+    return -1;
+}
+
+/* parse all the keys in one pass of buf, return 0 only if every key is found */
+int get_mem_from_proc_buf(const char *buf, struct proc_mem_key *keys, int key_num)
+{
+    const char *line = buf;
+    const char *val = NULL;
+    char *endptr = NULL;
+    int left = key_num;
+    int idx;
+
+    if (buf == NULL || keys == NULL) {
+        return -1;
+    }
+
+    for (idx = 0; idx < key_num; idx++) {
+        keys[idx].found = false;
+    }
+
+    while (line != NULL && *line != '\0' && left > 0) {
+        idx = match_proc_mem_key(line, keys, key_num);
+        if (idx >= 0) {
+            val = line + strlen(keys[idx].key) + 1;
+            while (*val == ' ' || *val == '\t') {
+                val++;
+            }
+            errno = 0;
+            *keys[idx].value = strtoul(val, &endptr, DECIMAL_RADIX);
+            if (errno != 0 || endptr == val) {
+                etmemd_log(ETMEMD_LOG_ERR, "get value of %s fail\n", keys[idx].key);
+                return -1;
+            }
+            keys[idx].found = true;
+            left--;
         }
 
-        if (get_unsigned_long_value(value, &val) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "get value with strtoul fail.\n");
-            break;
+        line = strchr(line, '\n');
+        if (line != NULL) {
+            line++;
         }
+    }
+
+    return left == 0 ? 0 : -1;
+}
+
+int get_mem_from_proc_fd(int fd, struct proc_mem_key *keys, int key_num)
+{
+    char buf[PROC_FILE_MAX_LEN];
 
-        *data = val;
-        ret = 0;
-        break;
+    if (etmemd_pread_file(fd, buf, PROC_FILE_MAX_LEN) <= 0) {
+        return -1;
     }
 
-    fclose(file);
+    return get_mem_from_proc_buf(buf, keys, key_num);
+}
+
+static int g_meminfo_fd = -1;
+static pthread_mutex_t g_meminfo_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* /proc/meminfo is opened once and kept open for the whole lifetime of etmemd */
+int get_mem_from_meminfo(struct proc_mem_key *keys, int key_num)
+{
+    int fd;
+
+    pthread_mutex_lock(&g_meminfo_mtx);
+    if (g_meminfo_fd < 0) {
+        g_meminfo_fd = open(MEMINFO_FILE, O_RDONLY | O_CLOEXEC);
+    }
+    fd = g_meminfo_fd;
+    pthread_mutex_unlock(&g_meminfo_mtx);
+
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s fail\n", MEMINFO_FILE);
+        return -1;
+    }
+
+    return get_mem_from_proc_fd(fd, keys, key_num);
+}
+
+/* read a sysfs file which only holds one number, such as nr_hugepages */
+int get_ulong_from_fd(int fd, unsigned long *value)
+{
+    char buf[KEY_VALUE_MAX_LEN];
+    char *endptr = NULL;
+
+    if (value == NULL || etmemd_pread_file(fd, buf, KEY_VALUE_MAX_LEN) <= 0) {
+        return -1;
+    }
+
+    errno = 0;
+    *value = strtoul(buf, &endptr, 0);
+    if (errno != 0 || endptr == buf) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int get_mem_from_proc_file(const char *pid, const char *file_name, unsigned long *data, const char *cmpstr)
+{
+    struct proc_mem_key key = {cmpstr, data, false};
+    int fd;
+    int ret;
+
+    if (data == NULL || cmpstr == NULL) {
+        return -1;
+    }
+
+    fd = etmemd_open_proc_fd(pid, file_name);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "cannot open %s for pid %s\n", file_name, pid);
+        return -1;
+    }
+
+    ret = get_mem_from_proc_fd(fd, &key, 1);
+    close(fd);
     return ret;
 }
 
+void etmemd_mem_snapshot_invalidate(struct mem_snapshot *snap)
+{
+    snap->sys_valid = false;
+    snap->pid_valid = false;
+}
+
+int etmemd_mem_snapshot_sys(struct mem_snapshot *snap)
+{
+    struct proc_mem_key keys[] = {
+        {"MemTotal", &snap->mem_total, false},
+        {"MemFree", &snap->mem_free, false},
+        {"SwapCached", &snap->swap_cached, false},
+    };
+
+    if (snap->sys_valid) {
+        return 0;
+    }
+
+    if (get_mem_from_meminfo(keys, ARRAY_SIZE(keys)) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get system memory from %s fail\n", MEMINFO_FILE);
+        return -1;
+    }
+
+    snap->sys_valid = true;
+    return 0;
+}
+
+int etmemd_mem_snapshot_pid(struct mem_snapshot *snap, unsigned int pid)
+{
+    char pid_str[PID_STR_MAX_LEN] = {0};
+    struct proc_mem_key keys[] = {
+        {VMRSS, &snap->vm_rss, false},
+        {VMSWAP, &snap->vm_swap, false},
+    };
+
+    if (snap->pid_valid) {
+        return 0;
+    }
+
+    if (!snap->status_opened) {
+        if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", pid) <= 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", pid);
+            return -1;
+        }
+        snap->status_fd = etmemd_open_proc_fd(pid_str, STATUS_FILE);
+        if (snap->status_fd < 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "cannot open %s for pid %u\n", STATUS_FILE, pid);
+            return -1;
+        }
+        snap->status_opened = true;
+    }
+
+    /* the fd of an exited pid fails with ESRCH, even if the pid number is reused */
+    if (get_mem_from_proc_fd(snap->status_fd, keys, ARRAY_SIZE(keys)) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get memory of pid %u fail\n", pid);
+        return -1;
+    }
+
+    snap->pid_valid = true;
+    return 0;
+}
+
+void etmemd_mem_snapshot_release(struct mem_snapshot *snap)
+{
+    if (snap->status_opened) {
+        close(snap->status_fd);
+        snap->status_opened = false;
+    }
+    snap->status_fd = -1;
+    etmemd_mem_snapshot_invalidate(snap);
+}
+
 unsigned long get_pagesize(void)
 {
     long pagesize;
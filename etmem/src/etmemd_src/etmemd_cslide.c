@@ -21,6 +21,8 @@
 #include <numa.h>
 #include <linux/limits.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/sysinfo.h>
 
 #include "securec.h"
 #include "etmemd_log.h"
@@ -30,14 +32,26 @@
 #include "etmemd_scan.h"
 #include "etmemd_migrate.h"
 #include "etmemd_file.h"
+#include "etmemd_threadpool.h"
+#include "etmemd_damon.h"
+#include "etmemd_scan_backend.h"
 
 #define HUGE_1M_SIZE    (1 << 20)
 #define HUGE_2M_SIZE    (2 << 20)
+#define HUGE_1G_SIZE    (1 << 30)
 #define BYTE_TO_KB(s)   ((s) >> 10)
 #define KB_TO_BYTE(s)   ((s) << 10)
-#define HUGE_2M_TO_KB(s) ((s) << 11)
 
 #define BATCHSIZE (1 << 16)
+#define NODE_CACHE_HASH         0x9E3779B1U
+#define NODE_CACHE_HASH_SHIFT   16
+#define PAGE_SLICES_INIT        16
+#define HOTNESS_DECAY_MAX       99
+#define PERCENT                 100
+#define NSEC_PER_SEC            ((long long)MSEC_PER_SEC * NSEC_PER_MSEC)
+#define MIG_PACE_SLICE_NS       (10 * NSEC_PER_MSEC)    // length of one paced move_pages call
+#define MIG_PACE_MIN_BATCH      HUGE_2M_SIZE
+#define MIG_PACE_WEIGHT         4                       // a new sample weights 1/4 in the measured values
 
 #define factory_foreach_working_pid_params(iter, factory) \
     for ((iter) = (factory)->working_head, next_working_params(&(iter)); \
@@ -47,21 +61,66 @@
 #define factory_foreach_pid_params(iter, factory) \
     for ((iter) = (factory)->working_head; (iter) != NULL; (iter) = (iter)->next)
 
+/* memory managed by cslide, which decides where the capacity of a node is read from */
+enum cslide_mem_type {
+    CSLIDE_MEM_HUGE_2M = 0,     /* 2M hugetlbfs, the default */
+    CSLIDE_MEM_HUGE_1G,         /* 1G hugetlbfs */
+    CSLIDE_MEM_NORMAL,          /* base pages and THP, capacity from nodeN/meminfo */
+};
+
+/* fields of one item of node_hop_limit */
+enum hop_limit_item {
+    HOP_HOT_NODE = 0,
+    HOP_COLD_NODE,
+    HOP_MIG_QUOTA,
+    HOP_HOT_RESERVE,
+    HOP_LIMIT_ITEMS,
+};
+
 struct node_mem {
-    long long huge_total;
-    long long huge_free;
+    long long total;        /* in bytes */
+    long long free;
+    int total_fd;           /* nr_hugepages, or nodeN/meminfo for normal memory, kept open to be reread */
+    int free_fd;            /* free_hugepages, -1 for normal memory */
 };
 
 struct sys_mem {
     int node_num;
+    enum cslide_mem_type type;
     struct node_mem *node_mem;
 };
 
+/* a scanned page, sorted by count and node into the pages array of the pid */
+struct cslide_page {
+    uint64_t addr;
+    enum page_type type;
+    int bucket;     // count * node_num + node, -1 if the node is unknown
+};
+
+/* pages of one count on one node, a slice of the sorted pages array */
 struct node_page_refs {
-    struct page_refs *head;
-    struct page_refs *tail;
+    uint64_t start;
+    uint64_t num;
     int64_t size;
-    uint32_t num;
+    int page_size;  // size of every page in the slice, 0 if the sizes are mixed
+};
+
+/* sorted pages picked for migration */
+struct page_slice {
+    uint64_t start;
+    uint64_t num;
+};
+
+struct page_slices {
+    struct page_slice *slice;
+    int num;
+    int cap;
+};
+
+/* pages picked for one node pair */
+struct cslide_grade {
+    struct page_slices hot;
+    struct page_slices cold;
 };
 
 struct count_page_refs {
@@ -69,16 +128,32 @@ struct count_page_refs {
     int node_num;
 };
 
+/* throughput of the migration between a node pair, measured and paced by move_pages calls */
+struct mig_pace {
+    long long rate;         // allowed bytes per second, 0 to migrate without pacing
+    long long batch_bytes;  // bytes moved by one move_pages call
+    long long tput;         // measured bytes per second of move_pages
+    long long latency;      // measured ns of one move_pages call
+    long long moved;        // bytes moved since start
+    struct timespec start;
+};
+
+/* one hop of a tier chain, pages are promoted from cold_node to hot_node and demoted backward */
 struct node_pair {
     int index;
     int hot_node;
     int cold_node;
+    int tier;           // 0 for the hop out of the fastest node of the chain
+    int mig_quota;      // in MB, -1 to use node_mig_quota
+    int hot_reserve;    // in MB, -1 to use node_hot_reserve
+    struct mig_pace pace;   // only used by the migrate job of the pair
 };
 
 struct node_map {
     struct node_pair *pair;
     int total_num;
     int cur_num;
+    int max_tier;
 };
 
 struct node_verifier {
@@ -106,6 +181,30 @@ struct node_pages_info {
     uint32_t cold;
 };
 
+/* last known node and decayed count of a page, kept across rounds */
+struct node_cache_entry {
+    uint64_t addr;
+    int node;
+    int age;        // rounds the cached node is used without query
+    float score;    // count decayed by hotness_decay
+};
+
+struct node_cache {
+    struct node_cache_entry *entry;     // sorted by addr
+    uint64_t num;
+    uint64_t cap;
+};
+
+/* pages whose node is queried by one move_pages call */
+struct node_query {
+    void **pages;
+    int *status;
+    int *count;
+    uint64_t *index;    // index of the page in the unsorted pages
+    int64_t *slots;     // index of the page in the new node cache, -1 if not cached
+    int num;
+};
+
 enum pid_param_state {
     STATE_NONE = 0,
     STATE_WORKING,
@@ -117,10 +216,15 @@ struct cslide_pid_params {
     enum pid_param_state state;
     int count;
     struct count_page_refs *count_page_refs;
-    struct memory_grade *memory_grade;
+    struct cslide_page *pages;  // scanned pages of this round sorted by count and node
+    uint64_t page_num;
+    struct cslide_grade *grade; // one for each node pair
+    int grade_num;
     struct node_pages_info *node_pages_info;
+    struct node_cache node_cache;
     struct vmas *vmas;
     struct vma_pf *vma_pf;
+    bool region_scanned;        // vma_pf of this round is filled from the damon snapshot
     unsigned int pid;
     struct cslide_eng_params *eng_params;
     struct cslide_task_params *task_params;
@@ -140,7 +244,14 @@ struct cslide_eng_params {
     int hot_threshold;
     int hot_reserve;    // in MB
     int mig_quota;      // in MB
+    int max_threads;
+    int node_cache_age; // rounds to use the cached node of a page, 0 to query every round
+    int hotness_decay;  // weight in percent of the score of last rounds, 0 to use count of this round only
+    int hot_hysteresis; // pages within this distance to hot_threshold are not moved
+    int mig_bandwidth;  // in MB/s for each node pair, 0 to migrate without pacing
+    enum cslide_mem_type mem_type;
     pthread_t worker;
+    thread_pool *pool;  // runs the scan, count and migrate jobs of cslide_main
     pthread_mutex_t stat_mtx;
     time_t stat_time;
     struct {
@@ -150,6 +261,7 @@ struct cslide_eng_params {
     };
     struct cslide_params_factory factory;
     struct node_pages_info *host_pages_info;
+    struct project *proj;   // owner of the damon monitor when scan_source is damon
     bool finish;
 };
 
@@ -163,8 +275,8 @@ struct node_ctrl {
     struct ctrl_cap hot_prefetch_cap;
     struct ctrl_cap cold_move_cap;
     long long cold_replaced; // cold mem in hot node replace by hot mem in cold node
-    long long cold_free; // free mem in cold node
-    long long free; // free mem in hot node
+    long long *cold_free; // free mem in cold node, shared with the other hop of the node
+    long long *free; // free mem in hot node, shared with the other hop of the node
     long long cold; // cold mem in hot node
     long long total; // total mem in hot node
     long long quota; // move quota
@@ -173,6 +285,7 @@ struct node_ctrl {
 
 struct flow_ctrl {
     struct node_ctrl *node_ctrl;
+    long long *node_free;
     int pair_num;
     int hot_enough;
     int prefetch_enough;
@@ -184,11 +297,12 @@ struct page_filter {
     long long (*flow_move_func)(struct flow_ctrl *ctrl, long long target, int node);
     bool (*flow_enough)(struct flow_ctrl *ctrl);
     void (*filter_policy)(struct page_filter *filter, struct node_pair *pair,
-            struct count_page_refs *cpf, struct memory_grade *memory_grade);
+            struct cslide_pid_params *params, struct count_page_refs *cpf);
     struct flow_ctrl *ctrl;
     int count_start;
     int count_end;
     int count_step;
+    int tier_step;  // 1 to walk the hops of a chain from the fastest node, -1 from the slowest node
 };
 
 struct cslide_cmd_item {
@@ -196,101 +310,200 @@ struct cslide_cmd_item {
     int (*func)(void *params, int fd);
 };
 
+/* jobs of one phase of cslide_main, the phase ends when all of them are done */
+struct cslide_batch {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int pending;
+    int ret;
+};
+
+struct cslide_job {
+    int (*func)(struct cslide_job *job);
+    struct cslide_batch *batch;
+    struct cslide_eng_params *eng_params;
+    struct cslide_pid_params *pid_params;
+    int pair_index;
+    long long window_ns;    // time given to the tier of the pair to migrate, <= 0 if it is used up
+};
+
 static inline int get_node_num(void)
 {
     return numa_num_configured_nodes();
 }
 
-static int init_sys_mem(struct sys_mem *mem)
+static int open_huge_mem_file(int node, int huge_size, const char *huge_state)
 {
-    int node_num = get_node_num();
+    char path[PATH_MAX];
+    int fd;
 
-    if (node_num <= 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "node number %d is invalid \n", node_num);
+    if (sprintf_s(path, PATH_MAX, "/sys/devices/system/node/node%d/hugepages/hugepages-%dkB/%s_hugepages",
+                  node, huge_size, huge_state) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf path to get hugepage number fail\n");
         return -1;
     }
 
-    mem->node_mem = malloc(sizeof(struct node_mem) * node_num);
-    if (mem->node_mem == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "alloc node_mem fail\n");
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open file %s failed\n", path);
         return -1;
     }
-    mem->node_num = node_num;
-    return 0;
+
+    return fd;
 }
 
-static void destroy_sys_mem(struct sys_mem *mem)
+static int open_node_meminfo_file(int node)
 {
-    mem->node_num = -1;
-    free(mem->node_mem);
-    mem->node_mem = NULL;
+    char path[PATH_MAX];
+    int fd;
+
+    if (sprintf_s(path, PATH_MAX, "/sys/devices/system/node/node%d/meminfo", node) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf path to get node meminfo fail\n");
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open file %s failed\n", path);
+        return -1;
+    }
+
+    return fd;
 }
 
-static int read_hugepage_num(char *path)
+static int mem_type_huge_size(enum cslide_mem_type type)
 {
-    FILE *f = NULL;
-    char *line = NULL;
-    size_t line_len = 0;
-    int nr = -1;
+    return type == CSLIDE_MEM_HUGE_1G ? HUGE_1G_SIZE : HUGE_2M_SIZE;
+}
 
-    f = fopen(path, "r");
-    if (f == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "open file %s failed\n", path);
+/* cslide only scans vmas of hugetlbfs, whose pages are of the mem type */
+static enum page_type mem_type_page_type(enum cslide_mem_type type)
+{
+    return type == CSLIDE_MEM_HUGE_1G ? PUD_TYPE : PMD_TYPE;
+}
+
+static void close_node_mem_files(struct node_mem *mem)
+{
+    if (mem->total_fd >= 0) {
+        close(mem->total_fd);
+        mem->total_fd = -1;
+    }
+    if (mem->free_fd >= 0) {
+        close(mem->free_fd);
+        mem->free_fd = -1;
+    }
+}
+
+static int open_node_mem_files(int node, struct node_mem *mem, enum cslide_mem_type type)
+{
+    int huge_size = BYTE_TO_KB(mem_type_huge_size(type));
+
+    if (type == CSLIDE_MEM_NORMAL) {
+        mem->total_fd = open_node_meminfo_file(node);
+        return mem->total_fd < 0 ? -1 : 0;
+    }
+
+    mem->total_fd = open_huge_mem_file(node, huge_size, "nr");
+    mem->free_fd = open_huge_mem_file(node, huge_size, "free");
+    if (mem->total_fd < 0 || mem->free_fd < 0) {
+        close_node_mem_files(mem);
         return -1;
     }
-    if (getline(&line, &line_len, f) < 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "read free hugepage from %s fail\n", path);
-        goto close_file;
+
+    return 0;
+}
+
+static int open_sys_mem_files(struct sys_mem *mem)
+{
+    int i;
+
+    /* counters are reread from offset 0 every cycle, no need to reopen the files */
+    for (i = 0; i < mem->node_num; i++) {
+        close_node_mem_files(&mem->node_mem[i]);
+        if (open_node_mem_files(i, &mem->node_mem[i], mem->type) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "open memory files of node %d fail\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* switch to the files of the memory type set in the engine configuration */
+static int set_sys_mem_type(struct sys_mem *mem, enum cslide_mem_type type)
+{
+    if (mem->type == type) {
+        return 0;
     }
 
-    nr = strtoull(line, NULL, 0);
-    free(line);
-close_file:
-    fclose(f);
-    return nr;
+    mem->type = type;
+    return open_sys_mem_files(mem);
 }
 
-static long long get_single_huge_mem(int node, int huge_size, char *huge_state)
+static void destroy_sys_mem(struct sys_mem *mem)
 {
-    char path[PATH_MAX];
-    int nr;
+    int i;
 
-    if (sprintf_s(path, PATH_MAX, "/sys/devices/system/node/node%d/hugepages/hugepages-%dkB/%s_hugepages",
-                  node, huge_size, huge_state) <= 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "snprintf path to get hugepage number fail\n");
+    for (i = 0; i < mem->node_num; i++) {
+        close_node_mem_files(&mem->node_mem[i]);
+    }
+    mem->node_num = -1;
+    free(mem->node_mem);
+    mem->node_mem = NULL;
+}
+
+static int init_sys_mem(struct sys_mem *mem)
+{
+    int node_num = get_node_num();
+    int i;
+
+    if (node_num <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "node number %d is invalid \n", node_num);
         return -1;
     }
 
-    nr = read_hugepage_num(path);
-    if (nr < 0) {
+    mem->node_mem = malloc(sizeof(struct node_mem) * node_num);
+    if (mem->node_mem == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc node_mem fail\n");
         return -1;
     }
+    for (i = 0; i < node_num; i++) {
+        mem->node_mem[i].total_fd = -1;
+        mem->node_mem[i].free_fd = -1;
+    }
+    mem->node_num = node_num;
+    mem->type = CSLIDE_MEM_HUGE_2M;
 
-    return KB_TO_BYTE((long long)nr * (long long)huge_size);
+    if (open_sys_mem_files(mem) != 0) {
+        destroy_sys_mem(mem);
+        return -1;
+    }
+
+    return 0;
 }
 
-static long long get_node_huge_total(int node, char *huge_state)
+static long long get_single_huge_mem(int fd, int huge_size)
 {
-    long long size_2m;
+    unsigned long nr;
 
-    size_2m = get_single_huge_mem(node, BYTE_TO_KB(HUGE_2M_SIZE), huge_state);
-    if (size_2m < 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get 2M %s page in node %d fail\n", huge_state, node);
+    if (get_ulong_from_fd(fd, &nr) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "read hugepage number fail\n");
         return -1;
     }
 
-    return size_2m;
+    return KB_TO_BYTE((long long)nr * (long long)huge_size);
 }
 
-static int get_node_huge_mem(int node, struct node_mem *mem)
+/* a node without hugepages is valid, it just has no capacity */
+static int get_node_huge_mem(int node, struct node_mem *mem, int huge_size)
 {
-    mem->huge_total = get_node_huge_total(node, "nr");
-    if (mem->huge_total <= 0) {
+    mem->total = get_single_huge_mem(mem->total_fd, huge_size);
+    if (mem->total < 0) {
         etmemd_log(ETMEMD_LOG_ERR, "get total hugepages of node %d fail\n", node);
         return -1;
     }
-    mem->huge_free = get_node_huge_total(node, "free");
-    if (mem->huge_free < 0) {
+    mem->free = get_single_huge_mem(mem->free_fd, huge_size);
+    if (mem->free < 0) {
         etmemd_log(ETMEMD_LOG_ERR, "get free hugepages of node %d fail\n", node);
         return -1;
     }
@@ -298,10 +511,44 @@ static int get_node_huge_mem(int node, struct node_mem *mem)
     return 0;
 }
 
-static int get_node_mem(int node, struct node_mem *mem)
+static int get_node_normal_mem(int node, struct node_mem *mem)
+{
+    char total_key[KEY_VALUE_MAX_LEN];
+    char free_key[KEY_VALUE_MAX_LEN];
+    unsigned long total_kb;
+    unsigned long free_kb;
+    struct proc_mem_key keys[] = {
+        {total_key, &total_kb, false},
+        {free_key, &free_kb, false},
+    };
+
+    if (sprintf_s(total_key, KEY_VALUE_MAX_LEN, "Node %d MemTotal", node) <= 0 ||
+        sprintf_s(free_key, KEY_VALUE_MAX_LEN, "Node %d MemFree", node) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf meminfo key of node %d fail\n", node);
+        return -1;
+    }
+
+    if (get_mem_from_proc_fd(mem->total_fd, keys, ARRAY_SIZE(keys)) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get meminfo of node %d fail\n", node);
+        return -1;
+    }
+
+    mem->total = KB_TO_BYTE((long long)total_kb);
+    mem->free = KB_TO_BYTE((long long)free_kb);
+    return 0;
+}
+
+static int get_node_mem(int node, struct node_mem *mem, enum cslide_mem_type type)
 {
-    if (get_node_huge_mem(node, mem) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get huge memory info of node %d fail\n", node);
+    int ret;
+
+    if (type == CSLIDE_MEM_NORMAL) {
+        ret = get_node_normal_mem(node, mem);
+    } else {
+        ret = get_node_huge_mem(node, mem, BYTE_TO_KB(mem_type_huge_size(type)));
+    }
+    if (ret != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get memory info of node %d fail\n", node);
         return -1;
     }
 
@@ -313,7 +560,7 @@ static int get_sys_mem(struct sys_mem *mem)
     int i;
 
     for (i = 0; i < mem->node_num; i++) {
-        if (get_node_mem(i, &(mem->node_mem[i])) != 0) {
+        if (get_node_mem(i, &(mem->node_mem[i]), mem->type) != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "get memory info of node %d fail\n", i);
             return -1;
         }
@@ -324,71 +571,86 @@ static int get_sys_mem(struct sys_mem *mem)
 
 static void init_node_page_refs(struct node_page_refs *npf)
 {
-    npf->head = NULL;
-    npf->tail = NULL;
-    npf->size = 0;
+    npf->start = 0;
     npf->num = 0;
+    npf->size = 0;
+    npf->page_size = 0;
 }
 
-static void clean_node_page_refs(struct node_page_refs *npf)
+static void npf_add_page(struct node_page_refs *npf, enum page_type type)
 {
-    clean_page_refs_unexpected(&npf->head);
-    npf->tail = NULL;
-    npf->size = 0;
-    npf->num = 0;
+    int page_size = page_type_to_size(type);
+
+    if (npf->num == 0) {
+        npf->page_size = page_size;
+    } else if (npf->page_size != page_size) {
+        npf->page_size = 0;
+    }
+    npf->size += page_size;
+    npf->num++;
 }
 
-static void npf_add_pf(struct node_page_refs *npf, struct page_refs *page_refs)
+static int page_slices_add(struct page_slices *slices, uint64_t start, uint64_t num)
 {
-    if (npf->head == NULL) {
-        npf->head = page_refs;
-        npf->tail = page_refs;
-    } else {
-        npf->tail->next = page_refs;
-        npf->tail = page_refs;
+    struct page_slice *slice = NULL;
+    int cap;
+
+    if (slices->num == slices->cap) {
+        cap = slices->cap == 0 ? PAGE_SLICES_INIT : slices->cap * 2;
+        slice = realloc(slices->slice, sizeof(struct page_slice) * cap);
+        if (slice == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "alloc page slices fail\n");
+            return -1;
+        }
+        slices->slice = slice;
+        slices->cap = cap;
     }
 
-    npf->size += page_type_to_size(page_refs->type);
-    npf->num++;
+    slices->slice[slices->num].start = start;
+    slices->slice[slices->num].num = num;
+    slices->num++;
+    return 0;
 }
 
-/* must called when all pf add to npf with npf_add_pf */
-static void npf_setup_tail(struct node_page_refs *npf)
+static void destroy_page_slices(struct page_slices *slices)
 {
-    if (npf->tail != NULL) {
-        npf->tail->next = NULL;
-    }
+    free(slices->slice);
+    slices->slice = NULL;
+    slices->num = 0;
+    slices->cap = 0;
 }
 
-static void move_npf_to_list(struct node_page_refs *npf, struct page_refs **list, long long size)
+/* take the pages within size from the head of npf, as one slice of the sorted pages */
+static void take_npf_pages(struct node_page_refs *npf, const struct cslide_page *pages,
+        struct page_slices *slices, long long size)
 {
-    struct page_refs *t = NULL;
-    struct page_refs *iter = NULL;
-    struct page_refs *tmp = NULL;
+    uint64_t num = 0;
     long long moved_size = 0;
+    int page_size;
 
     if (npf->size <= size) {
-        t = npf->tail;
+        num = npf->num;
         moved_size = npf->size;
+    } else if (npf->page_size != 0) {
+        num = (uint64_t)(size / npf->page_size);
+        moved_size = (long long)num * npf->page_size;
     } else {
-        for (iter = npf->head; iter != NULL && size >= moved_size + page_type_to_size(iter->type); iter = iter->next) {
-            moved_size += page_type_to_size(iter->type);
-            t = iter;
+        for (; num < npf->num; num++) {
+            page_size = page_type_to_size(pages[npf->start + num].type);
+            if (moved_size + page_size > size) {
+                break;
+            }
+            moved_size += page_size;
         }
     }
 
-    if (t != NULL) {
-        tmp = t->next;
-        t->next = *list;
-        *list = npf->head;
-        npf->head = tmp;
-        if (tmp == NULL) {
-            npf->tail = NULL;
-        }
+    if (num == 0 || page_slices_add(slices, npf->start, num) != 0) {
+        return;
     }
 
+    npf->start += num;
+    npf->num -= num;
     npf->size -= moved_size;
-    return;
 }
 
 static int init_count_page_refs(struct count_page_refs *cpf, int node_num)
@@ -412,7 +674,7 @@ static void clean_count_page_refs(struct count_page_refs *cpf)
     int i;
 
     for (i = 0; i < cpf->node_num; i++) {
-        clean_node_page_refs(&cpf->node_pfs[i]);
+        init_node_page_refs(&cpf->node_pfs[i]);
     }
 }
 
@@ -424,52 +686,72 @@ static void destroy_count_page_refs(struct count_page_refs *cpf)
     cpf->node_num = 0;
 }
 
-static void insert_count_pfs(struct count_page_refs *cpf, struct page_refs *pf, int *nodes, int num)
+/*
+ * counting sort of the pages by count and node, every (count, node) bucket gets a
+ * contiguous slice of the sorted pages
+ */
+static int sort_count_pages(struct cslide_pid_params *params, const struct cslide_page *unsorted, uint64_t num)
 {
+    struct count_page_refs *cpf = params->count_page_refs;
+    int node_num = cpf->node_num;
+    int bucket_num = (params->count + 1) * node_num;
     struct node_page_refs *npf = NULL;
-    struct page_refs *next = NULL;
-    int node, count, i;
+    uint64_t *pos = NULL;
+    uint64_t start = 0;
+    uint64_t i;
+    int b;
+
+    pos = malloc(sizeof(uint64_t) * bucket_num);
+    if (pos == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc sort buckets fail\n");
+        return -1;
+    }
 
     for (i = 0; i < num; i++) {
-        next = pf->next;
-        node = nodes[i];
-        if (node < 0 || node >= cpf->node_num) {
-            etmemd_log(ETMEMD_LOG_WARN, "addr %llx with invalid node %d\n", pf->addr, node);
-            pf->next = NULL;
-            etmemd_free_page_refs(pf);
-            pf = next;
-            continue;
+        b = unsorted[i].bucket;
+        if (b >= 0) {
+            npf_add_page(&cpf[b / node_num].node_pfs[b % node_num], unsorted[i].type);
         }
-        count = pf->count;
-        npf = &cpf[count].node_pfs[node];
-        npf_add_pf(npf, pf);
-        pf = next;
     }
-}
 
-/* must called after all page_refs insert by insert_count_pfs */
-static void setup_count_pfs_tail(struct count_page_refs *cpf, int count)
-{
-    int node, c;
-    struct node_page_refs *npf = NULL;
+    for (b = 0; b < bucket_num; b++) {
+        npf = &cpf[b / node_num].node_pfs[b % node_num];
+        npf->start = start;
+        pos[b] = start;
+        start += npf->num;
+    }
+
+    params->page_num = start;
+    if (start > 0) {
+        params->pages = malloc(sizeof(struct cslide_page) * start);
+        if (params->pages == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "malloc sorted pages fail\n");
+            free(pos);
+            return -1;
+        }
+    }
 
-    for (c = 0; c <= count; c++) {
-        for (node = 0; node < cpf->node_num; node++) {
-            npf = &cpf[c].node_pfs[node];
-            npf_setup_tail(npf);
+    for (i = 0; i < num; i++) {
+        b = unsorted[i].bucket;
+        if (b >= 0) {
+            params->pages[pos[b]++] = unsorted[i];
         }
     }
+
+    free(pos);
+    return 0;
 }
 
 static int init_node_map(struct node_map *node_map, int node_num)
 {
     int pair_num;
 
-    if (node_num % 2 != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "node_num is not even\n");
+    if (node_num < 2) {
+        etmemd_log(ETMEMD_LOG_ERR, "node_num %d is less than 2\n", node_num);
         return -1;
     }
-    pair_num = node_num / 2;
+    /* all nodes in one chain has the most hops */
+    pair_num = node_num - 1;
     node_map->pair = calloc(pair_num, sizeof(struct node_pair));
     if (node_map->pair == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "alloc memory for node map fail\n");
@@ -477,6 +759,7 @@ static int init_node_map(struct node_map *node_map, int node_num)
     }
     node_map->total_num = pair_num;
     node_map->cur_num = 0;
+    node_map->max_tier = 0;
     return 0;
 }
 
@@ -486,22 +769,49 @@ static void destroy_node_map(struct node_map *map)
     map->pair = NULL;
     map->total_num = 0;
     map->cur_num = 0;
+    map->max_tier = 0;
 }
 
-static int add_node_pair(struct node_map *map, int cold_node, int hot_node)
+static int add_node_hop(struct node_map *map, int cold_node, int hot_node, int tier)
 {
+    struct node_pair *pair = NULL;
+
     if (map->cur_num == map->total_num) {
         etmemd_log(ETMEMD_LOG_ERR, "too much pair, add pair hot %d cold %d fail\n",
                    hot_node, cold_node);
         return -1;
     }
-    map->pair[map->cur_num].hot_node = hot_node;
-    map->pair[map->cur_num].cold_node = cold_node;
-    map->pair[map->cur_num].index = map->cur_num;
+    pair = &map->pair[map->cur_num];
+    pair->hot_node = hot_node;
+    pair->cold_node = cold_node;
+    pair->index = map->cur_num;
+    pair->tier = tier;
+    pair->mig_quota = -1;
+    pair->hot_reserve = -1;
+    if (tier > map->max_tier) {
+        map->max_tier = tier;
+    }
     map->cur_num++;
     return 0;
 }
 
+static inline int add_node_pair(struct node_map *map, int cold_node, int hot_node)
+{
+    return add_node_hop(map, cold_node, hot_node, 0);
+}
+
+static struct node_pair *find_node_pair(struct node_map *map, int hot_node, int cold_node)
+{
+    int i;
+
+    for (i = 0; i < map->cur_num; i++) {
+        if (map->pair[i].hot_node == hot_node && map->pair[i].cold_node == cold_node) {
+            return &map->pair[i];
+        }
+    }
+    return NULL;
+}
+
 static int init_node_verifier(struct node_verifier *nv, int node_num)
 {
     nv->nodes_map_count = calloc(node_num, sizeof(int));
@@ -588,22 +898,23 @@ static struct cslide_pid_params *alloc_pid_params(struct cslide_eng_params *eng_
     }
 
     params->count = count;
-    params->memory_grade = calloc(pair_num, sizeof(struct memory_grade));
-    if (params->memory_grade == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "alloc memory_grade fail\n");
+    params->grade = calloc(pair_num, sizeof(struct cslide_grade));
+    if (params->grade == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc grade fail\n");
         goto free_count_page_refs;
     }
+    params->grade_num = pair_num;
 
     params->node_pages_info = calloc(node_num, sizeof(struct node_pages_info));
     if (params->node_pages_info == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "alloc pages info fail\n");
-        goto free_memory_grade;
+        goto free_grade;
     }
     return params;
 
-free_memory_grade:
-    free(params->memory_grade);
-    params->memory_grade = NULL;
+free_grade:
+    free(params->grade);
+    params->grade = NULL;
 free_count_page_refs:
     for (i--; i >= 0; i--) {
         destroy_count_page_refs(&params->count_page_refs[i]);
@@ -623,8 +934,16 @@ static void free_pid_params(struct cslide_pid_params *params)
 
     free(params->node_pages_info);
     params->node_pages_info = NULL;
-    free(params->memory_grade);
-    params->memory_grade = NULL;
+    free(params->node_cache.entry);
+    params->node_cache.entry = NULL;
+    for (i = 0; i < params->grade_num; i++) {
+        destroy_page_slices(&params->grade[i].hot);
+        destroy_page_slices(&params->grade[i].cold);
+    }
+    free(params->grade);
+    params->grade = NULL;
+    free(params->pages);
+    params->pages = NULL;
     for (i = 0; i <= count; i++) {
         destroy_count_page_refs(&params->count_page_refs[i]);
     }
@@ -645,12 +964,15 @@ static void clean_pid_param(struct cslide_pid_params *pid_params)
     int i;
 
     for (i = 0; i < pair_num; i++) {
-        clean_page_refs_unexpected(&pid_params->memory_grade[i].hot_pages);
-        clean_page_refs_unexpected(&pid_params->memory_grade[i].cold_pages);
+        pid_params->grade[i].hot.num = 0;
+        pid_params->grade[i].cold.num = 0;
     }
     for (i = 0; i <= pid_params->count; i++) {
         clean_count_page_refs(&pid_params->count_page_refs[i]);
     }
+    free(pid_params->pages);
+    pid_params->pages = NULL;
+    pid_params->page_num = 0;
 }
 
 static void destroy_factory(struct cslide_params_factory *factory)
@@ -750,81 +1072,294 @@ static bool factory_working_empty(struct cslide_params_factory *factory)
     return true;
 }
 
-static struct page_refs *next_vma_pf(struct cslide_pid_params *params, int *cur)
+/* return the bucket of the page in the sorted pages, -1 if it is not counted */
+static int page_bucket(const struct cslide_pid_params *params, uint64_t addr, int count, int node)
 {
-    int vma_pf_num = params->vmas->vma_cnt;
-    struct vma_pf *vma_pf = params->vma_pf;
-    struct page_refs *pf = NULL;
+    int node_num = params->count_page_refs->node_num;
 
-    while (*cur < vma_pf_num) {
-        pf = vma_pf[*cur].page_refs;
-        vma_pf[*cur].page_refs = NULL;
-        (*cur)++;
-        if (pf != NULL) {
-            break;
+    if (node < 0 || node >= node_num) {
+        etmemd_log(ETMEMD_LOG_WARN, "addr %llx with invalid node %d\n", addr, node);
+        return -1;
+    }
+    if (count < 0 || count > params->count) {
+        etmemd_log(ETMEMD_LOG_WARN, "addr %llx with invalid count %d\n", addr, count);
+        return -1;
+    }
+    return count * node_num + node;
+}
+
+/* spread the first query of new pages over the rounds of node_cache_age */
+static inline int node_cache_init_age(uint64_t addr, int max_age)
+{
+    return (int)((((uint32_t)(addr >> PAGE_SHIFT) * NODE_CACHE_HASH) >> NODE_CACHE_HASH_SHIFT) % max_age);
+}
+
+/*
+ * return the cached node of addr, or -1 if the node must be queried. pages are counted
+ * in increasing address, so the old cache is walked once by cursor
+ */
+static int node_cache_lookup(const struct node_cache *cache, uint64_t *cursor, uint64_t addr,
+        int max_age, int *age)
+{
+    const struct node_cache_entry *entry = NULL;
+
+    while (*cursor < cache->num && cache->entry[*cursor].addr < addr) {
+        (*cursor)++;
+    }
+
+    if (*cursor == cache->num || cache->entry[*cursor].addr != addr) {
+        *age = max_age > 0 ? node_cache_init_age(addr, max_age) : 0;
+        return -1;
+    }
+
+    entry = &cache->entry[*cursor];
+    if (entry->node < 0 || entry->age >= max_age) {
+        *age = 0;
+        return -1;
+    }
+
+    *age = entry->age + 1;
+    return entry->node;
+}
+
+/*
+ * score = decay * score + (1 - decay) * count, the score stays in the range of count and is
+ * bucketed as the count of the page. call it after node_cache_lookup of the same addr
+ */
+static int decay_page_count(const struct node_cache *cache, uint64_t cursor, uint64_t addr,
+        int count, int decay, float *score)
+{
+    float decayed = (float)count;
+
+    if (decay > 0 && cursor < cache->num && cache->entry[cursor].addr == addr) {
+        decayed = (decay * cache->entry[cursor].score + (PERCENT - decay) * (float)count) / PERCENT;
+    }
+
+    *score = decayed;
+    return (int)(decayed + 0.5f);
+}
+
+/* return the index of the new entry, or -1 if addr is not cached */
+static int64_t node_cache_append(struct node_cache *cache, uint64_t addr, int node, int age)
+{
+    struct node_cache_entry *entry = NULL;
+    uint64_t cap;
+
+    if (cache->num > 0 && cache->entry[cache->num - 1].addr >= addr) {
+        return -1;
+    }
+
+    if (cache->num == cache->cap) {
+        cap = cache->cap == 0 ? BATCHSIZE : cache->cap * 2;
+        entry = realloc(cache->entry, sizeof(struct node_cache_entry) * cap);
+        if (entry == NULL) {
+            return -1;
         }
+        cache->entry = entry;
+        cache->cap = cap;
+    }
+
+    entry = &cache->entry[cache->num];
+    entry->addr = addr;
+    entry->node = node;
+    entry->age = age;
+    entry->score = 0;
+    return (int64_t)cache->num++;
+}
+
+static int node_cache_entry_cmp(const void *key, const void *item)
+{
+    uint64_t addr = *(const uint64_t *)key;
+    const struct node_cache_entry *entry = (const struct node_cache_entry *)item;
+
+    if (addr < entry->addr) {
+        return -1;
     }
-    return pf;
+    return addr > entry->addr ? 1 : 0;
 }
 
+/* the node of a page is known after cslide migrates it, no need to query it next round */
+static void node_cache_update(struct node_cache *cache, uint64_t addr, int node)
+{
+    struct node_cache_entry *entry = NULL;
+
+    if (cache == NULL || cache->num == 0) {
+        return;
+    }
+
+    entry = bsearch(&addr, cache->entry, cache->num, sizeof(struct node_cache_entry), node_cache_entry_cmp);
+    if (entry != NULL) {
+        entry->node = node;
+    }
+}
+
+static void destroy_node_query(struct node_query *query)
+{
+    free(query->slots);
+    query->slots = NULL;
+    free(query->index);
+    query->index = NULL;
+    free(query->count);
+    query->count = NULL;
+    free(query->pages);
+    query->pages = NULL;
+    free(query->status);
+    query->status = NULL;
+}
+
+static int init_node_query(struct node_query *query, int batch_size)
+{
+    query->num = 0;
+    query->status = malloc(sizeof(int) * batch_size);
+    query->pages = malloc(sizeof(void *) * batch_size);
+    query->count = malloc(sizeof(int) * batch_size);
+    query->index = malloc(sizeof(uint64_t) * batch_size);
+    query->slots = malloc(sizeof(int64_t) * batch_size);
+    if (query->status == NULL || query->pages == NULL || query->count == NULL ||
+        query->index == NULL || query->slots == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc node query fail\n");
+        destroy_node_query(query);
+        return -1;
+    }
+    return 0;
+}
+
+static void node_query_add(struct node_query *query, uint64_t addr, int count, uint64_t index, int64_t slot)
+{
+    query->pages[query->num] = (void *)addr;
+    query->count[query->num] = count;
+    query->index[query->num] = index;
+    query->slots[query->num] = slot;
+    query->num++;
+}
+
+static int do_node_query(struct cslide_pid_params *params, struct node_query *query,
+        struct node_cache *cache, struct cslide_page *unsorted)
+{
+    struct cslide_page *page = NULL;
+    int i;
+
+    if (query->num == 0) {
+        return 0;
+    }
+
+    if (move_pages(params->pid, query->num, query->pages, NULL, query->status, MPOL_MF_MOVE_ALL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get page refs numa node fail\n");
+        return -1;
+    }
+
+    for (i = 0; i < query->num; i++) {
+        if (query->slots[i] >= 0) {
+            cache->entry[query->slots[i]].node = query->status[i];
+        }
+        page = &unsorted[query->index[i]];
+        page->bucket = page_bucket(params, page->addr, query->count[i], query->status[i]);
+    }
+    query->num = 0;
+    return 0;
+}
+
+static int add_unsorted_page(struct cslide_page **pages, uint64_t *num, uint64_t *cap,
+        const struct page_refs *pf, int bucket)
+{
+    struct cslide_page *tmp = NULL;
+    uint64_t new_cap;
+
+    if (*num == *cap) {
+        new_cap = *cap == 0 ? BATCHSIZE : *cap * 2;
+        tmp = realloc(*pages, sizeof(struct cslide_page) * new_cap);
+        if (tmp == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "alloc unsorted pages fail\n");
+            return -1;
+        }
+        *pages = tmp;
+        *cap = new_cap;
+    }
+
+    (*pages)[*num].addr = pf->addr;
+    (*pages)[*num].type = pf->type;
+    (*pages)[*num].bucket = bucket;
+    (*num)++;
+    return 0;
+}
+
+/*
+ * copy the scanned pages into a flat array with their node, free the page_refs of the
+ * vmas and sort the pages by count and node with sort_count_pages
+ */
 static int cslide_count_node_pfs(struct cslide_pid_params *params)
 {
     struct page_refs *page_refs = NULL;
-    struct page_refs *last = NULL;
-    unsigned int pid = params->pid;
-    int batch_size = BATCHSIZE;
-    void **pages = NULL;
-    int *status = NULL;
-    int actual_num = 0;
-    int ret = 0;
-    int vma_i = 0;
+    struct cslide_page *unsorted = NULL;
+    struct node_query query;
+    struct node_cache cache = {0};
+    int max_age = params->eng_params->node_cache_age;
+    int decay = params->eng_params->hotness_decay;
+    float score = 0;
+    uint64_t num = 0;
+    uint64_t cap = 0;
+    uint64_t cursor = 0;
+    uint64_t i;
+    int64_t slot = -1;
+    int node = -1;
+    int count;
+    int bucket;
+    int age = 0;
+    int ret = -1;
 
     if (params->vmas == NULL || params->vma_pf == NULL) {
         return 0;
     }
 
-    status = malloc(sizeof(int) * batch_size);
-    if (status == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "malloc status fail\n");
+    if (init_node_query(&query, BATCHSIZE) != 0) {
         return -1;
     }
 
-    pages = malloc(sizeof(void *) * batch_size);
-    if (pages == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "malloc pages fail\n");
-        ret = -1;
-        goto free_status;
-    }
+    for (i = 0; i < params->vmas->vma_cnt; i++) {
+        for (page_refs = params->vma_pf[i].page_refs; page_refs != NULL; page_refs = page_refs->next) {
+            count = page_refs->count;
+            if (max_age > 0 || decay > 0) {
+                node = node_cache_lookup(&params->node_cache, &cursor, page_refs->addr, max_age, &age);
+                count = decay_page_count(&params->node_cache, cursor, page_refs->addr, count, decay, &score);
+                slot = node_cache_append(&cache, page_refs->addr, node, age);
+                if (slot >= 0) {
+                    cache.entry[slot].score = score;
+                }
+            }
 
-    page_refs = next_vma_pf(params, &vma_i);
-    last = page_refs;
-    while (page_refs != NULL) {
-        pages[actual_num++] = (void *)page_refs->addr;
-        if (page_refs->next == NULL) {
-            page_refs->next = next_vma_pf(params, &vma_i);
-        }
-        if (actual_num == batch_size || page_refs->next == NULL) {
-            if (move_pages(pid, actual_num, pages, NULL, status, MPOL_MF_MOVE_ALL) != 0) {
-                etmemd_log(ETMEMD_LOG_ERR, "get page refs numa node fail\n");
-                clean_page_refs_unexpected(&last);
-                ret = -1;
-                break;
+            bucket = node >= 0 ? page_bucket(params, page_refs->addr, count, node) : -1;
+            if (add_unsorted_page(&unsorted, &num, &cap, page_refs, bucket) != 0) {
+                goto free_pages;
+            }
+            if (node >= 0) {
+                continue;
+            }
+
+            node_query_add(&query, page_refs->addr, count, num - 1, slot);
+            if (query.num == BATCHSIZE && do_node_query(params, &query, &cache, unsorted) != 0) {
+                goto free_pages;
             }
-            insert_count_pfs(params->count_page_refs, last, status, actual_num);
-            last = page_refs->next;
-            actual_num = 0;
         }
-        page_refs = page_refs->next;
+        /* the page_refs are not used any more after being copied */
+        clean_page_refs_unexpected(&params->vma_pf[i].page_refs);
     }
 
-    // this must be called before return
-    setup_count_pfs_tail(params->count_page_refs, params->count);
+    if (do_node_query(params, &query, &cache, unsorted) != 0 ||
+        sort_count_pages(params, unsorted, num) != 0) {
+        goto free_pages;
+    }
+    ret = 0;
 
-    free(pages);
-    pages = NULL;
-free_status:
-    free(status);
-    status = NULL;
+free_pages:
+    free(unsorted);
+    /* pages not counted this round are dropped from the cache */
+    if (ret == 0) {
+        free(params->node_cache.entry);
+        params->node_cache = cache;
+    } else {
+        free(cache.entry);
+    }
+    destroy_node_query(&query);
     return ret;
 }
 
@@ -852,20 +1387,20 @@ static bool node_cal_hot_can_move(struct node_ctrl *node_ctrl)
     long long can_move;
 
     // can_move limited by quota
-    if (node_ctrl->quota < node_ctrl->free) {
+    if (node_ctrl->quota < *node_ctrl->free) {
         can_move = node_ctrl->quota;
     } else {
         // can_move limited by hot node free
-        can_move = node_ctrl->free + (node_ctrl->quota - node_ctrl->free) / 2;
+        can_move = *node_ctrl->free + (node_ctrl->quota - *node_ctrl->free) / 2;
         // can_move limited by cold node free
-        if (can_move > node_ctrl->free + node_ctrl->cold_free) {
-            can_move = node_ctrl->free + node_ctrl->cold_free;
+        if (can_move > *node_ctrl->free + *node_ctrl->cold_free) {
+            can_move = *node_ctrl->free + *node_ctrl->cold_free;
         }
     }
 
     // can_move limited by free and cold mem in hot node
-    if (can_move > node_ctrl->cold + node_ctrl->free) {
-        can_move = node_ctrl->cold + node_ctrl->free;
+    if (can_move > node_ctrl->cold + *node_ctrl->free) {
+        can_move = node_ctrl->cold + *node_ctrl->free;
     }
     node_ctrl->hot_move_cap.cap = can_move;
     return can_move > 0;
@@ -885,15 +1420,15 @@ static void node_update_hot_move(struct node_ctrl *node_ctrl)
 {
     long long hot_move = node_ctrl->hot_move_cap.used;
 
-    if (hot_move > node_ctrl->free) {
-        node_ctrl->cold_replaced += hot_move - node_ctrl->free;
-        node_ctrl->quota -= node_ctrl->free + (hot_move - node_ctrl->free) * 2;
-        node_ctrl->cold_free += node_ctrl->free;
-        node_ctrl->free = 0;
+    if (hot_move > *node_ctrl->free) {
+        node_ctrl->cold_replaced += hot_move - *node_ctrl->free;
+        node_ctrl->quota -= *node_ctrl->free + (hot_move - *node_ctrl->free) * 2;
+        *node_ctrl->cold_free += *node_ctrl->free;
+        *node_ctrl->free = 0;
     } else {
-        node_ctrl->free -= hot_move;
+        *node_ctrl->free -= hot_move;
         node_ctrl->quota -= hot_move;
-        node_ctrl->cold_free += hot_move;
+        *node_ctrl->cold_free += hot_move;
     }
 }
 
@@ -902,12 +1437,12 @@ static bool node_cal_hot_can_prefetch(struct node_ctrl *node_ctrl)
 {
     long long can_prefetch;
 
-    if (node_ctrl->free <= node_ctrl->reserve) {
+    if (*node_ctrl->free <= node_ctrl->reserve) {
         can_prefetch = 0;
         goto exit;
     }
 
-    can_prefetch = node_ctrl->free - node_ctrl->reserve;
+    can_prefetch = *node_ctrl->free - node_ctrl->reserve;
     if (can_prefetch > node_ctrl->quota) {
         can_prefetch = node_ctrl->quota;
     }
@@ -931,19 +1466,19 @@ static void node_update_hot_prefetch(struct node_ctrl *node_ctrl)
 {
     long long hot_prefetch = node_ctrl->hot_prefetch_cap.used;
 
-    node_ctrl->free -= hot_prefetch;
+    *node_ctrl->free -= hot_prefetch;
     node_ctrl->quota -= hot_prefetch;
-    node_ctrl->cold_free += hot_prefetch;
+    *node_ctrl->cold_free += hot_prefetch;
 }
 
 static bool node_cal_cold_can_move(struct node_ctrl *node_ctrl)
 {
     long long can_move;
 
-    can_move = node_ctrl->quota < node_ctrl->reserve - node_ctrl->free ?
-        node_ctrl->quota : node_ctrl->reserve - node_ctrl->free;
-    if (can_move > node_ctrl->cold_free) {
-        can_move = node_ctrl->cold_free;
+    can_move = node_ctrl->quota < node_ctrl->reserve - *node_ctrl->free ?
+        node_ctrl->quota : node_ctrl->reserve - *node_ctrl->free;
+    if (can_move > *node_ctrl->cold_free) {
+        can_move = *node_ctrl->cold_free;
     }
     if (can_move < 0) {
         can_move = 0;
@@ -964,11 +1499,14 @@ static inline bool node_move_cold(struct node_ctrl *node_ctrl, long long *target
     return cap_cost(&node_ctrl->cold_move_cap, target);
 }
 
-static int init_flow_ctrl(struct flow_ctrl *ctrl, struct cslide_eng_params *eng_params)
+/* in bytes */
+static inline long long pair_mig_quota(const struct cslide_eng_params *eng_params, const struct node_pair *pair)
 {
+    return (long long)(pair->mig_quota >= 0 ? pair->mig_quota : eng_params->mig_quota) * HUGE_1M_SIZE;
+}
 
-    long long quota = (long long)eng_params->mig_quota * HUGE_1M_SIZE;
-    long long reserve = (long long)eng_params->hot_reserve * HUGE_1M_SIZE;
+static int init_flow_ctrl(struct flow_ctrl *ctrl, struct cslide_eng_params *eng_params)
+{
     struct sys_mem *sys_mem = &eng_params->mem;
     struct node_map *node_map = &eng_params->node_map;
     struct node_pair *pair = NULL;
@@ -981,6 +1519,18 @@ static int init_flow_ctrl(struct flow_ctrl *ctrl, struct cslide_eng_params *eng_
         return -1;
     }
 
+    /* a middle tier node is the cold node of one hop and the hot node of the next one */
+    ctrl->node_free = calloc(sys_mem->node_num, sizeof(long long));
+    if (ctrl->node_free == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc memory for node_free fail\n");
+        free(ctrl->node_ctrl);
+        ctrl->node_ctrl = NULL;
+        return -1;
+    }
+    for (i = 0; i < sys_mem->node_num; i++) {
+        ctrl->node_free[i] = sys_mem->node_mem[i].free;
+    }
+
     ctrl->pair_num = node_map->cur_num;
     ctrl->hot_enough = 0;
     ctrl->cold_enough = 0;
@@ -988,12 +1538,13 @@ static int init_flow_ctrl(struct flow_ctrl *ctrl, struct cslide_eng_params *eng_
     for (i = 0; i < ctrl->pair_num; i++) {
         pair = &node_map->pair[i];
         tmp = &ctrl->node_ctrl[i];
-        tmp->cold_free = sys_mem->node_mem[pair->cold_node].huge_free;
-        tmp->free = sys_mem->node_mem[pair->hot_node].huge_free;
+        tmp->cold_free = &ctrl->node_free[pair->cold_node];
+        tmp->free = &ctrl->node_free[pair->hot_node];
         tmp->cold = KB_TO_BYTE((unsigned long long)eng_params->host_pages_info[pair->hot_node].cold);
-        tmp->total = sys_mem->node_mem[pair->hot_node].huge_total;
-        tmp->quota = quota;
-        tmp->reserve = reserve;
+        tmp->total = sys_mem->node_mem[pair->hot_node].total;
+        tmp->quota = pair_mig_quota(eng_params, pair);
+        tmp->reserve = (long long)(pair->hot_reserve >= 0 ? pair->hot_reserve : eng_params->hot_reserve) *
+            HUGE_1M_SIZE;
     }
     return 0;
 }
@@ -1033,8 +1584,11 @@ static void flow_cal_hot_can_prefetch(struct flow_ctrl *ctrl)
 {
     int i;
 
+    /* the free mem of a middle tier node is updated by both of its hops first */
     for (i = 0; i < ctrl->pair_num; i++) {
         node_update_hot_move(&ctrl->node_ctrl[i]);
+    }
+    for (i = 0; i < ctrl->pair_num; i++) {
         if (!node_cal_hot_can_prefetch(&ctrl->node_ctrl[i])) {
             ctrl->prefetch_enough++;
         }
@@ -1067,6 +1621,8 @@ static void flow_cal_cold_can_move(struct flow_ctrl *ctrl)
 
     for (i = 0; i < ctrl->pair_num; i++) {
         node_update_hot_prefetch(&ctrl->node_ctrl[i]);
+    }
+    for (i = 0; i < ctrl->pair_num; i++) {
         if (!node_cal_cold_can_move(&ctrl->node_ctrl[i])) {
             ctrl->cold_enough++;
         }
@@ -1095,6 +1651,8 @@ static long long ctrl_cold_move(struct flow_ctrl *ctrl, long long target, int no
 
 static void destroy_flow_ctrl(struct flow_ctrl *ctrl)
 {
+    free(ctrl->node_free);
+    ctrl->node_free = NULL;
     free(ctrl->node_ctrl);
     ctrl->node_ctrl = NULL;
 }
@@ -1103,25 +1661,31 @@ static void do_filter(struct page_filter *filter, struct cslide_eng_params *eng_
 {
     struct cslide_pid_params *params = NULL;
     struct count_page_refs *cpf = NULL;
-    struct memory_grade *memory_grade = NULL;
     struct node_pair *pair = NULL;
-    int pair_num = eng_params->node_map.cur_num;
-    int i, j;
+    struct node_map *map = &eng_params->node_map;
+    int tier_start = filter->tier_step > 0 ? 0 : map->max_tier;
+    int tier_end = filter->tier_step > 0 ? map->max_tier + 1 : -1;
+    int i, j, t;
 
     filter->flow_cal_func(filter->ctrl);
     if (filter->flow_enough(filter->ctrl)) {
         return;
     }
 
+    /* pages of all tiers are placed by one walk of the counts, hops of each chain in tier_step order */
     for (i = filter->count_start; i != filter->count_end; i += filter->count_step) {
         factory_foreach_working_pid_params(params, &eng_params->factory) {
             cpf = &params->count_page_refs[i];
-            for (j = 0; j < pair_num; j++) {
-                pair = &eng_params->node_map.pair[j];
-                memory_grade = &params->memory_grade[j];
-                filter->filter_policy(filter, pair, cpf, memory_grade);
-                if (filter->flow_enough(filter->ctrl)) {
-                    return;
+            for (t = tier_start; t != tier_end; t += filter->tier_step) {
+                for (j = 0; j < map->cur_num; j++) {
+                    pair = &map->pair[j];
+                    if (pair->tier != t) {
+                        continue;
+                    }
+                    filter->filter_policy(filter, pair, params, cpf);
+                    if (filter->flow_enough(filter->ctrl)) {
+                        return;
+                    }
                 }
             }
         }
@@ -1129,23 +1693,43 @@ static void do_filter(struct page_filter *filter, struct cslide_eng_params *eng_
 }
 
 static void to_hot_policy(struct page_filter *filter, struct node_pair *pair,
-        struct count_page_refs *cpf, struct memory_grade *memory_grade)
+        struct cslide_pid_params *params, struct count_page_refs *cpf)
 {
     long long can_move;
     struct node_page_refs *npf = &cpf->node_pfs[pair->cold_node];
 
     can_move = filter->flow_move_func(filter->ctrl, npf->size, pair->index);
-    move_npf_to_list(npf, &memory_grade->hot_pages, can_move);
+    take_npf_pages(npf, params->pages, &params->grade[pair->index].hot, can_move);
 }
 
 static void to_cold_policy(struct page_filter *filter, struct node_pair *pair,
-        struct count_page_refs *cpf, struct memory_grade *memory_grade)
+        struct cslide_pid_params *params, struct count_page_refs *cpf)
 {
     long long can_move;
     struct node_page_refs *npf = &cpf->node_pfs[pair->hot_node];
 
     can_move = filter->flow_move_func(filter->ctrl, npf->size, pair->index);
-    move_npf_to_list(npf, &memory_grade->cold_pages, can_move);
+    take_npf_pages(npf, params->pages, &params->grade[pair->index].cold, can_move);
+}
+
+/*
+ * counts in [hot_threshold - hot_hysteresis, hot_threshold + hot_hysteresis) are the band
+ * where pages are neither promoted nor demoted, which stops pages near hot_threshold from
+ * moving back and forth. return the lowest count to promote
+ */
+static inline int hot_band_end(const struct cslide_eng_params *eng_params)
+{
+    int max_count = eng_params->loop * MAX_ACCESS_WEIGHT;
+    int t = eng_params->hot_threshold + eng_params->hot_hysteresis;
+
+    return t > max_count ? max_count + 1 : t;
+}
+
+static inline int cold_band_start(const struct cslide_eng_params *eng_params)
+{
+    int t = eng_params->hot_threshold - eng_params->hot_hysteresis;
+
+    return t < 0 ? 0 : t;
 }
 
 static void move_hot_pages(struct cslide_eng_params *eng_params, struct flow_ctrl *ctrl)
@@ -1157,8 +1741,9 @@ static void move_hot_pages(struct cslide_eng_params *eng_params, struct flow_ctr
     filter.filter_policy = to_hot_policy;
     filter.ctrl = ctrl;
     filter.count_start = eng_params->loop * MAX_ACCESS_WEIGHT;
-    filter.count_end = eng_params->hot_threshold - 1;
+    filter.count_end = hot_band_end(eng_params) - 1;
     filter.count_step = -1;
+    filter.tier_step = 1;
     do_filter(&filter, eng_params);
 }
 
@@ -1170,9 +1755,11 @@ static void prefetch_hot_pages(struct cslide_eng_params *eng_params, struct flow
     filter.flow_enough = is_prefetch_enough;
     filter.filter_policy = to_hot_policy;
     filter.ctrl = ctrl;
-    filter.count_start = eng_params->hot_threshold - 1;
+    /* pages in the band are not promoted even if the fast node has room, so start below it */
+    filter.count_start = cold_band_start(eng_params) - 1;
     filter.count_end = -1;
     filter.count_step = -1;
+    filter.tier_step = 1;
     do_filter(&filter, eng_params);
 }
 
@@ -1185,8 +1772,9 @@ static void move_cold_pages(struct cslide_eng_params *eng_params, struct flow_ct
     filter.filter_policy = to_cold_policy;
     filter.ctrl = ctrl;
     filter.count_start = 0;
-    filter.count_end = eng_params->hot_threshold;
+    filter.count_end = cold_band_start(eng_params);
     filter.count_step = 1;
+    filter.tier_step = -1;
     do_filter(&filter, eng_params);
 }
 
@@ -1207,6 +1795,110 @@ static int cslide_filter_pfs(struct cslide_eng_params *eng_params)
     return 0;
 }
 
+static void *cslide_job_routine(void *arg)
+{
+    struct cslide_job *job = (struct cslide_job *)arg;
+    struct cslide_batch *batch = job->batch;
+    int ret;
+
+    ret = job->func(job);
+
+    pthread_mutex_lock(&batch->mtx);
+    if (ret != 0) {
+        batch->ret = -1;
+    }
+    batch->pending--;
+    if (batch->pending == 0) {
+        pthread_cond_signal(&batch->cond);
+    }
+    pthread_mutex_unlock(&batch->mtx);
+    return NULL;
+}
+
+/* run the jobs by the worker pool and wait for all of them, return -1 if any of them fails */
+static int cslide_run_jobs(struct cslide_eng_params *eng_params, struct cslide_job *jobs, int num)
+{
+    struct cslide_batch batch = {
+        .pending = num,
+        .ret = 0,
+    };
+    int i;
+
+    if (num == 0) {
+        return 0;
+    }
+
+    if (pthread_mutex_init(&batch.mtx, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "init batch mutex fail\n");
+        return -1;
+    }
+    if (pthread_cond_init(&batch.cond, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "init batch cond fail\n");
+        pthread_mutex_destroy(&batch.mtx);
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        jobs[i].batch = &batch;
+        jobs[i].eng_params = eng_params;
+        /* run the job here if it cannot be queued, the result is the same */
+        if (eng_params->pool == NULL ||
+            threadpool_add_worker(eng_params->pool, cslide_job_routine, &jobs[i]) != 0) {
+            cslide_job_routine(&jobs[i]);
+        }
+    }
+    if (eng_params->pool != NULL) {
+        threadpool_notify(eng_params->pool);
+    }
+
+    pthread_mutex_lock(&batch.mtx);
+    while (batch.pending > 0) {
+        pthread_cond_wait(&batch.cond, &batch.mtx);
+    }
+    pthread_mutex_unlock(&batch.mtx);
+
+    /* let the idle workers wait on the pool again */
+    if (eng_params->pool != NULL) {
+        threadpool_reset_status(&eng_params->pool);
+    }
+    pthread_cond_destroy(&batch.cond);
+    pthread_mutex_destroy(&batch.mtx);
+    return batch.ret;
+}
+
+/* run func for each working pid in parallel */
+static int cslide_run_pid_jobs(struct cslide_eng_params *eng_params, int (*func)(struct cslide_job *job))
+{
+    struct cslide_pid_params *iter = NULL;
+    struct cslide_job *jobs = NULL;
+    int num = 0;
+    int ret;
+
+    factory_foreach_working_pid_params(iter, &eng_params->factory) {
+        num++;
+    }
+    if (num == 0) {
+        return 0;
+    }
+
+    jobs = calloc(num, sizeof(struct cslide_job));
+    if (jobs == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc cslide jobs fail\n");
+        return -1;
+    }
+
+    num = 0;
+    factory_foreach_working_pid_params(iter, &eng_params->factory) {
+        jobs[num].func = func;
+        jobs[num].pid_params = iter;
+        num++;
+    }
+
+    ret = cslide_run_jobs(eng_params, jobs, num);
+    free(jobs);
+    return ret;
+}
+
 static int cslide_get_vmas(struct cslide_pid_params *pid_params)
 {
     struct cslide_task_params *task_params = pid_params->task_params;
@@ -1267,6 +1959,50 @@ static void cslide_free_vmas(struct cslide_pid_params *params)
     params->vma_pf = NULL;
     free_vmas(params->vmas);
     params->vmas = NULL;
+    params->region_scanned = false;
+}
+
+/* fill vma_pf from the damon snapshot instead of the loops of idle_pages, 1 if the pid is not monitored */
+static int cslide_scan_regions(struct cslide_pid_params *params)
+{
+    struct cslide_eng_params *eng_params = params->eng_params;
+    struct page_scan *page_scan = (struct page_scan *)eng_params->proj->scan_param;
+    char pid[PID_STR_MAX_LEN] = {0};
+    struct damon_regions regions;
+    struct walk_address walk_address;
+    struct region_walk walk;
+    struct vma *vma = NULL;
+    int cursor = 0;
+    int ret = 0;
+    uint64_t i;
+
+    if (page_scan->source != SCAN_SRC_DAMON ||
+        etmemd_damon_get_regions(eng_params->proj, params->pid, &regions) != 0) {
+        return 1;
+    }
+
+    if (snprintf_s(pid, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", params->pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", params->pid);
+        etmemd_damon_free_regions(&regions);
+        return -1;
+    }
+
+    region_walk_open(&walk, pid, mem_type_page_type(eng_params->mem.type));
+    for (i = 0; i < params->vmas->vma_cnt; i++) {
+        vma = params->vma_pf[i].vma;
+        walk_address.walk_start = vma->start;
+        walk_address.walk_end = vma->end;
+        if (walk_regions(&regions, &cursor, &walk_address, params->count, &walk,
+                         &params->vma_pf[i].page_refs) == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "task %u build page_refs from damon regions fail\n", params->pid);
+            ret = -1;
+            break;
+        }
+    }
+    region_walk_close(&walk);
+
+    etmemd_damon_free_regions(&regions);
+    return ret;
 }
 
 static int cslide_scan_vmas(struct cslide_pid_params *params)
@@ -1275,53 +2011,73 @@ static int cslide_scan_vmas(struct cslide_pid_params *params)
     struct vmas *vmas = params->vmas;
     struct vma *vma = NULL;
     struct vma_pf *vma_pf = NULL;
-    FILE *scan_fp = NULL;
+    struct scan_backend backend;
     struct walk_address walk_address;
     uint64_t i;
-    int fd;
     struct cslide_task_params *task_params = params->task_params;
+    struct page_scan *page_scan = (struct page_scan *)params->eng_params->proj->scan_param;
     struct ioctl_para ioctl_para = {
         .ioctl_cmd = IDLE_SCAN_ADD_FLAGS,
         .ioctl_parameter = task_params->scan_flags,
     };
+    int ret;
 
-    if (snprintf_s(pid, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", params->pid) <= 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "snpintf pid %u fail\n", params->pid);
-        return -1;
+    /* one snapshot of damon stands for all the loops of the round */
+    if (params->region_scanned) {
+        return 0;
     }
-
-    scan_fp = etmemd_get_proc_file(pid, IDLE_SCAN_FILE, "r");
-    if (scan_fp == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "open %s file for pid %u fail\n", IDLE_SCAN_FILE, params->pid);
-        return -1;
+    ret = cslide_scan_regions(params);
+    if (ret <= 0) {
+        params->region_scanned = (ret == 0);
+        return ret;
     }
 
-    if (task_params->scan_flags != 0 && etmemd_send_ioctl_cmd(scan_fp, &ioctl_para) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "etmemd send_ioctl_cmd %s file for pid %u fail\n", IDLE_SCAN_FILE, params->pid);
-        fclose(scan_fp);
+    if (snprintf_s(pid, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", params->pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snpintf pid %u fail\n", params->pid);
         return -1;
     }
 
-    fd = fileno(scan_fp);
-    if (fd == -1) {
-        fclose(scan_fp);
-        etmemd_log(ETMEMD_LOG_ERR, "task %u fileno file fail for %s\n", params->pid, IDLE_SCAN_FILE);
+    if (scan_backend_open(&backend, page_scan->source, pid, &ioctl_para) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "task %u open scan backend fail\n", params->pid);
         return -1;
     }
+
     for (i = 0; i < vmas->vma_cnt; i++) {
         vma_pf = &params->vma_pf[i];
         vma = vma_pf->vma;
         walk_address.walk_start = vma->start;
         walk_address.walk_end = vma->end;
-        if (walk_vmas(fd, &walk_address, &vma_pf->page_refs, NULL, 0, 0) == NULL) {
+        walk_address.last_walk_end = vma->start;
+        if (walk_vmas(&backend, &walk_address, &vma_pf->page_refs, NULL, 0, 0) == NULL) {
             etmemd_log(ETMEMD_LOG_ERR, "task %u scan vma start %llu end %llu fail\n",
                     params->pid, vma->start, vma->end);
-            fclose(scan_fp);
+            scan_backend_close(&backend);
             return -1;
         }
     }
 
-    fclose(scan_fp);
+    scan_backend_close(&backend);
+    return 0;
+}
+
+static int cslide_get_vmas_job(struct cslide_job *job)
+{
+    if (cslide_get_vmas(job->pid_params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "cslide get vmas fail\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int cslide_scan_vmas_job(struct cslide_job *job)
+{
+    if (job->pid_params->vmas == NULL) {
+        return 0;
+    }
+    if (cslide_scan_vmas(job->pid_params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "cslide scan vmas fail\n");
+        return -1;
+    }
     return 0;
 }
 
@@ -1329,25 +2085,16 @@ static int cslide_scan_vmas(struct cslide_pid_params *params)
 // ->cslide_free_vmas
 static int cslide_do_scan(struct cslide_eng_params *eng_params)
 {
-    struct cslide_pid_params *iter = NULL;
     int i;
 
-    factory_foreach_working_pid_params(iter, &eng_params->factory) {
-        if (cslide_get_vmas(iter) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "cslide get vmas fail\n");
-            return -1;
-        }
+    if (cslide_run_pid_jobs(eng_params, cslide_get_vmas_job) != 0) {
+        return -1;
     }
 
+    /* pids are scanned in parallel, and each round is finished before the sleep */
     for (i = 0; i < eng_params->loop; i++) {
-        factory_foreach_working_pid_params(iter, &eng_params->factory) {
-            if (iter->vmas == NULL) {
-                continue;
-            }
-            if (cslide_scan_vmas(iter) != 0) {
-                etmemd_log(ETMEMD_LOG_ERR, "cslide scan vmas fail\n");
-                return -1;
-            }
+        if (cslide_run_pid_jobs(eng_params, cslide_scan_vmas_job) != 0) {
+            return -1;
         }
         sleep(eng_params->sleep);
     }
@@ -1355,18 +2102,88 @@ static int cslide_do_scan(struct cslide_eng_params *eng_params)
     return 0;
 }
 
-// error return -1; success return moved pages number
-static int do_migrate_pages(unsigned int pid, struct page_refs *page_refs, int node)
+static long long elapsed_ns(const struct timespec *from, const struct timespec *to)
+{
+    return (long long)(to->tv_sec - from->tv_sec) * NSEC_PER_SEC + (to->tv_nsec - from->tv_nsec);
+}
+
+/* one call lasts about MIG_PACE_SLICE_NS at the lower of the allowed and the measured rate, 0 for no limit */
+static long long mig_pace_batch_bytes(const struct mig_pace *pace)
+{
+    long long rate = pace->rate;
+    long long bytes;
+
+    if (rate == 0) {
+        return 0;
+    }
+    if (pace->tput > 0 && pace->tput < rate) {
+        rate = pace->tput;
+    }
+
+    bytes = rate / (NSEC_PER_SEC / MIG_PACE_SLICE_NS);
+    return bytes < MIG_PACE_MIN_BATCH ? MIG_PACE_MIN_BATCH : bytes;
+}
+
+static void mig_pace_begin(struct mig_pace *pace, long long rate)
+{
+    pace->rate = rate;
+    pace->moved = 0;
+    pace->batch_bytes = mig_pace_batch_bytes(pace);
+    clock_gettime(CLOCK_MONOTONIC, &pace->start);
+}
+
+static inline long long mig_pace_sample(long long old, long long sample)
+{
+    return old == 0 ? sample : old + (sample - old) / MIG_PACE_WEIGHT;
+}
+
+/* account a move_pages call started at call_start, and sleep until the bytes moved so far are due */
+static void mig_pace_batch(struct mig_pace *pace, long long bytes, const struct timespec *call_start)
+{
+    struct timespec now;
+    struct timespec gap;
+    long long ns;
+    long long due;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = elapsed_ns(call_start, &now);
+    if (ns > 0) {
+        pace->latency = mig_pace_sample(pace->latency, ns);
+        pace->tput = mig_pace_sample(pace->tput, (long long)((double)bytes * NSEC_PER_SEC / ns));
+    }
+    pace->moved += bytes;
+    pace->batch_bytes = mig_pace_batch_bytes(pace);
+    if (pace->rate == 0) {
+        return;
+    }
+
+    due = (long long)((double)pace->moved * NSEC_PER_SEC / pace->rate);
+    ns = elapsed_ns(&pace->start, &now);
+    if (due > ns) {
+        gap.tv_sec = (due - ns) / NSEC_PER_SEC;
+        gap.tv_nsec = (due - ns) % NSEC_PER_SEC;
+        (void)nanosleep(&gap, NULL);
+    }
+}
+
+// error return -1; success return moved size in bytes
+static long long do_migrate_pages(struct cslide_pid_params *params, const struct page_slices *slices, int node,
+        struct mig_pace *pace)
 {
     int batch_size = BATCHSIZE;
     int ret;
     void **pages = NULL;
     int *nodes = NULL;
     int *status = NULL;
+    const struct cslide_page *page = NULL;
+    const struct cslide_page *end = NULL;
     int actual_num = 0;
-    int moved = -1;
+    long long batch_size_bytes = 0;
+    long long moved = -1;
+    struct timespec call_start;
+    int i, j;
 
-    if (page_refs == NULL) {
+    if (slices->num == 0) {
         return 0;
     }
 
@@ -1389,23 +2206,37 @@ static int do_migrate_pages(unsigned int pid, struct page_refs *page_refs, int n
     }
 
     moved = 0;
-    while (page_refs != NULL) {
-        pages[actual_num] = (void *)page_refs->addr;
-        nodes[actual_num] = node;
-        actual_num++;
-        page_refs = page_refs->next;
-        if (actual_num == batch_size || page_refs == NULL) {
-            ret = move_pages(pid, actual_num, pages, nodes, status, MPOL_MF_MOVE_ALL);
+    for (i = 0; i < slices->num; i++) {
+        page = &params->pages[slices->slice[i].start];
+        end = page + slices->slice[i].num;
+        for (; page < end; page++) {
+            pages[actual_num] = (void *)page->addr;
+            nodes[actual_num] = node;
+            actual_num++;
+            batch_size_bytes += page_type_to_size(page->type);
+            if (actual_num < batch_size && (pace->batch_bytes == 0 || batch_size_bytes < pace->batch_bytes) &&
+                (page + 1 < end || i + 1 < slices->num)) {
+                continue;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &call_start);
+            ret = move_pages(params->pid, actual_num, pages, nodes, status, MPOL_MF_MOVE_ALL);
             if (ret != 0) {
-                etmemd_log(ETMEMD_LOG_ERR, "task %d move_pages fail with %d errno %d\n", pid, ret, errno);
+                etmemd_log(ETMEMD_LOG_ERR, "task %u move_pages fail with %d errno %d\n", params->pid, ret, errno);
                 moved = -1;
-                break;
+                goto free_pages;
+            }
+            for (j = 0; j < actual_num; j++) {
+                node_cache_update(&params->node_cache, (uint64_t)pages[j], status[j]);
             }
-            moved += actual_num;
+            mig_pace_batch(pace, batch_size_bytes, &call_start);
+            moved += batch_size_bytes;
+            batch_size_bytes = 0;
             actual_num = 0;
         }
     }
 
+free_pages:
     free(pages);
     pages = NULL;
 free_status:
@@ -1417,61 +2248,164 @@ free_nodes:
     return moved;
 }
 
-static int migrate_single_task(unsigned int pid, const struct memory_grade *memory_grade, int hot_node, int cold_node)
+static int migrate_single_task(struct cslide_pid_params *params, const struct cslide_grade *grade,
+        struct node_pair *pair)
 {
-    int moved;
+    unsigned int pid = params->pid;
+    int hot_node = pair->hot_node;
+    int cold_node = pair->cold_node;
+    long long moved;
 
-    moved = do_migrate_pages(pid, memory_grade->cold_pages, cold_node);
+    moved = do_migrate_pages(params, &grade->cold, cold_node, &pair->pace);
     if (moved == -1) {
         etmemd_log(ETMEMD_LOG_ERR, "task %u migrate cold pages fail\n", pid);
         return -1;
     }
     if (moved != 0) {
-        etmemd_log(ETMEMD_LOG_INFO, "task %u move pages %llu KB from node %d to node %d\n",
-                pid, HUGE_2M_TO_KB((unsigned int)moved), hot_node, cold_node);
+        etmemd_log(ETMEMD_LOG_INFO, "task %u move pages %lld KB from node %d to node %d\n",
+                pid, BYTE_TO_KB(moved), hot_node, cold_node);
     }
 
-    moved = do_migrate_pages(pid, memory_grade->hot_pages, hot_node);
+    moved = do_migrate_pages(params, &grade->hot, hot_node, &pair->pace);
     if (moved == -1) {
         etmemd_log(ETMEMD_LOG_ERR, "task %u migrate hot pages fail\n", pid);
         return -1;
     }
     if (moved != 0) {
-        etmemd_log(ETMEMD_LOG_INFO, "task %u move pages %llu KB from node %d to %d\n",
-                pid, HUGE_2M_TO_KB((unsigned int)moved), cold_node, hot_node);
+        etmemd_log(ETMEMD_LOG_INFO, "task %u move pages %lld KB from node %d to %d\n",
+                pid, BYTE_TO_KB(moved), cold_node, hot_node);
     }
 
     return 0;
 }
 
-static int cslide_do_migrate(struct cslide_eng_params *eng_params)
+/* the quota of the pair is spread over the window of its tier, and never faster than mig_bandwidth */
+static long long pair_mig_rate(const struct cslide_eng_params *eng_params, const struct node_pair *pair,
+                               long long window_ns)
+{
+    long long rate = (long long)eng_params->mig_bandwidth * HUGE_1M_SIZE;
+    long long quota = pair_mig_quota(eng_params, pair);
+    long long window_ms = window_ns / NSEC_PER_MSEC;
+
+    if (rate == 0) {
+        return 0;
+    }
+    if (window_ms > 0 && quota > 0 && quota * MSEC_PER_SEC / window_ms < rate) {
+        rate = quota * MSEC_PER_SEC / window_ms;
+    }
+    return rate;
+}
+
+/* the pages of all pids between one node pair, on a thread bound to the pair */
+static int cslide_migrate_pair_job(struct cslide_job *job)
 {
+    struct cslide_eng_params *eng_params = job->eng_params;
+    struct node_pair *pair = &eng_params->node_map.pair[job->pair_index];
     struct cslide_pid_params *iter = NULL;
-    struct node_pair *pair = NULL;
-    int bind_node, i;
+    int bind_node;
     int ret = 0;
 
+    bind_node = pair->hot_node < pair->cold_node ? pair->hot_node : pair->cold_node;
+    if (numa_run_on_node(bind_node) != 0) {
+        etmemd_log(ETMEMD_LOG_INFO, "fail to run on node %d to migrate memory\n", bind_node);
+    }
+
+    mig_pace_begin(&pair->pace, pair_mig_rate(eng_params, pair, job->window_ns));
     factory_foreach_working_pid_params(iter, &eng_params->factory) {
-        for (i = 0; i < eng_params->node_map.cur_num; i++) {
-            pair = &eng_params->node_map.pair[i];
-            bind_node = pair->hot_node < pair->cold_node ? pair->hot_node : pair->cold_node;
-            if (numa_run_on_node(bind_node) != 0) {
-                etmemd_log(ETMEMD_LOG_INFO, "fail to run on node %d to migrate memory\n", bind_node);
-            }
-            ret = migrate_single_task(iter->pid, &iter->memory_grade[i], pair->hot_node, pair->cold_node);
-            if (ret != 0) {
-                goto exit;
-            }
+        ret = migrate_single_task(iter, &iter->grade[job->pair_index], pair);
+        if (ret != 0) {
+            break;
         }
     }
+    if (pair->pace.moved != 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "node %d and %d migrate %lld KB/s latency %lld us batch %lld KB\n",
+                pair->hot_node, pair->cold_node, BYTE_TO_KB(pair->pace.tput),
+                pair->pace.latency / (NSEC_PER_MSEC / MSEC_PER_SEC), BYTE_TO_KB(pair->pace.batch_bytes));
+    }
 
-exit:
     if (numa_run_on_node(-1) != 0) {
         etmemd_log(ETMEMD_LOG_INFO, "fail to run on all node after migrate memory\n");
     }
     return ret;
 }
 
+static bool tier_has_pair(const struct node_map *map, int tier)
+{
+    int i;
+
+    for (i = 0; i < map->cur_num; i++) {
+        if (map->pair[i].tier == tier) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * the quota of every pair is already spent by cslide_filter_pfs. hops of the same tier share
+ * no node, so they are migrated in parallel, and the slowest tier goes first to make room
+ * in the middle tier nodes for the pages demoted from the tier above.
+ * tiers run one after another, so they share one deadline at the end of the interval, each
+ * tier is paced over an equal part of the time left.
+ */
+static int cslide_do_migrate(struct cslide_eng_params *eng_params)
+{
+    struct node_map *map = &eng_params->node_map;
+    struct cslide_job *jobs = NULL;
+    struct timespec deadline;
+    struct timespec now;
+    long long window_ns;
+    int tiers = 0;
+    int num;
+    int ret = 0;
+    int i, t;
+
+    if (map->cur_num == 0) {
+        return 0;
+    }
+
+    jobs = calloc(map->cur_num, sizeof(struct cslide_job));
+    if (jobs == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc cslide migrate jobs fail\n");
+        return -1;
+    }
+
+    for (t = map->max_tier; t >= 0; t--) {
+        if (tier_has_pair(map, t)) {
+            tiers++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += eng_params->interval;
+
+    for (t = map->max_tier; t >= 0 && tiers > 0; t--) {
+        if (!tier_has_pair(map, t)) {
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        window_ns = elapsed_ns(&now, &deadline) / tiers;
+        tiers--;
+
+        num = 0;
+        for (i = 0; i < map->cur_num; i++) {
+            if (map->pair[i].tier != t) {
+                continue;
+            }
+            jobs[num].func = cslide_migrate_pair_job;
+            jobs[num].pair_index = i;
+            jobs[num].window_ns = window_ns;
+            num++;
+        }
+        ret = cslide_run_jobs(eng_params, jobs, num);
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    free(jobs);
+    return ret;
+}
+
 static void init_host_pages_info(struct cslide_eng_params *eng_params)
 {
     int n;
@@ -1499,10 +2433,10 @@ static void update_pages_info(struct cslide_eng_params *eng_params, struct cslid
         task_pages[n].hot = 0;
 
         for (c = 0; c < actual_t; c++) {
-            task_pages[n].cold += HUGE_2M_TO_KB(pid_params->count_page_refs[c].node_pfs[n].num);
+            task_pages[n].cold += BYTE_TO_KB(pid_params->count_page_refs[c].node_pfs[n].size);
         }
         for (; c <= count; c++) {
-            task_pages[n].hot += HUGE_2M_TO_KB(pid_params->count_page_refs[c].node_pfs[n].num);
+            task_pages[n].hot += BYTE_TO_KB(pid_params->count_page_refs[c].node_pfs[n].size);
         }
 
         host_pages[n].cold += task_pages[n].cold;
@@ -1523,17 +2457,22 @@ static void cslide_stat(struct cslide_eng_params *eng_params)
     pthread_mutex_unlock(&eng_params->stat_mtx);
 }
 
+static int cslide_count_node_pfs_job(struct cslide_job *job)
+{
+    if (cslide_count_node_pfs(job->pid_params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "count node page refs fail\n");
+        return -1;
+    }
+    return 0;
+}
+
 static int cslide_policy(struct cslide_eng_params *eng_params)
 {
-    struct cslide_pid_params *pid_params = NULL;
     int ret;
 
-    factory_foreach_working_pid_params(pid_params, &eng_params->factory) {
-        ret = cslide_count_node_pfs(pid_params);
-        if (ret != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "count node page refs fail\n");
-            return ret;
-        }
+    ret = cslide_run_pid_jobs(eng_params, cslide_count_node_pfs_job);
+    if (ret != 0) {
+        return ret;
     }
 
     // update pages info now, so cslide_filter_pfs can use this info
@@ -1556,6 +2495,9 @@ static void cslide_clean_params(struct cslide_eng_params *eng_params)
 
 static void destroy_cslide_eng_params(struct cslide_eng_params *params)
 {
+    if (params->pool != NULL) {
+        threadpool_stop_and_destroy(&params->pool);
+    }
     free(params->host_pages_info);
     params->host_pages_info = NULL;
     destroy_factory(&params->factory);
@@ -1611,16 +2553,34 @@ destroy_sys_mem:
     return -1;
 }
 
+/* paced migration is spread over the interval, so only the rest of the interval is slept */
+static void cslide_sleep_interval(struct cslide_eng_params *eng_params, const struct timespec *mig_start)
+{
+    struct timespec now;
+    long long spent = 0;
+
+    if (eng_params->mig_bandwidth > 0 && (mig_start->tv_sec != 0 || mig_start->tv_nsec != 0)) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        spent = elapsed_ns(mig_start, &now) / NSEC_PER_SEC;
+    }
+    if (spent < eng_params->interval) {
+        sleep((unsigned int)(eng_params->interval - spent));
+    }
+}
+
 static void *cslide_main(void *arg)
 {
     struct cslide_eng_params *eng_params = (struct cslide_eng_params *)arg;
     struct sys_mem *mem = NULL;
+    struct timespec mig_start;
 
     // only invalid pthread id or deatch more than once will cause error
     // so no need to check return value of pthread_detach
     (void)pthread_detach(pthread_self());
 
     while (true) {
+        mig_start.tv_sec = 0;
+        mig_start.tv_nsec = 0;
         factory_update_pid_params(&eng_params->factory);
         if (eng_params->finish) {
             etmemd_log(ETMEMD_LOG_DEBUG, "cslide task is stopping...\n");
@@ -1646,13 +2606,14 @@ static void *cslide_main(void *arg)
             goto next;
         }
 
+        clock_gettime(CLOCK_MONOTONIC, &mig_start);
         if (cslide_do_migrate(eng_params) != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "cslide_do_migrate fail\n");
             goto next;
         }
 
 next:
-        sleep(eng_params->interval);
+        cslide_sleep_interval(eng_params, &mig_start);
         cslide_clean_params(eng_params);
     }
 
@@ -1781,7 +2742,7 @@ static int show_host_pages(void *params, int fd)
     dprintf_all(fd, "host pages info (KB):\n");
     dprintf_all(fd, "%5s %10s %10s %10s %10s\n", "node", "total", "used", "hot", "cold");
     for (n = 0; n < node_num; n++) {
-        total = eng_params->mem.node_mem[n].huge_total / 1024;
+        total = BYTE_TO_KB(eng_params->mem.node_mem[n].total);
         dprintf_all(fd, "%5d %10d %10d %10d %10d\n",
                     n, total, info[n].hot + info[n].cold, info[n].hot, info[n].cold);
     }
@@ -1880,10 +2841,6 @@ static int fill_task_vm_flags(void *obj, void *val)
     }
 
     params->vmflags_str = vm_flags;
-    if (params->vmflags_num != 1 || strcmp(params->vmflags_array[0], "ht") != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "cslide only work with ht set\n");
-        return -1;
-    }
     return 0;
 }
 
@@ -1908,13 +2865,32 @@ static int fill_task_scan_flags(void *obj, void *val)
 }
 
 static struct config_item g_cslide_task_config_items[] = {
-    {"vm_flags", STR_VAL, fill_task_vm_flags, false},
+    {"vm_flags", STR_VAL, fill_task_vm_flags, true},
     {"anon_only", STR_VAL, fill_task_anon_only, false},
     {"ign_host", STR_VAL, fill_task_scan_flags, false},
 };
 
+/*
+ * hugetlbfs is only found in vma with ht, and is scanned as huge pages.
+ * normal memory is scanned in all vmas or the ones of vm_flags, with the page size found by the scan.
+ */
+static int check_task_mem_type(struct cslide_task_params *params, enum cslide_mem_type type)
+{
+    if (type == CSLIDE_MEM_NORMAL) {
+        params->scan_flags &= ~SCAN_AS_HUGE;
+        return 0;
+    }
+
+    if (params->vmflags_num != 1 || strcmp(params->vmflags_array[0], "ht") != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "cslide only work with ht set for hugetlb memory\n");
+        return -1;
+    }
+    return 0;
+}
+
 static int cslide_fill_task(GKeyFile *config, struct task *tk)
 {
+    struct cslide_eng_params *eng_params = (struct cslide_eng_params *)tk->eng->params;
     struct cslide_task_params *params = calloc(1, sizeof(struct cslide_task_params));
 
     if (params == NULL) {
@@ -1928,6 +2904,10 @@ static int cslide_fill_task(GKeyFile *config, struct task *tk)
         goto exit;
     }
 
+    if (check_task_mem_type(params, eng_params->mem.type) != 0) {
+        goto exit;
+    }
+
     tk->params = params;
     if (etmemd_get_task_pids(tk, false) != 0) {
         etmemd_log(ETMEMD_LOG_ERR, "cslide fail to get task pids\n");
@@ -1949,6 +2929,10 @@ static void cslide_clear_task(struct task *tk)
     tk->params = NULL;
 }
 
+/*
+ * every item is a chain of nodes from the fastest tier to the slowest one, like "0,2,4",
+ * and each two adjacent nodes of it make a hop. "0,2" is the plain hot and cold node pair
+ */
 static int fill_node_pair(void *obj, void *val)
 {
     struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
@@ -1959,6 +2943,7 @@ static int fill_node_pair(void *obj, void *val)
     char *cold_node_str = NULL;
     char *saveptr_node = NULL;
     int hot_node, cold_node;
+    int tier;
     struct node_map *map = &params->node_map;
     struct node_verifier nv;
     char *pair_delim = " ;";
@@ -1979,29 +2964,37 @@ static int fill_node_pair(void *obj, void *val)
             goto err;
         }
 
-        cold_node_str = strtok_r(NULL, node_delim, &saveptr_node);
-        if (cold_node_str == NULL) {
-            etmemd_log(ETMEMD_LOG_ERR, "parse cold node failed\n");
-            goto err;
-        }
-
         if (get_int_value(hot_node_str, &hot_node) != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "transfer hot node %s to integer fail\n", hot_node_str);
             goto err;
         }
 
-        if (get_int_value(cold_node_str, &cold_node) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "transfer cold node %s to integer fail\n", cold_node_str);
+        if (!is_node_valid(&nv, hot_node)) {
+            etmemd_log(ETMEMD_LOG_ERR, "hot node %d invalid\n", hot_node);
             goto err;
         }
 
-        if (!is_node_valid(&nv, hot_node) || !is_node_valid(&nv, cold_node)) {
-            etmemd_log(ETMEMD_LOG_ERR, "node %d(hot)->%d(cold) invalid\n", hot_node, cold_node);
-            goto err;
+        for (tier = 0; (cold_node_str = strtok_r(NULL, node_delim, &saveptr_node)) != NULL; tier++) {
+            if (get_int_value(cold_node_str, &cold_node) != 0) {
+                etmemd_log(ETMEMD_LOG_ERR, "transfer cold node %s to integer fail\n", cold_node_str);
+                goto err;
+            }
+
+            if (!is_node_valid(&nv, cold_node)) {
+                etmemd_log(ETMEMD_LOG_ERR, "node %d(hot)->%d(cold) invalid\n", hot_node, cold_node);
+                goto err;
+            }
+
+            if (add_node_hop(map, cold_node, hot_node, tier) != 0) {
+                etmemd_log(ETMEMD_LOG_ERR, "add %d(hot)->%d(cold) fail\n", hot_node, cold_node);
+                goto err;
+            }
+            /* the cold node of this hop is the hot node of the next hop */
+            hot_node = cold_node;
         }
 
-        if (add_node_pair(map, cold_node, hot_node) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "add %d(hot)->%d(cold) fail\n", hot_node, cold_node);
+        if (tier == 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "parse cold node failed\n");
             goto err;
         }
     }
@@ -2065,11 +3058,166 @@ static int fill_mig_quota(void *obj, void *val)
     return 0;
 }
 
+static int parse_hop_limit(char *hop_str, int *hop, int num)
+{
+    char *saveptr = NULL;
+    char *item = NULL;
+    int i;
+
+    for (i = 0; i < num; i++) {
+        item = strtok_r(i == 0 ? hop_str : NULL, " ,", &saveptr);
+        if (item == NULL || get_int_value(item, &hop[i]) != 0 || hop[i] < 0) {
+            return -1;
+        }
+    }
+
+    return strtok_r(NULL, " ,", &saveptr) == NULL ? 0 : -1;
+}
+
+/* "hot,cold,quota,reserve;..." overrides node_mig_quota and node_hot_reserve of some hops */
+static int fill_hop_limit(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    char *hop_str = NULL;
+    char *saveptr = NULL;
+    struct node_pair *pair = NULL;
+    int hop[HOP_LIMIT_ITEMS];
+    int ret = -1;
+
+    for (hop_str = strtok_r((char *)val, " ;", &saveptr); hop_str != NULL;
+            hop_str = strtok_r(NULL, " ;", &saveptr)) {
+        if (parse_hop_limit(hop_str, hop, HOP_LIMIT_ITEMS) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "node_hop_limit : parse hop limit fail\n");
+            goto out;
+        }
+
+        pair = find_node_pair(&params->node_map, hop[HOP_HOT_NODE], hop[HOP_COLD_NODE]);
+        if (pair == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "node_hop_limit : hop %d(hot)->%d(cold) is not in node_pair\n",
+                       hop[HOP_HOT_NODE], hop[HOP_COLD_NODE]);
+            goto out;
+        }
+        pair->mig_quota = hop[HOP_MIG_QUOTA];
+        pair->hot_reserve = hop[HOP_HOT_RESERVE];
+    }
+    ret = 0;
+
+out:
+    free(val);
+    return ret;
+}
+
+static int fill_max_threads(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    int max_threads = parse_to_int(val);
+    int core = get_nprocs();
+
+    if (max_threads <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "config max threads %d not valid\n", max_threads);
+        return -1;
+    }
+
+    if (max_threads > 2 * core + 1) {
+        etmemd_log(ETMEMD_LOG_WARN, "max threads is limited to 2N+1 of the count of cores\n");
+        max_threads = 2 * core + 1;
+    }
+
+    params->max_threads = max_threads;
+    return 0;
+}
+
+static int fill_node_cache_age(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    int age = parse_to_int(val);
+
+    if (age < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "config node cache age %d not valid\n", age);
+        return -1;
+    }
+
+    params->node_cache_age = age;
+    return 0;
+}
+
+static int fill_hotness_decay(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    int decay = parse_to_int(val);
+
+    if (decay < 0 || decay > HOTNESS_DECAY_MAX) {
+        etmemd_log(ETMEMD_LOG_ERR, "config hotness decay %d not valid, should be in [0, %d]\n",
+                   decay, HOTNESS_DECAY_MAX);
+        return -1;
+    }
+
+    params->hotness_decay = decay;
+    return 0;
+}
+
+static int fill_hot_hysteresis(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    int hysteresis = parse_to_int(val);
+
+    if (hysteresis < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "config hot hysteresis %d not valid\n", hysteresis);
+        return -1;
+    }
+
+    params->hot_hysteresis = hysteresis;
+    return 0;
+}
+
+static int fill_mig_bandwidth(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    int bandwidth = parse_to_int(val);
+
+    if (bandwidth < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "config mig bandwidth %d not valid\n", bandwidth);
+        return -1;
+    }
+
+    params->mig_bandwidth = bandwidth;
+    return 0;
+}
+
+static int fill_mem_type(void *obj, void *val)
+{
+    struct cslide_eng_params *params = (struct cslide_eng_params *)obj;
+    char *mem_type = (char *)val;
+    int ret = 0;
+
+    if (strcmp(mem_type, "hugetlb_2m") == 0) {
+        params->mem_type = CSLIDE_MEM_HUGE_2M;
+    } else if (strcmp(mem_type, "hugetlb_1g") == 0) {
+        params->mem_type = CSLIDE_MEM_HUGE_1G;
+    } else if (strcmp(mem_type, "normal") == 0) {
+        params->mem_type = CSLIDE_MEM_NORMAL;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "mem_type : not support %s\n", mem_type);
+        etmemd_log(ETMEMD_LOG_ERR, "mem_type : only support hugetlb_2m/hugetlb_1g/normal\n");
+        ret = -1;
+    }
+
+    free(val);
+    return ret;
+}
+
 static struct config_item cslide_eng_config_items[] = {
     {"node_pair", STR_VAL, fill_node_pair, false},
     {"hot_threshold", INT_VAL, fill_hot_threshold, false},
     {"node_mig_quota", INT_VAL, fill_mig_quota, false},
     {"node_hot_reserve", INT_VAL, fill_hot_reserve, false},
+    {"node_hop_limit", STR_VAL, fill_hop_limit, true},
+    {"max_threads", INT_VAL, fill_max_threads, true},
+    {"node_cache_age", INT_VAL, fill_node_cache_age, true},
+    {"hotness_decay", INT_VAL, fill_hotness_decay, true},
+    {"hot_hysteresis", INT_VAL, fill_hot_hysteresis, true},
+    {"node_mig_bandwidth", INT_VAL, fill_mig_bandwidth, true},
+    {"mem_type", STR_VAL, fill_mem_type, true},
 };
 
 static int cslide_fill_eng(GKeyFile *config, struct engine *eng)
@@ -2090,12 +3238,25 @@ static int cslide_fill_eng(GKeyFile *config, struct engine *eng)
     params->loop = page_scan->loop;
     params->interval = page_scan->interval;
     params->sleep = page_scan->sleep;
+    params->proj = eng->proj;
+    params->max_threads = 1;
     if (parse_file_config(config, ENG_GROUP, cslide_eng_config_items,
         ARRAY_SIZE(cslide_eng_config_items), (void *)params) != 0) {
         etmemd_log(ETMEMD_LOG_ERR, "cslide fill engine params fail\n");
         goto destroy_eng_params;
     }
 
+    if (set_sys_mem_type(&params->mem, params->mem_type) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "cslide get memory of type %d fail\n", params->mem_type);
+        goto destroy_eng_params;
+    }
+
+    params->pool = threadpool_create(params->max_threads);
+    if (params->pool == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "create cslide worker pool fail\n");
+        goto destroy_eng_params;
+    }
+
     eng->params = params;
     if (pthread_create(&params->worker, NULL, cslide_main, params) != 0) {
         etmemd_log(ETMEMD_LOG_ERR, "start cslide main worker fail\n");
@@ -16,6 +16,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/limits.h>
 
 #include "securec.h"
 #include "etmemd_log.h"
@@ -26,8 +37,10 @@
 #include "etmemd_task_exp.h"
 #include "etmemd_scan.h"
 #include "etmemd_damon.h"
+#include "etmemd_region_sampler.h"
 
 #define KERNEL_DAMON_PATH "/sys/kernel/debug/damon/"
+#define KERNEL_DAMON_SYSFS_PATH "/sys/kernel/mm/damon/admin/"
 #define DAMON_PARAM_TARGET_IDS "target_ids"
 #define DAMON_PARAM_ATTRS "attrs"
 #define DAMON_PARAM_SCHEMES "schemes"
@@ -36,8 +49,38 @@
 #define ON_LEN 2
 #define OFF_LEN 3
 #define INT_MAX_LEN 10
+#define ULONG_MAX_LEN 20
 #define NUM_OF_ATTRS 5
 #define NUM_OF_SCHEMES 7
+#define NUM_OF_SCHEMES_EXT 18       // with quotas and watermarks, since linux 5.16
+
+#define DAMON_SYSFS_KDAMONDS 8      // each started project owns one kdamond with one context
+#define DAMON_SYSFS_VAL_LEN 32
+#define DAMOS_WMARK_PERMIL_MAX 1000
+#define DAMOS_QUOTA_WEIGHT_SZ 0     // the coldest and oldest regions go first when the quota is short
+#define DAMOS_QUOTA_WEIGHT_ACC 1
+#define DAMOS_QUOTA_WEIGHT_AGE 1
+
+/* attrs of the monitor of page scan projects, as the defaults of damon */
+#define DAMON_MONITOR_SAMPLE_US 5000
+#define DAMON_MONITOR_AGGR_US 100000
+#define DAMON_MONITOR_UPDATE_US 1000000
+#define DAMON_MONITOR_MIN_REGIONS 10
+#define DAMON_MONITOR_MAX_REGIONS 1000
+
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+enum damon_iface {
+    DAMON_IFACE_NONE = 0,
+    DAMON_IFACE_SYSFS,
+    DAMON_IFACE_DEBUGFS,
+    DAMON_IFACE_USER,           // regions sampled by etmemd through idle_pages
+};
 
 enum damos_action {
     DAMOS_WILLNEED,
@@ -53,7 +96,51 @@ struct action_item {
     enum damos_action action_type;
 };
 
-struct damon_eng_params {
+enum damos_wmark_metric {
+    DAMOS_WMARK_NONE,
+    DAMOS_WMARK_FREE_MEM_RATE,
+};
+
+/* files of one tried region */
+enum damon_region_item {
+    DAMON_REGION_START = 0,
+    DAMON_REGION_END,
+    DAMON_REGION_ACCESSES,
+    DAMON_REGION_AGE,
+    DAMON_REGION_ITEMS,
+};
+
+/* fields of one item of schemes, the quota fields are optional */
+enum scheme_item {
+    SCHEME_MIN_SIZE = 0,
+    SCHEME_MAX_SIZE,
+    SCHEME_MIN_ACC,
+    SCHEME_MAX_ACC,
+    SCHEME_MIN_AGE,
+    SCHEME_MAX_AGE,
+    SCHEME_ACTION,
+    SCHEME_QUOTA_MS,
+    SCHEME_QUOTA_BYTES,
+    SCHEME_QUOTA_RESET,
+    SCHEME_ITEMS,
+};
+
+/* 0 for no limit */
+struct damos_quota {
+    unsigned long ms;
+    unsigned long bytes;
+    unsigned long reset_interval;   // in ms
+};
+
+struct damos_wmark {
+    enum damos_wmark_metric metric;
+    unsigned long interval;         // in us
+    unsigned long high;             // in permil
+    unsigned long mid;
+    unsigned long low;
+};
+
+struct damon_scheme {
     unsigned long min_sz_region;
     unsigned long max_sz_region;
     unsigned int min_nr_accesses;
@@ -61,14 +148,96 @@ struct damon_eng_params {
     unsigned int min_age_region;
     unsigned int max_age_region;
     enum damos_action action;
+    struct damos_quota quota;
+};
+
+struct damon_addr_range {
+    unsigned long start;
+    unsigned long end;
+};
+
+/* quota of a scheme used in the current reset interval, when the schemes are applied by etmemd */
+struct damos_charge {
+    unsigned long bytes;
+    unsigned long us;
+    uint64_t reset_at;
 };
 
-static bool check_damon_exist(void)
+struct damon_eng_params {
+    struct damon_scheme *schemes;   // the first one is from min_size, ..., action
+    int nr_schemes;
+    struct damos_wmark wmark;       // shared by all schemes
+    struct damon_addr_range *exclude;
+    int nr_exclude;
+    enum damon_iface iface;         // of the running monitor, none if stopped
+    int kdamond;                    // index in sysfs of the running monitor
+    struct region_sampler *sampler; // the running monitor without kernel damon
+    struct damos_charge *charge;    // one for each scheme, with the sampler
+    bool wmark_active;
+    uint64_t wmark_checked;         // in us
+};
+
+struct damon_pids {
+    unsigned int *pid;
+    int num;
+};
+
+static bool g_kdamond_used[DAMON_SYSFS_KDAMONDS];
+static bool g_kdamonds_created;
+static bool g_debugfs_used;
+/*
+ * the monitors of projects may be stopped while the scan of an engine is reading it,
+ * the lock only guards the monitor of page_scan and its refs, not the reads of sysfs
+ */
+static pthread_mutex_t g_monitor_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* sysfs is preferred, debugfs is deprecated since linux 5.18 */
+static enum damon_iface get_damon_iface(void)
 {
-    if (access(KERNEL_DAMON_PATH, F_OK) != 0) {
-        return false;
+    if (access(KERNEL_DAMON_SYSFS_PATH, F_OK) == 0) {
+        return DAMON_IFACE_SYSFS;
     }
-    return true;
+    if (access(KERNEL_DAMON_PATH, F_OK) == 0) {
+        return DAMON_IFACE_DEBUGFS;
+    }
+    return DAMON_IFACE_NONE;
+}
+
+static struct action_item damon_action_items[] = {
+    {"willneed", DAMOS_WILLNEED},
+    {"cold", DAMOS_COLD},
+    {"pageout", DAMOS_PAGEOUT},
+    {"hugepage", DAMOS_HUGEPAGE},
+    {"nohugepage", DAMOS_NOHUGEPAGE},
+    {"stat", DAMOS_STAT},
+};
+
+static int parse_action(const char *action, enum damos_action *action_type)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(damon_action_items); i++) {
+        if (strcmp(action, damon_action_items[i].action_str) == 0) {
+            *action_type = damon_action_items[i].action_type;
+            return 0;
+        }
+    }
+
+    etmemd_log(ETMEMD_LOG_ERR, "damon action %s not supported\n", action);
+    return -1;
+}
+
+static const char *get_damon_action_str(enum damos_action action)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(damon_action_items); i++) {
+        if (damon_action_items[i].action_type == action) {
+            return damon_action_items[i].action_str;
+        }
+    }
+
+    return "stat";
 }
 
 static FILE *get_damon_file(const char *file)
@@ -265,27 +434,78 @@ out:
     return ret;
 }
 
+static bool is_quota_set(const struct damos_quota *quota)
+{
+    return quota->ms != 0 || quota->bytes != 0;
+}
+
+/* the old format of linux 5.15 is kept unless quotas or watermarks are used */
+static bool use_schemes_ext(const struct damon_eng_params *params)
+{
+    int i;
+
+    if (params->wmark.metric != DAMOS_WMARK_NONE) {
+        return true;
+    }
+    for (i = 0; i < params->nr_schemes; i++) {
+        if (is_quota_set(&params->schemes[i].quota)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int add_damon_scheme_str(char *schemes, size_t schemes_size, const struct damon_scheme *scheme,
+                                const struct damos_wmark *wmark, bool ext)
+{
+    size_t len = strlen(schemes);
+    int ret;
+
+    if (!ext) {
+        ret = snprintf_s(schemes + len, schemes_size - len, schemes_size - len - 1, "%lu %lu %u %u %u %u %d\n",
+                         scheme->min_sz_region, scheme->max_sz_region,
+                         scheme->min_nr_accesses, scheme->max_nr_accesses,
+                         scheme->min_age_region, scheme->max_age_region,
+                         scheme->action);
+    } else {
+        ret = snprintf_s(schemes + len, schemes_size - len, schemes_size - len - 1,
+                         "%lu %lu %u %u %u %u %d %lu %lu %lu %u %u %u %d %lu %lu %lu %lu\n",
+                         scheme->min_sz_region, scheme->max_sz_region,
+                         scheme->min_nr_accesses, scheme->max_nr_accesses,
+                         scheme->min_age_region, scheme->max_age_region,
+                         scheme->action, scheme->quota.ms, scheme->quota.bytes, scheme->quota.reset_interval,
+                         DAMOS_QUOTA_WEIGHT_SZ, DAMOS_QUOTA_WEIGHT_ACC, DAMOS_QUOTA_WEIGHT_AGE,
+                         wmark->metric, wmark->interval, wmark->high, wmark->mid, wmark->low);
+    }
+
+    return ret == -1 ? -1 : 0;
+}
+
 static char *get_damon_schemes_str(struct project *proj)
 {
     char *schemes = NULL;
     size_t schemes_size;
     struct damon_eng_params *params = (struct damon_eng_params *)proj->engs->params;
+    bool ext = use_schemes_ext(params);
+    int i;
+
+    if (params->nr_exclude != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "exclude_addr is not supported by damon debugfs, ignore it\n");
+    }
 
-    schemes_size = (INT_MAX_LEN + 1) * NUM_OF_SCHEMES;
+    schemes_size = (ULONG_MAX_LEN + 1) * (ext ? NUM_OF_SCHEMES_EXT : NUM_OF_SCHEMES) * params->nr_schemes + 1;
     schemes = (char *)calloc(schemes_size, sizeof(char));
     if (schemes == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "malloc for schemes in damon fail\n");
         return NULL;
     }
 
-    if (snprintf_s(schemes, schemes_size, schemes_size - 1, "%lu %lu %u %u %u %u %d",
-                   params->min_sz_region, params->max_sz_region,
-                   params->min_nr_accesses, params->max_nr_accesses,
-                   params->min_age_region, params->max_age_region,
-                   params->action) == -1) {
-        etmemd_log(ETMEMD_LOG_ERR, "snprintf for schemes fail\n");
-        free(schemes);
-        return NULL;
+    for (i = 0; i < params->nr_schemes; i++) {
+        if (add_damon_scheme_str(schemes, schemes_size, &params->schemes[i], &params->wmark, ext) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "snprintf for schemes fail\n");
+            free(schemes);
+            return NULL;
+        }
     }
 
     return schemes;
@@ -375,17 +595,12 @@ out:
     return ret;
 }
 
-int etmemd_start_damon(struct project *proj)
+static int damon_debugfs_start(struct project *proj)
 {
     bool start = true;
 
-    if (proj == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "proj should not be NULL\n");
-        return -1;
-    }
-
-    if (!check_damon_exist()) {
-        etmemd_log(ETMEMD_LOG_ERR, "kernel damon module not exist\n");
+    if (g_debugfs_used) {
+        etmemd_log(ETMEMD_LOG_ERR, "damon debugfs only monitors one project at a time\n");
         return -1;
     }
 
@@ -409,146 +624,1464 @@ int etmemd_start_damon(struct project *proj)
         return -1;
     }
 
+    g_debugfs_used = true;
     return 0;
 }
 
-int etmemd_stop_damon(void)
+static int damon_debugfs_stop(void)
 {
     bool start = false;
 
-    if (!check_damon_exist()) {
-        etmemd_log(ETMEMD_LOG_ERR, "kernel damon module not exist\n");
+    if (set_damon_monitor_on(start) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon monitor_on to off fail\n");
         return -1;
     }
 
-    if (set_damon_monitor_on(start) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "set damon monitor_on to off fail\n");
+    g_debugfs_used = false;
+    return 0;
+}
+
+static int damon_sysfs_path(char *path, const char *dir, const char *file)
+{
+    if (snprintf_s(path, PATH_MAX, PATH_MAX - 1, "%s%s", dir, file) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for damon sysfs path %s%s fail\n", dir, file);
+        return -1;
+    }
+    return 0;
+}
+
+static int damon_sysfs_write(const char *dir, const char *file, const char *val)
+{
+    char path[PATH_MAX] = {0};
+    size_t len = strlen(val);
+    ssize_t written;
+    int fd;
+
+    if (damon_sysfs_path(path, dir, file) != 0) {
+        return -1;
+    }
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open damon sysfs file %s fail\n", path);
+        return -1;
+    }
+
+    written = write(fd, val, len);
+    close(fd);
+    if (written != (ssize_t)len) {
+        etmemd_log(ETMEMD_LOG_ERR, "write %s to damon sysfs file %s fail\n", val, path);
         return -1;
     }
 
     return 0;
 }
 
-static int fill_min_size(void *obj, void *val)
+static int damon_sysfs_write_ulong(const char *dir, const char *file, unsigned long val)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned long min_size = parse_to_ulong(val);
+    char val_str[DAMON_SYSFS_VAL_LEN] = {0};
+
+    if (snprintf_s(val_str, DAMON_SYSFS_VAL_LEN, DAMON_SYSFS_VAL_LEN - 1, "%lu", val) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for damon sysfs value %lu fail\n", val);
+        return -1;
+    }
+    return damon_sysfs_write(dir, file, val_str);
+}
+
+/* sub dir of dir, ended with '/' */
+static int damon_sysfs_subdir(char *subdir, const char *dir, const char *name, int index)
+{
+    int ret;
 
-    params->min_sz_region = min_size;
+    if (index < 0) {
+        ret = snprintf_s(subdir, PATH_MAX, PATH_MAX - 1, "%s%s/", dir, name);
+    } else {
+        ret = snprintf_s(subdir, PATH_MAX, PATH_MAX - 1, "%s%s/%d/", dir, name, index);
+    }
+    if (ret == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for damon sysfs dir %s%s fail\n", dir, name);
+        return -1;
+    }
     return 0;
 }
 
-static int fill_max_size(void *obj, void *val)
+/* the count of kdamonds can only be changed when none of them runs, so all are created at the first start */
+static int damon_sysfs_get_kdamond(void)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned long max_size = parse_to_ulong(val);
+    char path[PATH_MAX] = {0};
+    unsigned long nr_kdamonds = 0;
+    int fd;
+    int i;
+
+    if (!g_kdamonds_created) {
+        if (damon_sysfs_path(path, KERNEL_DAMON_SYSFS_PATH, "kdamonds/nr_kdamonds") != 0) {
+            return -1;
+        }
+        fd = open(path, O_RDONLY);
+        if (fd < 0 || get_ulong_from_fd(fd, &nr_kdamonds) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "read damon sysfs file %s fail\n", path);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        close(fd);
+
+        if (nr_kdamonds < DAMON_SYSFS_KDAMONDS &&
+            damon_sysfs_write_ulong(KERNEL_DAMON_SYSFS_PATH, "kdamonds/nr_kdamonds", DAMON_SYSFS_KDAMONDS) != 0) {
+            return -1;
+        }
+        g_kdamonds_created = true;
+    }
+
+    for (i = 0; i < DAMON_SYSFS_KDAMONDS; i++) {
+        if (!g_kdamond_used[i]) {
+            return i;
+        }
+    }
+
+    etmemd_log(ETMEMD_LOG_ERR, "at most %d projects of region scan can be started\n", DAMON_SYSFS_KDAMONDS);
+    return -1;
+}
+
+static int damon_sysfs_set_attrs(const char *ctx_dir, const struct region_scan *reg_scan)
+{
+    char dir[PATH_MAX] = {0};
+
+    if (damon_sysfs_subdir(dir, ctx_dir, "monitoring_attrs/intervals", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "sample_us", reg_scan->sample_interval) != 0 ||
+        damon_sysfs_write_ulong(dir, "aggr_us", reg_scan->aggr_interval) != 0 ||
+        damon_sysfs_write_ulong(dir, "update_us", reg_scan->update_interval) != 0) {
+        return -1;
+    }
+
+    if (damon_sysfs_subdir(dir, ctx_dir, "monitoring_attrs/nr_regions", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "min", reg_scan->min_nr_regions) != 0 ||
+        damon_sysfs_write_ulong(dir, "max", reg_scan->max_nr_regions) != 0) {
+        return -1;
+    }
 
-    params->max_sz_region = max_size;
     return 0;
 }
 
-static int fill_min_acc(void *obj, void *val)
+/* the first pid of each task, a task without living pid fails the strict call and is skipped otherwise */
+static int add_task_pids(struct task *tk, struct damon_pids *pids, bool strict)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned int min_acc = parse_to_uint(val);
+    unsigned int *pid = NULL;
+
+    for (; tk != NULL; tk = tk->next) {
+        if (etmemd_get_task_pids(tk, false) != 0 || tk->pids == NULL) {
+            if (strict) {
+                etmemd_log(ETMEMD_LOG_ERR, "damon fail to get task pids\n");
+                return -1;
+            }
+            continue;
+        }
+
+        pid = realloc(pids->pid, sizeof(unsigned int) * (pids->num + 1));
+        if (pid == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "alloc damon target pids fail\n");
+            return -1;
+        }
+        pids->pid = pid;
+        pids->pid[pids->num++] = tk->pids->pid;
+    }
 
-    params->min_nr_accesses = min_acc;
     return 0;
 }
 
-static int fill_max_acc(void *obj, void *val)
+static int damon_sysfs_set_targets(const char *ctx_dir, const struct damon_pids *pids)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned int max_acc = parse_to_uint(val);
+    char dir[PATH_MAX] = {0};
+    int i;
+
+    if (damon_sysfs_subdir(dir, ctx_dir, "targets", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "nr_targets", (unsigned long)pids->num) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < pids->num; i++) {
+        if (damon_sysfs_subdir(dir, ctx_dir, "targets", i) != 0 ||
+            damon_sysfs_write_ulong(dir, "pid_target", pids->pid[i]) != 0) {
+            return -1;
+        }
+    }
 
-    params->max_nr_accesses = max_acc;
     return 0;
 }
 
-static int fill_min_age(void *obj, void *val)
+static int damon_sysfs_set_access_pattern(const char *scheme_dir, const struct damon_scheme *scheme)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned int min_age = parse_to_uint(val);
+    char dir[PATH_MAX] = {0};
+
+    if (damon_sysfs_subdir(dir, scheme_dir, "access_pattern/sz", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "min", scheme->min_sz_region) != 0 ||
+        damon_sysfs_write_ulong(dir, "max", scheme->max_sz_region) != 0) {
+        return -1;
+    }
+
+    if (damon_sysfs_subdir(dir, scheme_dir, "access_pattern/nr_accesses", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "min", scheme->min_nr_accesses) != 0 ||
+        damon_sysfs_write_ulong(dir, "max", scheme->max_nr_accesses) != 0) {
+        return -1;
+    }
+
+    if (damon_sysfs_subdir(dir, scheme_dir, "access_pattern/age", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "min", scheme->min_age_region) != 0 ||
+        damon_sysfs_write_ulong(dir, "max", scheme->max_age_region) != 0) {
+        return -1;
+    }
 
-    params->min_age_region = min_age;
     return 0;
 }
 
-static int fill_max_age(void *obj, void *val)
+static int damon_sysfs_set_quota(const char *scheme_dir, const struct damos_quota *quota)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    unsigned int max_age = parse_to_uint(val);
+    char dir[PATH_MAX] = {0};
+
+    if (damon_sysfs_subdir(dir, scheme_dir, "quotas", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "ms", quota->ms) != 0 ||
+        damon_sysfs_write_ulong(dir, "bytes", quota->bytes) != 0 ||
+        damon_sysfs_write_ulong(dir, "reset_interval_ms", quota->reset_interval) != 0) {
+        return -1;
+    }
+
+    if (!is_quota_set(quota)) {
+        return 0;
+    }
+
+    if (damon_sysfs_subdir(dir, scheme_dir, "quotas/weights", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "sz_permil", DAMOS_QUOTA_WEIGHT_SZ) != 0 ||
+        damon_sysfs_write_ulong(dir, "nr_accesses_permil", DAMOS_QUOTA_WEIGHT_ACC) != 0 ||
+        damon_sysfs_write_ulong(dir, "age_permil", DAMOS_QUOTA_WEIGHT_AGE) != 0) {
+        return -1;
+    }
 
-    params->max_age_region = max_age;
     return 0;
 }
 
-static struct action_item damon_action_items[] = {
-    {"willneed", DAMOS_WILLNEED},
-    {"cold", DAMOS_COLD},
-    {"pageout", DAMOS_PAGEOUT},
-    {"hugepage", DAMOS_HUGEPAGE},
-    {"nohugepage", DAMOS_NOHUGEPAGE},
-    {"stat", DAMOS_STAT},
-};
+static int damon_sysfs_set_wmark(const char *scheme_dir, const struct damos_wmark *wmark)
+{
+    char dir[PATH_MAX] = {0};
 
-static int fill_action(void *obj, void *val)
+    if (damon_sysfs_subdir(dir, scheme_dir, "watermarks", -1) != 0) {
+        return -1;
+    }
+
+    if (wmark->metric == DAMOS_WMARK_NONE) {
+        return damon_sysfs_write(dir, "metric", "none");
+    }
+
+    if (damon_sysfs_write(dir, "metric", "free_mem_rate") != 0 ||
+        damon_sysfs_write_ulong(dir, "interval_us", wmark->interval) != 0 ||
+        damon_sysfs_write_ulong(dir, "high", wmark->high) != 0 ||
+        damon_sysfs_write_ulong(dir, "mid", wmark->mid) != 0 ||
+        damon_sysfs_write_ulong(dir, "low", wmark->low) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* memory matching an addr filter is filtered out from the scheme */
+static int damon_sysfs_set_filters(const char *scheme_dir, const struct damon_eng_params *params)
 {
-    struct damon_eng_params *params = (struct damon_eng_params *)obj;
-    char *action = (char *)val;
-    unsigned int i;
+    char dir[PATH_MAX] = {0};
+    int i;
 
-    for (i = 0; i < ARRAY_SIZE(damon_action_items); i++) {
-        if (strcmp(action, damon_action_items[i].action_str) == 0) {
-            params->action = damon_action_items[i].action_type;
-            free(action);
-            return 0;
+    if (damon_sysfs_subdir(dir, scheme_dir, "filters", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "nr_filters", (unsigned long)params->nr_exclude) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < params->nr_exclude; i++) {
+        if (damon_sysfs_subdir(dir, scheme_dir, "filters", i) != 0 ||
+            damon_sysfs_write(dir, "type", "addr") != 0 ||
+            damon_sysfs_write_ulong(dir, "addr_start", params->exclude[i].start) != 0 ||
+            damon_sysfs_write_ulong(dir, "addr_end", params->exclude[i].end) != 0 ||
+            damon_sysfs_write(dir, "matching", "Y") != 0) {
+            return -1;
         }
     }
 
-    free(action);
-    return -1;
+    return 0;
 }
 
-static struct config_item damon_eng_config_items[] = {
-    {"min_size", INT_VAL, fill_min_size, false},
-    {"max_size", INT_VAL, fill_max_size, false},
-    {"min_acc", INT_VAL, fill_min_acc, false},
-    {"max_acc", INT_VAL, fill_max_acc, false},
-    {"min_age", INT_VAL, fill_min_age, false},
-    {"max_age", INT_VAL, fill_max_age, false},
-    {"action", STR_VAL, fill_action, false},
-};
+static int damon_sysfs_set_schemes(const char *ctx_dir, const struct damon_eng_params *params)
+{
+    char dir[PATH_MAX] = {0};
+    int i;
 
-static int damon_fill_eng(GKeyFile *config, struct engine *eng)
+    if (damon_sysfs_subdir(dir, ctx_dir, "schemes", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "nr_schemes", (unsigned long)params->nr_schemes) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < params->nr_schemes; i++) {
+        if (damon_sysfs_subdir(dir, ctx_dir, "schemes", i) != 0 ||
+            damon_sysfs_write(dir, "action", get_damon_action_str(params->schemes[i].action)) != 0 ||
+            damon_sysfs_set_access_pattern(dir, &params->schemes[i]) != 0 ||
+            damon_sysfs_set_quota(dir, &params->schemes[i].quota) != 0 ||
+            damon_sysfs_set_wmark(dir, &params->wmark) != 0 ||
+            damon_sysfs_set_filters(dir, params) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "set damon scheme %d fail\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* the whole context is written again at each start, kdamond reads it when turned on */
+static int damon_sysfs_set_ctx(const char *ctx_dir, const struct region_scan *attrs, const struct damon_pids *pids)
 {
-    struct damon_eng_params *params = calloc(1, sizeof(struct damon_eng_params));
+    if (damon_sysfs_write(ctx_dir, "operations", "vaddr") != 0) {
+        return -1;
+    }
 
-    if (params == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "alloc damon engine params fail\n");
+    if (damon_sysfs_set_attrs(ctx_dir, attrs) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon attrs fail\n");
         return -1;
     }
 
-    if (parse_file_config(config, ENG_GROUP, damon_eng_config_items,
-        ARRAY_SIZE(damon_eng_config_items), (void *)params) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "damon fill engine params fail.\n");
-        free(params);
+    if (damon_sysfs_set_targets(ctx_dir, pids) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon targets fail\n");
         return -1;
     }
 
-    eng->params = (void *)params;
     return 0;
 }
 
-static void damon_clear_eng(struct engine *eng)
+static int damon_sysfs_kdamond_dirs(int kdamond, char *kdamond_dir, char *ctx_dir)
 {
-    struct damon_eng_params *eng_params = (struct damon_eng_params *)eng->params;
+    if (damon_sysfs_subdir(kdamond_dir, KERNEL_DAMON_SYSFS_PATH, "kdamonds", kdamond) != 0 ||
+        damon_sysfs_subdir(ctx_dir, kdamond_dir, "contexts", 0) != 0) {
+        return -1;
+    }
+    return damon_sysfs_write_ulong(kdamond_dir, "contexts/nr_contexts", 1);
+}
 
-    if (eng_params == NULL) {
-        return;
+static int damon_sysfs_turn_on(int kdamond, const char *kdamond_dir)
+{
+    if (damon_sysfs_write(kdamond_dir, "state", "on") != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "turn on kdamond %d fail\n", kdamond);
+        return -1;
     }
 
-    free(eng_params);
+    g_kdamond_used[kdamond] = true;
+    return 0;
+}
+
+static int damon_sysfs_start(struct project *proj)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)proj->engs->params;
+    struct damon_pids pids = {0};
+    char kdamond_dir[PATH_MAX] = {0};
+    char ctx_dir[PATH_MAX] = {0};
+    int kdamond;
+    int ret = -1;
+
+    /* each task is a target, as target_ids of debugfs */
+    if (!is_engs_valid(proj) || add_task_pids(proj->engs->tasks, &pids, true) != 0) {
+        goto out;
+    }
+
+    kdamond = damon_sysfs_get_kdamond();
+    if (kdamond < 0) {
+        goto out;
+    }
+
+    if (damon_sysfs_kdamond_dirs(kdamond, kdamond_dir, ctx_dir) != 0 ||
+        damon_sysfs_set_ctx(ctx_dir, (struct region_scan *)proj->scan_param, &pids) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon context of kdamond %d fail\n", kdamond);
+        goto out;
+    }
+
+    if (damon_sysfs_set_schemes(ctx_dir, params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon schemes fail\n");
+        goto out;
+    }
+
+    if (damon_sysfs_turn_on(kdamond, kdamond_dir) != 0) {
+        goto out;
+    }
+    params->kdamond = kdamond;
+    ret = 0;
+
+out:
+    free(pids.pid);
+    return ret;
+}
+
+static bool damon_sysfs_is_on(const char *kdamond_dir)
+{
+    char path[PATH_MAX] = {0};
+    char state[DAMON_SYSFS_VAL_LEN] = {0};
+    ssize_t len;
+    int fd;
+
+    if (damon_sysfs_path(path, kdamond_dir, "state") != 0) {
+        return true;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return true;
+    }
+    len = etmemd_pread_file(fd, state, DAMON_SYSFS_VAL_LEN);
+    close(fd);
+
+    return len <= 0 || strncmp(state, "off", OFF_LEN) != 0;
+}
+
+/* kdamond also stops by itself when all its targets exit */
+static int damon_sysfs_stop(int kdamond)
+{
+    char kdamond_dir[PATH_MAX] = {0};
+
+    g_kdamond_used[kdamond] = false;
+    if (damon_sysfs_subdir(kdamond_dir, KERNEL_DAMON_SYSFS_PATH, "kdamonds", kdamond) != 0) {
+        return -1;
+    }
+
+    if (damon_sysfs_is_on(kdamond_dir) && damon_sysfs_write(kdamond_dir, "state", "off") != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "turn off kdamond %d fail\n", kdamond);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* region snapshots of the pids of a page scan project */
+struct damon_monitor {
+    int kdamond;
+    char kdamond_dir[PATH_MAX];
+    char ctx_dir[PATH_MAX];
+    struct damon_pids pids;     // pid[i] is target i, whose regions are tried by scheme i
+    struct timespec updated;    // last update of tried_regions
+    bool has_updated;
+    pthread_mutex_t mtx;        // serializes the update and the reads of tried_regions of the monitor
+    int refs;                   // the project and the scans reading it, under g_monitor_mtx
+};
+
+static const struct region_scan g_monitor_attrs = {
+    .sample_interval = DAMON_MONITOR_SAMPLE_US,
+    .aggr_interval = DAMON_MONITOR_AGGR_US,
+    .update_interval = DAMON_MONITOR_UPDATE_US,
+    .min_nr_regions = DAMON_MONITOR_MIN_REGIONS,
+    .max_nr_regions = DAMON_MONITOR_MAX_REGIONS,
+};
+
+/* scheme i only tries the regions of target i, so its tried_regions are the snapshot of the target */
+static int damon_sysfs_set_stat_schemes(const char *ctx_dir, int nr_targets)
+{
+    struct damon_scheme all = {
+        .min_sz_region = 0,
+        .max_sz_region = ULONG_MAX,
+        .min_nr_accesses = 0,
+        .max_nr_accesses = UINT_MAX,
+        .min_age_region = 0,
+        .max_age_region = UINT_MAX,
+        .action = DAMOS_STAT,
+    };
+    char dir[PATH_MAX] = {0};
+    char filter_dir[PATH_MAX] = {0};
+    int i;
+
+    if (damon_sysfs_subdir(dir, ctx_dir, "schemes", -1) != 0 ||
+        damon_sysfs_write_ulong(dir, "nr_schemes", (unsigned long)nr_targets) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < nr_targets; i++) {
+        if (damon_sysfs_subdir(dir, ctx_dir, "schemes", i) != 0 ||
+            damon_sysfs_write(dir, "action", get_damon_action_str(all.action)) != 0 ||
+            damon_sysfs_set_access_pattern(dir, &all) != 0 ||
+            damon_sysfs_write_ulong(dir, "filters/nr_filters", 1) != 0) {
+            return -1;
+        }
+
+        if (damon_sysfs_subdir(filter_dir, dir, "filters", 0) != 0 ||
+            damon_sysfs_write(filter_dir, "type", "target") != 0 ||
+            damon_sysfs_write_ulong(filter_dir, "target_idx", (unsigned long)i) != 0 ||
+            damon_sysfs_write(filter_dir, "matching", "N") != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void free_damon_monitor(struct damon_monitor *monitor)
+{
+    pthread_mutex_destroy(&monitor->mtx);
+    free(monitor->pids.pid);
+    monitor->pids.pid = NULL;
+    free(monitor);
+}
+
+static struct damon_monitor *get_damon_monitor(struct page_scan *page_scan)
+{
+    struct damon_monitor *monitor = NULL;
+
+    pthread_mutex_lock(&g_monitor_mtx);
+    monitor = (struct damon_monitor *)page_scan->monitor;
+    if (monitor != NULL) {
+        monitor->refs++;
+    }
+    pthread_mutex_unlock(&g_monitor_mtx);
+    return monitor;
+}
+
+/* the kdamond is stopped by the last one, so a scan never reads a kdamond taken by another project */
+static void put_damon_monitor(struct damon_monitor *monitor)
+{
+    bool last = false;
+
+    pthread_mutex_lock(&g_monitor_mtx);
+    monitor->refs--;
+    last = (monitor->refs == 0);
+    pthread_mutex_unlock(&g_monitor_mtx);
+
+    if (last) {
+        (void)damon_sysfs_stop(monitor->kdamond);
+        free_damon_monitor(monitor);
+    }
+}
+
+/* pids of the tasks found at start are monitored, the others are still scanned through idle_pages */
+int etmemd_damon_monitor_start(struct project *proj)
+{
+    struct page_scan *page_scan = (struct page_scan *)proj->scan_param;
+    struct damon_monitor *monitor = NULL;
+    struct engine *eng = NULL;
+
+    if (page_scan->monitor != NULL) {
+        return 0;
+    }
+
+    if (get_damon_iface() != DAMON_IFACE_SYSFS) {
+        etmemd_log(ETMEMD_LOG_ERR, "damon scan source needs the damon sysfs interface\n");
+        return -1;
+    }
+
+    monitor = calloc(1, sizeof(struct damon_monitor));
+    if (monitor == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc damon monitor fail\n");
+        return -1;
+    }
+    pthread_mutex_init(&monitor->mtx, NULL);
+    monitor->refs = 1;
+
+    for (eng = proj->engs; eng != NULL; eng = eng->next) {
+        if (add_task_pids(eng->tasks, &monitor->pids, false) != 0) {
+            goto free_monitor;
+        }
+    }
+    if (monitor->pids.num == 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "no pid of project %s to be monitored by damon\n", proj->name);
+        goto free_monitor;
+    }
+
+    monitor->kdamond = damon_sysfs_get_kdamond();
+    if (monitor->kdamond < 0) {
+        goto free_monitor;
+    }
+
+    if (damon_sysfs_kdamond_dirs(monitor->kdamond, monitor->kdamond_dir, monitor->ctx_dir) != 0 ||
+        damon_sysfs_set_ctx(monitor->ctx_dir, &g_monitor_attrs, &monitor->pids) != 0 ||
+        damon_sysfs_set_stat_schemes(monitor->ctx_dir, monitor->pids.num) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set damon monitor of kdamond %d fail\n", monitor->kdamond);
+        goto free_monitor;
+    }
+
+    if (damon_sysfs_turn_on(monitor->kdamond, monitor->kdamond_dir) != 0) {
+        goto free_monitor;
+    }
+
+    pthread_mutex_lock(&g_monitor_mtx);
+    page_scan->monitor = monitor;
+    pthread_mutex_unlock(&g_monitor_mtx);
+    return 0;
+
+free_monitor:
+    free_damon_monitor(monitor);
+    return -1;
+}
+
+void etmemd_damon_monitor_stop(struct project *proj)
+{
+    struct page_scan *page_scan = (struct page_scan *)proj->scan_param;
+    struct damon_monitor *monitor = NULL;
+
+    pthread_mutex_lock(&g_monitor_mtx);
+    monitor = (struct damon_monitor *)page_scan->monitor;
+    page_scan->monitor = NULL;
+    pthread_mutex_unlock(&g_monitor_mtx);
+
+    if (monitor == NULL) {
+        return;
+    }
+
+    put_damon_monitor(monitor);
+}
+
+static int damon_sysfs_read_ulong(const char *dir, const char *file, unsigned long *val)
+{
+    char path[PATH_MAX] = {0};
+    int fd;
+    int ret;
+
+    if (damon_sysfs_path(path, dir, file) != 0) {
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open damon sysfs file %s fail\n", path);
+        return -1;
+    }
+    ret = get_ulong_from_fd(fd, val);
+    close(fd);
+    return ret;
+}
+
+/* tried regions are numbered from 0, besides them there may be files like total_bytes */
+static int damon_sysfs_count_regions(const char *dir)
+{
+    DIR *dp = NULL;
+    struct dirent *entry = NULL;
+    int num = 0;
+
+    dp = opendir(dir);
+    if (dp == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "open damon sysfs dir %s fail\n", dir);
+        return -1;
+    }
+
+    while ((entry = readdir(dp)) != NULL) {
+        if (isdigit(entry->d_name[0])) {
+            num++;
+        }
+    }
+
+    closedir(dp);
+    return num;
+}
+
+static int cmp_damon_region(const void *a, const void *b)
+{
+    const struct damon_region *ra = (const struct damon_region *)a;
+    const struct damon_region *rb = (const struct damon_region *)b;
+
+    if (ra->start == rb->start) {
+        return 0;
+    }
+    return ra->start < rb->start ? -1 : 1;
+}
+
+static int damon_sysfs_read_regions(const char *scheme_dir, struct damon_regions *regions)
+{
+    char tried_dir[PATH_MAX] = {0};
+    char dir[PATH_MAX] = {0};
+    struct damon_region *region = NULL;
+    unsigned long val[DAMON_REGION_ITEMS];
+    int num;
+    int i;
+
+    if (damon_sysfs_subdir(tried_dir, scheme_dir, "tried_regions", -1) != 0) {
+        return -1;
+    }
+
+    num = damon_sysfs_count_regions(tried_dir);
+    if (num <= 0) {
+        return num;
+    }
+
+    regions->region = calloc(num, sizeof(struct damon_region));
+    if (regions->region == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc damon regions fail\n");
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (snprintf_s(dir, PATH_MAX, PATH_MAX - 1, "%s%d/", tried_dir, i) == -1 ||
+            damon_sysfs_read_ulong(dir, "start", &val[DAMON_REGION_START]) != 0 ||
+            damon_sysfs_read_ulong(dir, "end", &val[DAMON_REGION_END]) != 0 ||
+            damon_sysfs_read_ulong(dir, "nr_accesses", &val[DAMON_REGION_ACCESSES]) != 0 ||
+            damon_sysfs_read_ulong(dir, "age", &val[DAMON_REGION_AGE]) != 0) {
+            etmemd_damon_free_regions(regions);
+            return -1;
+        }
+
+        region = &regions->region[i];
+        region->start = val[DAMON_REGION_START];
+        region->end = val[DAMON_REGION_END];
+        region->nr_accesses = (unsigned int)val[DAMON_REGION_ACCESSES];
+        region->age = (unsigned int)val[DAMON_REGION_AGE];
+    }
+    regions->num = num;
+
+    qsort(regions->region, num, sizeof(struct damon_region), cmp_damon_region);
+    return num;
+}
+
+/* all schemes are updated at once, so the snapshot is shared by the pids within an aggregation */
+static int damon_monitor_update(struct damon_monitor *monitor)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (monitor->has_updated &&
+        (unsigned long)((now.tv_sec - monitor->updated.tv_sec) * USEC_PER_SEC +
+                        (now.tv_nsec - monitor->updated.tv_nsec) / NSEC_PER_USEC) < g_monitor_attrs.aggr_interval) {
+        return 0;
+    }
+
+    /* the write returns after kdamond applies the schemes once */
+    if (damon_sysfs_write(monitor->kdamond_dir, "state", "update_schemes_tried_regions") != 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &monitor->updated);
+    monitor->has_updated = true;
+    return 0;
+}
+
+int etmemd_damon_get_regions(const struct project *proj, unsigned int pid, struct damon_regions *regions)
+{
+    struct page_scan *page_scan = (struct page_scan *)proj->scan_param;
+    struct damon_monitor *monitor = NULL;
+    char dir[PATH_MAX] = {0};
+    int ret = -1;
+    int i;
+
+    regions->region = NULL;
+    regions->num = 0;
+    regions->max_nr_accesses = (unsigned int)(g_monitor_attrs.aggr_interval / g_monitor_attrs.sample_interval);
+
+    monitor = get_damon_monitor(page_scan);
+    if (monitor == NULL) {
+        return -1;
+    }
+
+    /* only the scans of the same project wait for the blocking update of its kdamond */
+    pthread_mutex_lock(&monitor->mtx);
+    for (i = 0; i < monitor->pids.num; i++) {
+        if (monitor->pids.pid[i] == pid) {
+            break;
+        }
+    }
+    if (i == monitor->pids.num) {
+        goto unlock;
+    }
+
+    if (damon_monitor_update(monitor) != 0 || damon_sysfs_subdir(dir, monitor->ctx_dir, "schemes", i) != 0) {
+        goto unlock;
+    }
+
+    if (damon_sysfs_read_regions(dir, regions) < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "read damon regions of pid %u fail\n", pid);
+        goto unlock;
+    }
+    ret = 0;
+
+unlock:
+    pthread_mutex_unlock(&monitor->mtx);
+    put_damon_monitor(monitor);
+    return ret;
+}
+
+void etmemd_damon_free_regions(struct damon_regions *regions)
+{
+    free(regions->region);
+    regions->region = NULL;
+    regions->num = 0;
+}
+
+static uint64_t damon_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * USEC_PER_SEC + (uint64_t)now.tv_nsec / NSEC_PER_USEC;
+}
+
+/* hugepage and nohugepage can not be advised to another process, they are only counted like stat */
+static int damon_user_advice(enum damos_action action)
+{
+    switch (action) {
+        case DAMOS_WILLNEED:
+            return MADV_WILLNEED;
+        case DAMOS_COLD:
+            return MADV_COLD;
+        case DAMOS_PAGEOUT:
+            return MADV_PAGEOUT;
+        default:
+            return -1;
+    }
+}
+
+/* schemes stop out of [low, high] of free_mem_rate, and restart once it gets below mid, as damon does */
+static bool damon_user_wmark_active(struct damon_eng_params *params, uint64_t now)
+{
+    struct damos_wmark *wmark = &params->wmark;
+    struct mem_snapshot snap = {0};
+    unsigned long rate;
+
+    if (wmark->metric == DAMOS_WMARK_NONE) {
+        return true;
+    }
+    if (params->wmark_checked != 0 && now - params->wmark_checked < wmark->interval) {
+        return params->wmark_active;
+    }
+    params->wmark_checked = now;
+
+    if (etmemd_mem_snapshot_sys(&snap) != 0 || snap.mem_total == 0) {
+        return params->wmark_active;
+    }
+
+    rate = snap.mem_free * DAMOS_WMARK_PERMIL_MAX / snap.mem_total;
+    if (rate > wmark->high || rate < wmark->low) {
+        params->wmark_active = false;
+    } else if (rate <= wmark->mid) {
+        params->wmark_active = true;
+    }
+    return params->wmark_active;
+}
+
+/* advise [start, end) except the exclude ranges from idx on, return the bytes advised */
+static unsigned long damon_user_madvise(int pidfd, unsigned long start, unsigned long end, int advice,
+                                        const struct damon_eng_params *params, int idx)
+{
+    const struct damon_addr_range *exclude = NULL;
+    unsigned long done = 0;
+    struct iovec iov;
+    long ret;
+
+    for (; idx < params->nr_exclude; idx++) {
+        exclude = &params->exclude[idx];
+        if (exclude->start >= end || exclude->end <= start) {
+            continue;
+        }
+        if (exclude->start > start) {
+            done += damon_user_madvise(pidfd, start, exclude->start, advice, params, idx + 1);
+        }
+        if (exclude->end < end) {
+            done += damon_user_madvise(pidfd, exclude->end, end, advice, params, idx + 1);
+        }
+        return done;
+    }
+
+    iov.iov_base = (void *)start;
+    iov.iov_len = end - start;
+#ifdef SYS_process_madvise
+    ret = syscall(SYS_process_madvise, pidfd, &iov, 1, advice, 0);
+#else
+    ret = -1;
+    errno = ENOSYS;
+#endif
+    if (ret < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "process_madvise %d for %lx-%lx fail, errno: %d\n", advice, start, end, errno);
+        return 0;
+    }
+    return (unsigned long)ret;
+}
+
+static bool is_region_matched(const struct damon_scheme *scheme, const struct damon_region *region)
+{
+    unsigned long sz = (unsigned long)(region->end - region->start);
+
+    return sz >= scheme->min_sz_region && sz <= scheme->max_sz_region &&
+        region->nr_accesses >= scheme->min_nr_accesses && region->nr_accesses <= scheme->max_nr_accesses &&
+        region->age >= scheme->min_age_region && region->age <= scheme->max_age_region;
+}
+
+/* the quota goes to the colder and older regions first, like the weights set through sysfs */
+static int cmp_colder_first(const void *a, const void *b)
+{
+    const struct damon_region *ra = *(const struct damon_region * const *)a;
+    const struct damon_region *rb = *(const struct damon_region * const *)b;
+
+    if (ra->nr_accesses != rb->nr_accesses) {
+        return ra->nr_accesses < rb->nr_accesses ? -1 : 1;
+    }
+    if (ra->age != rb->age) {
+        return ra->age > rb->age ? -1 : 1;
+    }
+    return 0;
+}
+
+static int cmp_hotter_first(const void *a, const void *b)
+{
+    return cmp_colder_first(b, a);
+}
+
+static void damon_user_reset_charge(const struct damos_quota *quota, struct damos_charge *charge, uint64_t now)
+{
+    if (quota->reset_interval != 0 && now - charge->reset_at < quota->reset_interval * USEC_PER_MSEC) {
+        return;
+    }
+    charge->bytes = 0;
+    charge->us = 0;
+    charge->reset_at = now;
+}
+
+static bool is_quota_exceeded(const struct damos_quota *quota, const struct damos_charge *charge)
+{
+    return (quota->bytes != 0 && charge->bytes >= quota->bytes) ||
+        (quota->ms != 0 && charge->us >= quota->ms * USEC_PER_MSEC);
+}
+
+static void damon_user_apply_scheme(struct damon_eng_params *params, int idx, int pidfd, unsigned int pid,
+                                    const struct damon_regions *regions)
+{
+    struct damon_scheme *scheme = &params->schemes[idx];
+    struct damos_charge *charge = &params->charge[idx];
+    const struct damon_region **matched = NULL;
+    unsigned long page_mask = (unsigned long)page_type_to_size(PTE_TYPE) - 1;
+    unsigned long applied = 0;
+    unsigned long start;
+    unsigned long end;
+    uint64_t begin;
+    int advice = damon_user_advice(scheme->action);
+    int num = 0;
+    int i;
+
+    matched = calloc(regions->num > 0 ? regions->num : 1, sizeof(struct damon_region *));
+    if (matched == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc matched regions of damon scheme %d fail\n", idx);
+        return;
+    }
+    for (i = 0; i < regions->num; i++) {
+        if (is_region_matched(scheme, &regions->region[i])) {
+            matched[num++] = &regions->region[i];
+        }
+    }
+
+    if (scheme->quota.bytes != 0 || scheme->quota.ms != 0) {
+        qsort(matched, num, sizeof(struct damon_region *),
+              scheme->action == DAMOS_WILLNEED ? cmp_hotter_first : cmp_colder_first);
+    }
+
+    damon_user_reset_charge(&scheme->quota, charge, damon_now_us());
+    for (i = 0; i < num && !is_quota_exceeded(&scheme->quota, charge); i++) {
+        start = (unsigned long)matched[i]->start;
+        end = (unsigned long)matched[i]->end;
+        if (scheme->quota.bytes != 0 && end - start > scheme->quota.bytes - charge->bytes) {
+            end = (start + scheme->quota.bytes - charge->bytes) & ~page_mask;
+            if (end <= start) {
+                break;
+            }
+        }
+
+        begin = damon_now_us();
+        applied += advice < 0 ? end - start : damon_user_madvise(pidfd, start, end, advice, params, 0);
+        charge->bytes += end - start;
+        charge->us += (unsigned long)(damon_now_us() - begin);
+    }
+
+    etmemd_log(ETMEMD_LOG_DEBUG, "damon scheme %d %s %lu bytes in %d regions of pid %u\n", idx,
+               get_damon_action_str(scheme->action), applied, num, pid);
+    free(matched);
+}
+
+/* called by the region sampler at the end of each aggregation */
+static void damon_user_apply(void *arg, unsigned int pid, const struct damon_regions *regions)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)arg;
+    int pidfd = -1;
+    int i;
+
+    if (!damon_user_wmark_active(params, damon_now_us())) {
+        return;
+    }
+
+#ifdef SYS_pidfd_open
+    pidfd = (int)syscall(SYS_pidfd_open, (pid_t)pid, 0);
+#endif
+    if (pidfd < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pidfd_open for pid %u fail, errno: %d\n", pid, errno);
+        return;
+    }
+
+    for (i = 0; i < params->nr_schemes; i++) {
+        damon_user_apply_scheme(params, i, pidfd, pid, regions);
+    }
+    close(pidfd);
+}
+
+static int damon_user_start(struct project *proj)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)proj->engs->params;
+    struct damon_pids pids = {0};
+    int ret = -1;
+    int i;
+
+    if (!is_engs_valid(proj) || add_task_pids(proj->engs->tasks, &pids, true) != 0) {
+        goto out;
+    }
+
+    params->charge = calloc(params->nr_schemes, sizeof(struct damos_charge));
+    if (params->charge == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc quota charges of damon schemes fail\n");
+        goto out;
+    }
+    for (i = 0; i < params->nr_schemes; i++) {
+        if (params->schemes[i].action != DAMOS_STAT && damon_user_advice(params->schemes[i].action) < 0) {
+            etmemd_log(ETMEMD_LOG_WARN, "damon action %s is only counted without kernel damon\n",
+                       get_damon_action_str(params->schemes[i].action));
+        }
+    }
+    params->wmark_active = false;
+    params->wmark_checked = 0;
+
+    params->sampler = region_sampler_start((struct region_scan *)proj->scan_param, pids.pid, pids.num,
+                                           damon_user_apply, params);
+    if (params->sampler == NULL) {
+        free(params->charge);
+        params->charge = NULL;
+        goto out;
+    }
+    ret = 0;
+
+out:
+    free(pids.pid);
+    return ret;
+}
+
+static int damon_user_stop(struct damon_eng_params *params)
+{
+    region_sampler_stop(params->sampler);
+    params->sampler = NULL;
+    free(params->charge);
+    params->charge = NULL;
+    return 0;
+}
+
+int etmemd_start_damon(struct project *proj)
+{
+    struct damon_eng_params *params = NULL;
+    enum damon_iface iface;
+    int ret;
+
+    if (proj == NULL || proj->engs == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "proj and its engine should not be NULL\n");
+        return -1;
+    }
+    params = (struct damon_eng_params *)proj->engs->params;
+
+    iface = get_damon_iface();
+    switch (iface) {
+        case DAMON_IFACE_SYSFS:
+            ret = damon_sysfs_start(proj);
+            break;
+        case DAMON_IFACE_DEBUGFS:
+            ret = damon_debugfs_start(proj);
+            break;
+        default:
+            etmemd_log(ETMEMD_LOG_WARN, "kernel damon module not exist, sample regions through idle_pages\n");
+            iface = DAMON_IFACE_USER;
+            ret = damon_user_start(proj);
+            break;
+    }
+
+    if (ret == 0) {
+        params->iface = iface;
+    }
+    return ret;
+}
+
+int etmemd_stop_damon(struct project *proj)
+{
+    struct damon_eng_params *params = NULL;
+    int ret;
+
+    if (proj == NULL || proj->engs == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "proj and its engine should not be NULL\n");
+        return -1;
+    }
+    params = (struct damon_eng_params *)proj->engs->params;
+
+    switch (params->iface) {
+        case DAMON_IFACE_SYSFS:
+            ret = damon_sysfs_stop(params->kdamond);
+            break;
+        case DAMON_IFACE_DEBUGFS:
+            ret = damon_debugfs_stop();
+            break;
+        case DAMON_IFACE_USER:
+            ret = damon_user_stop(params);
+            break;
+        default:
+            etmemd_log(ETMEMD_LOG_ERR, "damon of project %s is not started\n", proj->name);
+            return -1;
+    }
+
+    params->iface = DAMON_IFACE_NONE;
+    return ret;
+}
+
+static int fill_min_size(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long min_size = parse_to_ulong(val);
+
+    params->schemes[0].min_sz_region = min_size;
+    return 0;
+}
+
+static int fill_max_size(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long max_size = parse_to_ulong(val);
+
+    params->schemes[0].max_sz_region = max_size;
+    return 0;
+}
+
+static int fill_min_acc(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned int min_acc = parse_to_uint(val);
+
+    params->schemes[0].min_nr_accesses = min_acc;
+    return 0;
+}
+
+static int fill_max_acc(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned int max_acc = parse_to_uint(val);
+
+    params->schemes[0].max_nr_accesses = max_acc;
+    return 0;
+}
+
+static int fill_min_age(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned int min_age = parse_to_uint(val);
+
+    params->schemes[0].min_age_region = min_age;
+    return 0;
+}
+
+static int fill_max_age(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned int max_age = parse_to_uint(val);
+
+    params->schemes[0].max_age_region = max_age;
+    return 0;
+}
+
+static int fill_action(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    char *action = (char *)val;
+    int ret;
+
+    ret = parse_action(action, &params->schemes[0].action);
+    free(action);
+    return ret;
+}
+
+static int fill_quota_ms(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long quota_ms = parse_to_ulong(val);
+
+    params->schemes[0].quota.ms = quota_ms;
+    return 0;
+}
+
+static int fill_quota_bytes(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long quota_bytes = parse_to_ulong(val);
+
+    params->schemes[0].quota.bytes = quota_bytes;
+    return 0;
+}
+
+static int fill_quota_reset_interval(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long reset_interval = parse_to_ulong(val);
+
+    params->schemes[0].quota.reset_interval = reset_interval;
+    return 0;
+}
+
+static int fill_wmark_metric(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    char *metric = (char *)val;
+    int ret = 0;
+
+    if (strcmp(metric, "none") == 0) {
+        params->wmark.metric = DAMOS_WMARK_NONE;
+    } else if (strcmp(metric, "free_mem_rate") == 0) {
+        params->wmark.metric = DAMOS_WMARK_FREE_MEM_RATE;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "wmark_metric %s not supported, must be none or free_mem_rate\n", metric);
+        ret = -1;
+    }
+
+    free(metric);
+    return ret;
+}
+
+static int fill_wmark_interval(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long interval = parse_to_ulong(val);
+
+    params->wmark.interval = interval;
+    return 0;
+}
+
+static int fill_wmark_high(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long high = parse_to_ulong(val);
+
+    params->wmark.high = high;
+    return 0;
+}
+
+static int fill_wmark_mid(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long mid = parse_to_ulong(val);
+
+    params->wmark.mid = mid;
+    return 0;
+}
+
+static int fill_wmark_low(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    unsigned long low = parse_to_ulong(val);
+
+    params->wmark.low = low;
+    return 0;
+}
+
+/* "start-end", in decimal or hex */
+static int parse_addr_range(char *range_str, struct damon_addr_range *range)
+{
+    char *endptr = NULL;
+
+    errno = 0;
+    range->start = strtoul(range_str, &endptr, 0);
+    if (errno != 0 || endptr == range_str || *endptr != '-') {
+        return -1;
+    }
+
+    range_str = endptr + 1;
+    range->end = strtoul(range_str, &endptr, 0);
+    if (errno != 0 || endptr == range_str || *endptr != '\0') {
+        return -1;
+    }
+
+    return range->end > range->start ? 0 : -1;
+}
+
+/* "start-end;..." */
+static int fill_exclude_addr(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    struct damon_addr_range *exclude = NULL;
+    struct damon_addr_range range;
+    char *range_str = NULL;
+    char *saveptr = NULL;
+    int ret = -1;
+
+    for (range_str = strtok_r((char *)val, " ;", &saveptr); range_str != NULL;
+            range_str = strtok_r(NULL, " ;", &saveptr)) {
+        if (parse_addr_range(range_str, &range) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "exclude_addr : parse range %s fail\n", range_str);
+            goto out;
+        }
+
+        exclude = realloc(params->exclude, sizeof(struct damon_addr_range) * (params->nr_exclude + 1));
+        if (exclude == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "alloc exclude_addr fail\n");
+            goto out;
+        }
+        params->exclude = exclude;
+        params->exclude[params->nr_exclude++] = range;
+    }
+    ret = 0;
+
+out:
+    free(val);
+    return ret;
+}
+
+static int parse_scheme(char *scheme_str, struct damon_scheme *scheme)
+{
+    unsigned long item[SCHEME_ITEMS] = {0};
+    char *saveptr = NULL;
+    char *field = NULL;
+    int i;
+
+    for (i = 0; i < SCHEME_ITEMS; i++) {
+        field = strtok_r(i == 0 ? scheme_str : NULL, " ,", &saveptr);
+        if (field == NULL) {
+            break;
+        }
+        if (i == SCHEME_ACTION) {
+            if (parse_action(field, &scheme->action) != 0) {
+                return -1;
+            }
+        } else if (get_unsigned_long_value(field, &item[i]) != 0) {
+            return -1;
+        }
+    }
+
+    /* the quota fields are given all together or inherited from the first scheme */
+    if ((i != SCHEME_QUOTA_MS && i != SCHEME_ITEMS) || strtok_r(NULL, " ,", &saveptr) != NULL) {
+        return -1;
+    }
+
+    scheme->min_sz_region = item[SCHEME_MIN_SIZE];
+    scheme->max_sz_region = item[SCHEME_MAX_SIZE];
+    scheme->min_nr_accesses = (unsigned int)item[SCHEME_MIN_ACC];
+    scheme->max_nr_accesses = (unsigned int)item[SCHEME_MAX_ACC];
+    scheme->min_age_region = (unsigned int)item[SCHEME_MIN_AGE];
+    scheme->max_age_region = (unsigned int)item[SCHEME_MAX_AGE];
+    if (i == SCHEME_ITEMS) {
+        scheme->quota.ms = item[SCHEME_QUOTA_MS];
+        scheme->quota.bytes = item[SCHEME_QUOTA_BYTES];
+        scheme->quota.reset_interval = item[SCHEME_QUOTA_RESET];
+    }
+    return 0;
+}
+
+/* "min_size,max_size,min_acc,max_acc,min_age,max_age,action[,quota_ms,quota_bytes,quota_reset_interval];..." */
+static int fill_schemes(void *obj, void *val)
+{
+    struct damon_eng_params *params = (struct damon_eng_params *)obj;
+    struct damon_scheme *schemes = NULL;
+    char *scheme_str = NULL;
+    char *saveptr = NULL;
+    int ret = -1;
+
+    for (scheme_str = strtok_r((char *)val, ";", &saveptr); scheme_str != NULL;
+            scheme_str = strtok_r(NULL, ";", &saveptr)) {
+        schemes = realloc(params->schemes, sizeof(struct damon_scheme) * (params->nr_schemes + 1));
+        if (schemes == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "alloc damon schemes fail\n");
+            goto out;
+        }
+        params->schemes = schemes;
+        params->schemes[params->nr_schemes] = params->schemes[0];
+        if (parse_scheme(scheme_str, &params->schemes[params->nr_schemes]) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "schemes : parse scheme %d fail\n", params->nr_schemes);
+            goto out;
+        }
+        params->nr_schemes++;
+    }
+    ret = 0;
+
+out:
+    free(val);
+    return ret;
+}
+
+static struct config_item damon_eng_config_items[] = {
+    {"min_size", INT_VAL, fill_min_size, false},
+    {"max_size", INT_VAL, fill_max_size, false},
+    {"min_acc", INT_VAL, fill_min_acc, false},
+    {"max_acc", INT_VAL, fill_max_acc, false},
+    {"min_age", INT_VAL, fill_min_age, false},
+    {"max_age", INT_VAL, fill_max_age, false},
+    {"action", STR_VAL, fill_action, false},
+    {"quota_ms", INT_VAL, fill_quota_ms, true},
+    {"quota_bytes", INT_VAL, fill_quota_bytes, true},
+    {"quota_reset_interval", INT_VAL, fill_quota_reset_interval, true},
+    {"wmark_metric", STR_VAL, fill_wmark_metric, true},
+    {"wmark_interval", INT_VAL, fill_wmark_interval, true},
+    {"wmark_high", INT_VAL, fill_wmark_high, true},
+    {"wmark_mid", INT_VAL, fill_wmark_mid, true},
+    {"wmark_low", INT_VAL, fill_wmark_low, true},
+    {"exclude_addr", STR_VAL, fill_exclude_addr, true},
+    /* after the first scheme, which gives the default quota of the others */
+    {"schemes", STR_VAL, fill_schemes, true},
+};
+
+static bool is_wmark_valid(const struct damos_wmark *wmark)
+{
+    if (wmark->metric == DAMOS_WMARK_NONE) {
+        return true;
+    }
+
+    if (wmark->high > DAMOS_WMARK_PERMIL_MAX || wmark->high < wmark->mid || wmark->mid < wmark->low) {
+        etmemd_log(ETMEMD_LOG_ERR, "watermarks should be wmark_high >= wmark_mid >= wmark_low in [0, %d]\n",
+                   DAMOS_WMARK_PERMIL_MAX);
+        return false;
+    }
+    return true;
+}
+
+static void free_damon_eng_params(struct damon_eng_params *params)
+{
+    free(params->schemes);
+    params->schemes = NULL;
+    free(params->exclude);
+    params->exclude = NULL;
+    free(params);
+}
+
+static int damon_fill_eng(GKeyFile *config, struct engine *eng)
+{
+    struct damon_eng_params *params = calloc(1, sizeof(struct damon_eng_params));
+
+    if (params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc damon engine params fail\n");
+        return -1;
+    }
+
+    params->schemes = calloc(1, sizeof(struct damon_scheme));
+    if (params->schemes == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc damon schemes fail\n");
+        free(params);
+        return -1;
+    }
+    params->nr_schemes = 1;
+
+    if (parse_file_config(config, ENG_GROUP, damon_eng_config_items,
+        ARRAY_SIZE(damon_eng_config_items), (void *)params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "damon fill engine params fail.\n");
+        free_damon_eng_params(params);
+        return -1;
+    }
+
+    if (!is_wmark_valid(&params->wmark)) {
+        free_damon_eng_params(params);
+        return -1;
+    }
+
+    eng->params = (void *)params;
+    return 0;
+}
+
+static void damon_clear_eng(struct engine *eng)
+{
+    struct damon_eng_params *eng_params = (struct damon_eng_params *)eng->params;
+
+    if (eng_params == NULL) {
+        return;
+    }
+
+    /* the sampler calls back with the params */
+    if (eng_params->iface == DAMON_IFACE_USER) {
+        (void)damon_user_stop(eng_params);
+    }
+    free_damon_eng_params(eng_params);
     eng->params = NULL;
 }
 
@@ -0,0 +1,419 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Dynamic feedback engine, tune slide parameters by swap-in rate of each pid.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_engine.h"
+#include "etmemd_dynamic_fb.h"
+#include "etmemd_pool_adapter.h"
+#include "etmemd_file.h"
+
+#define CGROUP_FILE             "/cgroup"
+#define CGROUP_V2_PREFIX        "0::"
+#define CGROUP_V2_ROOT          "/sys/fs/cgroup"
+#define CGROUP_MEMORY_STAT      "/memory.stat"
+#define VMSTAT_FILE             "/proc/vmstat"
+#define NSEC_PER_SEC            1000000000.0
+
+static int open_cgroup_memory_stat(const char *pid_str)
+{
+    FILE *fp = NULL;
+    char line[FILE_LINE_MAX_LEN] = {0};
+    char path[PATH_MAX] = {0};
+    int fd = -1;
+    size_t len;
+
+    fp = etmemd_get_proc_file(pid_str, CGROUP_FILE, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    /* only the unified hierarchy of cgroup v2 has the workingset counters per cgroup */
+    while (fgets(line, FILE_LINE_MAX_LEN, fp) != NULL) {
+        if (strncmp(line, CGROUP_V2_PREFIX, strlen(CGROUP_V2_PREFIX)) != 0) {
+            continue;
+        }
+        len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
+        }
+        if (snprintf_s(path, PATH_MAX, PATH_MAX - 1, "%s%s%s", CGROUP_V2_ROOT,
+                       line + strlen(CGROUP_V2_PREFIX), CGROUP_MEMORY_STAT) <= 0) {
+            break;
+        }
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        break;
+    }
+
+    fclose(fp);
+    return fd;
+}
+
+static int read_cgroup_refault(int fd, unsigned long *value)
+{
+    struct proc_mem_key anon_key = {"workingset_refault_anon", value, false};
+    struct proc_mem_key key = {"workingset_refault", value, false};
+
+    /* kernels before 5.9 only have the counter of both anon and file refault */
+    if (get_mem_from_proc_fd(fd, &anon_key, 1) == 0) {
+        return 0;
+    }
+
+    return get_mem_from_proc_fd(fd, &key, 1);
+}
+
+static int read_swapin_counter(struct task_pid *tk_pid, struct dynamic_fb_pid_params *pid_params,
+                               unsigned long *value)
+{
+    struct proc_mem_key status_key = {SWAPIN, value, false};
+    struct proc_mem_key vmstat_key = {"pswpin", value, false};
+
+    switch (pid_params->source) {
+        case SWAPIN_SRC_STATUS:
+            if (etmemd_mem_snapshot_pid(&tk_pid->mem_snap, tk_pid->pid) != 0) {
+                return -1;
+            }
+            return get_mem_from_proc_fd(tk_pid->mem_snap.status_fd, &status_key, 1);
+        case SWAPIN_SRC_CGROUP:
+            return read_cgroup_refault(pid_params->stat_fd, value);
+        case SWAPIN_SRC_VMSTAT:
+            return get_mem_from_proc_fd(pid_params->stat_fd, &vmstat_key, 1);
+        default:
+            return -1;
+    }
+}
+
+/* pick the most accurate swap-in counter that the running kernel provides for the pid */
+static int probe_swapin_source(struct task_pid *tk_pid, struct dynamic_fb_pid_params *pid_params)
+{
+    char pid_str[PID_STR_MAX_LEN] = {0};
+    unsigned long value;
+
+    pid_params->source = SWAPIN_SRC_STATUS;
+    if (read_swapin_counter(tk_pid, pid_params, &value) == 0) {
+        return 0;
+    }
+
+    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", tk_pid->pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", tk_pid->pid);
+        goto no_source;
+    }
+
+    pid_params->stat_fd = open_cgroup_memory_stat(pid_str);
+    if (pid_params->stat_fd >= 0) {
+        pid_params->source = SWAPIN_SRC_CGROUP;
+        if (read_swapin_counter(tk_pid, pid_params, &value) == 0) {
+            return 0;
+        }
+        close(pid_params->stat_fd);
+    }
+
+    pid_params->stat_fd = open(VMSTAT_FILE, O_RDONLY | O_CLOEXEC);
+    if (pid_params->stat_fd >= 0) {
+        pid_params->source = SWAPIN_SRC_VMSTAT;
+        if (read_swapin_counter(tk_pid, pid_params, &value) == 0) {
+            etmemd_log(ETMEMD_LOG_WARN,
+                       "pid %u has no swap-in counter of its own, system wide pswpin is not used to tune it\n",
+                       tk_pid->pid);
+            return 0;
+        }
+        close(pid_params->stat_fd);
+    }
+
+no_source:
+    pid_params->stat_fd = -1;
+    pid_params->source = SWAPIN_SRC_NONE;
+    return -1;
+}
+
+static int update_swapin_rate(struct task_pid *tk_pid, struct dynamic_fb_pid_params *pid_params)
+{
+    struct timespec now;
+    unsigned long swapin;
+    double elapsed;
+
+    if (pid_params->source == SWAPIN_SRC_NONE && probe_swapin_source(tk_pid, pid_params) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "no swap-in counter found for pid %u\n", tk_pid->pid);
+        return -1;
+    }
+
+    if (read_swapin_counter(tk_pid, pid_params, &swapin) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "read swap-in counter of pid %u fail\n", tk_pid->pid);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* the first sample or a counter reset only gives the base of next cycle */
+    if (!pid_params->sampled || swapin < pid_params->last_swapin) {
+        pid_params->sampled = true;
+        pid_params->last_swapin = swapin;
+        pid_params->last_time = now;
+        return -1;
+    }
+
+    elapsed = (double)(now.tv_sec - pid_params->last_time.tv_sec) +
+        (double)(now.tv_nsec - pid_params->last_time.tv_nsec) / NSEC_PER_SEC;
+    if (elapsed <= 0) {
+        return -1;
+    }
+
+    tk_pid->rt_swapin_rate = (float)((double)(swapin - pid_params->last_swapin) / elapsed);
+    pid_params->last_swapin = swapin;
+    pid_params->last_time = now;
+    return 0;
+}
+
+/*
+ * Swap-in above target means that hot pages are swapped out, so lower T to keep more pages hot
+ * and raise dram_percent. Swap-in well under target means that more memory can be saved.
+ * Back off twice as fast as pushing, so that a refault storm is stopped in few cycles.
+ * */
+static void dynamic_fb_tune(struct task_pid *tk_pid, const struct dynamic_fb_params *params,
+                            struct dynamic_fb_pid_params *pid_params)
+{
+    struct slide_params *slide = &pid_params->slide;
+    int step = params->tune_step;
+    int t = slide->t;
+    int dram_percent = slide->dram_percent;
+
+    if (tk_pid->rt_swapin_rate > (float)params->swapin_target) {
+        t = t - 2 * step < 0 ? 0 : t - 2 * step;
+        if (dram_percent != 0) {
+            dram_percent = dram_percent + 2 * step > 100 ? 100 : dram_percent + 2 * step;
+        }
+    } else if (tk_pid->rt_swapin_rate * 2 < (float)params->swapin_target) {
+        t = t + step > 100 ? 100 : t + step;
+        if (dram_percent != 0) {
+            dram_percent = dram_percent - step < params->min_dram_percent ?
+                params->min_dram_percent : dram_percent - step;
+        }
+    }
+
+    if (t != slide->t || dram_percent != slide->dram_percent) {
+        etmemd_log(ETMEMD_LOG_INFO, "pid %u swap-in rate %.2f pages/s, tune T %d -> %d, dram_percent %d -> %d\n",
+                   tk_pid->pid, tk_pid->rt_swapin_rate, slide->t, t, slide->dram_percent, dram_percent);
+        slide->t = t;
+        slide->dram_percent = (uint8_t)dram_percent;
+    }
+}
+
+static void *dynamic_fb_executor(void *arg)
+{
+    struct task_pid *tk_pid = (struct task_pid *)arg;
+    struct dynamic_fb_params *params = (struct dynamic_fb_params *)tk_pid->tk->params;
+    struct dynamic_fb_pid_params *pid_params = (struct dynamic_fb_pid_params *)tk_pid->params;
+
+    if (params == NULL || pid_params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback params of pid %u is null\n", tk_pid->pid);
+        return NULL;
+    }
+
+    /*
+     * the swap-in since last cycle is the feedback of the last migration. pswpin of vmstat also counts
+     * the other processes, so a pid with only that counter keeps its configured T and dram_percent.
+     */
+    if (update_swapin_rate(tk_pid, pid_params) == 0 && pid_params->source != SWAPIN_SRC_VMSTAT) {
+        dynamic_fb_tune(tk_pid, params, pid_params);
+    }
+
+    (void)slide_do_executor(tk_pid, &pid_params->slide);
+    return NULL;
+}
+
+static int fill_task_swapin_target(void *obj, void *val)
+{
+    struct dynamic_fb_params *params = (struct dynamic_fb_params *)obj;
+    int target = parse_to_int(val);
+
+    if (target <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback param swapin_target %d should be greater than 0\n", target);
+        return -1;
+    }
+
+    params->swapin_target = (unsigned long)target;
+    return 0;
+}
+
+static int fill_task_tune_step(void *obj, void *val)
+{
+    struct dynamic_fb_params *params = (struct dynamic_fb_params *)obj;
+    int step = parse_to_int(val);
+
+    if (step <= 0 || step > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback param tune_step %d is invalid, the range is (0, 100]\n", step);
+        return -1;
+    }
+
+    params->tune_step = step;
+    return 0;
+}
+
+static int fill_task_min_dram_percent(void *obj, void *val)
+{
+    struct dynamic_fb_params *params = (struct dynamic_fb_params *)obj;
+    int value = parse_to_int(val);
+
+    if (value <= 0 || value > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback param min_dram_percent %d is invalid, the range is (0, 100]\n",
+                   value);
+        return -1;
+    }
+
+    params->min_dram_percent = value;
+    return 0;
+}
+
+static struct config_item g_dynamic_fb_task_config_items[] = {
+    {"swapin_target", INT_VAL, fill_task_swapin_target, false},
+    {"tune_step", INT_VAL, fill_task_tune_step, true},
+    {"min_dram_percent", INT_VAL, fill_task_min_dram_percent, true},
+};
+
+static int dynamic_fb_fill_task(GKeyFile *config, struct task *tk)
+{
+    struct dynamic_fb_params *params = calloc(1, sizeof(struct dynamic_fb_params));
+
+    if (params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc dynamic feedback param fail\n");
+        return -1;
+    }
+
+    params->tune_step = DYNAMIC_FB_DEFAULT_STEP;
+    params->min_dram_percent = DYNAMIC_FB_DEFAULT_MIN_DRAM;
+
+    if (slide_fill_params(config, &params->slide) != 0) {
+        goto free_params;
+    }
+
+    if (parse_file_config(config, TASK_GROUP, g_dynamic_fb_task_config_items,
+                          ARRAY_SIZE(g_dynamic_fb_task_config_items), (void *)params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback fill task fail\n");
+        goto free_params;
+    }
+
+    if (params->slide.dram_percent != 0 && params->slide.dram_percent < params->min_dram_percent) {
+        etmemd_log(ETMEMD_LOG_ERR, "dram_percent should not be less than min_dram_percent\n");
+        goto free_params;
+    }
+
+    tk->params = params;
+    return 0;
+
+free_params:
+    free(params);
+    return -1;
+}
+
+static void dynamic_fb_clear_task(struct task *tk)
+{
+    etmemd_free_task_pids(tk);
+    free(tk->params);
+    tk->params = NULL;
+}
+
+static int dynamic_fb_start_task(struct engine *eng, struct task *tk)
+{
+    struct dynamic_fb_params *params = tk->params;
+
+    params->executor = malloc(sizeof(struct task_executor));
+    if (params->executor == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback alloc memory for task_executor fail\n");
+        return -1;
+    }
+
+    params->executor->tk = tk;
+    params->executor->func = dynamic_fb_executor;
+    if (start_threadpool_work(params->executor) != 0) {
+        free(params->executor);
+        params->executor = NULL;
+        etmemd_log(ETMEMD_LOG_ERR, "dynamic feedback start task executor fail\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void dynamic_fb_stop_task(struct engine *eng, struct task *tk)
+{
+    struct dynamic_fb_params *params = tk->params;
+
+    stop_and_delete_threadpool_work(tk);
+    etmemd_free_task_pids(tk);
+    free(params->executor);
+    params->executor = NULL;
+}
+
+static int dynamic_fb_alloc_pid_params(struct engine *eng, struct task_pid **tk_pid)
+{
+    struct dynamic_fb_params *params = (struct dynamic_fb_params *)(*tk_pid)->tk->params;
+    struct dynamic_fb_pid_params *pid_params = NULL;
+
+    pid_params = calloc(1, sizeof(struct dynamic_fb_pid_params));
+    if (pid_params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc dynamic feedback pid params fail\n");
+        return -1;
+    }
+
+    /* every pid starts from the configured values and is tuned by its own feedback */
+    pid_params->slide = params->slide;
+    pid_params->slide.executor = NULL;
+    pid_params->source = SWAPIN_SRC_NONE;
+    pid_params->stat_fd = -1;
+    (*tk_pid)->params = pid_params;
+    return 0;
+}
+
+static void dynamic_fb_free_pid_params(struct engine *eng, struct task_pid **tk_pid)
+{
+    struct dynamic_fb_pid_params *pid_params = (struct dynamic_fb_pid_params *)(*tk_pid)->params;
+
+    if (pid_params == NULL) {
+        return;
+    }
+
+    if (pid_params->stat_fd >= 0) {
+        close(pid_params->stat_fd);
+    }
+    free(pid_params);
+    (*tk_pid)->params = NULL;
+}
+
+struct engine_ops g_dynamic_fb_eng_ops = {
+    .fill_eng_params = NULL,
+    .clear_eng_params = NULL,
+    .fill_task_params = dynamic_fb_fill_task,
+    .clear_task_params = dynamic_fb_clear_task,
+    .start_task = dynamic_fb_start_task,
+    .stop_task = dynamic_fb_stop_task,
+    .alloc_pid_params = dynamic_fb_alloc_pid_params,
+    .free_pid_params = dynamic_fb_free_pid_params,
+    .eng_mgt_func = NULL,
+};
+
+int fill_engine_type_dynamic_fb(struct engine *eng, GKeyFile *config)
+{
+    eng->ops = &g_dynamic_fb_eng_ops;
+    eng->engine_type = DYNAMIC_FB_ENGINE;
+    eng->name = "dynamic_fb";
+    return 0;
+}
@@ -20,6 +20,8 @@
 #include "etmemd_cslide.h"
 #include "etmemd_memdcd.h"
 #include "etmemd_damon.h"
+#include "etmemd_dynamic_fb.h"
+#include "etmemd_historical_fb.h"
 #include "etmemd_thirdparty.h"
 #include "etmemd_log.h"
 #include "etmemd_common.h"
@@ -40,6 +42,8 @@ static struct engine_add_item g_engine_add_items[] = {
     {"cslide", fill_engine_type_cslide},
     {"memdcd", fill_engine_type_memdcd},
     {"damon", fill_engine_type_damon},
+    {"dynamic_fb", fill_engine_type_dynamic_fb},
+    {"historical_fb", fill_engine_type_historical_fb},
     {"thirdparty", fill_engine_type_thirdparty},
 };
 
@@ -0,0 +1,853 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Historical feedback engine, keep cold pages that are predicted to be used by history.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_engine.h"
+#include "etmemd_historical_fb.h"
+#include "etmemd_scan.h"
+#include "etmemd_pool_adapter.h"
+#include "etmemd_file.h"
+
+#define PROC_STAT_FILE          "/stat"
+#define STAT_STARTTIME_INDEX    19      /* index of starttime in the fields after comm */
+#define HISTORY_SCORE_GAIN      64
+#define HISTORY_DECAY_DAYS      17      /* folds to decay HISTORY_SCORE_MAX to 0 without access */
+#define SECONDS_PER_HOUR        3600
+
+static int get_pid_start_time(unsigned int pid, uint64_t *start_time)
+{
+    char pid_str[PID_STR_MAX_LEN] = {0};
+    char buf[FILE_LINE_MAX_LEN] = {0};
+    char *fields = NULL;
+    char *saveptr = NULL;
+    char *tok = NULL;
+    int fd;
+    int i;
+
+    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", pid);
+        return -1;
+    }
+
+    fd = etmemd_open_proc_fd(pid_str, PROC_STAT_FILE);
+    if (fd < 0) {
+        return -1;
+    }
+    if (etmemd_pread_file(fd, buf, FILE_LINE_MAX_LEN) <= 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    /* comm may contain spaces and brackets, so count the fields from the last ')' */
+    fields = strrchr(buf, ')');
+    if (fields == NULL) {
+        return -1;
+    }
+
+    tok = strtok_r(fields + 1, " ", &saveptr);
+    for (i = 0; tok != NULL && i < STAT_STARTTIME_INDEX; i++) {
+        tok = strtok_r(NULL, " ", &saveptr);
+    }
+    if (tok == NULL) {
+        return -1;
+    }
+
+    *start_time = strtoull(tok, NULL, DECIMAL_RADIX);
+    return 0;
+}
+
+static int get_history_path(const struct historical_fb_params *params, unsigned int pid,
+                            char *path, const char *suffix)
+{
+    if (snprintf_s(path, PATH_MAX, PATH_MAX - 1, "%s/%u%s%s", params->history_dir, pid,
+                   HISTORY_FILE_SUFFIX, suffix) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf history path of pid %u fail\n", pid);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int history_table_reserve(struct history_table *table, uint32_t nr)
+{
+    struct history_region *regions = NULL;
+    bool *touched = NULL;
+
+    if (nr <= table->capacity) {
+        return 0;
+    }
+
+    regions = realloc(table->regions, sizeof(struct history_region) * nr);
+    if (regions == NULL) {
+        return -1;
+    }
+    table->regions = regions;
+
+    touched = realloc(table->touched, sizeof(bool) * nr);
+    if (touched == NULL) {
+        return -1;
+    }
+    table->touched = touched;
+    table->capacity = nr;
+    return 0;
+}
+
+static void history_table_destroy(struct history_table *table)
+{
+    free(table->regions);
+    table->regions = NULL;
+    free(table->touched);
+    table->touched = NULL;
+    table->capacity = 0;
+    table->header.nr_regions = 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = read(fd, (char *)buf + done, len - done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        done += (size_t)ret;
+    }
+
+    return 0;
+}
+
+static int write_all_data(int fd, const void *buf, size_t len)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = write(fd, (const char *)buf + done, len - done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        done += (size_t)ret;
+    }
+
+    return 0;
+}
+
+static void history_remove(const struct historical_fb_params *params, unsigned int pid)
+{
+    char path[PATH_MAX] = {0};
+
+    if (get_history_path(params, pid, path, "") != 0) {
+        return;
+    }
+
+    if (unlink(path) != 0 && errno != ENOENT) {
+        etmemd_log(ETMEMD_LOG_WARN, "remove history %s fail, errno: %d\n", path, errno);
+    }
+}
+
+/* history of the pid is only reused if it is recorded for the same process */
+static int history_load(const struct historical_fb_params *params, unsigned int pid, struct history_table *table)
+{
+    char path[PATH_MAX] = {0};
+    struct history_header header;
+    int fd;
+    int ret = -1;
+
+    if (get_history_path(params, pid, path, "") != 0) {
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (read_all(fd, &header, sizeof(header)) != 0 ||
+        header.magic != HISTORY_MAGIC || header.version != HISTORY_VERSION ||
+        header.region_shift != HISTORY_REGION_SHIFT || header.start_time != table->header.start_time ||
+        header.nr_regions > HISTORY_MAX_REGIONS || header.cur_hour < 0 || header.cur_hour >= HISTORY_HOURS) {
+        etmemd_log(ETMEMD_LOG_INFO, "history %s is not for current pid %u, drop it\n", path, pid);
+        close(fd);
+        /* no process can load it any more */
+        history_remove(params, pid);
+        return -1;
+    }
+
+    if (history_table_reserve(table, header.nr_regions) != 0) {
+        goto close_fd;
+    }
+
+    /* regions touched in the saved hour are folded with their access when the hour is rolled */
+    if (read_all(fd, table->regions, sizeof(struct history_region) * header.nr_regions) != 0 ||
+        read_all(fd, table->touched, sizeof(bool) * header.nr_regions) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "read regions from %s fail\n", path);
+        goto close_fd;
+    }
+
+    table->header = header;
+    ret = 0;
+
+close_fd:
+    close(fd);
+    return ret;
+}
+
+static int history_save(const struct historical_fb_params *params, unsigned int pid,
+                        const struct history_table *table)
+{
+    char path[PATH_MAX] = {0};
+    char tmp_path[PATH_MAX] = {0};
+    int fd;
+
+    if (get_history_path(params, pid, path, "") != 0 || get_history_path(params, pid, tmp_path, ".tmp") != 0) {
+        return -1;
+    }
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s fail, errno: %d\n", tmp_path, errno);
+        return -1;
+    }
+
+    if (write_all_data(fd, &table->header, sizeof(table->header)) != 0 ||
+        write_all_data(fd, table->regions, sizeof(struct history_region) * table->header.nr_regions) != 0 ||
+        write_all_data(fd, table->touched, sizeof(bool) * table->header.nr_regions) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "write history to %s fail\n", tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+
+    /* rename is atomic, a crash never leaves a partial history */
+    if (rename(tmp_path, path) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "rename %s to %s fail, errno: %d\n", tmp_path, path, errno);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline uint8_t fold_score(uint8_t score, bool touched)
+{
+    /* (score + 3) / 4 makes an unused score decay to 0 in the end */
+    int val = (int)score - ((int)score + 3) / 4 + (touched ? HISTORY_SCORE_GAIN : 0);
+
+    return val > HISTORY_SCORE_MAX ? HISTORY_SCORE_MAX : (uint8_t)val;
+}
+
+static bool region_is_empty(const struct history_region *region)
+{
+    int i;
+
+    for (i = 0; i < HISTORY_HOURS; i++) {
+        if (region->score[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* each hour passed without being watched, e.g. while etmemd is stopped, decays as an hour without access */
+static void decay_missed_hours(struct history_region *region, const int *missed)
+{
+    int hour;
+    int i;
+
+    for (hour = 0; hour < HISTORY_HOURS; hour++) {
+        for (i = 0; i < missed[hour] && region->score[hour] != 0; i++) {
+            region->score[hour] = fold_score(region->score[hour], false);
+        }
+    }
+}
+
+/*
+ * fold the accesses of the last hour into its score, decay the hours passed between it and the new hour,
+ * then drop regions without any history
+ */
+static void history_roll_hour(struct history_table *table, int hour, int64_t stamp)
+{
+    int missed[HISTORY_HOURS] = {0};
+    int prev = table->header.cur_hour;
+    int64_t passed = stamp - table->header.hour_stamp;
+    int64_t h;
+    uint32_t i;
+    uint32_t n = 0;
+
+    /* every score reaches 0 after HISTORY_DECAY_DAYS misses, so longer gaps are all the same */
+    if (passed > (int64_t)HISTORY_HOURS * HISTORY_DECAY_DAYS) {
+        passed = (int64_t)HISTORY_HOURS * HISTORY_DECAY_DAYS;
+    }
+    for (h = 1; h < passed; h++) {
+        missed[(prev + h) % HISTORY_HOURS]++;
+    }
+
+    for (i = 0; i < table->header.nr_regions; i++) {
+        table->regions[i].score[prev] = fold_score(table->regions[i].score[prev], table->touched[i]);
+        if (passed > 1) {
+            decay_missed_hours(&table->regions[i], missed);
+        }
+        if (region_is_empty(&table->regions[i])) {
+            continue;
+        }
+        table->regions[n] = table->regions[i];
+        table->touched[n] = false;
+        n++;
+    }
+
+    table->header.nr_regions = n;
+    table->header.cur_hour = hour;
+    table->header.hour_stamp = stamp;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t *collect_accessed_regions(const struct page_refs *page_refs, uint32_t *nr)
+{
+    const struct page_refs *iter = NULL;
+    uint64_t *addrs = NULL;
+    uint32_t count = 0;
+    uint32_t i;
+    uint32_t n = 0;
+
+    for (iter = page_refs; iter != NULL; iter = iter->next) {
+        if (iter->m > 0) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        *nr = 0;
+        return NULL;
+    }
+
+    addrs = malloc(sizeof(uint64_t) * count);
+    if (addrs == NULL) {
+        return NULL;
+    }
+
+    count = 0;
+    for (iter = page_refs; iter != NULL; iter = iter->next) {
+        if (iter->m > 0) {
+            addrs[count++] = iter->addr >> HISTORY_REGION_SHIFT;
+        }
+    }
+
+    qsort(addrs, count, sizeof(uint64_t), compare_u64);
+    for (i = 0; i < count; i++) {
+        if (n == 0 || addrs[n - 1] != addrs[i]) {
+            addrs[n++] = addrs[i];
+        }
+    }
+
+    *nr = n;
+    return addrs;
+}
+
+/* merge the sorted accessed regions of this scan into the sorted history table in one pass */
+static int history_record(struct history_table *table, const uint64_t *addrs, uint32_t nr)
+{
+    uint32_t old_nr = table->header.nr_regions;
+    uint32_t new_nr = 0;
+    uint32_t total;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    int k;
+
+    /* count regions not in the table yet */
+    while (j < nr) {
+        if (i < old_nr && table->regions[i].addr < addrs[j]) {
+            i++;
+        } else if (i < old_nr && table->regions[i].addr == addrs[j]) {
+            i++;
+            j++;
+        } else {
+            new_nr++;
+            j++;
+        }
+    }
+
+    if (old_nr + new_nr > HISTORY_MAX_REGIONS) {
+        etmemd_log(ETMEMD_LOG_WARN, "history regions exceed %d, only record known regions\n", HISTORY_MAX_REGIONS);
+        new_nr = 0;
+    }
+    total = old_nr + new_nr;
+    if (history_table_reserve(table, total) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc memory for history regions fail\n");
+        return -1;
+    }
+
+    /* merge backwards, so that regions are moved in place */
+    i = old_nr;
+    j = nr;
+    k = (int)total - 1;
+    while (j > 0 && k >= 0) {
+        if (i > 0 && table->regions[i - 1].addr > addrs[j - 1]) {
+            table->regions[k] = table->regions[i - 1];
+            table->touched[k--] = table->touched[--i];
+        } else if (i > 0 && table->regions[i - 1].addr == addrs[j - 1]) {
+            table->regions[k] = table->regions[i - 1];
+            table->touched[k--] = true;
+            i--;
+            j--;
+        } else if (new_nr > 0) {
+            (void)memset_s(&table->regions[k], sizeof(struct history_region), 0, sizeof(struct history_region));
+            table->regions[k].addr = addrs[j - 1];
+            table->touched[k--] = true;
+            new_nr--;
+            j--;
+        } else {
+            /* the table is full, skip unknown regions */
+            j--;
+        }
+    }
+
+    table->header.nr_regions = total;
+    return 0;
+}
+
+/* hour of the day to score, and hours since the epoch to count the hours passed */
+static int current_hour(int64_t *stamp)
+{
+    time_t now = time(NULL);
+    struct tm tm_now;
+
+    *stamp = (int64_t)(now / SECONDS_PER_HOUR);
+    if (localtime_r(&now, &tm_now) == NULL) {
+        return 0;
+    }
+
+    return tm_now.tm_hour;
+}
+
+static void historical_fb_scan_hook(struct task_pid *tk_pid, const struct page_refs *page_refs)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)tk_pid->tk->params;
+    struct historical_fb_pid_params *pid_params = (struct historical_fb_pid_params *)tk_pid->params;
+    struct history_table *table = NULL;
+    uint64_t *addrs = NULL;
+    uint32_t nr = 0;
+    int64_t stamp;
+    int hour = current_hour(&stamp);
+
+    if (pid_params == NULL) {
+        return;
+    }
+    table = &pid_params->table;
+
+    if (stamp != table->header.hour_stamp) {
+        history_roll_hour(table, hour, stamp);
+        if (history_save(params, tk_pid->pid, table) != 0) {
+            etmemd_log(ETMEMD_LOG_WARN, "save history of pid %u fail\n", tk_pid->pid);
+        }
+    }
+
+    addrs = collect_accessed_regions(page_refs, &nr);
+    if (nr == 0) {
+        return;
+    }
+    if (addrs == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc memory for accessed regions of pid %u fail\n", tk_pid->pid);
+        return;
+    }
+
+    if (history_record(table, addrs, nr) == 0) {
+        pid_params->dirty = true;
+    }
+    free(addrs);
+}
+
+static const struct history_region *history_search(const struct history_table *table, uint64_t addr)
+{
+    uint64_t key = addr >> HISTORY_REGION_SHIFT;
+    uint32_t low = 0;
+    uint32_t high = table->header.nr_regions;
+    uint32_t mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (table->regions[mid].addr == key) {
+            return &table->regions[mid];
+        }
+        if (table->regions[mid].addr < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+/* region used in this hour or the next one of past days is predicted to be used soon */
+static bool history_predict_used(const struct history_table *table, uint64_t addr, int threshold)
+{
+    const struct history_region *region = history_search(table, addr);
+    int hour = table->header.cur_hour;
+
+    if (region == NULL) {
+        return false;
+    }
+
+    return region->score[hour] >= threshold || region->score[(hour + 1) % HISTORY_HOURS] >= threshold;
+}
+
+static void historical_fb_grade_hook(struct task_pid *tk_pid, struct memory_grade *memory_grade)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)tk_pid->tk->params;
+    struct historical_fb_pid_params *pid_params = (struct historical_fb_pid_params *)tk_pid->params;
+    struct page_refs **cold = &memory_grade->cold_pages;
+    int threshold = params->predict_threshold * HISTORY_SCORE_MAX / 100;
+    unsigned long kept = 0;
+
+    if (pid_params == NULL || pid_params->table.header.nr_regions == 0) {
+        return;
+    }
+
+    while (*cold != NULL) {
+        if (history_predict_used(&pid_params->table, (*cold)->addr, threshold)) {
+            *cold = add_page_refs_into_memory_grade(*cold, &memory_grade->hot_pages);
+            kept++;
+            continue;
+        }
+        cold = &((*cold)->next);
+    }
+
+    if (kept != 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pid %u keep %lu cold pages predicted to be used by history\n",
+                   tk_pid->pid, kept);
+    }
+}
+
+static void *historical_fb_executor(void *arg)
+{
+    struct task_pid *tk_pid = (struct task_pid *)arg;
+    struct historical_fb_params *params = (struct historical_fb_params *)tk_pid->tk->params;
+
+    (void)slide_do_executor(tk_pid, &params->slide);
+    return NULL;
+}
+
+static int fill_task_history_dir(void *obj, void *val)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)obj;
+    char *dir = (char *)val;
+
+    if (dir[0] != '/' || strlen(dir) >= PATH_MAX / 2) {
+        etmemd_log(ETMEMD_LOG_ERR, "history_dir %s should be an absolute path shorter than %d\n", dir, PATH_MAX / 2);
+        free(dir);
+        return -1;
+    }
+
+    if (strncpy_s(params->history_dir, PATH_MAX, dir, strlen(dir)) != EOK) {
+        etmemd_log(ETMEMD_LOG_ERR, "strncpy history_dir fail\n");
+        free(dir);
+        return -1;
+    }
+
+    free(dir);
+    return 0;
+}
+
+static int fill_task_predict_threshold(void *obj, void *val)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)obj;
+    int value = parse_to_int(val);
+
+    if (value <= 0 || value > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "predict_threshold %d is invalid, the range is (0, 100]\n", value);
+        return -1;
+    }
+
+    params->predict_threshold = value;
+    return 0;
+}
+
+static struct config_item g_historical_fb_task_config_items[] = {
+    {"history_dir", STR_VAL, fill_task_history_dir, true},
+    {"predict_threshold", INT_VAL, fill_task_predict_threshold, true},
+};
+
+/* create dir with the missing parents of it, as mkdir -p */
+static int mkdir_parents(const char *dir)
+{
+    char path[PATH_MAX] = {0};
+    char *p = NULL;
+
+    if (strncpy_s(path, PATH_MAX, dir, strlen(dir)) != EOK) {
+        return -1;
+    }
+
+    for (p = path + 1; *p != '\0'; p++) {
+        if (*p != '/') {
+            continue;
+        }
+        *p = '\0';
+        if (mkdir(path, S_IRWXU) != 0 && errno != EEXIST) {
+            return -1;
+        }
+        *p = '/';
+    }
+
+    if (mkdir(path, S_IRWXU) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int check_history_dir(const char *dir)
+{
+    struct stat st;
+
+    if (stat(dir, &st) != 0) {
+        if (mkdir_parents(dir) != 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "create history_dir %s fail, errno: %d\n", dir, errno);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        etmemd_log(ETMEMD_LOG_ERR, "history_dir %s is not a directory\n", dir);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* a history can only be loaded by the process it is recorded for */
+static bool history_process_exited(unsigned int pid, uint64_t start_time)
+{
+    uint64_t cur_start_time;
+
+    return get_pid_start_time(pid, &cur_start_time) != 0 || cur_start_time != start_time;
+}
+
+/* drop the histories of the processes which exited while they were not watched */
+static void history_dir_prune(const struct historical_fb_params *params)
+{
+    struct history_header header;
+    struct dirent *dent = NULL;
+    char *end = NULL;
+    unsigned long pid;
+    DIR *dir = NULL;
+    int fd;
+
+    dir = opendir(params->history_dir);
+    if (dir == NULL) {
+        etmemd_log(ETMEMD_LOG_WARN, "open %s fail, errno: %d\n", params->history_dir, errno);
+        return;
+    }
+
+    while ((dent = readdir(dir)) != NULL) {
+        pid = strtoul(dent->d_name, &end, DECIMAL_RADIX);
+        if (end == dent->d_name || pid == 0 || pid > UINT32_MAX || strcmp(end, HISTORY_FILE_SUFFIX) != 0) {
+            continue;
+        }
+
+        fd = openat(dirfd(dir), dent->d_name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        if (read_all(fd, &header, sizeof(header)) != 0 || header.magic != HISTORY_MAGIC ||
+            history_process_exited((unsigned int)pid, header.start_time)) {
+            etmemd_log(ETMEMD_LOG_INFO, "process of history %s exits, remove it\n", dent->d_name);
+            history_remove(params, (unsigned int)pid);
+        }
+        close(fd);
+    }
+
+    closedir(dir);
+}
+
+static int historical_fb_fill_task(GKeyFile *config, struct task *tk)
+{
+    struct historical_fb_params *params = calloc(1, sizeof(struct historical_fb_params));
+
+    if (params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc historical feedback param fail\n");
+        return -1;
+    }
+
+    params->predict_threshold = HISTORY_DEFAULT_PREDICT;
+    if (strncpy_s(params->history_dir, PATH_MAX, HISTORY_DEFAULT_DIR, strlen(HISTORY_DEFAULT_DIR)) != EOK) {
+        goto free_params;
+    }
+
+    if (slide_fill_params(config, &params->slide) != 0) {
+        goto free_params;
+    }
+
+    if (parse_file_config(config, TASK_GROUP, g_historical_fb_task_config_items,
+                          ARRAY_SIZE(g_historical_fb_task_config_items), (void *)params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "historical feedback fill task fail\n");
+        goto free_params;
+    }
+
+    if (check_history_dir(params->history_dir) != 0) {
+        goto free_params;
+    }
+    history_dir_prune(params);
+
+    params->slide.scan_hook = historical_fb_scan_hook;
+    params->slide.grade_hook = historical_fb_grade_hook;
+    tk->params = params;
+    return 0;
+
+free_params:
+    free(params);
+    return -1;
+}
+
+static void historical_fb_clear_task(struct task *tk)
+{
+    etmemd_free_task_pids(tk);
+    free(tk->params);
+    tk->params = NULL;
+}
+
+static int historical_fb_start_task(struct engine *eng, struct task *tk)
+{
+    struct historical_fb_params *params = tk->params;
+
+    params->executor = malloc(sizeof(struct task_executor));
+    if (params->executor == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "historical feedback alloc memory for task_executor fail\n");
+        return -1;
+    }
+
+    params->executor->tk = tk;
+    params->executor->func = historical_fb_executor;
+    if (start_threadpool_work(params->executor) != 0) {
+        free(params->executor);
+        params->executor = NULL;
+        etmemd_log(ETMEMD_LOG_ERR, "historical feedback start task executor fail\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void historical_fb_stop_task(struct engine *eng, struct task *tk)
+{
+    struct historical_fb_params *params = tk->params;
+
+    stop_and_delete_threadpool_work(tk);
+    etmemd_free_task_pids(tk);
+    free(params->executor);
+    params->executor = NULL;
+}
+
+static int historical_fb_alloc_pid_params(struct engine *eng, struct task_pid **tk_pid)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)(*tk_pid)->tk->params;
+    struct historical_fb_pid_params *pid_params = NULL;
+    struct history_header *header = NULL;
+
+    pid_params = calloc(1, sizeof(struct historical_fb_pid_params));
+    if (pid_params == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc historical feedback pid params fail\n");
+        return -1;
+    }
+
+    header = &pid_params->table.header;
+    header->magic = HISTORY_MAGIC;
+    header->version = HISTORY_VERSION;
+    header->region_shift = HISTORY_REGION_SHIFT;
+    header->cur_hour = current_hour(&header->hour_stamp);
+    if (get_pid_start_time((*tk_pid)->pid, &header->start_time) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "get start time of pid %u fail\n", (*tk_pid)->pid);
+    } else if (history_load(params, (*tk_pid)->pid, &pid_params->table) == 0) {
+        etmemd_log(ETMEMD_LOG_INFO, "load %u history regions of pid %u\n", header->nr_regions, (*tk_pid)->pid);
+    }
+
+    (*tk_pid)->params = pid_params;
+    return 0;
+}
+
+static void historical_fb_free_pid_params(struct engine *eng, struct task_pid **tk_pid)
+{
+    struct historical_fb_params *params = (struct historical_fb_params *)(*tk_pid)->tk->params;
+    struct historical_fb_pid_params *pid_params = (struct historical_fb_pid_params *)(*tk_pid)->params;
+
+    if (pid_params == NULL) {
+        return;
+    }
+
+    /*
+     * history of the current hour is kept if the task is only stopped for a while,
+     * and removed with the process, no other process could use it.
+     */
+    if (params != NULL && (etmemd_task_pid_exited(*tk_pid) ||
+        history_process_exited((*tk_pid)->pid, pid_params->table.header.start_time))) {
+        history_remove(params, (*tk_pid)->pid);
+    } else if (pid_params->dirty && params != NULL &&
+               history_save(params, (*tk_pid)->pid, &pid_params->table) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "save history of pid %u fail\n", (*tk_pid)->pid);
+    }
+
+    history_table_destroy(&pid_params->table);
+    free(pid_params);
+    (*tk_pid)->params = NULL;
+}
+
+struct engine_ops g_historical_fb_eng_ops = {
+    .fill_eng_params = NULL,
+    .clear_eng_params = NULL,
+    .fill_task_params = historical_fb_fill_task,
+    .clear_task_params = historical_fb_clear_task,
+    .start_task = historical_fb_start_task,
+    .stop_task = historical_fb_stop_task,
+    .alloc_pid_params = historical_fb_alloc_pid_params,
+    .free_pid_params = historical_fb_free_pid_params,
+    .eng_mgt_func = NULL,
+};
+
+int fill_engine_type_historical_fb(struct engine *eng, GKeyFile *config)
+{
+    eng->ops = &g_historical_fb_eng_ops;
+    eng->engine_type = HISTORICAL_FB_ENGINE;
+    eng->name = "historical_fb";
+    return 0;
+}
@@ -20,6 +20,8 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
 
 #include "securec.h"
 #include "etmemd_log.h"
@@ -32,58 +34,121 @@
 #include "etmemd_memdcd.h"
 
 #define MAX_VMA_NUM 512
-#define RESP_MSG_MAX_LEN 10
 #define CLIENT_RECV_DEFAULT_TIME 10
 
+#define MEMDCD_FRAME_MAGIC 0x4d444344U /* "MDCD" */
+#define MEMDCD_PROTO_VERSION 2
+#define MEMDCD_FRAME_WINDOW 16
+
+#define MEMDCD_RING_SIZE (1U << 20)
+#define MEMDCD_RING_FDS 2
+#define MEMDCD_RING_ALIGN 8
+#define MEMDCD_RING_PAD UINT32_MAX
+#define RING_ALIGN_UP(x) (((x) + MEMDCD_RING_ALIGN - 1) & ~((uint64_t)MEMDCD_RING_ALIGN - 1))
+
+#define MEMDCD_PAGE_UNIT_SHIFT 12
+#define MEMDCD_VARINT_MAX_LEN 10
+#define MEMDCD_RUN_MAX_LEN (MEMDCD_VARINT_MAX_LEN * 4)
+
 enum MEMDCD_CMD_TYPE {
     MEMDCD_CMD_MEM = 0
 };
 
-enum SwapType {
-    SWAP_TYPE_VMA_ADDR = 0xFFFFFF01,
-    SWAP_TYPE_MAX
+enum MEMDCD_MESSAGE_STATUS {
+    MEMDCD_SEND_START,
+    MEMDCD_SEND_PROCESS,
+    MEMDCD_SEND_END,
 };
 
-struct vma_addr {
-    uint64_t start_addr;
-    uint64_t vma_len;
+enum MEMDCD_FRAME_TYPE {
+    MEMDCD_FRAME_MSG,
+    MEMDCD_FRAME_ACK,
+    MEMDCD_FRAME_RING_SETUP,
 };
 
-struct vma_addr_with_count {
-    struct vma_addr vma;
-    int count;
+struct memdcd_frame_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t seq;
+    uint32_t length;
 };
 
-enum MEMDCD_MESSAGE_STATUS {
-    MEMDCD_SEND_START,
-    MEMDCD_SEND_PROCESS,
-    MEMDCD_SEND_END,
+struct memdcd_frame_ack {
+    uint32_t failed;
 };
 
-struct swap_vma_with_count {
-    enum SwapType type;
-    uint64_t length;
+/*
+ * the pages are sent as runs of contiguous pages of the same size and count, each run is encoded as
+ * four varints: zigzag of the distance from the end of the previous run, the size of each page, the
+ * count, and the number of pages. distances and sizes are in the unit of 1 << MEMDCD_PAGE_UNIT_SHIFT.
+ */
+struct memdcd_compact_message {
+    uint32_t cmd_type;
+    int32_t pid;
+    uint32_t enable_uswap;
+    uint32_t status;
     uint64_t total_length;
-    enum MEMDCD_MESSAGE_STATUS status;
-    struct vma_addr_with_count vma_addrs[MAX_VMA_NUM];
+    uint32_t count;
+    uint32_t runs;
 };
 
-struct memory_message {
-    int pid;
-    uint32_t enable_uswap;
-    struct swap_vma_with_count vma;
+struct memdcd_msg_frame {
+    struct memdcd_frame_header header;
+    struct memdcd_compact_message msg;
+    unsigned char runs[MAX_VMA_NUM * MEMDCD_RUN_MAX_LEN];
 };
 
-struct memdcd_message {
-    enum MEMDCD_CMD_TYPE cmd_type;
-    union {
-        struct memory_message memory_msg;
-    };
+struct memdcd_run {
+    uint64_t addr;
+    uint64_t size;
+    int count;
+    uint32_t nr;
+};
+
+/* a frame being encoded, the pages of the last run are put into the frame when the run ends */
+struct memdcd_encoder {
+    struct memdcd_msg_frame frame;
+    size_t runs_len;
+    uint64_t prev_end;
+    struct memdcd_run run;
+};
+
+struct memdcd_ack_frame {
+    struct memdcd_frame_header header;
+    struct memdcd_frame_ack ack;
+};
+
+/*
+ * the ring is a memfd shared with memdcd, set up by a frame with the memfd and an eventfd passed by
+ * SCM_RIGHTS. a message is put into a record of the ring instead of the socket, then the eventfd is
+ * written to wake memdcd up. memdcd moves tail after it handles the messages and acks them on the socket.
+ */
+struct memdcd_ring {
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    unsigned char data[] __attribute__((aligned(64)));
+};
+
+struct memdcd_ring_setup {
+    uint32_t size;
+};
+
+struct memdcd_setup_frame {
+    struct memdcd_frame_header header;
+    struct memdcd_ring_setup setup;
+};
+
+/* records never wrap, a record of MEMDCD_RING_PAD fills the end of the ring */
+struct memdcd_ring_record {
+    uint32_t seq;
+    uint32_t length;
 };
 
 static int memdcd_connection_init(time_t tm_out, const char sock_path[])
 {
     struct sockaddr_un addr;
+    struct timeval timeout = {tm_out, 0};
     int len;
 
     int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -92,8 +157,6 @@ static int memdcd_connection_init(time_t tm_out, const char sock_path[])
         return -1;
     }
 
-    len = offsetof(struct sockaddr_un, sun_path) + strlen(addr.sun_path);
-
     if (memset_s(&addr, sizeof(struct sockaddr_un),
                  0, sizeof(struct sockaddr_un)) != EOK) {
         etmemd_log(ETMEMD_LOG_ERR, "clear addr failed\n");
@@ -116,6 +179,12 @@ static int memdcd_connection_init(time_t tm_out, const char sock_path[])
         goto err_out;
     }
 
+    /* do not wait for the ack of memdcd forever */
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "set recv timeout for memdcd socket fail, error(%s)\n", strerror(errno));
+        goto err_out;
+    }
+
     return sockfd;
 
 err_out:
@@ -123,55 +192,392 @@ err_out:
     return -1;
 }
 
-static int send_data_to_memdcd(unsigned int pid, struct memdcd_message *msg, const char sock_path[])
+static void memdcd_ring_release(struct memdcd_params *params)
 {
-    int client_fd;
-    int ret = 0;
-    int read_bytes;
-    int write_bytes;
-    char buff[RESP_MSG_MAX_LEN] = {0};
-    time_t recv_timeout = CLIENT_RECV_DEFAULT_TIME;
-
-    client_fd = memdcd_connection_init(recv_timeout, sock_path);
-    if (client_fd < 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "%s: connect error %d.\n", __func__, client_fd);
+    if (params->ring != NULL) {
+        munmap(params->ring, sizeof(struct memdcd_ring) + MEMDCD_RING_SIZE);
+        params->ring = NULL;
+    }
+    if (params->event_fd >= 0) {
+        close(params->event_fd);
+        params->event_fd = -1;
+    }
+}
+
+static void memdcd_disconnect(struct memdcd_params *params)
+{
+    memdcd_ring_release(params);
+    if (params->sock_fd >= 0) {
+        close(params->sock_fd);
+        params->sock_fd = -1;
+    params->event_fd = -1;
+    }
+}
+
+static int memdcd_send_all(int fd, const void *buf, size_t len)
+{
+    size_t sent = 0;
+    ssize_t rc;
+
+    while (sent < len) {
+        rc = send(fd, (const char *)buf + sent, len - sent, MSG_NOSIGNAL);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            etmemd_log(ETMEMD_LOG_ERR, "send to memdcd fail, error(%s)\n", strerror(errno));
+            return -1;
+        }
+        sent += (size_t)rc;
+    }
+
+    return 0;
+}
+
+static int memdcd_recv_all(int fd, void *buf, size_t len)
+{
+    size_t got = 0;
+    ssize_t rc;
+
+    while (got < len) {
+        rc = recv(fd, (char *)buf + got, len - got, 0);
+        if (rc == 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "connection closed by memdcd\n");
+            return -1;
+        }
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            etmemd_log(ETMEMD_LOG_ERR, "recv from memdcd fail, error(%s)\n", strerror(errno));
+            return -1;
+        }
+        got += (size_t)rc;
+    }
+
+    return 0;
+}
+
+/* read the acks until no more than window frames are left unacknowledged */
+static int memdcd_wait_ack(struct memdcd_params *params, uint32_t window, uint32_t *failed)
+{
+    struct memdcd_ack_frame frame;
+
+    while (params->seq - params->acked > window) {
+        if (memdcd_recv_all(params->sock_fd, &frame, sizeof(frame)) != 0) {
+            return -1;
+        }
+
+        if (frame.header.magic != MEMDCD_FRAME_MAGIC || frame.header.version != MEMDCD_PROTO_VERSION ||
+            frame.header.type != MEMDCD_FRAME_ACK || frame.header.length != sizeof(struct memdcd_frame_ack)) {
+            etmemd_log(ETMEMD_LOG_ERR, "invalid ack frame from memdcd\n");
+            return -1;
+        }
+        /* acks are cumulative, the seq must be in the frames sent and not acknowledged */
+        if (frame.header.seq - params->acked > params->seq - params->acked) {
+            etmemd_log(ETMEMD_LOG_ERR, "ack of frame %u from memdcd is out of window (%u, %u]\n",
+                       frame.header.seq, params->acked, params->seq);
+            return -1;
+        }
+
+        params->acked = frame.header.seq;
+        *failed += frame.ack.failed;
+    }
+
+    return 0;
+}
+
+static int memdcd_send_fds(int fd, const void *buf, size_t len, const int *fds, int nr_fds)
+{
+    char control[CMSG_SPACE(sizeof(int) * MEMDCD_RING_FDS)];
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = len,
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = CMSG_SPACE(sizeof(int) * nr_fds),
+    };
+    struct cmsghdr *cmsg = NULL;
+    ssize_t rc;
+
+    if (memset_s(control, sizeof(control), 0, sizeof(control)) != EOK) {
+        etmemd_log(ETMEMD_LOG_ERR, "clear control message fail\n");
+        return -1;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nr_fds);
+    if (memcpy_s(CMSG_DATA(cmsg), sizeof(int) * nr_fds, fds, sizeof(int) * nr_fds) != EOK) {
+        etmemd_log(ETMEMD_LOG_ERR, "copy fds to control message fail\n");
         return -1;
     }
-    write_bytes = write(client_fd, msg, sizeof(struct memdcd_message));
-    if (write_bytes <= 0) {
-        etmemd_log(ETMEMD_LOG_DEBUG, "etmemd_socket: send to memdcd for pid %u, bytes: %d\n",
-            pid, write_bytes);
+
+    do {
+        rc = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "send fds to memdcd fail, error(%s)\n", strerror(errno));
+        return -1;
+    }
+
+    /* the fds go with the first byte, the rest is sent as usual */
+    return memdcd_send_all(fd, (const char *)buf + rc, len - (size_t)rc);
+}
+
+/*
+ * set up the ring on the new connection. return 0 if the ring is used, 1 if it is not and the
+ * connection goes on with the socket, -1 if the connection is broken.
+ */
+static int memdcd_ring_setup(struct memdcd_params *params)
+{
+    struct memdcd_setup_frame frame;
+    size_t map_len = sizeof(struct memdcd_ring) + MEMDCD_RING_SIZE;
+    int fds[MEMDCD_RING_FDS];
+    uint32_t failed = 0;
+    void *addr = NULL;
+    int mem_fd;
+    int ret = 1;
+
+    mem_fd = memfd_create("etmemd_memdcd_ring", MFD_CLOEXEC);
+    if (mem_fd < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "create memfd for ring fail, error(%s)\n", strerror(errno));
+        return 1;
+    }
+    if (ftruncate(mem_fd, (off_t)map_len) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "resize memfd for ring fail, error(%s)\n", strerror(errno));
+        goto close_memfd;
+    }
+    addr = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (addr == MAP_FAILED) {
+        etmemd_log(ETMEMD_LOG_WARN, "map ring fail, error(%s)\n", strerror(errno));
+        goto close_memfd;
+    }
+    params->ring = (struct memdcd_ring *)addr;
+    params->ring_head = 0;
+    params->event_fd = eventfd(0, EFD_CLOEXEC);
+    if (params->event_fd < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "create eventfd for ring fail, error(%s)\n", strerror(errno));
+        goto release_ring;
+    }
+
+    frame.header.magic = MEMDCD_FRAME_MAGIC;
+    frame.header.version = MEMDCD_PROTO_VERSION;
+    frame.header.type = MEMDCD_FRAME_RING_SETUP;
+    frame.header.seq = ++params->seq;
+    frame.header.length = sizeof(struct memdcd_ring_setup);
+    frame.setup.size = MEMDCD_RING_SIZE;
+    fds[0] = mem_fd;
+    fds[1] = params->event_fd;
+    if (memdcd_send_fds(params->sock_fd, &frame, sizeof(frame), fds, MEMDCD_RING_FDS) != 0 ||
+        memdcd_wait_ack(params, 0, &failed) != 0) {
         ret = -1;
-        goto CLOSE_SOCK;
+        goto release_ring;
+    }
+    if (failed != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "memdcd refuses the ring, send to it by the socket\n");
+        goto release_ring;
     }
 
-    read_bytes = read(client_fd, buff, RESP_MSG_MAX_LEN);
-    if (read_bytes > 0) {
-        if (strcmp(buff, "success") == 0) {
-            etmemd_log(ETMEMD_LOG_INFO, "etmemd_socket: recv respond success.\n");
-        } else {
-            etmemd_log(ETMEMD_LOG_ERR, "etmemd_socket: recv respond failed.\n");
-            ret = -1;
+    close(mem_fd);
+    return 0;
+
+release_ring:
+    memdcd_ring_release(params);
+close_memfd:
+    close(mem_fd);
+    return ret;
+}
+
+static int memdcd_open_connection(struct memdcd_params *params)
+{
+    params->sock_fd = memdcd_connection_init(CLIENT_RECV_DEFAULT_TIME, params->memdcd_socket);
+    if (params->sock_fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "%s: connect to memdcd fail\n", __func__);
+        return -1;
+    }
+
+    /* seq is counted by each connection */
+    params->seq = 0;
+    params->acked = 0;
+    return 0;
+}
+
+static int memdcd_connect(struct memdcd_params *params)
+{
+    if (params->sock_fd >= 0) {
+        return 0;
+    }
+
+    if (memdcd_open_connection(params) != 0) {
+        return -1;
+    }
+    if (!params->use_ring || memdcd_ring_setup(params) >= 0) {
+        return 0;
+    }
+
+    /* memdcd of an older version closes the connection for the setup, go on with the socket */
+    etmemd_log(ETMEMD_LOG_WARN, "set up ring with memdcd fail, send to it by the socket\n");
+    memdcd_disconnect(params);
+    return memdcd_open_connection(params);
+}
+
+/* put the message of frame into the ring, wait for memdcd to take the messages before if it is full */
+static int memdcd_ring_put(struct memdcd_params *params, const struct memdcd_msg_frame *frame, uint32_t *failed)
+{
+    struct memdcd_ring_record record = {
+        .seq = frame->header.seq,
+        .length = frame->header.length,
+    };
+    uint64_t need = RING_ALIGN_UP(sizeof(record) + record.length);
+    uint64_t offset = params->ring_head & (MEMDCD_RING_SIZE - 1);
+    uint64_t pad = MEMDCD_RING_SIZE - offset < need ? MEMDCD_RING_SIZE - offset : 0;
+    uint64_t val = 1;
+
+    /* memdcd moves tail before it acks, so the space comes with the acks of the messages before */
+    while (params->ring_head + pad + need - __atomic_load_n(&params->ring->tail, __ATOMIC_ACQUIRE) >
+           MEMDCD_RING_SIZE) {
+        if (params->seq - 1 == params->acked) {
+            etmemd_log(ETMEMD_LOG_ERR, "no space in ring for %lu bytes\n", need);
+            return -1;
+        }
+        if (memdcd_wait_ack(params, params->seq - params->acked - 1, failed) != 0) {
+            return -1;
         }
     }
 
-CLOSE_SOCK:
-    close(client_fd);
+    if (pad != 0) {
+        struct memdcd_ring_record pad_record = {
+            .seq = 0,
+            .length = MEMDCD_RING_PAD,
+        };
+        if (memcpy_s(params->ring->data + offset, pad, &pad_record, sizeof(pad_record)) != EOK) {
+            return -1;
+        }
+        params->ring_head += pad;
+        offset = 0;
+    }
+    if (memcpy_s(params->ring->data + offset, MEMDCD_RING_SIZE - offset, &record, sizeof(record)) != EOK ||
+        memcpy_s(params->ring->data + offset + sizeof(record), MEMDCD_RING_SIZE - offset - sizeof(record),
+                 &frame->msg, record.length) != EOK) {
+        etmemd_log(ETMEMD_LOG_ERR, "copy message to ring fail\n");
+        return -1;
+    }
+    params->ring_head += need;
+    __atomic_store_n(&params->ring->head, params->ring_head, __ATOMIC_RELEASE);
 
-    return ret;
+    if (write(params->event_fd, &val, sizeof(val)) != sizeof(val)) {
+        etmemd_log(ETMEMD_LOG_ERR, "wake memdcd up fail, error(%s)\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* frames are sent without waiting for the ack, unless MEMDCD_FRAME_WINDOW of them are unacknowledged */
+static int memdcd_send_frame(struct memdcd_params *params, struct memdcd_msg_frame *frame, uint32_t *failed)
+{
+    if (memdcd_wait_ack(params, MEMDCD_FRAME_WINDOW - 1, failed) != 0) {
+        return -1;
+    }
+
+    frame->header.seq = ++params->seq;
+    if (params->ring != NULL) {
+        return memdcd_ring_put(params, frame, failed);
+    }
+    return memdcd_send_all(params->sock_fd, frame, sizeof(struct memdcd_frame_header) + frame->header.length);
+}
+
+static size_t put_varint(unsigned char *buf, uint64_t val)
+{
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        buf[len++] = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    buf[len++] = (unsigned char)val;
+    return len;
 }
 
-static int memdcd_do_migrate(unsigned int pid, struct page_refs *page_refs_list, const char sock_path[])
+static void memdcd_encoder_put_run(struct memdcd_encoder *enc)
+{
+    struct memdcd_run *run = &enc->run;
+    uint64_t start = run->addr >> MEMDCD_PAGE_UNIT_SHIFT;
+    uint64_t size = run->size >> MEMDCD_PAGE_UNIT_SHIFT;
+    int64_t dist = (int64_t)(start - enc->prev_end);
+    unsigned char *pos = enc->frame.runs + enc->runs_len;
+
+    if (run->nr == 0) {
+        return;
+    }
+
+    pos += put_varint(pos, ((uint64_t)dist << 1) ^ (uint64_t)(dist >> 63));
+    pos += put_varint(pos, size);
+    pos += put_varint(pos, (uint64_t)(unsigned int)run->count);
+    pos += put_varint(pos, run->nr);
+    enc->runs_len = (size_t)(pos - enc->frame.runs);
+
+    enc->frame.msg.count += run->nr;
+    enc->frame.msg.runs++;
+    enc->frame.header.length = sizeof(struct memdcd_compact_message) + enc->runs_len;
+    enc->prev_end = start + size * run->nr;
+    run->nr = 0;
+}
+
+static void memdcd_encoder_add(struct memdcd_encoder *enc, const struct page_refs *page_refs)
+{
+    struct memdcd_run *run = &enc->run;
+    uint64_t size = (uint64_t)page_type_to_size(page_refs->type);
+
+    if (run->nr != 0 && size == run->size && page_refs->count == run->count &&
+        page_refs->addr == run->addr + run->size * run->nr) {
+        run->nr++;
+        return;
+    }
+
+    memdcd_encoder_put_run(enc);
+    run->addr = page_refs->addr;
+    run->size = size;
+    run->count = page_refs->count;
+    run->nr = 1;
+}
+
+static void memdcd_encoder_reset(struct memdcd_encoder *enc)
+{
+    enc->frame.header.length = sizeof(struct memdcd_compact_message);
+    enc->frame.msg.count = 0;
+    enc->frame.msg.runs = 0;
+    enc->runs_len = 0;
+    enc->prev_end = 0;
+    enc->run.nr = 0;
+}
+
+static void memdcd_encoder_init(struct memdcd_encoder *enc, unsigned int pid, uint64_t total_count)
+{
+    enc->frame.header.magic = MEMDCD_FRAME_MAGIC;
+    enc->frame.header.version = MEMDCD_PROTO_VERSION;
+    enc->frame.header.type = MEMDCD_FRAME_MSG;
+
+    enc->frame.msg.cmd_type = MEMDCD_CMD_MEM;
+    enc->frame.msg.pid = (int32_t)pid;
+    enc->frame.msg.enable_uswap = true;
+    enc->frame.msg.status = MEMDCD_SEND_START;
+    enc->frame.msg.total_length = total_count;
+    memdcd_encoder_reset(enc);
+}
+
+static int memdcd_send_page_refs(unsigned int pid, struct page_refs *page_refs_list,
+                                 struct memdcd_params *params, struct memdcd_encoder *enc)
 {
     int count = 0, total_count = 0;
-    int ret = 0;
-    struct swap_vma_with_count *swap_vma = NULL;
+    uint32_t failed = 0;
     struct page_refs *page_refs = page_refs_list;
-    struct memdcd_message *msg;
 
-    if (page_refs_list == NULL) {
-        /* do nothing */
-        return 0;
+    if (memdcd_connect(params) != 0) {
+        return -1;
     }
 
     while (page_refs != NULL) {
@@ -180,25 +586,9 @@ static int memdcd_do_migrate(unsigned int pid, struct page_refs *page_refs_list,
     }
     page_refs = page_refs_list;
 
-    msg = (struct memdcd_message *)calloc(1, sizeof(struct memdcd_message));
-    if (msg == NULL) {
-        etmemd_log(ETMEMD_LOG_WARN, "memigd_socket: malloc for swap vma failed. \n");
-        return -1;
-    }
-
-    msg->cmd_type = MEMDCD_CMD_MEM;
-    msg->memory_msg.pid = pid;
-    msg->memory_msg.enable_uswap = true;
-    msg->memory_msg.vma.status = MEMDCD_SEND_START;
-
-    swap_vma = &(msg->memory_msg.vma);
-    swap_vma->type = SWAP_TYPE_VMA_ADDR;
-    swap_vma->total_length = total_count;
-
+    memdcd_encoder_init(enc, pid, (uint64_t)total_count);
     while (page_refs != NULL) {
-        swap_vma->vma_addrs[count].vma.start_addr = page_refs->addr;
-        swap_vma->vma_addrs[count].vma.vma_len = page_type_to_size(page_refs->type);
-        swap_vma->vma_addrs[count].count = page_refs->count;
+        memdcd_encoder_add(enc, page_refs);
         count++;
         page_refs = page_refs->next;
 
@@ -208,30 +598,82 @@ static int memdcd_do_migrate(unsigned int pid, struct page_refs *page_refs_list,
         if (page_refs == NULL) {
             break;
         }
-        swap_vma->length = count * sizeof(struct vma_addr_with_count);
-        if (send_data_to_memdcd(pid, msg, sock_path) != 0) {
-            ret = -1;
-            goto FREE_SWAP;
+        memdcd_encoder_put_run(enc);
+        if (memdcd_send_frame(params, &enc->frame, &failed) != 0) {
+            goto broken;
+        }
+        /* memdcd drops the pages of pid once a message of them fails, no need to send the rest */
+        if (failed != 0) {
+            break;
         }
         count = 0;
-        msg->memory_msg.vma.status = MEMDCD_SEND_PROCESS;
-        if (memset_s(swap_vma->vma_addrs, sizeof(swap_vma->vma_addrs),
-                    0, sizeof(swap_vma->vma_addrs)) != EOK) {
-            etmemd_log(ETMEMD_LOG_ERR, "clear swap_vma failed\n");
-            ret = -1;
-            goto FREE_SWAP;
+        enc->frame.msg.status = MEMDCD_SEND_PROCESS;
+        memdcd_encoder_reset(enc);
+    }
+
+    if (failed == 0) {
+        if (enc->frame.msg.status != MEMDCD_SEND_START)
+            enc->frame.msg.status = MEMDCD_SEND_END;
+        memdcd_encoder_put_run(enc);
+        if (memdcd_send_frame(params, &enc->frame, &failed) != 0) {
+            goto broken;
         }
     }
 
-    if (msg->memory_msg.vma.status != MEMDCD_SEND_START)
-        msg->memory_msg.vma.status = MEMDCD_SEND_END;
-    swap_vma->length = count * sizeof(struct vma_addr_with_count);
-    if (send_data_to_memdcd(pid, msg, sock_path) != 0) {
-        ret = -1;
+    /* keep the connection clean for the next pid */
+    if (memdcd_wait_ack(params, 0, &failed) != 0) {
+        goto broken;
+    }
+    if (failed != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "memdcd fail to handle %u messages for pid %u\n", failed, pid);
+        return -1;
+    }
+    return 0;
+
+broken:
+    memdcd_disconnect(params);
+    return -1;
+}
+
+static void memdcd_cancel_migrate(void *arg)
+{
+    struct memdcd_params *params = (struct memdcd_params *)arg;
+
+    /* the frame may be sent partly, the connection can not be used any longer */
+    memdcd_disconnect(params);
+    pthread_mutex_unlock(&params->conn_lock);
+}
+
+static int memdcd_do_migrate(unsigned int pid, struct page_refs *page_refs_list, struct memdcd_params *params)
+{
+    struct memdcd_encoder *enc = NULL;
+    bool reused = false;
+    int ret;
+
+    if (page_refs_list == NULL) {
+        /* do nothing */
+        return 0;
+    }
+
+    enc = (struct memdcd_encoder *)malloc(sizeof(struct memdcd_encoder));
+    if (enc == NULL) {
+        etmemd_log(ETMEMD_LOG_WARN, "memigd_socket: malloc for swap vma failed. \n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&params->conn_lock);
+    pthread_cleanup_push(memdcd_cancel_migrate, params);
+    reused = params->sock_fd >= 0;
+    ret = memdcd_send_page_refs(pid, page_refs_list, params, enc);
+    /* memdcd may be restarted since the last scan, try once more with a new connection */
+    if (ret != 0 && reused && params->sock_fd < 0) {
+        etmemd_log(ETMEMD_LOG_INFO, "connection to memdcd is broken, reconnect for pid %u\n", pid);
+        ret = memdcd_send_page_refs(pid, page_refs_list, params, enc);
     }
+    pthread_cleanup_pop(0);
+    pthread_mutex_unlock(&params->conn_lock);
 
-FREE_SWAP:
-    free(msg);
+    free(enc);
     return ret;
 }
 
@@ -270,7 +712,7 @@ static struct page_refs *memdcd_do_scan(const struct task_pid *tpid, const struc
 
     /* loop for scanning idle_pages to get result of memory access. */
     for (i = 0; i < page_scan->loop; i++) {
-        ret = get_page_refs(vmas, pid, &page_refs, NULL, 0, i, page_scan->loop - 1);
+        ret = get_page_refs(vmas, pid, &page_refs, NULL, NULL, page_scan->source, i, page_scan->loop - 1);
         if (ret != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "scan operation failed\n");
             /* free page_refs nodes already exist */
@@ -297,7 +739,7 @@ static void *memdcd_executor(void *arg)
     pthread_cleanup_push(clean_page_refs_unexpected, &page_refs);
     page_refs = memdcd_do_scan(tk_pid, tk_pid->tk);
     if (page_refs != NULL) {
-        if (memdcd_do_migrate(tk_pid->pid, page_refs, memdcd_params->memdcd_socket) != 0) {
+        if (memdcd_do_migrate(tk_pid->pid, page_refs, memdcd_params) != 0) {
             etmemd_log(ETMEMD_LOG_WARN, "memdcd migrate for pid %u fail\n", tk_pid->pid);
         }
     }
@@ -334,8 +776,28 @@ static int fill_task_sock_path(void *obj, void *val)
     return 0;
 }
 
+static int fill_task_transport(void *obj, void *val)
+{
+    struct memdcd_params *params = (struct memdcd_params *)obj;
+    char *transport = (char *)val;
+    int ret = 0;
+
+    if (strcmp(transport, "ring") == 0) {
+        params->use_ring = true;
+    } else if (strcmp(transport, "socket") == 0) {
+        params->use_ring = false;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "transport %s is not supported, only socket or ring\n", transport);
+        ret = -1;
+    }
+
+    free(val);
+    return ret;
+}
+
 static struct config_item g_memdcd_task_config_items[] = {
     {"Sock", STR_VAL, fill_task_sock_path, false},
+    {"Transport", STR_VAL, fill_task_transport, true},
 };
 
 static int memdcd_fill_task(GKeyFile *config, struct task *tk)
@@ -347,6 +809,7 @@ static int memdcd_fill_task(GKeyFile *config, struct task *tk)
     }
 
     memset_s(params->memdcd_socket, MAX_SOCK_PATH_LENGTH, 0, MAX_SOCK_PATH_LENGTH);
+    params->sock_fd = -1;
 
     if (parse_file_config(config, TASK_GROUP, g_memdcd_task_config_items, ARRAY_SIZE(g_memdcd_task_config_items),
                           (void *)params) != 0) {
@@ -359,6 +822,11 @@ static int memdcd_fill_task(GKeyFile *config, struct task *tk)
         goto free_params;
     }
 
+    if (pthread_mutex_init(&params->conn_lock, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "init connection lock of memdcd fail\n");
+        goto free_params;
+    }
+
     tk->params = params;
     return 0;
 
@@ -369,6 +837,10 @@ free_params:
 
 static void memdcd_clear_task(struct task *tk)
 {
+    struct memdcd_params *params = tk->params;
+
+    memdcd_disconnect(params);
+    pthread_mutex_destroy(&params->conn_lock);
     free(tk->params);
     tk->params = NULL;
 }
@@ -402,6 +874,9 @@ static void memdcd_stop_task(struct engine *eng, struct task *tk)
     stop_and_delete_threadpool_work(tk);
     free(params->executor);
     params->executor = NULL;
+
+    /* executors are all stopped, nobody uses the connection any longer */
+    memdcd_disconnect(params);
 }
 
 struct engine_ops g_memdcd_eng_ops = {
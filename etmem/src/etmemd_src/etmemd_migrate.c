@@ -20,6 +20,9 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <errno.h>
+#include <numa.h>
+#include <numaif.h>
 
 #include "securec.h"
 #include "etmemd.h"
@@ -28,6 +31,7 @@
 #include "etmemd_common.h"
 #include "etmemd_slide.h"
 #include "etmemd_log.h"
+#include "etmemd_cgroup.h"
 
 #define RECLAIM_SWAPCACHE_MAGIC         0x77
 #define RECLAIM_SWAPCACHE_ON            _IOW(RECLAIM_SWAPCACHE_MAGIC, 0x1, unsigned int)
@@ -108,31 +112,23 @@ static int etmemd_migrate_mem(const char *pid, const char *grade_path, struct pa
     return 0;
 }
 
-static bool check_should_reclaim_swapcache(const struct task_pid *tk_pid)
+static bool check_should_reclaim_swapcache(struct task_pid *tk_pid)
 {
     struct project *proj = tk_pid->tk->eng->proj;
-    unsigned long mem_total;
-    unsigned long swapcache_total;
-    int ret;
+    struct mem_snapshot *snap = &tk_pid->mem_snap;
 
     if (proj->swapcache_high_wmark == -1 || proj->swapcache_low_wmark == -1) {
         return false;
     }
 
-    ret = get_mem_from_proc_file(NULL, PROC_MEMINFO, &mem_total, "MemTotal");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get memtotal fail\n");
+    if (etmemd_mem_snapshot_sys(snap) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get memtotal and swapcache_total fail\n");
         return false;
     }
 
-    ret = get_mem_from_proc_file(NULL, PROC_MEMINFO, &swapcache_total, "SwapCached");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get swapcache_total fail\n");
-        return false;
-    }
-
-    if (swapcache_total == 0 ||
-        (mem_total / swapcache_total) >= (unsigned long)(MAX_SWAPCACHE_WMARK_VALUE / proj->swapcache_high_wmark)) {
+    if (snap->swap_cached == 0 ||
+        (snap->mem_total / snap->swap_cached) >=
+        (unsigned long)(MAX_SWAPCACHE_WMARK_VALUE / proj->swapcache_high_wmark)) {
         return false;
     }
 
@@ -167,7 +163,7 @@ static int set_swapcache_wmark(const struct task_pid *tk_pid, const char *pid_st
     return 0;
 }
 
-int etmemd_reclaim_swapcache(const struct task_pid *tk_pid)
+int etmemd_reclaim_swapcache(struct task_pid *tk_pid)
 {
     char pid_str[PID_STR_MAX_LEN] = {0};
     FILE *fp = NULL;
@@ -229,35 +225,119 @@ int etmemd_grade_migrate(const char *pid, const struct memory_grade *memory_grad
     return ret;
 }
 
-unsigned long check_should_migrate(const struct task_pid *tk_pid)
+/* free memory of the numa node in KB */
+int etmemd_node_free_mem(int node, unsigned long *free_kb)
+{
+    long long free_bytes;
+
+    if (numa_node_size64(node, &free_bytes) < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get free memory of node %d fail\n", node);
+        return -1;
+    }
+
+    *free_kb = (unsigned long)free_bytes / 1024;
+    return 0;
+}
+
+/*
+ * query the node of the pages by batches, pages already on the node are moved from the list
+ * to on_node, return the count of them or -1 on fail.
+ */
+int etmemd_take_node_pages(unsigned int pid, struct page_refs **page_refs_list, int node,
+                           struct page_refs **on_node)
+{
+    struct page_refs **link = page_refs_list;
+    struct page_refs *batch[MOVE_PAGES_BATCH];
+    struct page_refs *page_refs = NULL;
+    void *pages[MOVE_PAGES_BATCH];
+    int status[MOVE_PAGES_BATCH];
+    int actual_num;
+    int taken = 0;
+    int i;
+
+    while (*link != NULL) {
+        actual_num = 0;
+        for (page_refs = *link; page_refs != NULL && actual_num < MOVE_PAGES_BATCH; page_refs = page_refs->next) {
+            batch[actual_num] = page_refs;
+            pages[actual_num] = (void *)page_refs->addr;
+            actual_num++;
+        }
+
+        /* the nodes are NULL, only the node of each page is returned in status */
+        if (move_pages((int)pid, actual_num, pages, NULL, status, 0) < 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "query node of pages of pid %u fail, errno %d\n", pid, errno);
+            return -1;
+        }
+
+        for (i = 0; i < actual_num; i++) {
+            if (status[i] == node) {
+                batch[i]->next = *on_node;
+                *on_node = batch[i];
+                taken++;
+            } else {
+                *link = batch[i];
+                link = &batch[i]->next;
+            }
+        }
+        *link = page_refs;
+    }
+
+    return taken;
+}
+
+/*
+ * move the pages to the node by batches, return the count of pages moved or -1 on fail.
+ * pages already on the node are counted too, see etmemd_take_node_pages to leave them out.
+ */
+int etmemd_migrate_node(unsigned int pid, struct page_refs *page_refs_list, int node)
+{
+    struct page_refs *page_refs = page_refs_list;
+    void *pages[MOVE_PAGES_BATCH];
+    int nodes[MOVE_PAGES_BATCH];
+    int status[MOVE_PAGES_BATCH];
+    int actual_num = 0;
+    int moved = 0;
+    int i;
+
+    while (page_refs != NULL) {
+        pages[actual_num] = (void *)page_refs->addr;
+        nodes[actual_num] = node;
+        actual_num++;
+        page_refs = page_refs->next;
+        if (actual_num < MOVE_PAGES_BATCH && page_refs != NULL) {
+            continue;
+        }
+
+        /* a positive return is the count of pages not moved, the status tells which */
+        if (move_pages((int)pid, actual_num, pages, nodes, status, MPOL_MF_MOVE_ALL) < 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "move pages of pid %u to node %d fail, errno %d\n", pid, node, errno);
+            return -1;
+        }
+
+        for (i = 0; i < actual_num; i++) {
+            if (status[i] == node) {
+                moved++;
+            }
+        }
+        actual_num = 0;
+    }
+
+    return moved;
+}
+
+unsigned long check_should_migrate(struct task_pid *tk_pid, const struct slide_params *slide_params)
 {
-    int ret = -1;
     unsigned long vm_rss;
     unsigned long vm_swap;
     unsigned long vm_cmp;
     unsigned long need_to_swap_page_num;
-    char pid_str[PID_STR_MAX_LEN] = {0};
     unsigned long pagesize;
-    struct slide_params *slide_params = NULL;
-
-    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", tk_pid->pid) <= 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", tk_pid->pid);
-        return 0;
-    }
-
-    ret = get_mem_from_proc_file(pid_str, STATUS_FILE, &vm_rss, VMRSS);
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get vmrss %s fail", pid_str);
-        return 0;
-    }
 
-    ret = get_mem_from_proc_file(pid_str, STATUS_FILE, &vm_swap, VMSWAP);
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get swapout %s fail", pid_str);
+    if (etmemd_task_pid_mem_usage(tk_pid, &vm_rss, &vm_swap) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get vmrss and swapout of %u fail", tk_pid->pid);
         return 0;
     }
 
-    slide_params = (struct slide_params *)tk_pid->tk->params;
     if (slide_params == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "slide params is null");
         return 0;
@@ -272,5 +352,10 @@ unsigned long check_should_migrate(const struct task_pid *tk_pid)
     pagesize = get_pagesize();
     need_to_swap_page_num = KB_TO_BYTE(vm_rss - vm_cmp) / pagesize;
 
+    /* the target is of the whole cgroup, the colder member takes the larger part */
+    if (tk_pid->tk->cgroup != NULL) {
+        need_to_swap_page_num = etmemd_cgroup_share(tk_pid, need_to_swap_page_num);
+    }
+
     return need_to_swap_page_num;
 }
@@ -19,6 +19,8 @@
 #include "etmemd_pool_adapter.h"
 #include "etmemd_engine.h"
 #include "etmemd_scan.h"
+#include "etmemd_proc_event.h"
+#include "etmemd_cgroup.h"
 
 static void push_ctrl_workflow(struct task_pid **tk_pid, void *(*exector)(void *))
 {
@@ -50,6 +52,10 @@ static void *launch_threadtimer_executor(void *arg)
     int scheduing_count;
 
     if (tk->eng->proj->start) {
+        /* a new interval starts, a refresh of the pids between intervals keeps the last one */
+        if (tk->cgroup != NULL) {
+            etmemd_cgroup_roll_cold(tk);
+        }
         if (etmemd_get_task_pids(tk, true) != 0) {
             return NULL;
         }
@@ -75,6 +81,19 @@ static void *launch_threadtimer_executor(void *arg)
     return NULL;
 }
 
+/* new pids join the task and exited ones leave it, they are scanned in the next interval */
+static void *refresh_threadtimer_pids(void *arg)
+{
+    struct task_executor *executor = (struct task_executor*)arg;
+    struct task *tk = executor->tk;
+
+    if (tk->eng->proj->start && etmemd_get_task_pids(tk, true) != 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "refresh pids of task %s fail\n", tk->value);
+    }
+
+    return NULL;
+}
+
 int start_threadpool_work(struct task_executor *executor)
 {
     struct task *tk = executor->tk;
@@ -99,6 +118,7 @@ int start_threadpool_work(struct task_executor *executor)
         return -1;
     }
 
+    thread_timer_set_refresher(tk->timer_inst, refresh_threadtimer_pids);
     if (thread_timer_start(tk->timer_inst, launch_threadtimer_executor, executor) != 0) {
         threadpool_stop_and_destroy(&tk->threadpool_inst);
         thread_timer_destroy(&tk->timer_inst);
@@ -107,6 +127,10 @@ int start_threadpool_work(struct task_executor *executor)
         return -1;
     }
 
+    /* the pids of the task of cgroup type are refreshed when the cgroup becomes populated or empty */
+    etmemd_cgroup_watch_add(tk);
+    /* the task of name type is refreshed when a process of the name starts */
+    etmemd_proc_watch_task(tk);
     return 0;
 }
 
@@ -123,6 +147,9 @@ void stop_and_delete_threadpool_work(struct task *tk)
 
     /* stop the threadtimer first */
     thread_timer_stop(tk->timer_inst);
+    /* the proc event listener must not kick the timer after it is destroyed */
+    etmemd_proc_watch_forget_task(tk);
+    etmemd_cgroup_watch_del(tk);
 
     /* destroy them then */
     thread_timer_destroy(&tk->timer_inst);
@@ -0,0 +1,392 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Walk /proc once and share the pid, comm and ppid of all processes among tasks.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_proc.h"
+
+#define PROC_DIR                    "/proc"
+#define PROC_STAT_BUF_LEN           512
+#define PROC_ENTRY_INIT_NUM         1024
+
+static struct proc_snapshot *g_proc_snap = NULL;
+static pthread_mutex_t g_proc_snap_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static bool is_pid_dir_name(const char *name)
+{
+    if (*name == '\0') {
+        return false;
+    }
+
+    for (; *name != '\0'; name++) {
+        if (*name < '0' || *name > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* parse "pid (comm) state ppid ...", comm may contain spaces and ')' so use the last ')' */
+static int parse_proc_stat(char *buf, struct proc_entry *entry)
+{
+    char *comm_start = NULL;
+    char *comm_end = NULL;
+    char *ppid_str = NULL;
+    char *end = NULL;
+    unsigned long ppid;
+    size_t comm_len;
+
+    comm_start = strchr(buf, '(');
+    comm_end = strrchr(buf, ')');
+    if (comm_start == NULL || comm_end == NULL || comm_end < comm_start) {
+        return -1;
+    }
+
+    comm_len = (size_t)(comm_end - comm_start - 1);
+    if (comm_len >= PROC_COMM_LEN) {
+        comm_len = PROC_COMM_LEN - 1;
+    }
+    if (comm_len > 0 && memcpy_s(entry->comm, PROC_COMM_LEN, comm_start + 1, comm_len) != EOK) {
+        return -1;
+    }
+    entry->comm[comm_len] = '\0';
+
+    /* skip ") " and the state field */
+    if (comm_end[1] != ' ' || comm_end[2] == '\0' || comm_end[3] != ' ') {
+        return -1;
+    }
+    ppid_str = comm_end + 4;
+
+    errno = 0;
+    ppid = strtoul(ppid_str, &end, 10);
+    if (errno != 0 || end == ppid_str || ppid > UINT_MAX) {
+        return -1;
+    }
+    entry->ppid = (unsigned int)ppid;
+    return 0;
+}
+
+static int read_proc_entry(int dir_fd, const char *name, struct proc_entry *entry)
+{
+    char path[PID_STR_MAX_LEN + sizeof("/stat")] = {0};
+    char buf[PROC_STAT_BUF_LEN];
+    unsigned int pid;
+    ssize_t len;
+    int fd;
+
+    if (get_unsigned_int_value(name, &pid) != 0) {
+        return -1;
+    }
+
+    if (snprintf_s(path, sizeof(path), sizeof(path) - 1, "%s/stat", name) == -1) {
+        return -1;
+    }
+
+    /* the process may exit while walking, it is not an error */
+    fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    len = etmemd_pread_file(fd, buf, sizeof(buf));
+    close(fd);
+    if (len <= 0) {
+        return -1;
+    }
+
+    entry->pid = pid;
+    return parse_proc_stat(buf, entry);
+}
+
+static int walk_proc_dir(struct proc_snapshot *snap)
+{
+    struct proc_entry *tmp = NULL;
+    struct dirent *dent = NULL;
+    size_t cap = PROC_ENTRY_INIT_NUM;
+    DIR *dir = NULL;
+
+    snap->entries = (struct proc_entry *)calloc(cap, sizeof(struct proc_entry));
+    if (snap->entries == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for proc entries fail\n");
+        return -1;
+    }
+
+    dir = opendir(PROC_DIR);
+    if (dir == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s fail, errno: %d\n", PROC_DIR, errno);
+        return -1;
+    }
+
+    while ((dent = readdir(dir)) != NULL) {
+        if (!is_pid_dir_name(dent->d_name)) {
+            continue;
+        }
+
+        if (snap->nr == cap) {
+            tmp = (struct proc_entry *)realloc(snap->entries, cap * 2 * sizeof(struct proc_entry));
+            if (tmp == NULL) {
+                etmemd_log(ETMEMD_LOG_ERR, "realloc for proc entries fail\n");
+                closedir(dir);
+                return -1;
+            }
+            snap->entries = tmp;
+            cap *= 2;
+        }
+
+        if (read_proc_entry(dirfd(dir), dent->d_name, &snap->entries[snap->nr]) == 0) {
+            snap->nr++;
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+static int entry_pid_cmp(const void *a, const void *b)
+{
+    const struct proc_entry *ea = (const struct proc_entry *)a;
+    const struct proc_entry *eb = (const struct proc_entry *)b;
+
+    if (ea->pid != eb->pid) {
+        return ea->pid < eb->pid ? -1 : 1;
+    }
+    return 0;
+}
+
+static int child_cmp(const void *a, const void *b)
+{
+    const struct proc_child *ca = (const struct proc_child *)a;
+    const struct proc_child *cb = (const struct proc_child *)b;
+
+    if (ca->ppid != cb->ppid) {
+        return ca->ppid < cb->ppid ? -1 : 1;
+    }
+    if (ca->pid != cb->pid) {
+        return ca->pid < cb->pid ? -1 : 1;
+    }
+    return 0;
+}
+
+static int entry_name_cmp(const void *a, const void *b)
+{
+    const struct proc_entry *ea = *(const struct proc_entry * const *)a;
+    const struct proc_entry *eb = *(const struct proc_entry * const *)b;
+    int ret;
+
+    ret = strcmp(ea->comm, eb->comm);
+    if (ret != 0) {
+        return ret;
+    }
+    return entry_pid_cmp(ea, eb);
+}
+
+static int build_proc_index(struct proc_snapshot *snap)
+{
+    size_t i;
+
+    /* readdir of /proc is in pid order in practice, but it is not promised */
+    qsort(snap->entries, snap->nr, sizeof(struct proc_entry), entry_pid_cmp);
+
+    if (snap->nr == 0) {
+        return 0;
+    }
+
+    snap->children = (struct proc_child *)calloc(snap->nr, sizeof(struct proc_child));
+    snap->by_name = (struct proc_entry **)calloc(snap->nr, sizeof(struct proc_entry *));
+    if (snap->children == NULL || snap->by_name == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for proc index fail\n");
+        return -1;
+    }
+
+    for (i = 0; i < snap->nr; i++) {
+        snap->children[i].ppid = snap->entries[i].ppid;
+        snap->children[i].pid = snap->entries[i].pid;
+        snap->by_name[i] = &snap->entries[i];
+    }
+
+    qsort(snap->children, snap->nr, sizeof(struct proc_child), child_cmp);
+    qsort(snap->by_name, snap->nr, sizeof(struct proc_entry *), entry_name_cmp);
+    return 0;
+}
+
+static void free_proc_snapshot(struct proc_snapshot *snap)
+{
+    etmemd_safe_free((void **)&snap->entries);
+    etmemd_safe_free((void **)&snap->children);
+    etmemd_safe_free((void **)&snap->by_name);
+    free(snap);
+}
+
+static struct proc_snapshot *build_proc_snapshot(void)
+{
+    struct proc_snapshot *snap = NULL;
+
+    snap = (struct proc_snapshot *)calloc(1, sizeof(struct proc_snapshot));
+    if (snap == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for proc snapshot fail\n");
+        return NULL;
+    }
+
+    if (walk_proc_dir(snap) != 0 || build_proc_index(snap) != 0) {
+        free_proc_snapshot(snap);
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &snap->time);
+    return snap;
+}
+
+static bool proc_snapshot_expired(const struct proc_snapshot *snap)
+{
+    struct timespec now;
+    long long elapsed_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (long long)(now.tv_sec - snap->time.tv_sec) * MSEC_PER_SEC +
+                 (now.tv_nsec - snap->time.tv_nsec) / NSEC_PER_MSEC;
+    return elapsed_ms >= PROC_SNAPSHOT_TTL_MS;
+}
+
+/* drop the global reference, the snapshot is freed when the last user puts it */
+static void release_global_snapshot(void)
+{
+    if (g_proc_snap == NULL) {
+        return;
+    }
+
+    g_proc_snap->refs--;
+    if (g_proc_snap->refs == 0) {
+        free_proc_snapshot(g_proc_snap);
+    }
+    g_proc_snap = NULL;
+}
+
+/*
+ * tasks triggered in the same tick share one walk of /proc, the walk is done under the lock
+ * so that concurrent timers do not walk /proc again.
+ */
+struct proc_snapshot *etmemd_proc_snapshot_get(void)
+{
+    struct proc_snapshot *snap = NULL;
+
+    pthread_mutex_lock(&g_proc_snap_mtx);
+    if (g_proc_snap == NULL || proc_snapshot_expired(g_proc_snap)) {
+        release_global_snapshot();
+        g_proc_snap = build_proc_snapshot();
+        if (g_proc_snap == NULL) {
+            pthread_mutex_unlock(&g_proc_snap_mtx);
+            return NULL;
+        }
+        g_proc_snap->refs = 1;
+    }
+
+    snap = g_proc_snap;
+    snap->refs++;
+    pthread_mutex_unlock(&g_proc_snap_mtx);
+    return snap;
+}
+
+void etmemd_proc_snapshot_put(struct proc_snapshot *snap)
+{
+    if (snap == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_proc_snap_mtx);
+    snap->refs--;
+    if (snap->refs == 0) {
+        free_proc_snapshot(snap);
+    }
+    pthread_mutex_unlock(&g_proc_snap_mtx);
+}
+
+/* force the next user to walk /proc again */
+void etmemd_proc_snapshot_invalidate(void)
+{
+    pthread_mutex_lock(&g_proc_snap_mtx);
+    release_global_snapshot();
+    pthread_mutex_unlock(&g_proc_snap_mtx);
+}
+
+/* the lowest pid whose comm equals name, the same as the first line of pgrep -x */
+int etmemd_proc_snapshot_find_name(const struct proc_snapshot *snap, const char *name, unsigned int *pid)
+{
+    size_t left = 0;
+    size_t right;
+    size_t mid;
+
+    if (snap == NULL || name == NULL || pid == NULL) {
+        return -1;
+    }
+
+    right = snap->nr;
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (strcmp(snap->by_name[mid]->comm, name) < 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    if (left == snap->nr || strcmp(snap->by_name[left]->comm, name) != 0) {
+        return -1;
+    }
+
+    *pid = snap->by_name[left]->pid;
+    return 0;
+}
+
+/* children of ppid in pid order, the same as pgrep -P */
+size_t etmemd_proc_snapshot_children(const struct proc_snapshot *snap, unsigned int ppid,
+                                     const struct proc_child **children)
+{
+    size_t left = 0;
+    size_t right;
+    size_t mid;
+    size_t end;
+
+    if (snap == NULL || children == NULL) {
+        return 0;
+    }
+
+    right = snap->nr;
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (snap->children[mid].ppid < ppid) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    end = left;
+    while (end < snap->nr && snap->children[end].ppid == ppid) {
+        end++;
+    }
+
+    *children = snap->children + left;
+    return end - left;
+}
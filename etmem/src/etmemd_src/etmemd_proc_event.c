@@ -0,0 +1,498 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Listen to fork, exec and exit of processes through the netlink proc connector.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_proc.h"
+#include "etmemd_proc_event.h"
+
+#define PROC_EVENT_RECV_LEN         4096
+
+static struct task_pid *g_watch_table[PROC_WATCH_HASH_SIZE];
+static struct task *g_kick_tasks[PROC_EVENT_KICK_MAX];
+static int g_kick_num = 0;
+static struct task *g_name_tasks[PROC_EVENT_KICK_MAX];     /* tasks finding their pid by name */
+static int g_name_num = 0;
+static pthread_mutex_t g_watch_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t g_event_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_event_thread;
+static int g_event_fd = -1;
+static int g_event_refs = 0;
+static bool g_event_stop = false;
+
+static unsigned int watch_hash(unsigned int pid)
+{
+    return pid % PROC_WATCH_HASH_SIZE;
+}
+
+void etmemd_proc_watch_add(struct task_pid *tk_pid)
+{
+    unsigned int idx = watch_hash(tk_pid->pid);
+
+    pthread_mutex_lock(&g_watch_mtx);
+    tk_pid->watch_next = g_watch_table[idx];
+    g_watch_table[idx] = tk_pid;
+    tk_pid->watched = true;
+    pthread_mutex_unlock(&g_watch_mtx);
+}
+
+static void watch_unlink(struct task_pid **link)
+{
+    struct task_pid *tk_pid = *link;
+
+    *link = tk_pid->watch_next;
+    tk_pid->watch_next = NULL;
+    tk_pid->watched = false;
+}
+
+void etmemd_proc_watch_del(struct task_pid *tk_pid)
+{
+    struct task_pid **link = NULL;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    if (!tk_pid->watched) {
+        pthread_mutex_unlock(&g_watch_mtx);
+        return;
+    }
+
+    for (link = &g_watch_table[watch_hash(tk_pid->pid)]; *link != NULL; link = &(*link)->watch_next) {
+        if (*link == tk_pid) {
+            watch_unlink(link);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_watch_mtx);
+}
+
+void etmemd_proc_watch_task(struct task *tk)
+{
+    if (tk->type == NULL || strcmp(tk->type, "name") != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_watch_mtx);
+    if (g_name_num < PROC_EVENT_KICK_MAX) {
+        g_name_tasks[g_name_num++] = tk;
+    } else {
+        etmemd_log(ETMEMD_LOG_DEBUG, "too many name tasks, %s is found in its interval only\n", tk->value);
+    }
+    pthread_mutex_unlock(&g_watch_mtx);
+}
+
+static int remove_task(struct task **tasks, int num, const struct task *tk)
+{
+    int i;
+    int j = 0;
+
+    for (i = 0; i < num; i++) {
+        if (tasks[i] != tk) {
+            tasks[j++] = tasks[i];
+        }
+    }
+
+    return j;
+}
+
+/* called after the timer of task is stopped, the listener must not refresh it any more */
+void etmemd_proc_watch_forget_task(const struct task *tk)
+{
+    struct task_pid **link = NULL;
+    int i;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    for (i = 0; i < PROC_WATCH_HASH_SIZE; i++) {
+        link = &g_watch_table[i];
+        while (*link != NULL) {
+            if ((*link)->tk == tk) {
+                watch_unlink(link);
+            } else {
+                link = &(*link)->watch_next;
+            }
+        }
+    }
+
+    g_kick_num = remove_task(g_kick_tasks, g_kick_num, tk);
+    g_name_num = remove_task(g_name_tasks, g_name_num, tk);
+    pthread_mutex_unlock(&g_watch_mtx);
+}
+
+/* must be called with g_watch_mtx held */
+static void add_kick_task(struct task *tk)
+{
+    int i;
+
+    if (tk->timer_inst == NULL) {
+        return;
+    }
+
+    for (i = 0; i < g_kick_num; i++) {
+        if (g_kick_tasks[i] == tk) {
+            return;
+        }
+    }
+
+    if (g_kick_num < PROC_EVENT_KICK_MAX) {
+        g_kick_tasks[g_kick_num++] = tk;
+    }
+}
+
+/*
+ * the events of the whole system come here, the shared /proc snapshot is only dropped
+ * if the event changes the pids of some task.
+ */
+static bool handle_fork_event(unsigned int parent, unsigned int child)
+{
+    struct task_pid *tk_pid = NULL;
+    bool changed = false;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    for (tk_pid = g_watch_table[watch_hash(parent)]; tk_pid != NULL; tk_pid = tk_pid->watch_next) {
+        /* only children of the task pid are managed, see etmemd_get_task_pids */
+        if (tk_pid->pid == parent && tk_pid->root) {
+            add_kick_task(tk_pid->tk);
+            changed = true;
+        }
+    }
+
+    /* the pid is reused, the watcher of the old process is out of date */
+    for (tk_pid = g_watch_table[watch_hash(child)]; tk_pid != NULL; tk_pid = tk_pid->watch_next) {
+        if (tk_pid->pid == child) {
+            __atomic_store_n(&tk_pid->exited, true, __ATOMIC_RELEASE);
+            changed = true;
+        }
+    }
+    pthread_mutex_unlock(&g_watch_mtx);
+
+    return changed;
+}
+
+static bool handle_exit_event(unsigned int pid)
+{
+    struct task_pid *tk_pid = NULL;
+    bool changed = false;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    for (tk_pid = g_watch_table[watch_hash(pid)]; tk_pid != NULL; tk_pid = tk_pid->watch_next) {
+        if (tk_pid->pid == pid) {
+            __atomic_store_n(&tk_pid->exited, true, __ATOMIC_RELEASE);
+            changed = true;
+        }
+    }
+    pthread_mutex_unlock(&g_watch_mtx);
+
+    return changed;
+}
+
+static int read_proc_comm(unsigned int pid, char *comm, size_t len)
+{
+    char path[sizeof(PROC_PATH) + PID_STR_MAX_LEN + sizeof("/comm")] = {0};
+    char *newline = NULL;
+    ssize_t ret;
+    int fd;
+
+    if (snprintf_s(path, sizeof(path), sizeof(path) - 1, PROC_PATH "%u/comm", pid) == -1) {
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ret = etmemd_pread_file(fd, comm, len);
+    close(fd);
+    if (ret <= 0) {
+        return -1;
+    }
+
+    newline = strchr(comm, '\n');
+    if (newline != NULL) {
+        *newline = '\0';
+    }
+    return 0;
+}
+
+/* name of the process is changed, it matters if it is watched or gets the name of a task */
+static bool handle_comm_event(unsigned int pid)
+{
+    char comm[PROC_COMM_LEN + 1] = {0};
+    struct task_pid *tk_pid = NULL;
+    bool changed = false;
+    bool has_comm = false;
+    int i;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    for (tk_pid = g_watch_table[watch_hash(pid)]; tk_pid != NULL; tk_pid = tk_pid->watch_next) {
+        if (tk_pid->pid == pid && tk_pid->root) {
+            add_kick_task(tk_pid->tk);
+            changed = true;
+        }
+    }
+
+    for (i = 0; i < g_name_num; i++) {
+        /* read the name once, only if some task finds its pid by name */
+        if (!has_comm) {
+            if (read_proc_comm(pid, comm, sizeof(comm)) != 0) {
+                break;
+            }
+            has_comm = true;
+        }
+        if (strcmp(g_name_tasks[i]->value, comm) == 0) {
+            add_kick_task(g_name_tasks[i]);
+            changed = true;
+        }
+    }
+    pthread_mutex_unlock(&g_watch_mtx);
+
+    return changed;
+}
+
+static void handle_proc_event(const struct proc_event *ev)
+{
+    bool changed = false;
+
+    switch (ev->what) {
+        case PROC_EVENT_FORK:
+            /* threads are not interesting */
+            if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) {
+                return;
+            }
+            changed = handle_fork_event((unsigned int)ev->event_data.fork.parent_tgid,
+                                        (unsigned int)ev->event_data.fork.child_tgid);
+            break;
+        case PROC_EVENT_EXEC:
+            changed = handle_comm_event((unsigned int)ev->event_data.exec.process_tgid);
+            break;
+        case PROC_EVENT_COMM:
+            /* only the name of the main thread is the name of the process */
+            if (ev->event_data.comm.process_pid != ev->event_data.comm.process_tgid) {
+                return;
+            }
+            changed = handle_comm_event((unsigned int)ev->event_data.comm.process_tgid);
+            break;
+        case PROC_EVENT_EXIT:
+            if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) {
+                return;
+            }
+            changed = handle_exit_event((unsigned int)ev->event_data.exit.process_tgid);
+            break;
+        default:
+            break;
+    }
+
+    if (changed) {
+        etmemd_proc_snapshot_invalidate();
+    }
+}
+
+static void handle_proc_msg(const char *buf, size_t len)
+{
+    const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+    const struct cn_msg *cn = NULL;
+    struct proc_event ev;
+
+    for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+        if (nlh->nlmsg_type == NLMSG_NOOP || nlh->nlmsg_type == NLMSG_ERROR) {
+            continue;
+        }
+
+        cn = (const struct cn_msg *)NLMSG_DATA(nlh);
+        if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC ||
+            cn->len < sizeof(struct proc_event)) {
+            continue;
+        }
+        /* data of cn_msg is only 4 bytes aligned, copy it out before reading the 8 bytes timestamp */
+        if (memcpy_s(&ev, sizeof(ev), cn->data, sizeof(ev)) != EOK) {
+            continue;
+        }
+        handle_proc_event(&ev);
+    }
+}
+
+static long long elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+    return (long long)(to->tv_sec - from->tv_sec) * MSEC_PER_SEC + (to->tv_nsec - from->tv_nsec) / NSEC_PER_MSEC;
+}
+
+/*
+ * kicks are merged, so a storm of forks does not walk /proc continuously,
+ * a kick only refreshes the pids of the task, they are scanned in its interval.
+ */
+static void flush_kick_tasks(struct timespec *last_flush)
+{
+    struct timespec now;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (elapsed_ms(last_flush, &now) < PROC_EVENT_KICK_MS) {
+        return;
+    }
+    *last_flush = now;
+
+    pthread_mutex_lock(&g_watch_mtx);
+    for (i = 0; i < g_kick_num; i++) {
+        thread_timer_refresh(g_kick_tasks[i]->timer_inst);
+    }
+    g_kick_num = 0;
+    pthread_mutex_unlock(&g_watch_mtx);
+}
+
+static void *proc_event_routine(void *arg)
+{
+    char buf[PROC_EVENT_RECV_LEN] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct pollfd pfd = { .fd = g_event_fd, .events = POLLIN };
+    struct timespec last_flush = {0};
+    ssize_t len;
+    int ret;
+
+    while (!__atomic_load_n(&g_event_stop, __ATOMIC_ACQUIRE)) {
+        ret = poll(&pfd, 1, PROC_EVENT_POLL_MS);
+        if (ret > 0 && (pfd.revents & POLLIN) != 0) {
+            len = recv(g_event_fd, buf, sizeof(buf), 0);
+            if (len > 0) {
+                handle_proc_msg(buf, (size_t)len);
+            } else if (len < 0 && errno == ENOBUFS) {
+                /* events are lost, the next discovery must walk /proc again */
+                etmemd_log(ETMEMD_LOG_DEBUG, "proc connector overrun, events are lost\n");
+                etmemd_proc_snapshot_invalidate();
+            }
+        }
+        flush_kick_tasks(&last_flush);
+    }
+
+    return NULL;
+}
+
+static int send_mcast_op(int fd, enum proc_cn_mcast_op op)
+{
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    struct cn_msg *cn = NULL;
+
+    if (memset_s(buf, sizeof(buf), 0, sizeof(buf)) != EOK) {
+        return -1;
+    }
+
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    nlh->nlmsg_pid = (__u32)getpid();
+
+    cn = (struct cn_msg *)NLMSG_DATA(nlh);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(enum proc_cn_mcast_op);
+    if (memcpy_s(cn->data, sizeof(enum proc_cn_mcast_op), &op, sizeof(op)) != EOK) {
+        return -1;
+    }
+
+    if (send(fd, nlh, nlh->nlmsg_len, 0) < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "send to proc connector fail, errno: %d\n", errno);
+        return -1;
+    }
+    return 0;
+}
+
+static int open_proc_connector(void)
+{
+    struct sockaddr_nl addr = {0};
+    int fd;
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "open netlink connector fail, errno: %d\n", errno);
+        return -1;
+    }
+
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "bind netlink connector fail, errno: %d\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    /* need CAP_NET_ADMIN, pidfds still work without the listener */
+    if (send_mcast_op(fd, PROC_CN_MCAST_LISTEN) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int etmemd_proc_event_start(void)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&g_event_mtx);
+    if (g_event_refs > 0) {
+        g_event_refs++;
+        goto out;
+    }
+
+    g_event_fd = open_proc_connector();
+    if (g_event_fd < 0) {
+        ret = -1;
+        goto out;
+    }
+
+    __atomic_store_n(&g_event_stop, false, __ATOMIC_RELEASE);
+    if (pthread_create(&g_event_thread, NULL, proc_event_routine, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "create proc event thread fail\n");
+        (void)send_mcast_op(g_event_fd, PROC_CN_MCAST_IGNORE);
+        close(g_event_fd);
+        g_event_fd = -1;
+        ret = -1;
+        goto out;
+    }
+    g_event_refs = 1;
+    etmemd_log(ETMEMD_LOG_DEBUG, "proc event listener starts\n");
+
+out:
+    pthread_mutex_unlock(&g_event_mtx);
+    return ret;
+}
+
+void etmemd_proc_event_stop(void)
+{
+    pthread_mutex_lock(&g_event_mtx);
+    if (g_event_refs == 0 || --g_event_refs > 0) {
+        pthread_mutex_unlock(&g_event_mtx);
+        return;
+    }
+
+    __atomic_store_n(&g_event_stop, true, __ATOMIC_RELEASE);
+    pthread_join(g_event_thread, NULL);
+    (void)send_mcast_op(g_event_fd, PROC_CN_MCAST_IGNORE);
+    close(g_event_fd);
+    g_event_fd = -1;
+    pthread_mutex_unlock(&g_event_mtx);
+    etmemd_log(ETMEMD_LOG_DEBUG, "proc event listener stops\n");
+}
@@ -26,6 +26,8 @@
 #include "etmemd_project.h"
 #include "etmemd_engine.h"
 #include "etmemd_damon.h"
+#include "etmemd_proc_event.h"
+#include "etmemd_rank.h"
 #include "etmemd_common.h"
 #include "etmemd_file.h"
 #include "etmemd_log.h"
@@ -497,10 +499,32 @@ static int fill_page_scan_sleep(void *obj, void *val)
     return 0;
 }
 
+static int fill_page_scan_source(void *obj, void *val)
+{
+    struct page_scan *scan = (struct page_scan *)obj;
+    char *source = (char *)val;
+    int ret = 0;
+
+    if (strcmp(source, "idle_pages") == 0) {
+        scan->source = SCAN_SRC_IDLE_PAGES;
+    } else if (strcmp(source, "damon") == 0) {
+        scan->source = SCAN_SRC_DAMON;
+    } else if (strcmp(source, "page_idle") == 0) {
+        scan->source = SCAN_SRC_PAGE_IDLE;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "invalid scan source %s, must be idle_pages, damon or page_idle\n", source);
+        ret = -1;
+    }
+
+    free(source);
+    return ret;
+}
+
 struct config_item g_page_scan_config_items[] = {
     {"loop", INT_VAL, fill_page_scan_loop, false},
     {"interval", INT_VAL, fill_page_scan_interval, false},
     {"sleep", INT_VAL, fill_page_scan_sleep, false},
+    {"scan_source", STR_VAL, fill_page_scan_source, true},
 };
 
 static int fill_region_scan_samp_interval(void *obj, void *val)
@@ -560,12 +584,34 @@ static int fill_region_scan_max_nr(void *obj, void *val)
     return 0;
 }
 
+/* the damon of the kernel is preferred, the source is read by the userspace sampler without it */
+static int fill_region_scan_source(void *obj, void *val)
+{
+    struct region_scan *scan = (struct region_scan *)obj;
+    char *source = (char *)val;
+    int ret = 0;
+
+    if (strcmp(source, "idle_pages") == 0) {
+        scan->source = SCAN_SRC_IDLE_PAGES;
+    } else if (strcmp(source, "page_idle") == 0) {
+        scan->source = SCAN_SRC_PAGE_IDLE;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "invalid scan source %s of region scan, must be idle_pages or page_idle\n",
+                   source);
+        ret = -1;
+    }
+
+    free(source);
+    return ret;
+}
+
 struct config_item g_region_scan_config_items[] = {
     {"sample_interval", INT_VAL, fill_region_scan_samp_interval, false},
     {"aggr_interval", INT_VAL, fill_region_scan_aggr_interval, false},
     {"update_interval", INT_VAL, fill_region_scan_updt_interval, false},
     {"min_nr_regions", INT_VAL, fill_region_scan_min_nr, false},
     {"max_nr_regions", INT_VAL, fill_region_scan_max_nr, false},
+    {"scan_source", STR_VAL, fill_region_scan_source, true},
 };
 
 int scan_fill_by_conf(GKeyFile *config, struct project *proj)
@@ -682,6 +728,40 @@ static int fill_project_swapcache_high_wmark(void *obj, void *val)
     return 0;
 }
 
+/* fill the project parameter: proc_event
+ * proc_event: 0 or 1. listen to fork and exit of processes through the netlink proc connector */
+static int fill_project_proc_event(void *obj, void *val)
+{
+    struct project *proj = (struct project *)obj;
+    int proc_event = parse_to_int(val);
+
+    if (proc_event != 0 && proc_event != 1) {
+        etmemd_log(ETMEMD_LOG_ERR, "invaild project proc_event value %d, it must be 0 or 1.\n", proc_event);
+        return -1;
+    }
+
+    proj->proc_event = proc_event == 1;
+    return 0;
+}
+
+/* fill the project parameter: global_dram_percent
+ * global_dram_percent: (0, 100]. rank the pages of all pids of the project together, and keep
+ * this percent of the memory of the whole project in dram */
+static int fill_project_global_dram_percent(void *obj, void *val)
+{
+    struct project *proj = (struct project *)obj;
+    int global_dram_percent = parse_to_int(val);
+
+    if (global_dram_percent <= 0 || global_dram_percent > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "invaild project global_dram_percent value %d, it must be between 1 and 100.\n",
+                   global_dram_percent);
+        return -1;
+    }
+
+    proj->global_dram_percent = global_dram_percent;
+    return 0;
+}
+
 static bool check_swapcache_wmark_valid(struct project *proj)
 {
     if (proj->swapcache_high_wmark == -1 && proj->swapcache_low_wmark == -1) {
@@ -703,6 +783,8 @@ static struct config_item g_project_config_items[] = {
     {"sysmem_threshold", INT_VAL, fill_project_sysmem_threshold, true},
     {"swapcache_high_wmark", INT_VAL, fill_project_swapcache_high_wmark, true},
     {"swapcache_low_wmark", INT_VAL, fill_project_swapcache_low_wmark, true},
+    {"proc_event", INT_VAL, fill_project_proc_event, true},
+    {"global_dram_percent", INT_VAL, fill_project_global_dram_percent, true},
 };
 
 static void clear_project(struct project *proj)
@@ -716,6 +798,8 @@ static void clear_project(struct project *proj)
         free(proj->scan_param);
         proj->scan_param = NULL;
     }
+
+    etmemd_rank_free(proj);
 }
 
 static int project_fill_by_conf(GKeyFile *config, struct project *proj)
@@ -732,15 +816,32 @@ static int project_fill_by_conf(GKeyFile *config, struct project *proj)
         clear_project(proj);
         return -1;
     }
+
+    if (proj->global_dram_percent > 0 && etmemd_rank_init(proj) != 0) {
+        clear_project(proj);
+        return -1;
+    }
     return 0;
 }
 
+static void stop_proc_event(struct project *proj)
+{
+    if (proj->proc_event_started) {
+        etmemd_proc_event_stop();
+        proj->proc_event_started = false;
+    }
+}
+
 static void do_remove_project(struct project *proj)
 {
     SLIST_REMOVE(&g_projects, proj, project, entry);
     while (proj->engs != NULL) {
         do_remove_engine(proj, proj->engs);
     }
+    stop_proc_event(proj);
+    if (proj->type == PAGE_SCAN) {
+        etmemd_damon_monitor_stop(proj);
+    }
     clear_project(proj);
     free(proj);
 }
@@ -894,6 +995,11 @@ enum opt_result etmemd_migrate_start(const char *project_name)
 
     switch (proj->type) {
         case PAGE_SCAN:
+            if (((struct page_scan *)proj->scan_param)->source == SCAN_SRC_DAMON &&
+                etmemd_damon_monitor_start(proj) != 0) {
+                etmemd_log(ETMEMD_LOG_WARN, "start damon monitor of project %s fail, scan idle_pages instead\n",
+                           project_name);
+            }
             if (start_tasks(proj) != 0) {
                 etmemd_log(ETMEMD_LOG_ERR, "some task of project %s start fail\n", project_name);
                 return OPT_INTER_ERR;
@@ -910,6 +1016,15 @@ enum opt_result etmemd_migrate_start(const char *project_name)
             return OPT_INVAL;
     }
 
+    /* pids are still checked by pidfds if the listener fails to start */
+    if (proj->proc_event) {
+        if (etmemd_proc_event_start() == 0) {
+            proj->proc_event_started = true;
+        } else {
+            etmemd_log(ETMEMD_LOG_WARN, "start proc event listener of project %s fail\n", project_name);
+        }
+    }
+
     proj->start = true;
     return OPT_SUCCESS;
 }
@@ -938,9 +1053,10 @@ enum opt_result etmemd_migrate_stop(const char *project_name)
     switch (proj->type) {
         case PAGE_SCAN:
             stop_tasks(proj);
+            etmemd_damon_monitor_stop(proj);
             break;
         case REGION_SCAN:
-            if (etmemd_stop_damon() != 0) {
+            if (etmemd_stop_damon(proj) != 0) {
                 etmemd_log(ETMEMD_LOG_ERR, "stop damon of project %s fail\n", project_name);
                 return OPT_INTER_ERR;
             }
@@ -950,6 +1066,7 @@ enum opt_result etmemd_migrate_stop(const char *project_name)
             return OPT_INVAL;
     }
 
+    stop_proc_event(proj);
     proj->start = false;
     return OPT_SUCCESS;
 }
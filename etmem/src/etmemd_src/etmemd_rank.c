@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Rank the pages of all pids in a project to meet a project wide dram target.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_engine.h"
+#include "etmemd_rank.h"
+
+int etmemd_rank_init(struct project *proj)
+{
+    struct project_rank *rank = NULL;
+
+    rank = (struct project_rank *)calloc(1, sizeof(struct project_rank));
+    if (rank == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for project rank fail\n");
+        return -1;
+    }
+
+    if (pthread_mutex_init(&rank->lock, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "init lock of project rank fail\n");
+        free(rank);
+        return -1;
+    }
+
+    proj->rank = rank;
+    return 0;
+}
+
+void etmemd_rank_free(struct project *proj)
+{
+    if (proj->rank == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&proj->rank->lock);
+    free(proj->rank);
+    proj->rank = NULL;
+}
+
+int etmemd_rank_bin(double possibility)
+{
+    int bin = (int)(possibility * (RANK_BIN_NUM - 1));
+
+    if (bin < 0) {
+        return 0;
+    }
+    if (bin >= RANK_BIN_NUM) {
+        return RANK_BIN_NUM - 1;
+    }
+    return bin;
+}
+
+/* must be called with rank->lock held */
+static void rank_sub_pid(struct project_rank *rank, const struct rank_pid *rp)
+{
+    int i;
+
+    for (i = 0; i < RANK_BIN_NUM; i++) {
+        rank->hist[i] -= rp->hist[i];
+    }
+    rank->rss -= rp->rss;
+    rank->swap -= rp->swap;
+}
+
+/* replace the last histogram of the pid in the project by the new one */
+int etmemd_rank_publish(struct task_pid *tk_pid, const unsigned long *hist, unsigned long rss, unsigned long swap)
+{
+    struct project_rank *rank = tk_pid->tk->eng->proj->rank;
+    struct rank_pid *rp = tk_pid->rank;
+    int i;
+
+    if (rank == NULL) {
+        return -1;
+    }
+
+    if (rp == NULL) {
+        rp = (struct rank_pid *)calloc(1, sizeof(struct rank_pid));
+        if (rp == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "malloc for rank of pid %u fail\n", tk_pid->pid);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&rank->lock);
+    if (tk_pid->rank != NULL) {
+        rank_sub_pid(rank, rp);
+    }
+
+    for (i = 0; i < RANK_BIN_NUM; i++) {
+        rp->hist[i] = hist[i];
+        rank->hist[i] += hist[i];
+    }
+    rp->rss = rss;
+    rp->swap = swap;
+    rank->rss += rss;
+    rank->swap += swap;
+    tk_pid->rank = rp;
+    pthread_mutex_unlock(&rank->lock);
+
+    return 0;
+}
+
+void etmemd_rank_pid_release(struct task_pid *tk_pid)
+{
+    struct project_rank *rank = NULL;
+
+    if (tk_pid->rank == NULL) {
+        return;
+    }
+
+    rank = tk_pid->tk->eng->proj->rank;
+    if (rank != NULL) {
+        pthread_mutex_lock(&rank->lock);
+        rank_sub_pid(rank, tk_pid->rank);
+        pthread_mutex_unlock(&rank->lock);
+    }
+
+    free(tk_pid->rank);
+    tk_pid->rank = NULL;
+}
+
+/*
+ * walk the histogram of the project from the coldest bin, until the pages reach the amount
+ * over the project dram target. pids which have not been scanned yet are not counted.
+ */
+void etmemd_rank_cutoff(struct project *proj, struct rank_cutoff *cutoff)
+{
+    struct project_rank *rank = proj->rank;
+    unsigned long target;
+    unsigned long need;
+    unsigned long sum = 0;
+    int i;
+
+    cutoff->bin = 0;
+    cutoff->fraction = 0;
+
+    pthread_mutex_lock(&rank->lock);
+    target = (rank->rss + rank->swap) / 100 * (unsigned long)proj->global_dram_percent;
+    if (rank->rss <= target) {
+        pthread_mutex_unlock(&rank->lock);
+        return;
+    }
+
+    need = rank->rss - target;
+    for (i = 0; i < RANK_BIN_NUM; i++) {
+        if (sum + rank->hist[i] >= need) {
+            cutoff->bin = i;
+            cutoff->fraction = rank->hist[i] == 0 ? 0 : (double)(need - sum) / rank->hist[i];
+            pthread_mutex_unlock(&rank->lock);
+            return;
+        }
+        sum += rank->hist[i];
+    }
+    pthread_mutex_unlock(&rank->lock);
+
+    /* all pages scanned are not enough */
+    cutoff->bin = RANK_BIN_NUM;
+    cutoff->fraction = 0;
+}
@@ -0,0 +1,644 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Adaptive region based access monitoring in userspace, for kernels without damon.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_common.h"
+#include "etmemd_scan.h"
+#include "etmemd_scan_backend.h"
+#include "etmemd_region_sampler.h"
+
+struct sampler_region {
+    uint64_t start;
+    uint64_t end;
+    uint64_t sampling_addr;         // the page checked in this sample
+    unsigned int nr_accesses;
+    unsigned int last_nr_accesses;  // of the last aggregation, to age the region
+    unsigned int age;
+};
+
+struct sampler_target {
+    unsigned int pid;
+    struct scan_backend backend;    // closed after the pid exits
+    struct sampler_region *region;  // sorted by address, contiguous within a vma
+    int num;
+};
+
+struct region_sampler {
+    struct region_scan attrs;
+    struct sampler_target *target;
+    int nr_targets;
+    unsigned int max_nr_accesses;
+    unsigned int seed;
+    region_aggr_fn aggr_fn;
+    void *arg;
+    pthread_t worker;
+    bool stop;
+};
+
+static uint64_t sampler_page_size(void)
+{
+    return (uint64_t)page_type_to_size(PTE_TYPE);
+}
+
+static uint64_t sampler_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * USEC_PER_SEC + (uint64_t)now.tv_nsec / NSEC_PER_USEC;
+}
+
+/* a random value in [low, high) */
+static uint64_t sampler_rand(struct region_sampler *sampler, uint64_t low, uint64_t high)
+{
+    uint64_t rand_val = ((uint64_t)rand_r(&sampler->seed) << 32) | (uint64_t)rand_r(&sampler->seed);
+
+    return high > low ? low + rand_val % (high - low) : low;
+}
+
+static int sampler_nr_regions(const struct region_sampler *sampler)
+{
+    int num = 0;
+    int i;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        num += sampler->target[i].num;
+    }
+    return num;
+}
+
+/* regions are never smaller than a page, and the total size is split into min_nr_regions at least */
+static uint64_t sampler_sz_limit(const struct region_sampler *sampler)
+{
+    const struct sampler_target *target = NULL;
+    uint64_t total = 0;
+    uint64_t limit;
+    int i;
+    int j;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        for (j = 0; j < target->num; j++) {
+            total += target->region[j].end - target->region[j].start;
+        }
+    }
+
+    limit = sampler->attrs.min_nr_regions > 0 ? total / sampler->attrs.min_nr_regions : total;
+    limit &= ~(sampler_page_size() - 1);
+    return limit < sampler_page_size() ? sampler_page_size() : limit;
+}
+
+static bool is_target_alive(const struct sampler_target *target)
+{
+    return target->backend.priv != NULL;
+}
+
+static void sampler_target_exit(struct sampler_target *target)
+{
+    scan_backend_close(&target->backend);
+    etmemd_log(ETMEMD_LOG_DEBUG, "pid %u exits, stop sampling it\n", target->pid);
+}
+
+/*
+ * cover the vmas with the regions like damon_set_regions(), the regions out of the vmas are dropped,
+ * the first and the last region within a vma are stretched to its bounds, and a vma without any
+ * region gets a new one.
+ */
+static int sampler_set_regions(struct sampler_target *target, const struct vmas *vmas)
+{
+    struct sampler_region *region = NULL;
+    struct vma *vma = vmas->vma_list;
+    int cap = target->num + 2 * (int)vmas->vma_cnt;
+    int cursor = 0;
+    int num = 0;
+    int first;
+    uint64_t i;
+
+    region = calloc(cap > 0 ? cap : 1, sizeof(struct sampler_region));
+    if (region == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc regions of pid %u fail\n", target->pid);
+        return -1;
+    }
+
+    for (i = 0; i < vmas->vma_cnt && vma != NULL; i++, vma = vma->next) {
+        while (cursor < target->num && target->region[cursor].end <= vma->start) {
+            cursor++;
+        }
+
+        first = num;
+        while (cursor < target->num && target->region[cursor].start < vma->end) {
+            region[num++] = target->region[cursor];
+            /* the rest of the region is in the next vma */
+            if (target->region[cursor].end > vma->end) {
+                break;
+            }
+            cursor++;
+        }
+
+        if (num == first) {
+            region[num].start = vma->start;
+            region[num].end = vma->end;
+            num++;
+            continue;
+        }
+        region[first].start = vma->start;
+        region[num - 1].end = vma->end;
+    }
+
+    for (first = 0; first < num; first++) {
+        region[first].sampling_addr = region[first].start;
+    }
+    free(target->region);
+    target->region = region;
+    target->num = num;
+    return 0;
+}
+
+static int sampler_split_evenly(struct sampler_target *target, uint64_t sz_limit)
+{
+    struct sampler_region *region = NULL;
+    uint64_t start;
+    uint64_t end;
+    uint64_t cap = 0;
+    int num = 0;
+    int i;
+
+    for (i = 0; i < target->num; i++) {
+        cap += (target->region[i].end - target->region[i].start + sz_limit - 1) / sz_limit;
+    }
+
+    region = calloc(cap > 0 ? cap : 1, sizeof(struct sampler_region));
+    if (region == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc regions of pid %u fail\n", target->pid);
+        return -1;
+    }
+
+    for (i = 0; i < target->num; i++) {
+        end = target->region[i].end;
+        for (start = target->region[i].start; start < end; start += sz_limit) {
+            region[num] = target->region[i];
+            region[num].start = start;
+            region[num].end = end - start > sz_limit ? start + sz_limit : end;
+            region[num].sampling_addr = start;
+            num++;
+        }
+    }
+
+    free(target->region);
+    target->region = region;
+    target->num = num;
+    return 0;
+}
+
+/* check the pages picked by sampler_prepare(), which are accessed since then */
+static void sampler_check(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    int ret;
+    int i;
+    int j;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        for (j = 0; j < target->num && is_target_alive(target); j++) {
+            ret = sample_page_access(&target->backend, target->region[j].sampling_addr);
+            if (ret < 0) {
+                sampler_target_exit(target);
+            } else if (ret > 0) {
+                target->region[j].nr_accesses++;
+            }
+        }
+    }
+}
+
+/* pick a random page of each region, and clear its access bit by reading it */
+static void sampler_prepare(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    struct sampler_region *region = NULL;
+    uint64_t page_size = sampler_page_size();
+    int i;
+    int j;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        for (j = 0; j < target->num && is_target_alive(target); j++) {
+            region = &target->region[j];
+            region->sampling_addr = region->start +
+                sampler_rand(sampler, 0, (region->end - region->start) / page_size) * page_size;
+            if (sample_page_access(&target->backend, region->sampling_addr) < 0) {
+                sampler_target_exit(target);
+            }
+        }
+    }
+}
+
+static unsigned int diff_nr_accesses(unsigned int a, unsigned int b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static void sampler_age_regions(struct sampler_target *target, unsigned int thres)
+{
+    struct sampler_region *region = NULL;
+    int i;
+
+    for (i = 0; i < target->num; i++) {
+        region = &target->region[i];
+        if (diff_nr_accesses(region->nr_accesses, region->last_nr_accesses) > thres) {
+            region->age = 0;
+        } else {
+            region->age++;
+        }
+    }
+}
+
+/* adjacent regions with similar access frequency are merged, weighted by their sizes */
+static void sampler_merge_regions(struct sampler_target *target, unsigned int thres, uint64_t sz_limit)
+{
+    struct sampler_region *prev = NULL;
+    struct sampler_region *cur = NULL;
+    uint64_t sz_prev;
+    uint64_t sz_cur;
+    int num = 0;
+    int i;
+
+    for (i = 0; i < target->num; i++) {
+        cur = &target->region[i];
+        if (prev != NULL) {
+            sz_prev = prev->end - prev->start;
+            sz_cur = cur->end - cur->start;
+            if (prev->end == cur->start && sz_prev + sz_cur <= sz_limit &&
+                diff_nr_accesses(prev->nr_accesses, cur->nr_accesses) <= thres) {
+                prev->nr_accesses = (unsigned int)((prev->nr_accesses * sz_prev + cur->nr_accesses * sz_cur) /
+                                                   (sz_prev + sz_cur));
+                prev->age = (unsigned int)((prev->age * sz_prev + cur->age * sz_cur) / (sz_prev + sz_cur));
+                prev->end = cur->end;
+                continue;
+            }
+        }
+        target->region[num] = *cur;
+        prev = &target->region[num];
+        num++;
+    }
+    target->num = num;
+}
+
+/* the threshold is raised until the count of regions is within max_nr_regions */
+static void sampler_merge(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    uint64_t sz_limit = sampler_sz_limit(sampler);
+    unsigned int max_seen = 0;
+    unsigned int thres;
+    int i;
+    int j;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        for (j = 0; j < target->num; j++) {
+            if (target->region[j].nr_accesses > max_seen) {
+                max_seen = target->region[j].nr_accesses;
+            }
+        }
+    }
+
+    thres = max_seen / SAMPLER_MERGE_THRES_DIV;
+    thres = thres > 0 ? thres : 1;
+    for (i = 0; i < sampler->nr_targets; i++) {
+        sampler_age_regions(&sampler->target[i], thres);
+    }
+
+    do {
+        for (i = 0; i < sampler->nr_targets; i++) {
+            sampler_merge_regions(&sampler->target[i], thres, sz_limit);
+        }
+        thres *= 2;
+    } while ((unsigned long)sampler_nr_regions(sampler) > sampler->attrs.max_nr_regions &&
+             thres / 2 < sampler->max_nr_accesses);
+}
+
+static int sampler_split_regions(struct region_sampler *sampler, struct sampler_target *target, int nr_subs)
+{
+    struct sampler_region *region = NULL;
+    struct sampler_region *cur = NULL;
+    uint64_t page_size = sampler_page_size();
+    uint64_t sz_sub;
+    uint64_t start;
+    int num = 0;
+    int i;
+    int j;
+
+    region = calloc(target->num > 0 ? target->num * nr_subs : 1, sizeof(struct sampler_region));
+    if (region == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc regions of pid %u fail\n", target->pid);
+        return -1;
+    }
+
+    for (i = 0; i < target->num; i++) {
+        cur = &target->region[i];
+        start = cur->start;
+        for (j = 0; j < nr_subs - 1; j++) {
+            sz_sub = sampler_rand(sampler, 1, SAMPLER_SPLIT_RAND_MAX) * (cur->end - start) / SAMPLER_SPLIT_RAND_MAX;
+            sz_sub &= ~(page_size - 1);
+            if (sz_sub == 0 || sz_sub >= cur->end - start) {
+                break;
+            }
+            region[num] = *cur;
+            region[num].start = start;
+            region[num].end = start + sz_sub;
+            num++;
+            start += sz_sub;
+        }
+        region[num] = *cur;
+        region[num].start = start;
+        num++;
+    }
+
+    free(target->region);
+    target->region = region;
+    target->num = num;
+    return 0;
+}
+
+/* regions are split in 2, or 3 if they are far fewer than max_nr_regions, to find the access pattern within */
+static void sampler_split(struct region_sampler *sampler)
+{
+    unsigned long nr_regions = (unsigned long)sampler_nr_regions(sampler);
+    int nr_subs = 2;
+    int i;
+
+    if (nr_regions > sampler->attrs.max_nr_regions / 2) {
+        return;
+    }
+    if (nr_regions < sampler->attrs.max_nr_regions / SAMPLER_SPLIT_MAX_SUBS) {
+        nr_subs = SAMPLER_SPLIT_MAX_SUBS;
+    }
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        if (is_target_alive(&sampler->target[i])) {
+            (void)sampler_split_regions(sampler, &sampler->target[i], nr_subs);
+        }
+    }
+}
+
+static void sampler_report(struct region_sampler *sampler, const struct sampler_target *target)
+{
+    struct damon_regions regions;
+    int i;
+
+    regions.region = calloc(target->num > 0 ? target->num : 1, sizeof(struct damon_region));
+    if (regions.region == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc regions to report for pid %u fail\n", target->pid);
+        return;
+    }
+
+    for (i = 0; i < target->num; i++) {
+        regions.region[i].start = target->region[i].start;
+        regions.region[i].end = target->region[i].end;
+        regions.region[i].nr_accesses = target->region[i].nr_accesses;
+        regions.region[i].age = target->region[i].age;
+    }
+    regions.num = target->num;
+    regions.max_nr_accesses = sampler->max_nr_accesses;
+
+    sampler->aggr_fn(sampler->arg, target->pid, &regions);
+    free(regions.region);
+}
+
+static void sampler_aggregate(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    int i;
+    int j;
+
+    sampler_merge(sampler);
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        if (!is_target_alive(target)) {
+            continue;
+        }
+        sampler_report(sampler, target);
+        for (j = 0; j < target->num; j++) {
+            target->region[j].last_nr_accesses = target->region[j].nr_accesses;
+            target->region[j].nr_accesses = 0;
+        }
+    }
+
+    sampler_split(sampler);
+}
+
+static struct vmas *sampler_get_vmas(unsigned int pid)
+{
+    char pid_str[PID_STR_MAX_LEN] = {0};
+
+    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid %u fail\n", pid);
+        return NULL;
+    }
+    return get_vmas(pid_str);
+}
+
+/* follow the mmap and munmap of the pids */
+static void sampler_update(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    struct vmas *vmas = NULL;
+    int i;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        if (!is_target_alive(target)) {
+            continue;
+        }
+
+        vmas = sampler_get_vmas(target->pid);
+        if (vmas == NULL) {
+            sampler_target_exit(target);
+            continue;
+        }
+        (void)sampler_set_regions(target, vmas);
+        free_vmas(vmas);
+    }
+}
+
+static bool sampler_has_target(const struct region_sampler *sampler)
+{
+    int i;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        if (is_target_alive(&sampler->target[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sampler_sleep_us(unsigned long us)
+{
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / USEC_PER_SEC),
+        .tv_nsec = (long)(us % USEC_PER_SEC) * NSEC_PER_USEC,
+    };
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void *sampler_main(void *arg)
+{
+    struct region_sampler *sampler = (struct region_sampler *)arg;
+    uint64_t next_aggr = sampler_now_us() + sampler->attrs.aggr_interval;
+    uint64_t next_update = sampler_now_us() + sampler->attrs.update_interval;
+    uint64_t now;
+
+    sampler_prepare(sampler);
+    while (!sampler->stop && sampler_has_target(sampler)) {
+        sampler_sleep_us(sampler->attrs.sample_interval);
+        sampler_check(sampler);
+
+        now = sampler_now_us();
+        if (now >= next_aggr) {
+            sampler_aggregate(sampler);
+            next_aggr = now + sampler->attrs.aggr_interval;
+        }
+        if (now >= next_update) {
+            sampler_update(sampler);
+            next_update = now + sampler->attrs.update_interval;
+        }
+        sampler_prepare(sampler);
+    }
+
+    etmemd_log(ETMEMD_LOG_DEBUG, "region sampler exits\n");
+    return NULL;
+}
+
+static void free_region_sampler(struct region_sampler *sampler)
+{
+    struct sampler_target *target = NULL;
+    int i;
+
+    for (i = 0; i < sampler->nr_targets; i++) {
+        target = &sampler->target[i];
+        scan_backend_close(&target->backend);
+        free(target->region);
+    }
+    free(sampler->target);
+    free(sampler);
+}
+
+static int sampler_init_target(struct sampler_target *target, unsigned int pid, enum scan_source source)
+{
+    char pid_str[PID_STR_MAX_LEN] = {0};
+    struct vmas *vmas = NULL;
+    int ret;
+
+    target->pid = pid;
+    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", pid) <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid %u fail\n", pid);
+        return -1;
+    }
+
+    if (scan_backend_open(&target->backend, source, pid_str, NULL) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open scan backend for pid %u fail\n", pid);
+        return -1;
+    }
+
+    vmas = get_vmas(pid_str);
+    if (vmas == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "get vmas for pid %u fail\n", pid);
+        return -1;
+    }
+    ret = sampler_set_regions(target, vmas);
+    free_vmas(vmas);
+    return ret;
+}
+
+struct region_sampler *region_sampler_start(const struct region_scan *attrs, const unsigned int *pids, int nr_pids,
+                                            region_aggr_fn aggr_fn, void *arg)
+{
+    struct region_sampler *sampler = NULL;
+    uint64_t sz_limit;
+    int i;
+
+    if (attrs->sample_interval == 0 || attrs->aggr_interval < attrs->sample_interval || nr_pids <= 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "invalid attrs or no pid for the region sampler\n");
+        return NULL;
+    }
+
+    sampler = calloc(1, sizeof(struct region_sampler));
+    if (sampler == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc region sampler fail\n");
+        return NULL;
+    }
+    sampler->target = calloc(nr_pids, sizeof(struct sampler_target));
+    if (sampler->target == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "alloc targets of region sampler fail\n");
+        free(sampler);
+        return NULL;
+    }
+
+    sampler->attrs = *attrs;
+    sampler->nr_targets = nr_pids;
+    sampler->max_nr_accesses = (unsigned int)(attrs->aggr_interval / attrs->sample_interval);
+    sampler->seed = (unsigned int)sampler_now_us();
+    sampler->aggr_fn = aggr_fn;
+    sampler->arg = arg;
+
+    for (i = 0; i < nr_pids; i++) {
+        if (sampler_init_target(&sampler->target[i], pids[i], attrs->source) != 0) {
+            goto free_sampler;
+        }
+    }
+
+    sz_limit = sampler_sz_limit(sampler);
+    for (i = 0; i < nr_pids; i++) {
+        if (sampler_split_evenly(&sampler->target[i], sz_limit) != 0) {
+            goto free_sampler;
+        }
+    }
+
+    if (pthread_create(&sampler->worker, NULL, sampler_main, sampler) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "start region sampler fail\n");
+        goto free_sampler;
+    }
+
+    return sampler;
+
+free_sampler:
+    free_region_sampler(sampler);
+    return NULL;
+}
+
+void region_sampler_stop(struct region_sampler *sampler)
+{
+    if (sampler == NULL) {
+        return;
+    }
+
+    sampler->stop = true;
+    pthread_join(sampler->worker, NULL);
+    free_region_sampler(sampler);
+}
@@ -22,10 +22,12 @@
 
 #include "etmemd.h"
 #include "etmemd_scan.h"
+#include "etmemd_scan_backend.h"
 #include "etmemd_project.h"
 #include "etmemd_engine.h"
 #include "etmemd_common.h"
 #include "etmemd_slide.h"
+#include "etmemd_damon.h"
 #include "etmemd_log.h"
 #include "securec.h"
 
@@ -33,6 +35,7 @@
 #define PMD_IDLE_PTES_PARAMETER 512
 #define VMFLAG_MAX_NUM 30
 #define VMFLAG_VALID_LEN 2
+#define REGION_PAGEMAP_BATCH 512
 
 static bool g_exp_scan_inited = false;
 
@@ -509,6 +512,7 @@ static struct page_refs *alloc_page_refs_node(u_int64_t addr, double est_time, e
 static struct page_refs **update_page_refs(u_int64_t addr,
                                            double est_time,
                                            enum page_type type,
+                                           bool dirty,
                                            struct page_refs **page_refs)
 {
     struct page_refs *tmp_pf = NULL;
@@ -519,6 +523,7 @@ static struct page_refs **update_page_refs(u_int64_t addr,
         if (*page_refs == NULL) {
             return NULL;
         }
+        (*page_refs)->dirty = dirty ? 1 : 0;
         return &((*page_refs)->next);
     }
     
@@ -529,6 +534,9 @@ static struct page_refs **update_page_refs(u_int64_t addr,
     double x, u, v, new_u, new_v;
     /* if the address is the one that we need to update */
     if (addr == (*page_refs)->addr) {
+        if (dirty) {
+            (*page_refs)->dirty++;
+        }
         if (est_time != -1){
             (*page_refs)->m++;
 	        int m_ = (*page_refs)->m;
@@ -568,7 +576,7 @@ static struct page_refs **update_page_refs(u_int64_t addr,
     /* if the address is behind the currnet node, return to operate next node */
     if (addr > (*page_refs)->addr) {
         page_refs = &((*page_refs)->next);
-        return update_page_refs(addr, est_time, type, page_refs);
+        return update_page_refs(addr, est_time, type, dirty, page_refs);
     }
 
     /* the address must be before the current node when code gets here, alloc a node first,
@@ -578,6 +586,7 @@ static struct page_refs **update_page_refs(u_int64_t addr,
         /* it is no meaning to do anything else if we cannot alloc a page_refs struct */
         return NULL;
     }
+    tmp_pf->dirty = dirty ? 1 : 0;
 
     tmp_pf->next = *page_refs;
     *page_refs = tmp_pf;
@@ -664,7 +673,7 @@ static struct page_refs **record_parse_result(u_int64_t addr, enum page_idle_typ
         }
 
         page_size_type = g_page_type_by_idle_kind[type];
-        pf = update_page_refs(addr, est_time, page_size_type, pf);
+        pf = update_page_refs(addr, est_time, page_size_type, type == PTE_DIRTY || type == PMD_DIRTY, pf);
         /*when it is the last loop, the possibility of being visted 
         in the future should be updated*/
         if (loop_index == loop_end) update_possibility(pf, loop_index);
@@ -771,7 +780,7 @@ static struct page_refs **parse_vma_result(const unsigned char *buf, u_int64_t s
     return pf;
 }
 
-struct page_refs **walk_vmas(int fd,
+struct page_refs **walk_vmas(struct scan_backend *backend,
                              struct walk_address *walk_address,
                              struct page_refs **pf,
                              unsigned long *use_rss,
@@ -780,6 +789,7 @@ struct page_refs **walk_vmas(int fd,
 {
     unsigned char *buf = NULL;
     u_int64_t size;
+    u_int64_t last_end;
     ssize_t recv_size;
 
     /* we make the buffer size as fitable as within a vma.
@@ -794,24 +804,278 @@ struct page_refs **walk_vmas(int fd,
         return NULL;
     }
 
-    if (lseek(fd, (long)walk_address->walk_start, SEEK_SET) == -1) {
-        etmemd_log(ETMEMD_LOG_ERR, "set seek of file fail (%s)\n", strerror(errno));
-        free(buf);
+    /* the buffer may be full before the end of the vma, read again from where the last read ends */
+    do {
+        last_end = walk_address->last_walk_end;
+        recv_size = scan_backend_read(backend, walk_address->walk_start, buf, size);
+        if (recv_size <= 0) {
+            break;
+        }
+
+        pf = parse_vma_result(buf, (u_int64_t)recv_size, pf, &(walk_address->last_walk_end),
+                              use_rss, loop_index, loop_end);
+        if (pf == NULL) {
+            break;
+        }
+        walk_address->walk_start = walk_address->last_walk_end;
+    } while (walk_address->last_walk_end > last_end && walk_address->last_walk_end < walk_address->walk_end);
+
+    free(buf);
+    return pf;
+}
+
+static struct page_refs *alloc_region_page_refs(u_int64_t addr, enum page_type type, const struct damon_region *region,
+                                                unsigned int max_nr_accesses, int max_count)
+{
+    struct page_refs *pf = NULL;
+    unsigned int nr_accesses = region->nr_accesses;
+    int count;
+
+    if (nr_accesses > max_nr_accesses) {
+        nr_accesses = max_nr_accesses;
+    }
+    count = (int)(((u_int64_t)nr_accesses * (u_int64_t)max_count + max_nr_accesses - 1) / max_nr_accesses);
+
+    pf = alloc_page_refs_node(addr, count > 0 ? (double)max_count - 0.5 : -1, type);
+    if (pf == NULL) {
         return NULL;
     }
 
-    recv_size = read(fd, buf, size);
-    if (recv_size <= 0) {
-        free(buf);
+    /* as if the page was seen accessed in count of max_count loops */
+    pf->count = count;
+    pf->m = count - 2;
+    pf->possibility = (double)nr_accesses / max_nr_accesses;
+    return pf;
+}
+
+/*
+ * damon regions are not aware of residency, pagemap tells the pages which are present.
+ * VmRSS does not count hugetlb pages, so HugetlbPages is added to the budget.
+ */
+void region_walk_open(struct region_walk *walk, const char *pid, enum page_type type)
+{
+    unsigned long rss_kb = 0;
+    unsigned long hugetlb_kb = 0;
+    unsigned long page_kb = (unsigned long)page_type_to_size(type) / 1024;
+    struct proc_mem_key keys[] = {
+        {VMRSS, &rss_kb, false},
+        {"HugetlbPages", &hugetlb_kb, false},
+    };
+    int fd;
+
+    walk->type = type;
+    walk->budget = ULONG_MAX;
+    fd = etmemd_open_proc_fd(pid, STATUS_FILE);
+    if (fd >= 0) {
+        /* HugetlbPages is not there before linux 4.5, then only VmRSS is found */
+        (void)get_mem_from_proc_fd(fd, keys, ARRAY_SIZE(keys));
+        if (keys[0].found && page_kb != 0) {
+            walk->budget = (rss_kb + hugetlb_kb) / page_kb;
+        }
+        close(fd);
+    }
+
+    walk->pagemap_fd = etmemd_open_proc_fd(pid, PAGEMAP_FILE);
+    if (walk->pagemap_fd < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "open %s of pid %s fail, take all pages of regions as present\n",
+                   PAGEMAP_FILE, pid);
+    }
+}
+
+void region_walk_close(struct region_walk *walk)
+{
+    if (walk->pagemap_fd >= 0) {
+        close(walk->pagemap_fd);
+        walk->pagemap_fd = -1;
+    }
+}
+
+/*
+ * the pagemap entries of nr pages of walk->type from addr, all of them are taken as present if pagemap
+ * is not readable. pagemap has an entry per base page, so the first one stands for a huge page.
+ */
+static void read_region_pagemap(const struct region_walk *walk, u_int64_t addr, uint64_t *entry, int nr)
+{
+    u_int64_t base_size = (u_int64_t)page_type_to_size(PTE_TYPE);
+    u_int64_t page_size = (u_int64_t)page_type_to_size(walk->type);
+    size_t len = (size_t)nr * sizeof(uint64_t);
+    int i;
+
+    if (walk->pagemap_fd >= 0 && page_size == base_size) {
+        if (pread(walk->pagemap_fd, entry, len, (off_t)(addr / base_size * sizeof(uint64_t))) == (ssize_t)len) {
+            return;
+        }
+    } else if (walk->pagemap_fd >= 0) {
+        for (i = 0; i < nr; i++) {
+            if (pread(walk->pagemap_fd, &entry[i], sizeof(uint64_t),
+                      (off_t)((addr + (u_int64_t)i * page_size) / base_size * sizeof(uint64_t))) !=
+                (ssize_t)sizeof(uint64_t)) {
+                break;
+            }
+        }
+        if (i == nr) {
+            return;
+        }
+    }
+
+    for (i = 0; i < nr; i++) {
+        entry[i] = PAGEMAP_PRESENT;
+    }
+}
+
+static struct page_refs **walk_region_pages(const struct damon_regions *regions, const struct damon_region *region,
+                                            u_int64_t start, u_int64_t end, int max_count,
+                                            struct region_walk *walk, struct page_refs **pf)
+{
+    u_int64_t page_size = (u_int64_t)page_type_to_size(walk->type);
+    uint64_t entry[REGION_PAGEMAP_BATCH];
+    u_int64_t addr;
+    int nr;
+    int i;
+
+    for (addr = start; addr + page_size <= end; addr += (u_int64_t)nr * page_size) {
+        nr = (end - addr) / page_size > REGION_PAGEMAP_BATCH ? REGION_PAGEMAP_BATCH : (int)((end - addr) / page_size);
+        read_region_pagemap(walk, addr, entry, nr);
+        for (i = 0; i < nr; i++) {
+            if ((entry[i] & PAGEMAP_PRESENT) == 0) {
+                continue;
+            }
+            if (walk->budget == 0) {
+                etmemd_log(ETMEMD_LOG_DEBUG, "page_refs of damon regions reach the rss, stop walking\n");
+                return pf;
+            }
+            *pf = alloc_region_page_refs(addr + (u_int64_t)i * page_size, walk->type, region,
+                                         regions->max_nr_accesses, max_count);
+            if (*pf == NULL) {
+                return NULL;
+            }
+            pf = &((*pf)->next);
+            walk->budget--;
+        }
+    }
+
+    return pf;
+}
+
+/*
+ * expand the damon regions within walk_address to a page_refs node per present page of walk->type,
+ * appended to pf.
+ * the regions before the cursor are skipped, and the cursor is left at the first region not finished,
+ * so that the vmas of a process are walked one by one in address order.
+ * max_count is the count of a page accessed in every sample of the aggregation.
+ */
+struct page_refs **walk_regions(const struct damon_regions *regions, int *cursor, const struct walk_address *walk_address,
+                                int max_count, struct region_walk *walk, struct page_refs **pf)
+{
+    const struct damon_region *region = NULL;
+    u_int64_t page_size = (u_int64_t)page_type_to_size(walk->type);
+    u_int64_t start;
+    u_int64_t end;
+
+    if (regions->max_nr_accesses == 0) {
         return pf;
     }
 
-    pf = parse_vma_result(buf, (u_int64_t)recv_size, pf, &(walk_address->last_walk_end), use_rss, loop_index, loop_end);
+    for (; *cursor < regions->num && walk->budget != 0; (*cursor)++) {
+        region = &regions->region[*cursor];
+        if (region->end <= walk_address->walk_start) {
+            continue;
+        }
+        if (region->start >= walk_address->walk_end) {
+            break;
+        }
+
+        start = region->start > walk_address->walk_start ? region->start : walk_address->walk_start;
+        start = (start + page_size - 1) & ~(page_size - 1);
+        end = region->end < walk_address->walk_end ? region->end : walk_address->walk_end;
+        pf = walk_region_pages(regions, region, start, end, max_count, walk, pf);
+        if (pf == NULL) {
+            return NULL;
+        }
+
+        /* the rest of the region is in the next vma */
+        if (region->end > walk_address->walk_end) {
+            break;
+        }
+    }
 
-    free(buf);
     return pf;
 }
 
+/* the page_refs of the vmas built from the damon snapshot of the process */
+static int get_region_page_refs(const char *pid, const struct vmas *vmas, const struct damon_regions *regions,
+                                int max_count, struct page_refs **page_refs)
+{
+    struct vma *vma = vmas->vma_list;
+    struct walk_address walk_address = {0, 0, 0};
+    struct page_refs **tmp_page_refs = page_refs;
+    struct region_walk walk;
+    int cursor = 0;
+    int ret = 0;
+    u_int64_t i;
+
+    region_walk_open(&walk, pid, PTE_TYPE);
+    for (i = 0; i < vmas->vma_cnt && vma != NULL; i++, vma = vma->next) {
+        walk_address.walk_start = vma->start;
+        walk_address.walk_end = vma->end;
+        tmp_page_refs = walk_regions(regions, &cursor, &walk_address, max_count, &walk, tmp_page_refs);
+        if (tmp_page_refs == NULL) {
+            etmemd_log(ETMEMD_LOG_ERR, "build page_refs from damon regions fail\n");
+            ret = -1;
+            break;
+        }
+    }
+    region_walk_close(&walk);
+
+    return ret;
+}
+
+/*
+ * read whether the page at addr is accessed since the last read of it from the backend,
+ * the access of the pages covered by the read is cleared.
+ * return 1 if accessed, 0 if idle or not mapped, -1 if the read fails.
+ */
+int sample_page_access(struct scan_backend *backend, u_int64_t addr)
+{
+    unsigned char buf[EPT_IDLE_BUF_MIN];
+    u_int64_t address = 0;
+    u_int64_t size;
+    u_int64_t i;
+    ssize_t recv_size;
+    enum page_idle_type type;
+    int nr;
+
+    addr &= ~((u_int64_t)page_type_to_size(PTE_TYPE) - 1);
+    recv_size = scan_backend_read(backend, addr, buf, sizeof(buf));
+    if (recv_size < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < (u_int64_t)recv_size; i++) {
+        if (buf[i] == PIP_CMD_SET_HVA) {
+            if (i + sizeof(u_int64_t) >= (u_int64_t)recv_size) {
+                break;
+            }
+            address = get_address_from_buf(buf, i);
+            i += sizeof(u_int64_t);
+            continue;
+        }
+
+        nr = get_page_nr_from_buf(buf[i]);
+        type = get_page_type_from_buf(buf[i]);
+        if (type >= PIP_CMD) {
+            break;
+        }
+        size = (u_int64_t)nr * page_type_to_size(g_page_type_by_idle_kind[type]);
+        if (addr >= address && addr < address + size) {
+            return type < PTE_IDLE ? 1 : 0;
+        }
+        address += size;
+    }
+
+    return 0;
+}
+
 /*
 * scan the process vma to get page_refs for migrate.
 * use_rss: memory that is being used by the process,
@@ -819,32 +1083,16 @@ struct page_refs **walk_vmas(int fd,
 * In other policies, NULL can be directly transmitted.
 * */
 int get_page_refs(const struct vmas *vmas, const char *pid, struct page_refs **page_refs,
-                  unsigned long *use_rss, struct ioctl_para *ioctl_para, int loop_idx, int loop_end)
+                  unsigned long *use_rss, struct ioctl_para *ioctl_para, enum scan_source source,
+                  int loop_idx, int loop_end)
 {
     u_int64_t i;
-    FILE *scan_fp = NULL;
-    int fd = -1;
+    struct scan_backend backend;
     struct vma *vma = vmas->vma_list;
     struct page_refs **tmp_page_refs = NULL;
     struct walk_address walk_address = {0, 0, 0};
 
-    scan_fp = etmemd_get_proc_file(pid, IDLE_SCAN_FILE, "r");
-    if (scan_fp == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "open %s file fail\n", IDLE_SCAN_FILE);
-        return -1;
-    }
-
-    if (ioctl_para != NULL && ioctl_para->ioctl_parameter != 0
-            && etmemd_send_ioctl_cmd(scan_fp, ioctl_para) != 0) {
-        fclose(scan_fp);
-        etmemd_log(ETMEMD_LOG_ERR, "etmemd_send_ioctl_cmd %s file for pid %s fail\n", IDLE_SCAN_FILE, pid);
-        return -1;
-    }
-
-    fd = fileno(scan_fp);
-    if (fd == -1) {
-        etmemd_log(ETMEMD_LOG_ERR, "fileno file fail\n");
-        fclose(scan_fp);
+    if (scan_backend_open(&backend, source, pid, ioctl_para) != 0) {
         return -1;
     }
 
@@ -862,17 +1110,17 @@ int get_page_refs(const struct vmas *vmas, const char *pid, struct page_refs **p
         if (walk_address.last_walk_end > vma->start) {
             walk_address.walk_start = walk_address.last_walk_end;
         }
-        tmp_page_refs = walk_vmas(fd, &walk_address, tmp_page_refs, use_rss, loop_idx, loop_end);
+        tmp_page_refs = walk_vmas(&backend, &walk_address, tmp_page_refs, use_rss, loop_idx, loop_end);
         if (tmp_page_refs == NULL) {
             etmemd_log(ETMEMD_LOG_ERR, "get end of address after last walk fail\n");
-            fclose(scan_fp);
+            scan_backend_close(&backend);
             return -1;
         }
 
         vma = vma->next;
     }
 
-    fclose(scan_fp);
+    scan_backend_close(&backend);
     return 0;
 }
 
@@ -892,7 +1140,7 @@ int etmemd_get_page_refs(const struct vmas *vmas, const char *pid, struct page_r
     ioctl_para.ioctl_parameter = flags & ALL_SCAN_FLAGS;
     ioctl_para.ioctl_cmd = IDLE_SCAN_ADD_FLAGS;
 
-    return get_page_refs(vmas, pid, page_refs, NULL, &ioctl_para, 0, 0);
+    return get_page_refs(vmas, pid, page_refs, NULL, &ioctl_para, SCAN_SRC_IDLE_PAGES, 0, 0);
 }
 
 void etmemd_free_page_refs(struct page_refs *pf)
@@ -906,7 +1154,7 @@ void etmemd_free_page_refs(struct page_refs *pf)
     }
 }
 
-struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task *tk)
+struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task *tk, unsigned int scan_flags)
 {
     int i;
     struct vmas *vmas = NULL;
@@ -914,6 +1162,7 @@ struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task
     int ret;
     char pid[PID_STR_MAX_LEN] = {0};
     struct ioctl_para ioctl_para = {0};
+    struct damon_regions regions;
 
     if (tk == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "task struct is null for pid %u\n", tpid->pid);
@@ -934,15 +1183,29 @@ struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task
         return NULL;
     }
 
+    /* one snapshot of damon stands for all the loops, pids not monitored are still scanned */
+    if (page_scan->source == SCAN_SRC_DAMON &&
+        etmemd_damon_get_regions(tk->eng->proj, tpid->pid, &regions) == 0) {
+        ret = get_region_page_refs(pid, vmas, &regions, page_scan->loop, &page_refs);
+        etmemd_damon_free_regions(&regions);
+        free_vmas(vmas);
+        if (ret != 0) {
+            etmemd_free_page_refs(page_refs);
+            return NULL;
+        }
+        return page_refs;
+    }
+
     ioctl_para.ioctl_cmd = VMA_SCAN_ADD_FLAGS;
     if (tk->swap_flag != 0) {
         ioctl_para.ioctl_parameter = VMA_SCAN_FLAG;
     }
+    ioctl_para.ioctl_parameter |= scan_flags;
 
     /* loop for scanning idle_pages to get result of memory access. */
     for (i = 0; i < page_scan->loop; i++) {
         //pass parameter i(loop no.) and page_scan->loop - 1(total loop number)
-        ret = get_page_refs(vmas, pid, &page_refs, NULL, &ioctl_para, i, page_scan->loop - 1);
+        ret = get_page_refs(vmas, pid, &page_refs, NULL, &ioctl_para, page_scan->source, i, page_scan->loop - 1);
         if (ret != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "scan operation failed\n");
             /* free page_refs nodes already exist */
@@ -950,7 +1213,12 @@ struct page_refs *etmemd_do_scan(const struct task_pid *tpid, const struct task
             page_refs = NULL;
             break;
         }
-        sleep((unsigned)page_scan->sleep);
+        if (etmemd_task_pid_sleep(tpid, (unsigned)page_scan->sleep)) {
+            etmemd_log(ETMEMD_LOG_DEBUG, "pid %u exits, cancel the scan\n", tpid->pid);
+            etmemd_free_page_refs(page_refs);
+            page_refs = NULL;
+            break;
+        }
     }
 
     free_vmas(vmas);
@@ -981,6 +1249,7 @@ void clean_memory_grade_unexpected(void *arg)
     }
 
     clean_page_refs_unexpected(&((*mg)->hot_pages));
+    clean_page_refs_unexpected(&((*mg)->warm_pages));
     clean_page_refs_unexpected(&((*mg)->cold_pages));
     free(*mg);
     *mg = NULL;
@@ -1018,7 +1287,7 @@ struct page_sort *alloc_page_sort(const struct task_pid *tpid)
 
     page_sort->loop = page_scan->loop;
     //pages are sorted by the possibility 
-    page_sort->page_refs_sort = (struct page_refs **)calloc(5, sizeof(struct page_refs *));
+    page_sort->page_refs_sort = (struct page_refs **)calloc(PAGE_SORT_NUM, sizeof(struct page_refs *));
     if (page_sort->page_refs_sort == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "calloc page refs sort failed.\n");
         free(page_sort);
@@ -1074,10 +1343,12 @@ int sort_by_possibility(double p){
 
 /* Move the colder pages by sorting page refs.
  * Use original page_refs if dram_percent is not set.
- * But, use the sorting result of page_refs, if dram_percent is set to (0, 100] */
-struct page_sort *sort_page_refs(struct page_refs **page_refs, const struct task_pid *tpid)
+ * But, use the sorting result of page_refs, if dram_percent is set to (0, 100]
+ * or the project ranks the pages of all pids by global_dram_percent */
+struct page_sort *sort_page_refs(struct page_refs **page_refs, const struct task_pid *tpid,
+                                 const struct slide_params *slide_params)
 {
-    struct slide_params *slide_params = NULL;
+    struct page_scan *page_scan = NULL;
     struct page_sort *page_sort = NULL;
     struct page_refs *page_next = NULL;
     int index;
@@ -1086,15 +1357,15 @@ struct page_sort *sort_page_refs(struct page_refs **page_refs, const struct task
     if (page_sort == NULL)
         return NULL;
 
-    slide_params = (struct slide_params *)tpid->tk->params;
-    if (slide_params == NULL || slide_params->dram_percent == 0) {
+    page_scan = (struct page_scan *)tpid->tk->eng->proj->scan_param;
+    if (slide_params == NULL || (slide_params->dram_percent == 0 && tpid->tk->eng->proj->rank == NULL)) {
         page_sort->page_refs = page_refs;
         return page_sort;
     }
 
     while (*page_refs != NULL) {
         page_next = (*page_refs)->next;
-        index = sort_by_possibility((*page_refs)->possibility);
+        index = sort_by_possibility(slide_evict_cost(*page_refs, slide_params, page_scan->loop));
         (*page_refs)->next = (page_sort->page_refs_sort[index]);
         (page_sort->page_refs_sort[index]) = *page_refs;
         *page_refs = page_next;
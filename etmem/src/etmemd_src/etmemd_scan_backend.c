@@ -0,0 +1,476 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Backends which read the access of pages for scan.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "securec.h"
+#include "etmemd_log.h"
+#include "etmemd_scan.h"
+#include "etmemd_scan_backend.h"
+
+#define IDLE_ENTRY_NR_MAX       0x0F
+#define IDLE_ENTRY_TYPE_SHIFT   4
+#define IDLE_PAGES_PER_BYTE     8       /* a byte of buffer covers 8 pages, the same as idle_pages */
+#define BITS_PER_BYTE           8
+
+static FILE *open_idle_pages(const char *pid, bool dirty)
+{
+    FILE *scan_fp = NULL;
+    int fd;
+
+    if (!dirty) {
+        return etmemd_get_proc_file(pid, IDLE_SCAN_FILE, "r");
+    }
+
+    fd = etmemd_open_proc_file(pid, IDLE_SCAN_FILE, O_RDONLY | SCAN_DIRTY_PAGE);
+    if (fd < 0) {
+        return NULL;
+    }
+    scan_fp = fdopen(fd, "r");
+    if (scan_fp == NULL) {
+        close(fd);
+    }
+    return scan_fp;
+}
+
+static int idle_pages_open(struct scan_backend *backend, const char *pid, struct ioctl_para *ioctl_para)
+{
+    FILE *scan_fp = NULL;
+    struct ioctl_para para = {0};
+    bool dirty = false;
+
+    if (ioctl_para != NULL) {
+        para = *ioctl_para;
+        dirty = (para.ioctl_parameter & SCAN_DIRTY_PAGE) != 0;
+        para.ioctl_parameter &= ~(unsigned int)SCAN_DIRTY_PAGE;
+    }
+
+    scan_fp = open_idle_pages(pid, dirty);
+    if (scan_fp == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s file for pid %s fail\n", IDLE_SCAN_FILE, pid);
+        return -1;
+    }
+
+    if (para.ioctl_parameter != 0 && etmemd_send_ioctl_cmd(scan_fp, &para) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "etmemd_send_ioctl_cmd %s file for pid %s fail\n", IDLE_SCAN_FILE, pid);
+        fclose(scan_fp);
+        return -1;
+    }
+
+    backend->priv = scan_fp;
+    return 0;
+}
+
+static ssize_t idle_pages_read(struct scan_backend *backend, uint64_t addr, unsigned char *buf, size_t size)
+{
+    int fd = fileno((FILE *)backend->priv);
+
+    if (lseek(fd, (long)addr, SEEK_SET) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "set seek of file fail (%s)\n", strerror(errno));
+        return -1;
+    }
+
+    return read(fd, buf, size);
+}
+
+static void idle_pages_close(struct scan_backend *backend)
+{
+    fclose((FILE *)backend->priv);
+}
+
+static const struct scan_backend_ops g_idle_pages_ops = {
+    .name = "idle_pages",
+    .open = idle_pages_open,
+    .read = idle_pages_read,
+    .close = idle_pages_close,
+};
+
+struct page_idle_scan {
+    FILE *pagemap_fp;
+    int bitmap_fd;
+    uint64_t entry[PAGE_IDLE_BATCH];        // pagemap entries of the batch
+    uint64_t word_idx[PAGE_IDLE_BATCH];     // sorted distinct bitmap words covering the pfns of the batch
+    uint64_t word[PAGE_IDLE_BATCH];         // the bits read of word_idx
+    uint64_t mark[PAGE_IDLE_BATCH];         // the bits to set idle of word_idx
+    int nr_words;
+};
+
+/* the buffer filled in the format of idle_pages: PIP_CMD_SET_HVA with the address, then entries of type|nr */
+struct idle_buf {
+    unsigned char *buf;
+    size_t size;
+    size_t pos;
+    size_t last;        // index of the last entry, size if none after the address
+};
+
+static int page_idle_open(struct scan_backend *backend, const char *pid, struct ioctl_para *ioctl_para)
+{
+    struct page_idle_scan *scan = NULL;
+
+    /* scan flags are of the etmem_scan module, page_idle has no such control */
+    (void)ioctl_para;
+
+    scan = (struct page_idle_scan *)calloc(1, sizeof(struct page_idle_scan));
+    if (scan == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "malloc for page_idle scan fail\n");
+        return -1;
+    }
+
+    scan->pagemap_fp = etmemd_get_proc_file(pid, PAGEMAP_FILE, "r");
+    if (scan->pagemap_fp == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s file for pid %s fail\n", PAGEMAP_FILE, pid);
+        free(scan);
+        return -1;
+    }
+
+    scan->bitmap_fd = open(PAGE_IDLE_BITMAP, O_RDWR);
+    if (scan->bitmap_fd < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "open %s fail (%s), CONFIG_IDLE_PAGE_TRACKING is needed\n",
+                   PAGE_IDLE_BITMAP, strerror(errno));
+        fclose(scan->pagemap_fp);
+        free(scan);
+        return -1;
+    }
+
+    backend->priv = scan;
+    return 0;
+}
+
+static void page_idle_close(struct scan_backend *backend)
+{
+    struct page_idle_scan *scan = (struct page_idle_scan *)backend->priv;
+
+    close(scan->bitmap_fd);
+    fclose(scan->pagemap_fp);
+    free(scan);
+}
+
+static uint64_t entry_to_pfn(uint64_t entry)
+{
+    /* the pfn is 0 for the readers without CAP_SYS_ADMIN, which is taken as not present */
+    if ((entry & PAGEMAP_PRESENT) == 0) {
+        return 0;
+    }
+    return entry & PAGEMAP_PFN_MASK;
+}
+
+static int cmp_word_idx(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    if (x == y) {
+        return 0;
+    }
+    return x < y ? -1 : 1;
+}
+
+static void collect_words(struct page_idle_scan *scan, int nr)
+{
+    int i;
+    int n = 0;
+    uint64_t pfn;
+
+    for (i = 0; i < nr; i++) {
+        pfn = entry_to_pfn(scan->entry[i]);
+        if (pfn != 0) {
+            scan->word_idx[n++] = pfn / PAGE_IDLE_WORD_BITS;
+        }
+    }
+
+    qsort(scan->word_idx, (size_t)n, sizeof(uint64_t), cmp_word_idx);
+    scan->nr_words = 0;
+    for (i = 0; i < n; i++) {
+        if (scan->nr_words == 0 || scan->word_idx[scan->nr_words - 1] != scan->word_idx[i]) {
+            scan->word_idx[scan->nr_words++] = scan->word_idx[i];
+        }
+    }
+}
+
+/* length of the run of consecutive words from index i */
+static int word_run_len(const struct page_idle_scan *scan, int i)
+{
+    int j = i + 1;
+
+    while (j < scan->nr_words && scan->word_idx[j] == scan->word_idx[j - 1] + 1) {
+        j++;
+    }
+    return j - i;
+}
+
+/* each run of consecutive words is read by one pread, the words failed to read are taken as accessed */
+static void read_words(struct page_idle_scan *scan)
+{
+    int i;
+    int len;
+    ssize_t ret;
+
+    for (i = 0; i < scan->nr_words; i += len) {
+        len = word_run_len(scan, i);
+        ret = pread(scan->bitmap_fd, &scan->word[i], (size_t)len * sizeof(uint64_t),
+                    (off_t)(scan->word_idx[i] * sizeof(uint64_t)));
+        if (ret != (ssize_t)(len * sizeof(uint64_t))) {
+            etmemd_log(ETMEMD_LOG_DEBUG, "read page_idle bitmap at word %llu fail\n",
+                       (unsigned long long)scan->word_idx[i]);
+            (void)memset_s(&scan->word[i], (size_t)len * sizeof(uint64_t), 0, (size_t)len * sizeof(uint64_t));
+        }
+        (void)memset_s(&scan->mark[i], (size_t)len * sizeof(uint64_t), 0, (size_t)len * sizeof(uint64_t));
+    }
+}
+
+/* set the pages reported idle again, so that the next read tells the access in between */
+static void write_words(struct page_idle_scan *scan)
+{
+    int i;
+    int len;
+    ssize_t ret;
+
+    for (i = 0; i < scan->nr_words; i += len) {
+        len = word_run_len(scan, i);
+        ret = pwrite(scan->bitmap_fd, &scan->mark[i], (size_t)len * sizeof(uint64_t),
+                     (off_t)(scan->word_idx[i] * sizeof(uint64_t)));
+        if (ret != (ssize_t)(len * sizeof(uint64_t))) {
+            etmemd_log(ETMEMD_LOG_DEBUG, "write page_idle bitmap at word %llu fail\n",
+                       (unsigned long long)scan->word_idx[i]);
+        }
+    }
+}
+
+static int find_word(const struct page_idle_scan *scan, uint64_t pfn)
+{
+    uint64_t key = pfn / PAGE_IDLE_WORD_BITS;
+    uint64_t *found = NULL;
+
+    found = bsearch(&key, scan->word_idx, (size_t)scan->nr_words, sizeof(uint64_t), cmp_word_idx);
+    return found == NULL ? -1 : (int)(found - scan->word_idx);
+}
+
+static bool is_page_idle(const struct page_idle_scan *scan, uint64_t pfn)
+{
+    int i = find_word(scan, pfn);
+
+    return i >= 0 && (scan->word[i] & (1ULL << (pfn % PAGE_IDLE_WORD_BITS))) != 0;
+}
+
+static void mark_page_idle(struct page_idle_scan *scan, uint64_t pfn)
+{
+    int i = find_word(scan, pfn);
+
+    if (i >= 0) {
+        scan->mark[i] |= 1ULL << (pfn % PAGE_IDLE_WORD_BITS);
+    }
+}
+
+static bool idle_buf_set_addr(struct idle_buf *ib, uint64_t addr)
+{
+    int i;
+
+    if (ib->pos + 1 + sizeof(uint64_t) > ib->size) {
+        return false;
+    }
+
+    ib->buf[ib->pos++] = PIP_CMD_SET_HVA;
+    /* the address is stored in big endian */
+    for (i = (int)sizeof(uint64_t) - 1; i >= 0; i--) {
+        ib->buf[ib->pos++] = (unsigned char)(addr >> ((unsigned int)i * BITS_PER_BYTE));
+    }
+    ib->last = ib->size;
+    return true;
+}
+
+/* append nr pages of type, merged into the last entry when the type is the same */
+static bool idle_buf_put(struct idle_buf *ib, enum page_idle_type type, int nr)
+{
+    unsigned char *last = NULL;
+    int room;
+
+    while (nr > 0) {
+        if (ib->last != ib->size) {
+            last = &ib->buf[ib->last];
+            room = IDLE_ENTRY_NR_MAX - (*last & IDLE_ENTRY_NR_MAX);
+            if ((*last >> IDLE_ENTRY_TYPE_SHIFT) == type && room > 0) {
+                room = room < nr ? room : nr;
+                *last += (unsigned char)room;
+                nr -= room;
+                continue;
+            }
+        }
+
+        if (ib->pos >= ib->size) {
+            return false;
+        }
+        ib->last = ib->pos;
+        ib->buf[ib->pos++] = (unsigned char)((unsigned int)type << IDLE_ENTRY_TYPE_SHIFT);
+    }
+    return true;
+}
+
+/* a thp is seen as the pfns of a whole aligned pmd which are contiguous from an aligned head */
+static bool is_thp_batch(const struct page_idle_scan *scan, int nr)
+{
+    int i;
+    uint64_t head = entry_to_pfn(scan->entry[0]);
+
+    if (nr != PAGE_IDLE_BATCH || head == 0 || head % PAGE_IDLE_BATCH != 0) {
+        return false;
+    }
+    for (i = 1; i < nr; i++) {
+        if (entry_to_pfn(scan->entry[i]) != head + (uint64_t)i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_hole_batch(const struct page_idle_scan *scan, int nr)
+{
+    int i;
+
+    if (nr != PAGE_IDLE_BATCH) {
+        return false;
+    }
+    for (i = 0; i < nr; i++) {
+        if (entry_to_pfn(scan->entry[i]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* the access of a thp is tracked on its head page */
+static bool fill_thp_batch(struct page_idle_scan *scan, struct idle_buf *ib)
+{
+    uint64_t head = entry_to_pfn(scan->entry[0]);
+
+    if (!idle_buf_put(ib, is_page_idle(scan, head) ? PMD_IDLE : PMD_ACCESS, 1)) {
+        return false;
+    }
+    mark_page_idle(scan, head);
+    return true;
+}
+
+/* only the pages reported are set idle, the access of the others is kept for the next read */
+static bool fill_pte_batch(struct page_idle_scan *scan, struct idle_buf *ib, int nr)
+{
+    int i;
+    uint64_t pfn;
+    enum page_idle_type type;
+
+    for (i = 0; i < nr; i++) {
+        pfn = entry_to_pfn(scan->entry[i]);
+        if (pfn == 0) {
+            type = PTE_HOLE;
+        } else {
+            type = is_page_idle(scan, pfn) ? PTE_IDLE : PTE_ACCESS;
+        }
+        if (!idle_buf_put(ib, type, 1)) {
+            return false;
+        }
+        if (pfn != 0) {
+            mark_page_idle(scan, pfn);
+        }
+    }
+    return true;
+}
+
+/*
+ * translate the pages to pfns by pagemap a pmd at a time, then read the idle bits of the pfns
+ * from the bitmap and set them idle again.
+ */
+static ssize_t page_idle_read(struct scan_backend *backend, uint64_t addr, unsigned char *buf, size_t size)
+{
+    struct page_idle_scan *scan = (struct page_idle_scan *)backend->priv;
+    struct idle_buf ib = {buf, size, 0, size};
+    uint64_t page_size = (uint64_t)page_type_to_size(PTE_TYPE);
+    uint64_t pmd_size = (uint64_t)page_type_to_size(PMD_TYPE);
+    uint64_t start = addr & ~(page_size - 1);
+    uint64_t end = start + (uint64_t)size * IDLE_PAGES_PER_BYTE * page_size;
+    uint64_t batch_end;
+    ssize_t ret;
+    int nr;
+    bool filled = false;
+
+    if (!idle_buf_set_addr(&ib, start)) {
+        return 0;
+    }
+
+    for (; start < end; start = batch_end) {
+        batch_end = (start & ~(pmd_size - 1)) + pmd_size;
+        batch_end = batch_end < end ? batch_end : end;
+        nr = (int)((batch_end - start) / page_size);
+
+        ret = pread(fileno(scan->pagemap_fp), scan->entry, (size_t)nr * sizeof(uint64_t),
+                    (off_t)(start / page_size * sizeof(uint64_t)));
+        if (ret < 0) {
+            etmemd_log(ETMEMD_LOG_ERR, "read pagemap fail (%s)\n", strerror(errno));
+            return -1;
+        }
+        nr = (int)((size_t)ret / sizeof(uint64_t));
+        if (nr == 0) {
+            break;
+        }
+
+        if (is_hole_batch(scan, nr)) {
+            if (!idle_buf_put(&ib, PMD_HOLE, 1)) {
+                break;
+            }
+            continue;
+        }
+
+        collect_words(scan, nr);
+        read_words(scan);
+        if (is_thp_batch(scan, nr)) {
+            filled = fill_thp_batch(scan, &ib);
+        } else {
+            filled = fill_pte_batch(scan, &ib, nr);
+        }
+        write_words(scan);
+        if (!filled) {
+            break;
+        }
+    }
+
+    return (ssize_t)ib.pos;
+}
+
+static const struct scan_backend_ops g_page_idle_ops = {
+    .name = "page_idle",
+    .open = page_idle_open,
+    .read = page_idle_read,
+    .close = page_idle_close,
+};
+
+int scan_backend_open(struct scan_backend *backend, enum scan_source source,
+                      const char *pid, struct ioctl_para *ioctl_para)
+{
+    backend->ops = source == SCAN_SRC_PAGE_IDLE ? &g_page_idle_ops : &g_idle_pages_ops;
+    backend->priv = NULL;
+
+    return backend->ops->open(backend, pid, ioctl_para);
+}
+
+void scan_backend_close(struct scan_backend *backend)
+{
+    if (backend->priv == NULL) {
+        return;
+    }
+    backend->ops->close(backend);
+    backend->priv = NULL;
+}
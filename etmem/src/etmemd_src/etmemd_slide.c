@@ -18,6 +18,7 @@
 #include <string.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <numa.h>
 
 #include "securec.h"
 #include "etmemd_log.h"
@@ -28,15 +29,123 @@
 #include "etmemd_migrate.h"
 #include "etmemd_pool_adapter.h"
 #include "etmemd_file.h"
+#include "etmemd_rank.h"
 
-static struct memory_grade *slide_policy_interface(struct page_sort **page_sort, const struct task_pid *tpid)
+double slide_evict_cost(const struct page_refs *page_refs, const struct slide_params *params, int loop)
+{
+    double cost = page_refs->possibility;
+
+    /* a dirty page costs a swap write to evict, a clean one is dropped or already has a copy in swap */
+    if (params->dirty_weight == 0 || loop <= 0) {
+        return cost;
+    }
+    cost += (double)params->dirty_weight / 100 * page_refs->dirty / loop;
+    return cost > 1.0 ? 1.0 : cost;
+}
+
+static int slide_scan_loop(const struct task_pid *tpid)
+{
+    return ((struct page_scan *)tpid->tk->eng->proj->scan_param)->loop;
+}
+
+/* weight of the pid when the reclaim target of its cgroup is distributed */
+static unsigned long count_cold_pages(const struct page_sort *page_sort, int t)
+{
+    const struct page_refs *page_refs = NULL;
+    unsigned long count = 0;
+    int i;
+
+    for (i = 0; i < PAGE_SORT_NUM; i++) {
+        for (page_refs = page_sort->page_refs_sort[i]; page_refs != NULL; page_refs = page_refs->next) {
+            if ((int)(page_refs->possibility * 100) < t) {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+/* the most the pid may give out without dropping below its own dram_percent */
+static unsigned long rank_pid_floor(unsigned long rss, unsigned long swap, const struct slide_params *slide_params)
+{
+    unsigned long keep;
+
+    if (slide_params->dram_percent == 0) {
+        return rss;
+    }
+
+    keep = (rss + swap) / 100 * slide_params->dram_percent;
+    return rss > keep ? rss - keep : 0;
+}
+
+/*
+ * publish the hotness histogram of the pid to the project, and take its pages colder than the
+ * project cutoff. each pid takes the same fraction of the cutoff bin, so the project target is
+ * met once all pids are scanned, without ordering the pages of different pids.
+ */
+static void slide_policy_global(struct page_sort *page_sort, struct task_pid *tpid,
+                                const struct slide_params *slide_params, struct memory_grade *memory_grade)
+{
+    struct page_refs **page_refs = NULL;
+    struct rank_cutoff cutoff;
+    unsigned long hist[RANK_BIN_NUM] = {0};
+    unsigned long boundary;
+    unsigned long budget;
+    unsigned long size;
+    int loop = slide_scan_loop(tpid);
+    int bin;
+    int i;
+
+    for (i = 0; i < PAGE_SORT_NUM; i++) {
+        struct page_refs *p = page_sort->page_refs_sort[i];
+        for (; p != NULL; p = p->next) {
+            bin = etmemd_rank_bin(slide_evict_cost(p, slide_params, loop));
+            hist[bin] += (unsigned long)page_type_to_size(p->type) / 1024;
+        }
+    }
+
+    if (etmemd_mem_snapshot_pid(&tpid->mem_snap, tpid->pid) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get vmrss and swapout of %u fail", tpid->pid);
+        return;
+    }
+
+    if (etmemd_rank_publish(tpid, hist, tpid->mem_snap.vm_rss, tpid->mem_snap.vm_swap) != 0) {
+        return;
+    }
+
+    etmemd_rank_cutoff(tpid->tk->eng->proj, &cutoff);
+    budget = rank_pid_floor(tpid->mem_snap.vm_rss, tpid->mem_snap.vm_swap, slide_params);
+    boundary = cutoff.bin < RANK_BIN_NUM ? (unsigned long)(hist[cutoff.bin] * cutoff.fraction) : 0;
+
+    for (i = 0; i < PAGE_SORT_NUM && budget > 0; i++) {
+        page_refs = &page_sort->page_refs_sort[i];
+
+        while (*page_refs != NULL && budget > 0) {
+            bin = etmemd_rank_bin(slide_evict_cost(*page_refs, slide_params, loop));
+            size = (unsigned long)page_type_to_size((*page_refs)->type) / 1024;
+            if (bin >= slide_params->t || bin > cutoff.bin || size > budget ||
+                (bin == cutoff.bin && size > boundary)) {
+                page_refs = &(*page_refs)->next;
+                continue;
+            }
+
+            if (bin == cutoff.bin) {
+                boundary -= size;
+            }
+            budget -= size;
+            *page_refs = add_page_refs_into_memory_grade(*page_refs, &memory_grade->cold_pages);
+        }
+    }
+}
+
+static struct memory_grade *slide_policy_interface(struct page_sort **page_sort, struct task_pid *tpid,
+                                                   const struct slide_params *slide_params)
 {
-    struct slide_params *slide_params = (struct slide_params *)(tpid->tk->params);
     struct page_refs **page_refs = NULL;
     struct memory_grade *memory_grade = NULL;
     unsigned long need_2_swap_num;
     volatile uint64_t count = 0;
-    struct page_scan *page_scan = (struct page_scan *)tpid->tk->eng->proj->scan_param;
 
     if (slide_params == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "cannot get params for slide\n");
@@ -49,6 +158,11 @@ static struct memory_grade *slide_policy_interface(struct page_sort **page_sort,
         return NULL;
     }
 
+    if (tpid->tk->eng->proj->rank != NULL) {
+        slide_policy_global(*page_sort, tpid, slide_params, memory_grade);
+        return memory_grade;
+    }
+
     if (slide_params->dram_percent == 0) {
         page_refs = (*page_sort)->page_refs;
 
@@ -63,17 +177,24 @@ static struct memory_grade *slide_policy_interface(struct page_sort **page_sort,
         return memory_grade;
     }
 
-    need_2_swap_num = check_should_migrate(tpid);
+    if (tpid->tk->cgroup != NULL) {
+        tpid->cold_pages = count_cold_pages(*page_sort, slide_params->t);
+    }
+
+    need_2_swap_num = check_should_migrate(tpid, slide_params);
     if (need_2_swap_num == 0)
         goto count_out;
-    // the total loop number should equal the size of page->sort in "etmemd_scan.c" 
-    for (int i = 0; i < 5; i++) {
+    /*
+     * the bins only order the pages by the eviction cost, so the clean cold pages go before the dirty ones.
+     * whether a page is cold is still told by its possibility against t, not by the cost.
+     */
+    for (int i = 0; i < PAGE_SORT_NUM; i++) {
         page_refs = &((*page_sort)->page_refs_sort[i]);
 
         while (*page_refs != NULL) {
             if ((int)((*page_refs)->possibility * 100) >= slide_params->t) {
                 *page_refs = add_page_refs_into_memory_grade(*page_refs, &memory_grade->hot_pages);
-                goto count_out;
+                continue;
             }
 
             *page_refs = add_page_refs_into_memory_grade(*page_refs, &memory_grade->cold_pages);
@@ -87,8 +208,79 @@ count_out:
     return memory_grade;
 }
 
-static int slide_do_migrate(unsigned int pid, const struct memory_grade *memory_grade)
+/* move pages in [t, warm_t) to the tail of candidates, the order of lists is the priority */
+static void pick_warm_from_list(struct page_refs **page_refs, const struct slide_params *slide_params,
+                                struct page_refs ***tail)
+{
+    struct page_refs *page = NULL;
+    int p;
+
+    while (*page_refs != NULL) {
+        p = (int)((*page_refs)->possibility * 100);
+        if (p < slide_params->t || p >= slide_params->warm_t) {
+            page_refs = &(*page_refs)->next;
+            continue;
+        }
+
+        page = *page_refs;
+        *page_refs = page->next;
+        page->next = NULL;
+        **tail = page;
+        *tail = &page->next;
+    }
+}
+
+/*
+ * pages not picked as cold, and in [t, warm_t), are moved to the slow node as long as it has
+ * free memory. pages still colder than t are left in dram, they are over the swap target.
+ * pages already on the slow node are not moved again, and not charged to its free memory.
+ */
+static void slide_pick_warm(unsigned int pid, struct page_sort *page_sort, struct memory_grade *memory_grade,
+                            const struct slide_params *slide_params)
+{
+    struct page_refs *candidates = NULL;
+    struct page_refs **tail = &candidates;
+    unsigned long capacity;
+    unsigned long size;
+    int i;
+
+    if (slide_params->warm_t == 0) {
+        return;
+    }
+
+    if (etmemd_node_free_mem(slide_params->slow_node, &capacity) != 0 || capacity == 0) {
+        return;
+    }
+
+    pick_warm_from_list(&memory_grade->hot_pages, slide_params, &tail);
+    if (page_sort->page_refs != NULL) {
+        pick_warm_from_list(page_sort->page_refs, slide_params, &tail);
+    }
+    for (i = 0; i < PAGE_SORT_NUM; i++) {
+        pick_warm_from_list(&page_sort->page_refs_sort[i], slide_params, &tail);
+    }
+
+    /* pages left on the slow node stay as they are, like the hot pages */
+    if (candidates != NULL &&
+        etmemd_take_node_pages(pid, &candidates, slide_params->slow_node, &memory_grade->hot_pages) < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pid %u cannot query node of warm pages\n", pid);
+    }
+
+    while (candidates != NULL) {
+        size = (unsigned long)page_type_to_size(candidates->type) / 1024;
+        if (size > capacity) {
+            candidates = add_page_refs_into_memory_grade(candidates, &memory_grade->hot_pages);
+            continue;
+        }
+        capacity -= size;
+        candidates = add_page_refs_into_memory_grade(candidates, &memory_grade->warm_pages);
+    }
+}
+
+static int slide_do_migrate(unsigned int pid, const struct memory_grade *memory_grade,
+                            const struct slide_params *params)
 {
+    int moved;
     int ret;
     char pid_str[PID_STR_MAX_LEN] = {0};
 
@@ -102,6 +294,16 @@ static int slide_do_migrate(unsigned int pid, const struct memory_grade *memory_
         return -1;
     }
 
+    if (memory_grade->warm_pages != NULL) {
+        moved = etmemd_migrate_node(pid, memory_grade->warm_pages, params->slow_node);
+        if (moved < 0) {
+            /* the cold pages are still swapped out, the warm pages are tried again next interval */
+            etmemd_log(ETMEMD_LOG_ERR, "pid %u fails to move warm pages to node %d\n", pid, params->slow_node);
+        } else {
+            etmemd_log(ETMEMD_LOG_DEBUG, "pid %u moves %d warm pages to node %d\n", pid, moved, params->slow_node);
+        }
+    }
+
     /* we swap the cold pages for temporary, and do other operations later */
     ret = etmemd_grade_migrate(pid_str, memory_grade);
     return ret;
@@ -109,25 +311,16 @@ static int slide_do_migrate(unsigned int pid, const struct memory_grade *memory_
 
 static int check_sysmem_lower_threshold(struct task_pid *tk_pid)
 {
-    unsigned long mem_total;
-    unsigned long mem_free;
+    struct mem_snapshot *snap = &tk_pid->mem_snap;
     int vm_cmp;
-    int ret;
 
-    ret = get_mem_from_proc_file(NULL, PROC_MEMINFO, &mem_total, "MemTotal");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get memtotal fail\n");
-        return DONT_SWAP;
-    }
-
-    ret = get_mem_from_proc_file(NULL, PROC_MEMINFO, &mem_free, "MemFree");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get memfree fail\n");
+    if (etmemd_mem_snapshot_sys(snap) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get system meminfo fail\n");
         return DONT_SWAP;
     }
 
     /* Calculate the free memory percentage in 0 - 100 */
-    vm_cmp = (mem_free * 100) / mem_total;
+    vm_cmp = (snap->mem_free * 100) / snap->mem_total;
     if (vm_cmp < tk_pid->tk->eng->proj->sysmem_threshold) {
         return DO_SWAP;
     }
@@ -135,17 +328,9 @@ static int check_sysmem_lower_threshold(struct task_pid *tk_pid)
     return DONT_SWAP;
 }
 
-static int check_pid_should_swap(const char *pid, unsigned long vmrss, const struct task_pid *tk_pid)
+static int check_pid_should_swap(const struct task_pid *tk_pid, unsigned long vmrss, unsigned long vmswap)
 {
-    unsigned long vmswap;
     unsigned long vmcmp;
-    int ret;
-
-    ret = get_mem_from_proc_file(pid, STATUS_FILE, &vmswap, "VmSwap");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get VmSwap fail\n");
-        return DONT_SWAP;
-    }
 
     /* Calculate the total amount of memory that can be swappout for the current process
      * and check whether the memory is larger than the current swapout amount.
@@ -158,31 +343,23 @@ static int check_pid_should_swap(const char *pid, unsigned long vmrss, const str
     return DONT_SWAP;
 }
 
-static int check_pidmem_lower_threshold(struct task_pid *tk_pid)
+static int check_pidmem_lower_threshold(struct task_pid *tk_pid, const struct slide_params *params)
 {
-    struct slide_params *params = NULL;
     unsigned long vmrss;
-    int ret;
-    char pid_str[PID_STR_MAX_LEN] = {0};
+    unsigned long vmswap;
 
-    params = (struct slide_params *)tk_pid->tk->params;
     if (params == NULL) {
         return DONT_SWAP;
     }
 
-    if (snprintf_s(pid_str, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", tk_pid->pid) <= 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "snprintf pid fail %u", tk_pid->pid);
-        return DONT_SWAP;
-    }
-
-    ret = get_mem_from_proc_file(pid_str, STATUS_FILE, &vmrss, "VmRSS");
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get VmRSS fail\n");
+    /* the usage of the whole cgroup for task of cgroup type */
+    if (etmemd_task_pid_mem_usage(tk_pid, &vmrss, &vmswap) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "get VmRSS and VmSwap of pid %u fail\n", tk_pid->pid);
         return DONT_SWAP;
     }
 
     if (params->swap_threshold == 0) {
-        return check_pid_should_swap(pid_str, vmrss, tk_pid);
+        return check_pid_should_swap(tk_pid, vmrss, vmswap);
     }
 
     if (vmrss > params->swap_threshold) {
@@ -192,7 +369,7 @@ static int check_pidmem_lower_threshold(struct task_pid *tk_pid)
     return DONT_SWAP;
 }
 
-static int check_should_swap(struct task_pid *tk_pid)
+static int check_should_swap(struct task_pid *tk_pid, const struct slide_params *params)
 {
     if (tk_pid->tk->eng->proj->sysmem_threshold == -1) {
         return DO_SWAP;
@@ -202,18 +379,41 @@ static int check_should_swap(struct task_pid *tk_pid)
         return DONT_SWAP;
     }
 
-    return check_pidmem_lower_threshold(tk_pid);
+    return check_pidmem_lower_threshold(tk_pid, params);
 }
 
-static void *slide_executor(void *arg)
+/* the scan hook learns from every loop, even if nothing is to be swapped out in it */
+static void slide_scan_for_hook(struct task_pid *tk_pid, const struct slide_params *params)
+{
+    struct page_refs *page_refs = NULL;
+
+    pthread_cleanup_push(clean_page_refs_unexpected, &page_refs);
+    page_refs = etmemd_do_scan(tk_pid, tk_pid->tk, 0);
+    if (page_refs != NULL) {
+        params->scan_hook(tk_pid, page_refs);
+    }
+    pthread_cleanup_pop(1);
+}
+
+int slide_do_executor(struct task_pid *tk_pid, const struct slide_params *params)
 {
-    struct task_pid *tk_pid = (struct task_pid *)arg;
     struct page_refs *page_refs = NULL;
     struct memory_grade *memory_grade = NULL;
     struct page_sort *page_sort = NULL;
+    volatile int ret = -1;  /* set between pthread_cleanup_push and pop, which use sigsetjmp */
 
-    if (check_should_swap(tk_pid) == DONT_SWAP) {
-        return NULL;
+    if (etmemd_task_pid_exited(tk_pid)) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pid %u exits, skip it\n", tk_pid->pid);
+        return -1;
+    }
+
+    /* counters read from meminfo and status are shared by all checks of this cycle */
+    etmemd_mem_snapshot_invalidate(&tk_pid->mem_snap);
+    if (check_should_swap(tk_pid, params) == DONT_SWAP) {
+        if (params->scan_hook != NULL) {
+            slide_scan_for_hook(tk_pid, params);
+        }
+        return -1;
     }
 
     /* register cleanup function in case of unexpected cancellation detected,
@@ -222,19 +422,26 @@ static void *slide_executor(void *arg)
     pthread_cleanup_push(clean_page_refs_unexpected, &page_refs);
     pthread_cleanup_push(clean_page_sort_unexpected, &page_sort);
 
-    page_refs = etmemd_do_scan(tk_pid, tk_pid->tk);
+    /* the write of pages is only tracked when it takes part in the eviction cost */
+    page_refs = etmemd_do_scan(tk_pid, tk_pid->tk, params->dirty_weight != 0 ? SCAN_DIRTY_PAGE : 0);
     if (page_refs == NULL) {
         etmemd_log(ETMEMD_LOG_WARN, "pid %u cannot get page refs\n", tk_pid->pid);
         goto scan_out;
     }
+    if (params->scan_hook != NULL) {
+        params->scan_hook(tk_pid, page_refs);
+    }
 
-    page_sort = sort_page_refs(&page_refs, tk_pid);
+    page_sort = sort_page_refs(&page_refs, tk_pid, params);
     if (page_sort == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "failed to alloc memory for page sort.", tk_pid->pid);
         goto scan_out;
     }
 
-    memory_grade = slide_policy_interface(&page_sort, tk_pid);
+    memory_grade = slide_policy_interface(&page_sort, tk_pid, params);
+    if (memory_grade != NULL) {
+        slide_pick_warm(tk_pid->pid, page_sort, memory_grade, params);
+    }
 
 scan_out:
     /* clean up page_sort linked array */
@@ -252,8 +459,20 @@ scan_out:
         goto exit;
     }
 
-    if (slide_do_migrate(tk_pid->pid, memory_grade) != 0) {
+    if (params->grade_hook != NULL) {
+        params->grade_hook(tk_pid, memory_grade);
+    }
+
+    /* the process exits during the scan */
+    if (etmemd_task_pid_exited(tk_pid)) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pid %u exits, cancel the migration\n", tk_pid->pid);
+        goto exit;
+    }
+
+    if (slide_do_migrate(tk_pid->pid, memory_grade, params) != 0) {
         etmemd_log(ETMEMD_LOG_DEBUG, "slide migrate for pid %u fail\n", tk_pid->pid);
+    } else {
+        ret = 0;
     }
 
     if (etmemd_reclaim_swapcache(tk_pid) != 0) {
@@ -267,6 +486,14 @@ exit:
         etmemd_log(ETMEMD_LOG_INFO, "malloc_trim to release memory for pid %u fail\n", tk_pid->pid);
     }
 
+    return ret;
+}
+
+static void *slide_executor(void *arg)
+{
+    struct task_pid *tk_pid = (struct task_pid *)arg;
+
+    (void)slide_do_executor(tk_pid, (struct slide_params *)tk_pid->tk->params);
     return NULL;
 }
 
@@ -320,30 +547,99 @@ static int fill_task_swap_threshold(void *obj, void *val)
     return 0;
 }
 
+static int fill_task_warm_threshold(void *obj, void *val)
+{
+    struct slide_params *params = (struct slide_params *)obj;
+    int warm_t = parse_to_int(val);
+
+    if (warm_t <= 0 || warm_t > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "slide engine param warm_threshold %d must be in (0, 100]\n", warm_t);
+        return -1;
+    }
+
+    params->warm_t = warm_t;
+    return 0;
+}
+
+static int fill_task_slow_node(void *obj, void *val)
+{
+    struct slide_params *params = (struct slide_params *)obj;
+    int node = parse_to_int(val);
+
+    if (numa_available() < 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "numa is not available for slow_node\n");
+        return -1;
+    }
+
+    if (node < 0 || node > numa_max_node()) {
+        etmemd_log(ETMEMD_LOG_ERR, "slide engine param slow_node %d must be in [0, %d]\n", node, numa_max_node());
+        return -1;
+    }
+
+    params->slow_node = node;
+    return 0;
+}
+
+static int fill_task_dirty_weight(void *obj, void *val)
+{
+    struct slide_params *params = (struct slide_params *)obj;
+    int weight = parse_to_int(val);
+
+    if (weight < 0 || weight > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "slide engine param dirty_weight %d must be in [0, 100]\n", weight);
+        return -1;
+    }
+
+    params->dirty_weight = weight;
+    return 0;
+}
+
 static struct config_item g_slide_task_config_items[] = {
     {"T", INT_VAL, fill_task_threshold, false},
     {"swap_threshold", STR_VAL, fill_task_swap_threshold, true},
     {"dram_percent", INT_VAL, fill_task_dram_percent, true},
+    {"warm_threshold", INT_VAL, fill_task_warm_threshold, true},
+    {"slow_node", INT_VAL, fill_task_slow_node, true},
+    {"dirty_weight", INT_VAL, fill_task_dirty_weight, true},
 };
 
+int slide_fill_params(GKeyFile *config, struct slide_params *params)
+{
+    params->slow_node = -1;
+    if (parse_file_config(config, TASK_GROUP, g_slide_task_config_items, ARRAY_SIZE(g_slide_task_config_items),
+                          (void *)params) != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "slide fill task fail\n");
+        return -1;
+    }
+    //params->t is a percentage.
+    if (params->t > 100) {
+        etmemd_log(ETMEMD_LOG_ERR, "engine param T must less than 1.\n");
+        return -1;
+    }
+
+    if ((params->warm_t == 0) != (params->slow_node == -1)) {
+        etmemd_log(ETMEMD_LOG_ERR, "warm_threshold and slow_node must be set together\n");
+        return -1;
+    }
+
+    if (params->warm_t != 0 && params->warm_t <= params->t) {
+        etmemd_log(ETMEMD_LOG_ERR, "warm_threshold %d must be larger than T %d\n", params->warm_t, params->t);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int slide_fill_task(GKeyFile *config, struct task *tk)
 {
     struct slide_params *params = calloc(1, sizeof(struct slide_params));
-    struct page_scan *page_scan = (struct page_scan *)tk->eng->proj->scan_param;
 
     if (params == NULL) {
         etmemd_log(ETMEMD_LOG_ERR, "alloc slide param fail\n");
         return -1;
     }
 
-    if (parse_file_config(config, TASK_GROUP, g_slide_task_config_items, ARRAY_SIZE(g_slide_task_config_items),
-                          (void *)params) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "slide fill task fail\n");
-        goto free_params;
-    }
-    //params->t is a percentage.
-    if (params->t > 100) {
-        etmemd_log(ETMEMD_LOG_ERR, "engine param T must less than 1.\n");
+    if (slide_fill_params(config, params) != 0) {
         goto free_params;
     }
     tk->params = params;
@@ -19,7 +19,9 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <fcntl.h>
-#include <sys/wait.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 
 #include "securec.h"
@@ -28,56 +30,10 @@
 #include "etmemd_task.h"
 #include "etmemd_engine.h"
 #include "etmemd_file.h"
-
-static int get_pid_through_pipe(char *arg_pid[], const int *pipefd)
-{
-    pid_t pid;
-    int status;
-    int stdout_copy_fd;
-    int ret;
-
-    pid = fork();
-    if (pid < 0) {
-        return -1;
-    }
-
-    if (pid == 0) {
-        close(pipefd[0]);
-
-        stdout_copy_fd = dup(STDOUT_FILENO);
-        if (stdout_copy_fd < 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "dup(STDOUT_FILENO) fail.\n");
-            close(pipefd[1]);
-            return -1;
-        }
-
-        ret = dup2(pipefd[1], fileno(stdout));
-        if (ret == -1) {
-            etmemd_log(ETMEMD_LOG_ERR, "dup2 pipefd fail.\n");
-            close(pipefd[1]);
-            return -1;
-        }
-
-        if (execve(arg_pid[0], arg_pid, NULL) == -1) {
-            etmemd_log(ETMEMD_LOG_ERR, "execve %s fail with %s.\n", arg_pid[0], strerror(errno));
-            close(pipefd[1]);
-            return -1;
-        }
-
-        if (fflush(stdout) != 0) {
-            etmemd_log(ETMEMD_LOG_ERR, "fflush execve stdout fail.\n");
-            close(pipefd[1]);
-            return -1;
-        }
-        close(pipefd[1]);
-        dup2(stdout_copy_fd, fileno(stdout));
-    }
-
-    /* wait for execve done */
-    wait(&status);
-
-    return 0;
-}
+#include "etmemd_proc.h"
+#include "etmemd_proc_event.h"
+#include "etmemd_cgroup.h"
+#include "etmemd_rank.h"
 
 void free_task_pid_mem(struct task_pid **tk_pid)
 {
@@ -85,6 +41,12 @@ void free_task_pid_mem(struct task_pid **tk_pid)
     if (eng->ops->free_pid_params != NULL) {
         eng->ops->free_pid_params(eng, tk_pid);
     }
+    etmemd_proc_watch_del(*tk_pid);
+    if ((*tk_pid)->pidfd >= 0) {
+        close((*tk_pid)->pidfd);
+    }
+    etmemd_mem_snapshot_release(&(*tk_pid)->mem_snap);
+    etmemd_rank_pid_release(*tk_pid);
     etmemd_safe_free((void **)tk_pid);
 }
 
@@ -99,7 +61,20 @@ static void clean_nouse_pid(struct task_pid **tk_pid)
     }
 }
 
-static struct task_pid *alloc_tkpid_node(unsigned int pid, struct task *tk)
+static int open_pidfd(unsigned int pid)
+{
+#ifdef SYS_pidfd_open
+    int fd = (int)syscall(SYS_pidfd_open, (pid_t)pid, 0);
+    if (fd < 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "pidfd_open for pid %u fail, errno: %d\n", pid, errno);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static struct task_pid *alloc_tkpid_node(unsigned int pid, struct task *tk, bool root)
 {
     struct task_pid *tk_pid = NULL;
     struct engine *eng = tk->eng;
@@ -111,19 +86,25 @@ static struct task_pid *alloc_tkpid_node(unsigned int pid, struct task *tk)
     }
     tk_pid->pid = pid;
     tk_pid->tk = tk;
+    tk_pid->root = root;
+    tk_pid->pidfd = open_pidfd(pid);
 
     if (eng->ops->alloc_pid_params != NULL && eng->ops->alloc_pid_params(eng, &tk_pid) != 0) {
+        if (tk_pid->pidfd >= 0) {
+            close(tk_pid->pidfd);
+        }
         free(tk_pid);
         return NULL;
     }
 
+    etmemd_proc_watch_add(tk_pid);
     return tk_pid;
 }
 
 static struct task_pid **insert_task_pids(unsigned int pid, struct task_pid **current_pid, struct task *tk)
 {
     struct task_pid *tk_pid = NULL;
-    tk_pid = alloc_tkpid_node(pid, tk);
+    tk_pid = alloc_tkpid_node(pid, tk, false);
     if (tk_pid == NULL) {
         return NULL;
     }
@@ -139,11 +120,12 @@ static struct task_pid **update_task_pids(unsigned int pid, struct task_pid **cu
         return insert_task_pids(pid, current_pid, tk);
     }
 
-    if (pid == (*current_pid)->pid) {
+    if (pid == (*current_pid)->pid && !etmemd_task_pid_exited(*current_pid)) {
         return &((*current_pid)->next);
     }
 
-    if (pid > (*current_pid)->pid) {
+    /* the pid is reused by a new process if the old one exited */
+    if (pid >= (*current_pid)->pid) {
         tk_tmp = *current_pid;
         *current_pid = (*current_pid)->next;
         free_task_pid_mem(&tk_tmp);
@@ -164,11 +146,11 @@ static int fill_task_pid(struct task *tk, const char *val)
         return -1;
     }
 
-    if (tk->pids != NULL && tk->pids->pid == pid)
+    if (tk->pids != NULL && tk->pids->pid == pid && !etmemd_task_pid_exited(tk->pids))
         return 0;
 
     clean_nouse_pid(&(tk->pids));
-    tk_pid = alloc_tkpid_node(pid, tk);
+    tk_pid = alloc_tkpid_node(pid, tk, true);
     if (tk_pid == NULL) {
         return -1;
     }
@@ -178,70 +160,29 @@ static int fill_task_pid(struct task *tk, const char *val)
     return 0;
 }
 
-static int read_fill_child_pid_file(struct task *tk, FILE *file)
-{
-    struct task_pid **current_pid = &(tk->pids->next);
-    char line[FILE_LINE_MAX_LEN] = {};
-    unsigned int pid;
-    int ret;
-
-    while (fgets(line, FILE_LINE_MAX_LEN, file) != NULL) {
-        if (line[strlen(line) - 1] == '\n') {
-            line[strlen(line) - 1] = '\0';
-        }
-
-        ret = get_unsigned_int_value(line, &pid);
-        if (ret != 0) {
-            return ret;
-        }
-
-        current_pid = update_task_pids(pid, current_pid, tk);
-        if (current_pid == NULL) {
-            return -1;
-        }
-    }
-
-    clean_nouse_pid(current_pid);
-    return 0;
-}
-
-static int get_pid_from_type_name(char *val, char *pid)
+static int get_pid_from_type_name(const char *val, char *pid)
 {
-    char *arg_pid[] = {"/usr/bin/pgrep", "-x", val, NULL};
-    FILE *file = NULL;
+    struct proc_snapshot *snap = NULL;
+    unsigned int found;
     int ret = -1;
-    int pipefd[PIPE_FD_LEN]; /* used for pipefd[PIPE_FD_LEN] communication to obtain the task PID */
 
-    if (pipe(pipefd) == -1) {
+    snap = etmemd_proc_snapshot_get();
+    if (snap == NULL) {
         return -1;
     }
 
-    if (get_pid_through_pipe(arg_pid, pipefd) != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get pid through pipe failed.\n");
-        close(pipefd[1]);
-        goto err_out;
+    if (etmemd_proc_snapshot_find_name(snap, val, &found) != 0) {
+        goto out;
     }
 
-    close(pipefd[1]);
-    file = fdopen(pipefd[0], "r");
-    if (file == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "fopen pipefd[0] fail.\n");
-        goto err_out;
+    if (snprintf_s(pid, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%u", found) == -1) {
+        etmemd_log(ETMEMD_LOG_ERR, "snprintf for pid %u fail\n", found);
+        goto out;
     }
-
     ret = 0;
-    if (fgets(pid, PID_STR_MAX_LEN, file) == NULL) {
-        ret = -1;
-    } else if (strlen(pid) >= 1 && pid[strlen(pid) - 1] == '\n') {
-        /* remove the last character of \n, otherwise it will cause error of access() */
-        pid[strlen(pid) - 1] = '\0';
-    }
 
-    fclose(file);
-    return ret;
-
-err_out:
-    close(pipefd[0]);
+out:
+    etmemd_proc_snapshot_put(snap);
     return ret;
 }
 
@@ -269,43 +210,132 @@ int get_pid_from_task_type(const struct task *tk, char *pid)
     return -1;
 }
 
-static int fill_task_child_pid(struct task *tk, char *pid)
+static int fill_task_child_pid(struct task *tk, const char *pid)
 {
-    char *arg_pid[] = {"/usr/bin/pgrep", "-P", pid, NULL};
-    FILE *file = NULL;
-    int ret;
-    int pipefd[PIPE_FD_LEN]; /* used for pipefd[PIPE_FD_LEN] communication to obtain the task PID */
+    struct task_pid **current_pid = &(tk->pids->next);
+    const struct proc_child *children = NULL;
+    struct proc_snapshot *snap = NULL;
+    unsigned int ppid;
+    size_t nr;
+    size_t i;
+    int ret = 0;
+
+    if (get_unsigned_int_value(pid, &ppid) != 0) {
+        return -1;
+    }
 
-    if (pipe(pipefd) == -1) {
+    snap = etmemd_proc_snapshot_get();
+    if (snap == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "get proc snapshot fail.\n");
         return -1;
     }
 
-    ret = get_pid_through_pipe(arg_pid, pipefd);
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get pid through pipe failed.\n");
-        close(pipefd[1]);
-        goto err_out;
+    /* children are in pid order, so they can be merged with the sorted pids list */
+    nr = etmemd_proc_snapshot_children(snap, ppid, &children);
+    for (i = 0; i < nr; i++) {
+        current_pid = update_task_pids(children[i].pid, current_pid, tk);
+        if (current_pid == NULL) {
+            ret = -1;
+            goto out;
+        }
     }
 
-    close(pipefd[1]);
-    file = fdopen(pipefd[0], "r");
-    if (file == NULL) {
-        etmemd_log(ETMEMD_LOG_ERR, "fopen pipefd file fail.\n");
-        ret = -1;
-        goto err_out;
+    clean_nouse_pid(current_pid);
+
+out:
+    etmemd_proc_snapshot_put(snap);
+    return ret;
+}
+
+/* the process of tk_pid exits, running scan or migration of it should be cancelled */
+bool etmemd_task_pid_exited(const struct task_pid *tk_pid)
+{
+    struct pollfd pfd;
+
+    if (__atomic_load_n(&tk_pid->exited, __ATOMIC_ACQUIRE)) {
+        return true;
     }
 
-    ret = read_fill_child_pid_file(tk, file);
-    if (ret != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "get child pid through pipe file failed.\n");
+    if (tk_pid->pidfd < 0) {
+        return false;
     }
 
-    fclose(file);
-    return ret;
+    pfd.fd = tk_pid->pidfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN) != 0;
+}
 
-err_out:
-    close(pipefd[0]);
-    return ret;
+/* sleep between scans, but wake up as soon as the process exits. return true if it exits */
+bool etmemd_task_pid_sleep(const struct task_pid *tk_pid, unsigned int seconds)
+{
+    struct pollfd pfd;
+
+    if (tk_pid->pidfd < 0) {
+        sleep(seconds);
+        return etmemd_task_pid_exited(tk_pid);
+    }
+
+    pfd.fd = tk_pid->pidfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, (int)(seconds * MSEC_PER_SEC)) > 0 && (pfd.revents & POLLIN) != 0) {
+        return true;
+    }
+    return etmemd_task_pid_exited(tk_pid);
+}
+
+/* all processes in the cgroup are members of the task, none of them is the task pid */
+static int fill_task_cgroup_pids(struct task *tk)
+{
+    struct task_pid **current_pid = &(tk->pids);
+    unsigned int *pids = NULL;
+    size_t nr;
+    size_t i;
+
+    if (etmemd_cgroup_get_pids(tk->cgroup, &pids, &nr) != 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "get pids of cgroup %s fail\n", tk->cgroup->path);
+        etmemd_free_task_pids(tk);
+        return -1;
+    }
+
+    if (nr == 0) {
+        etmemd_log(ETMEMD_LOG_DEBUG, "cgroup %s of task %s is empty\n", tk->cgroup->path, tk->value);
+        etmemd_free_task_pids(tk);
+        return -1;
+    }
+
+    for (i = 0; i < nr; i++) {
+        current_pid = update_task_pids(pids[i], current_pid, tk);
+        if (current_pid == NULL) {
+            free(pids);
+            etmemd_free_task_pids(tk);
+            return -1;
+        }
+    }
+    clean_nouse_pid(current_pid);
+    free(pids);
+
+    if (etmemd_cgroup_refresh(tk) != 0) {
+        etmemd_log(ETMEMD_LOG_WARN, "get memory usage of cgroup %s fail\n", tk->cgroup->path);
+        return -1;
+    }
+    return 0;
+}
+
+int etmemd_task_pid_mem_usage(struct task_pid *tk_pid, unsigned long *rss, unsigned long *swap)
+{
+    if (tk_pid->tk->cgroup != NULL) {
+        return etmemd_cgroup_mem_usage(tk_pid->tk->cgroup, rss, swap);
+    }
+
+    if (etmemd_mem_snapshot_pid(&tk_pid->mem_snap, tk_pid->pid) != 0) {
+        return -1;
+    }
+
+    *rss = tk_pid->mem_snap.vm_rss;
+    *swap = tk_pid->mem_snap.vm_swap;
+    return 0;
 }
 
 static bool check_task_pid_exists(const char *pid)
@@ -344,6 +374,10 @@ int etmemd_get_task_pids(struct task *tk, bool recursive)
 {
     char pid[PID_STR_MAX_LEN] = {0};
 
+    if (tk->cgroup != NULL) {
+        return fill_task_cgroup_pids(tk);
+    }
+
     /* get the pid of target first */
     if (get_pid_from_task_type(tk, pid) != 0) {
         return -1;
@@ -376,6 +410,7 @@ int etmemd_get_task_pids(struct task *tk, bool recursive)
 
 static void clear_task_struct(struct task *task)
 {
+    etmemd_cgroup_task_free(task);
     etmemd_safe_free((void **)&task->type);
     etmemd_safe_free((void **)&task->value);
     etmemd_safe_free((void **)&task->name);
@@ -426,8 +461,8 @@ static int fill_task_type(void *obj, void *val)
 {
     struct task *tk = (struct task *)obj;
     char *type = (char *)val;
-    if (strcmp(val, "pid") != 0 && strcmp(val, "name") != 0) {
-        etmemd_log(ETMEMD_LOG_ERR, "invalid task type, must be pid or name.\n");
+    if (strcmp(val, "pid") != 0 && strcmp(val, "name") != 0 && strcmp(val, "cgroup") != 0) {
+        etmemd_log(ETMEMD_LOG_ERR, "invalid task type, must be pid, name or cgroup.\n");
         free(val);
         return -1;
     }
@@ -441,6 +476,12 @@ static int fill_task_value(void *obj, void *val)
     struct task *tk = (struct task *)obj;
     char *value = (char *)val;
 
+    /* value of cgroup task is a path, which is longer than a process name */
+    if (strcmp(tk->type, "cgroup") == 0) {
+        tk->value = value;
+        return etmemd_cgroup_task_init(tk);
+    }
+
     if (check_str_valid(value) != 0) {
         etmemd_log(ETMEMD_LOG_ERR, "invalid task value, please check.\n");
         free(val);
@@ -500,12 +541,38 @@ static int fill_task_swap_flag(void *obj, void *val)
     return -1;
 }
 
+static int fill_task_cgroup_recursive(void *obj, void *val)
+{
+    struct task *tk = (struct task *)obj;
+    char *recursive = (char *)val;
+    int ret = 0;
+
+    if (tk->cgroup == NULL) {
+        etmemd_log(ETMEMD_LOG_ERR, "cgroup_recursive is only for task of cgroup type.\n");
+        free(val);
+        return -1;
+    }
+
+    if (strcmp(recursive, "yes") == 0) {
+        tk->cgroup->recursive = true;
+    } else if (strcmp(recursive, "no") == 0) {
+        tk->cgroup->recursive = false;
+    } else {
+        etmemd_log(ETMEMD_LOG_ERR, "cgroup_recursive para is not valid.\n");
+        ret = -1;
+    }
+
+    free(val);
+    return ret;
+}
+
 struct config_item g_task_config_items[] = {
     {"name", STR_VAL, fill_task_name, false},
     {"type", STR_VAL, fill_task_type, false},
     {"value", STR_VAL, fill_task_value, false},
     {"swap_flag", STR_VAL, fill_task_swap_flag, true},
     {"max_threads", INT_VAL, fill_task_threads, true},
+    {"cgroup_recursive", STR_VAL, fill_task_cgroup_recursive, true},
 };
 
 static int task_fill_by_conf(GKeyFile *config, struct task *tk)
@@ -28,6 +28,22 @@ static void threadtimer_cancel_unlock(void *arg)
     pthread_mutex_unlock(tmp_mutex);
 }
 
+static void threadtimer_cancel_relock(void *arg)
+{
+    pthread_mutex_t *tmp_mutex = arg;
+    pthread_mutex_lock(tmp_mutex);
+}
+
+/* run func without the mutex, so that a kick or refresh does not wait for the executor to finish */
+static void thread_timer_run(timer_thread *timer, user_functional func)
+{
+    pthread_mutex_unlock(&timer->cond_mutex);
+    /* relock if cancelled, the mutex is unlocked by the cleanup of thread_timer_routine */
+    pthread_cleanup_push(threadtimer_cancel_relock, &timer->cond_mutex);
+    (*func)(timer->user_param);
+    pthread_cleanup_pop(1);
+}
+
 static void *thread_timer_routine(void *arg)
 {
     timer_thread *timer = (timer_thread *)arg;
@@ -40,6 +56,20 @@ static void *thread_timer_routine(void *arg)
     pthread_cleanup_push(threadtimer_cancel_unlock, &timer->cond_mutex);
     pthread_mutex_lock(&timer->cond_mutex);
     while (!timer->down) {
+        /* kicked while the executor was running */
+        if (__atomic_exchange_n(&timer->kicked, false, __ATOMIC_ACQ_REL)) {
+            thread_timer_run(timer, timer->functor);
+            continue;
+        }
+
+        /* asked to refresh while the executor was running */
+        if (__atomic_exchange_n(&timer->refresh, false, __ATOMIC_ACQ_REL)) {
+            if (timer->refresher != NULL) {
+                thread_timer_run(timer, timer->refresher);
+            }
+            continue;
+        }
+
         if (clock_gettime(CLOCK_MONOTONIC, &timespec) != 0) {
             etmemd_log(ETMEMD_LOG_ERR, "clock get time fail!\n");
             break;
@@ -54,7 +84,13 @@ static void *thread_timer_routine(void *arg)
         timespec.tv_nsec = 0;
         return_status = pthread_cond_timedwait(&timer->cond, &timer->cond_mutex, &timespec);
         if (return_status == ETIMEDOUT) {
-            (*timer->functor)(timer->user_param);
+            /* the executor does all the refresh does */
+            __atomic_store_n(&timer->kicked, false, __ATOMIC_RELEASE);
+            __atomic_store_n(&timer->refresh, false, __ATOMIC_RELEASE);
+            thread_timer_run(timer, timer->functor);
+        } else if (return_status == 0) {
+            /* kicked or spurious wakeup, a kick or refresh is handled at the head of the loop */
+            continue;
         } else {
             etmemd_log(ETMEMD_LOG_WARN, "timer will be exit ! \n");
             break;
@@ -135,6 +171,46 @@ int thread_timer_start(timer_thread* inst, void *(*executor)(void *arg), void *a
     return 0;
 }
 
+static void thread_timer_wake(timer_thread* inst)
+{
+    /*
+     * the flags are checked under the mutex before the timer waits, so the timer either sees the flag
+     * or is already waiting when the signal is sent. the executor runs without the mutex.
+     */
+    pthread_mutex_lock(&inst->cond_mutex);
+    pthread_cond_signal(&inst->cond);
+    pthread_mutex_unlock(&inst->cond_mutex);
+}
+
+void thread_timer_kick(timer_thread* inst)
+{
+    if (inst == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&inst->kicked, true, __ATOMIC_RELEASE);
+    thread_timer_wake(inst);
+}
+
+void thread_timer_set_refresher(timer_thread* inst, void *(*refresher)(void *arg))
+{
+    if (inst == NULL) {
+        return;
+    }
+
+    inst->refresher = refresher;
+}
+
+void thread_timer_refresh(timer_thread* inst)
+{
+    if (inst == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&inst->refresh, true, __ATOMIC_RELEASE);
+    thread_timer_wake(inst);
+}
+
 void thread_timer_stop(timer_thread* inst)
 {
     if (inst == NULL) {
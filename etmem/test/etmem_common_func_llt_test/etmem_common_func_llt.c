@@ -270,6 +270,45 @@ static void test_get_mem_from_proc_file_ok(void)
     CU_ASSERT_EQUAL(get_mem_from_proc_file("1", "/status", &data, "VmRSS"), 0);
 }
 
+static void test_get_mem_from_proc_buf(void)
+{
+    unsigned long total = 0;
+    unsigned long free_mem = 0;
+    unsigned long cached = 0;
+    const char *buf = "MemTotal:       16000 kB\nMemFree:         8000 kB\nSwapCached:        12 kB\n";
+    struct proc_mem_key keys[] = {
+        {"SwapCached", &cached, false},
+        {"MemFree", &free_mem, false},
+        {"MemTotal", &total, false},
+    };
+    struct proc_mem_key miss_key[] = {
+        {"Mem", &total, false},
+    };
+
+    CU_ASSERT_EQUAL(get_mem_from_proc_buf(buf, keys, ARRAY_SIZE(keys)), 0);
+    CU_ASSERT_EQUAL(total, 16000);
+    CU_ASSERT_EQUAL(free_mem, 8000);
+    CU_ASSERT_EQUAL(cached, 12);
+    CU_ASSERT_EQUAL(get_mem_from_proc_buf(buf, miss_key, ARRAY_SIZE(miss_key)), -1);
+    CU_ASSERT_EQUAL(get_mem_from_proc_buf(NULL, keys, ARRAY_SIZE(keys)), -1);
+}
+
+static void test_mem_snapshot(void)
+{
+    struct mem_snapshot snap = {0};
+
+    CU_ASSERT_EQUAL(etmemd_mem_snapshot_sys(&snap), 0);
+    CU_ASSERT_NOT_EQUAL(snap.mem_total, 0);
+    CU_ASSERT_EQUAL(etmemd_mem_snapshot_pid(&snap, 1), 0);
+    CU_ASSERT_TRUE(snap.status_opened);
+
+    /* reread with the fd kept open */
+    etmemd_mem_snapshot_invalidate(&snap);
+    CU_ASSERT_EQUAL(etmemd_mem_snapshot_pid(&snap, 1), 0);
+    etmemd_mem_snapshot_release(&snap);
+    CU_ASSERT_FALSE(snap.status_opened);
+}
+
 static void test_get_swap_threshold_inKB_error(void)
 {
     char *swap_threshold = "50m";
@@ -432,6 +471,8 @@ int main(int argc, const char **argv)
         CU_ADD_TEST(suite, test_get_proc_file_ok) == NULL ||
         CU_ADD_TEST(suite, test_get_mem_from_proc_file_error) == NULL ||
         CU_ADD_TEST(suite, test_get_mem_from_proc_file_ok) == NULL ||
+        CU_ADD_TEST(suite, test_get_mem_from_proc_buf) == NULL ||
+        CU_ADD_TEST(suite, test_mem_snapshot) == NULL ||
         CU_ADD_TEST(suite, test_get_swap_threshold_inKB_error) == NULL ||
         CU_ADD_TEST(suite, test_get_swap_threshold_inKB_ok) == NULL ||
         CU_ADD_TEST(suite, test_etmemd_send_ioctl_cmd_error) == NULL ||
@@ -379,13 +379,13 @@ static int check_addr_node(void *addr, pid_t pid, int node, int num)
     return 0;
 }
 
-static int page_refs_num(struct page_refs *page_refs)
+static int page_slices_num(const struct page_slices *slices)
 {
     int ret = 0;
+    int i;
 
-    while (page_refs != NULL) {
-        ret++;
-        page_refs = page_refs->next;
+    for (i = 0; i < slices->num; i++) {
+        ret += slices->slice[i].num;
     }
 
     printf("page_refs num %d\n", ret);
@@ -697,7 +697,7 @@ static void test_etmem_cslide_policy_001(void)
     void *hot_addr = NULL;
     void *cold_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -712,17 +712,17 @@ static void test_etmem_cslide_policy_001(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_HUGEPAGE_NUM);
     cslide_clean_params(&eng_params);
 
     /* hot move is not limited by hot_reserve */
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
-    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].huge_total >> BYTE_TO_MB_SHIFT;
+    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].total >> BYTE_TO_MB_SHIFT;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_HUGEPAGE_NUM);
     cslide_clean_params(&eng_params);
     eng_params.hot_reserve = 0;
 
@@ -733,7 +733,7 @@ static void test_etmem_cslide_policy_001(void)
                    hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     eng_params.mig_quota = TEST_LIMIT_HUGE * HUGE_TO_MB;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_LIMIT_HUGE);
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_LIMIT_HUGE);
     cslide_clean_params(&eng_params);
     eng_params.mig_quota = DEFAULT_MIG_QUOTA;
 
@@ -741,23 +741,23 @@ static void test_etmem_cslide_policy_001(void)
     cold_addr = get_hugepage(TEST_LIMIT_COLD_HUGE, hot_node, pid);
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_LIMIT_COLD_HUGE << HUGE_SHIFT));
-    eng_params.mem.node_mem[hot_node].huge_free = TEST_LIMIT_HOT_FREE_HUGE << HUGE_SHIFT;
+    eng_params.mem.node_mem[hot_node].free = TEST_LIMIT_HOT_FREE_HUGE << HUGE_SHIFT;
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
 
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), 
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), 
                     TEST_LIMIT_COLD_HUGE + TEST_LIMIT_HOT_FREE_HUGE);
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_LIMIT_COLD_HUGE);
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_LIMIT_COLD_HUGE);
     cslide_clean_params(&eng_params);
 
     /* limited by "hot node free space" + "cold node free space" */
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_LIMIT_COLD_HUGE << HUGE_SHIFT));
-    eng_params.mem.node_mem[hot_node].huge_free = TEST_LIMIT_HOT_FREE_HUGE << HUGE_SHIFT;
-    eng_params.mem.node_mem[cold_node].huge_free = TEST_LIMIT_COLD_FREE_HUGE << HUGE_SHIFT;
+    eng_params.mem.node_mem[hot_node].free = TEST_LIMIT_HOT_FREE_HUGE << HUGE_SHIFT;
+    eng_params.mem.node_mem[cold_node].free = TEST_LIMIT_COLD_FREE_HUGE << HUGE_SHIFT;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), 
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), 
                     TEST_LIMIT_COLD_FREE_HUGE + TEST_LIMIT_HOT_FREE_HUGE);
     CU_ASSERT_EQUAL(free_hugepage(cold_addr, TEST_LIMIT_COLD_HUGE), 0);
 
@@ -781,7 +781,7 @@ static void test_etmem_cslide_policy_002(void)
     struct cslide_eng_params eng_params;
     void *prefetch_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -796,17 +796,17 @@ static void test_etmem_cslide_policy_002(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, prefetch_addr, prefetch_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_HUGEPAGE_NUM);
     cslide_clean_params(&eng_params);
 
     /* prefetch is limited by hot_reserve */
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, prefetch_addr, prefetch_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
-    eng_params.hot_reserve = (eng_params.mem.node_mem[hot_node].huge_free >> BYTE_TO_MB_SHIFT) - HUGE_TO_MB;
+    eng_params.hot_reserve = (eng_params.mem.node_mem[hot_node].free >> BYTE_TO_MB_SHIFT) - HUGE_TO_MB;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), 1);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), 1);
     cslide_clean_params(&eng_params);
     eng_params.hot_reserve = 0;
 
@@ -817,8 +817,8 @@ static void test_etmem_cslide_policy_002(void)
                    prefetch_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     eng_params.mig_quota = TEST_LIMIT_HUGE * HUGE_TO_MB;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_LIMIT_HUGE);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_LIMIT_HUGE);
     cslide_clean_params(&eng_params);
     eng_params.mig_quota = DEFAULT_MIG_QUOTA;
 
@@ -833,7 +833,7 @@ static void test_etmem_cslide_policy_003(void)
     struct cslide_eng_params eng_params;
     void *cold_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -843,14 +843,14 @@ static void test_etmem_cslide_policy_003(void)
     hot_node = get_first_hot_node(&g_default_cslide_eng);
     cold_addr = get_hugepage(TEST_HUGEPAGE_NUM, hot_node, pid);
     get_sys_mem(&eng_params.mem);
-    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].huge_total >> BYTE_TO_MB_SHIFT;
+    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].total >> BYTE_TO_MB_SHIFT;
 
     /* unlimited cold move */
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_HUGEPAGE_NUM);
     cslide_clean_params(&eng_params);
 
     /* cold move is limited by mig_quota with 1 */
@@ -860,18 +860,18 @@ static void test_etmem_cslide_policy_003(void)
                    cold_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     eng_params.mig_quota = TEST_LIMIT_HUGE * HUGE_TO_MB;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_LIMIT_HUGE);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_LIMIT_HUGE);
     cslide_clean_params(&eng_params);
     eng_params.mig_quota = DEFAULT_MIG_QUOTA;
 
     /* cold move is limited by free space in cold node */
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
-    eng_params.mem.node_mem[cold_node].huge_free = TEST_LIMIT_COLD_HUGE << HUGE_SHIFT;
+    eng_params.mem.node_mem[cold_node].free = TEST_LIMIT_COLD_HUGE << HUGE_SHIFT;
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_LIMIT_COLD_HUGE);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_LIMIT_COLD_HUGE);
     cslide_clean_params(&eng_params);
 
     /* clean up */
@@ -911,7 +911,7 @@ static void test_etmem_cslide_mig_001(void)
     struct cslide_eng_params eng_params;
     void *hot_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -926,8 +926,8 @@ static void test_etmem_cslide_mig_001(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_HUGEPAGE_NUM);
     CU_ASSERT_EQUAL(cslide_do_migrate(&eng_params), 0);
     CU_ASSERT_EQUAL(check_addr_node(hot_addr, pid, hot_node, TEST_HUGEPAGE_NUM), 0);
     cslide_clean_params(&eng_params);
@@ -941,7 +941,7 @@ static void test_etmem_cslide_mig_002(void)
     struct cslide_eng_params eng_params;
     void *hot_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -956,8 +956,8 @@ static void test_etmem_cslide_mig_002(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, TEST_LOOP, hot_addr, hot_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->hot_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->hot), TEST_HUGEPAGE_NUM);
     pid_params->pid = NO_EXIST_PID;
     CU_ASSERT_NOT_EQUAL(cslide_do_migrate(&eng_params), 0);
     cslide_clean_params(&eng_params);
@@ -972,7 +972,7 @@ static void test_etmem_cslide_mig_003(void)
     struct cslide_eng_params eng_params;
     void *cold_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -981,7 +981,7 @@ static void test_etmem_cslide_mig_003(void)
     cold_node = get_first_cold_node(&g_default_cslide_eng);
     hot_node = get_first_hot_node(&g_default_cslide_eng);
     get_sys_mem(&eng_params.mem);
-    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].huge_total >> BYTE_TO_MB_SHIFT;
+    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].total >> BYTE_TO_MB_SHIFT;
 
     /* move cold pages normally */
     cold_addr = get_hugepage(TEST_HUGEPAGE_NUM, hot_node, pid);
@@ -989,8 +989,8 @@ static void test_etmem_cslide_mig_003(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_HUGEPAGE_NUM);
     CU_ASSERT_EQUAL(cslide_do_migrate(&eng_params), 0);
     CU_ASSERT_EQUAL(check_addr_node(cold_addr, pid, cold_node, TEST_HUGEPAGE_NUM), 0);
     cslide_clean_params(&eng_params);
@@ -1004,7 +1004,7 @@ static void test_etmem_cslide_mig_004(void)
     struct cslide_eng_params eng_params;
     void *cold_addr = NULL;
     pid_t pid = getpid();
-    struct memory_grade *memory_grade = NULL;
+    struct cslide_grade *grade = NULL;
     int cold_node, hot_node;
 
     /* init */
@@ -1013,7 +1013,7 @@ static void test_etmem_cslide_mig_004(void)
     cold_node = get_first_cold_node(&g_default_cslide_eng);
     hot_node = get_first_hot_node(&g_default_cslide_eng);
     get_sys_mem(&eng_params.mem);
-    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].huge_total >> BYTE_TO_MB_SHIFT;
+    eng_params.hot_reserve = eng_params.mem.node_mem[hot_node].total >> BYTE_TO_MB_SHIFT;
 
     /* move cold pages with no exist task */
     cold_addr = get_hugepage(TEST_HUGEPAGE_NUM, hot_node, pid);
@@ -1021,8 +1021,8 @@ static void test_etmem_cslide_mig_004(void)
     CU_ASSERT_EQUAL(cslide_do_scan(&eng_params), 0);
     set_page_count(pid_params, 0, cold_addr, cold_addr + (TEST_HUGEPAGE_NUM << HUGE_SHIFT));
     CU_ASSERT_EQUAL(cslide_policy(&eng_params), 0);
-    memory_grade = &pid_params->memory_grade[0];
-    CU_ASSERT_EQUAL(page_refs_num(memory_grade->cold_pages), TEST_HUGEPAGE_NUM);
+    grade = &pid_params->grade[0];
+    CU_ASSERT_EQUAL(page_slices_num(&grade->cold), TEST_HUGEPAGE_NUM);
     pid_params->pid = NO_EXIST_PID;
     CU_ASSERT_NOT_EQUAL(cslide_do_migrate(&eng_params), 0);
     cslide_clean_params(&eng_params);
@@ -1030,6 +1030,354 @@ static void test_etmem_cslide_mig_004(void)
     pid_params->pid = pid;
 }
 
+/* capacity of normal memory comes from nodeN/meminfo, hugetlb from the hugepages counters */
+static void test_etmem_cslide_mem_type(void)
+{
+    struct sys_mem mem = {0};
+    struct cslide_task_params task_params = {0};
+    int i;
+
+    CU_ASSERT_EQUAL(init_sys_mem(&mem), 0);
+    CU_ASSERT_EQUAL(mem.type, CSLIDE_MEM_HUGE_2M);
+    CU_ASSERT_EQUAL(get_sys_mem(&mem), 0);
+
+    CU_ASSERT_EQUAL(set_sys_mem_type(&mem, CSLIDE_MEM_NORMAL), 0);
+    CU_ASSERT_EQUAL(get_sys_mem(&mem), 0);
+    for (i = 0; i < mem.node_num; i++) {
+        CU_ASSERT_EQUAL(mem.node_mem[i].free_fd, -1);
+        CU_ASSERT(mem.node_mem[i].total > 0);
+        CU_ASSERT(mem.node_mem[i].free <= mem.node_mem[i].total);
+    }
+    destroy_sys_mem(&mem);
+
+    /* hugetlb needs vm_flags=ht, normal memory scans all vmas as they are */
+    task_params.scan_flags = SCAN_AS_HUGE;
+    CU_ASSERT_EQUAL(check_task_mem_type(&task_params, CSLIDE_MEM_HUGE_2M), -1);
+    CU_ASSERT_EQUAL(check_task_mem_type(&task_params, CSLIDE_MEM_NORMAL), 0);
+    CU_ASSERT_EQUAL(task_params.scan_flags & SCAN_AS_HUGE, 0);
+    task_params.vmflags_num = 1;
+    task_params.vmflags_array = g_vmflags_array;
+    CU_ASSERT_EQUAL(check_task_mem_type(&task_params, CSLIDE_MEM_HUGE_1G), 0);
+}
+
+#define TEST_CACHE_ADDR     0x40000000ULL
+#define TEST_CACHE_AGE      8
+#define TEST_CACHE_PAGES    64
+
+#define TEST_DECAY          50
+#define TEST_DECAY_SCORE    8
+
+/* scores decay across rounds, and pages within the hysteresis band stay where they are */
+static void test_etmem_cslide_hotness_decay(void)
+{
+    struct cslide_eng_params eng_params = {0};
+    struct node_cache cache = {0};
+    uint64_t cursor = 0;
+    float score = 0;
+    int age = 0;
+
+    CU_ASSERT_EQUAL(node_cache_append(&cache, TEST_CACHE_ADDR, 0, 0), 0);
+    cache.entry[0].score = TEST_DECAY_SCORE;
+
+    /* a new page starts from its count */
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR - HUGE_2M_SIZE, 0, &age), -1);
+    CU_ASSERT_EQUAL(decay_page_count(&cache, cursor, TEST_CACHE_ADDR - HUGE_2M_SIZE, 1, TEST_DECAY, &score), 1);
+
+    /* an idle page keeps part of its score, without decay only the count of this round is used */
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR, 0, &age), -1);
+    CU_ASSERT_EQUAL(decay_page_count(&cache, cursor, TEST_CACHE_ADDR, 0, TEST_DECAY, &score),
+                    TEST_DECAY_SCORE * TEST_DECAY / PERCENT);
+    CU_ASSERT_EQUAL(decay_page_count(&cache, cursor, TEST_CACHE_ADDR, 0, 0, &score), 0);
+    free(cache.entry);
+
+    eng_params.loop = 1;
+    eng_params.hot_threshold = 2;
+    CU_ASSERT_EQUAL(hot_band_end(&eng_params), 2);
+    CU_ASSERT_EQUAL(cold_band_start(&eng_params), 2);
+    eng_params.hot_hysteresis = 1;
+    CU_ASSERT_EQUAL(hot_band_end(&eng_params), 3);
+    CU_ASSERT_EQUAL(cold_band_start(&eng_params), 1);
+    eng_params.hot_hysteresis = MAX_ACCESS_WEIGHT + 2;
+    CU_ASSERT_EQUAL(hot_band_end(&eng_params), MAX_ACCESS_WEIGHT + 1);
+    CU_ASSERT_EQUAL(cold_band_start(&eng_params), 0);
+}
+
+#define TEST_PACE_RATE      (256LL * HUGE_1M_SIZE)
+#define TEST_PACE_PARTS     16
+
+static void test_etmem_cslide_mig_pace(void)
+{
+    struct mig_pace pace = {0};
+    struct timespec now;
+    long long bytes = TEST_PACE_RATE / TEST_PACE_PARTS;
+
+    /* no pacing, batches are only limited by BATCHSIZE */
+    mig_pace_begin(&pace, 0);
+    CU_ASSERT_EQUAL(pace.batch_bytes, 0);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    mig_pace_batch(&pace, bytes, &now);
+    CU_ASSERT_EQUAL(pace.moved, bytes);
+    CU_ASSERT_EQUAL(pace.batch_bytes, 0);
+
+    /* a fast move_pages does not enlarge the batch beyond the allowed rate */
+    pace.tput = 0;
+    mig_pace_begin(&pace, TEST_PACE_RATE);
+    CU_ASSERT_EQUAL(pace.batch_bytes, TEST_PACE_RATE / (NSEC_PER_SEC / MIG_PACE_SLICE_NS));
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    mig_pace_batch(&pace, bytes, &now);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    CU_ASSERT_TRUE(elapsed_ns(&pace.start, &now) >= NSEC_PER_SEC / TEST_PACE_PARTS);
+    CU_ASSERT_TRUE(pace.tput > 0);
+    CU_ASSERT_TRUE(pace.latency > 0);
+    CU_ASSERT_EQUAL(pace.batch_bytes, TEST_PACE_RATE / (NSEC_PER_SEC / MIG_PACE_SLICE_NS));
+
+    /* a slow move_pages shrinks the batch to keep each call short */
+    pace.tput = TEST_PACE_RATE / TEST_PACE_PARTS;
+    CU_ASSERT_EQUAL(mig_pace_batch_bytes(&pace), MIG_PACE_MIN_BATCH);
+}
+
+#define TEST_RATE_QUOTA     100     // MB
+#define TEST_RATE_BANDWIDTH 1000    // MB/s
+#define TEST_RATE_INTERVAL  10
+
+/* the quota is spread over the window of the tier, a used up window migrates at full bandwidth */
+static void test_etmem_cslide_pair_mig_rate(void)
+{
+    struct cslide_eng_params eng_params = {0};
+    struct node_pair pair = {0};
+    long long window_ns = (long long)TEST_RATE_INTERVAL * NSEC_PER_SEC;
+
+    eng_params.mig_quota = TEST_RATE_QUOTA;
+    pair.mig_quota = -1;
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, window_ns), 0);
+
+    eng_params.mig_bandwidth = TEST_RATE_BANDWIDTH;
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, window_ns),
+                    (long long)TEST_RATE_QUOTA * HUGE_1M_SIZE / TEST_RATE_INTERVAL);
+
+    /* two tiers share the interval, each one moves its quota in half of it */
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, window_ns / 2),
+                    (long long)TEST_RATE_QUOTA * HUGE_1M_SIZE * 2 / TEST_RATE_INTERVAL);
+
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, 0), (long long)TEST_RATE_BANDWIDTH * HUGE_1M_SIZE);
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, -window_ns), (long long)TEST_RATE_BANDWIDTH * HUGE_1M_SIZE);
+
+    /* the quota of the hop overrides node_mig_quota */
+    pair.mig_quota = TEST_RATE_QUOTA * 2;
+    CU_ASSERT_EQUAL(pair_mig_rate(&eng_params, &pair, window_ns),
+                    (long long)TEST_RATE_QUOTA * HUGE_1M_SIZE * 2 / TEST_RATE_INTERVAL);
+}
+
+#define TEST_SORT_COUNT     2
+#define TEST_SORT_NODES     2
+#define TEST_SORT_PAGES     6
+
+/* pages are sorted into one slice per count and node, and picked as prefixes of the slices */
+static void test_etmem_cslide_sort_pages(void)
+{
+    struct cslide_pid_params params = {0};
+    struct count_page_refs cpf[TEST_SORT_COUNT + 1];
+    struct page_slices slices = {0};
+    struct node_page_refs *npf = NULL;
+    struct cslide_page unsorted[TEST_SORT_PAGES] = {
+        {TEST_CACHE_ADDR, PTE_TYPE, 2 * TEST_SORT_NODES + 1},
+        {TEST_CACHE_ADDR + 1 * HUGE_2M_SIZE, PMD_TYPE, 0},
+        {TEST_CACHE_ADDR + 2 * HUGE_2M_SIZE, PTE_TYPE, 2 * TEST_SORT_NODES + 1},
+        {TEST_CACHE_ADDR + 3 * HUGE_2M_SIZE, PMD_TYPE, -1},
+        {TEST_CACHE_ADDR + 4 * HUGE_2M_SIZE, PMD_TYPE, 2 * TEST_SORT_NODES + 1},
+        {TEST_CACHE_ADDR + 5 * HUGE_2M_SIZE, PMD_TYPE, 0},
+    };
+    int i;
+
+    for (i = 0; i <= TEST_SORT_COUNT; i++) {
+        CU_ASSERT_EQUAL(init_count_page_refs(&cpf[i], TEST_SORT_NODES), 0);
+    }
+    params.count = TEST_SORT_COUNT;
+    params.count_page_refs = cpf;
+
+    /* the page with unknown node is not counted */
+    CU_ASSERT_EQUAL(sort_count_pages(&params, unsorted, TEST_SORT_PAGES), 0);
+    CU_ASSERT_EQUAL(params.page_num, TEST_SORT_PAGES - 1);
+    CU_ASSERT_EQUAL(cpf[0].node_pfs[0].start, 0);
+    CU_ASSERT_EQUAL(cpf[0].node_pfs[0].num, 2);
+    CU_ASSERT_EQUAL(cpf[0].node_pfs[0].page_size, page_type_to_size(PMD_TYPE));
+    npf = &cpf[TEST_SORT_COUNT].node_pfs[1];
+    CU_ASSERT_EQUAL(npf->start, 2);
+    CU_ASSERT_EQUAL(npf->num, 3);
+    CU_ASSERT_EQUAL(npf->page_size, 0);
+    CU_ASSERT_EQUAL(params.pages[npf->start + 1].addr, TEST_CACHE_ADDR + 2 * HUGE_2M_SIZE);
+
+    /* uniform slice is cut by page size, mixed slice is cut page by page */
+    take_npf_pages(&cpf[0].node_pfs[0], params.pages, &slices, page_type_to_size(PMD_TYPE) + 1);
+    CU_ASSERT_EQUAL(slices.num, 1);
+    CU_ASSERT_EQUAL(slices.slice[0].num, 1);
+    CU_ASSERT_EQUAL(cpf[0].node_pfs[0].start, 1);
+    take_npf_pages(npf, params.pages, &slices, page_type_to_size(PTE_TYPE) - 1);
+    CU_ASSERT_EQUAL(slices.num, 1);
+    take_npf_pages(npf, params.pages, &slices, 2 * page_type_to_size(PTE_TYPE));
+    CU_ASSERT_EQUAL(slices.num, 2);
+    CU_ASSERT_EQUAL(slices.slice[1].start, 2);
+    CU_ASSERT_EQUAL(slices.slice[1].num, 2);
+    CU_ASSERT_EQUAL(npf->num, 1);
+    CU_ASSERT_EQUAL(npf->size, page_type_to_size(PMD_TYPE));
+
+    destroy_page_slices(&slices);
+    free(params.pages);
+    for (i = 0; i <= TEST_SORT_COUNT; i++) {
+        destroy_count_page_refs(&cpf[i]);
+    }
+}
+
+/* the node of a page is queried once in node_cache_age rounds, unless cslide moves it */
+static void test_etmem_cslide_node_cache(void)
+{
+    struct node_cache cache = {0};
+    uint64_t cursor = 0;
+    bool spread = false;
+    int first_age = -1;
+    int age = 0;
+    int i;
+
+    /* entries are kept sorted, an address out of order is not cached */
+    CU_ASSERT_EQUAL(node_cache_append(&cache, TEST_CACHE_ADDR, 0, 0), 0);
+    CU_ASSERT_EQUAL(node_cache_append(&cache, TEST_CACHE_ADDR + HUGE_2M_SIZE, 1, TEST_CACHE_AGE), 1);
+    CU_ASSERT_EQUAL(node_cache_append(&cache, TEST_CACHE_ADDR, 1, 0), -1);
+
+    /* new pages and aged pages are queried */
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR - HUGE_2M_SIZE, TEST_CACHE_AGE, &age), -1);
+    CU_ASSERT(age >= 0 && age < TEST_CACHE_AGE);
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR, TEST_CACHE_AGE, &age), 0);
+    CU_ASSERT_EQUAL(age, 1);
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR + HUGE_2M_SIZE, TEST_CACHE_AGE, &age), -1);
+    CU_ASSERT_EQUAL(age, 0);
+
+    /* migration updates the node, a page failed to move is queried again */
+    node_cache_update(&cache, TEST_CACHE_ADDR, 1);
+    cursor = 0;
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR, TEST_CACHE_AGE, &age), 1);
+    node_cache_update(&cache, TEST_CACHE_ADDR, -1);
+    cursor = 0;
+    CU_ASSERT_EQUAL(node_cache_lookup(&cache, &cursor, TEST_CACHE_ADDR, TEST_CACHE_AGE, &age), -1);
+    free(cache.entry);
+
+    /* first queries of new pages are spread over the rounds */
+    for (i = 0; i < TEST_CACHE_PAGES; i++) {
+        age = node_cache_init_age(TEST_CACHE_ADDR + (uint64_t)i * HUGE_2M_SIZE, TEST_CACHE_AGE);
+        CU_ASSERT(age >= 0 && age < TEST_CACHE_AGE);
+        if (first_age != -1 && age != first_age) {
+            spread = true;
+        }
+        first_age = age;
+    }
+    CU_ASSERT_TRUE(spread);
+}
+
+#define TEST_TIER_NODES     5
+#define TEST_NODE_FREE      1024
+
+static int fill_test_node_pair(struct cslide_eng_params *eng_params, const char *node_pair)
+{
+    destroy_node_map(&eng_params->node_map);
+    CU_ASSERT_EQUAL(init_node_map(&eng_params->node_map, eng_params->mem.node_num), 0);
+    return fill_node_pair(eng_params, strdup(node_pair));
+}
+
+/* node 2 is the cold node of hop 0->2 and the hot node of hop 2->4 */
+static void test_etmem_cslide_node_chain(void)
+{
+    struct cslide_eng_params eng_params = {0};
+    struct node_mem node_mem[TEST_TIER_NODES] = {0};
+    struct node_pages_info host_pages_info[TEST_TIER_NODES] = {0};
+    struct flow_ctrl ctrl;
+    int i;
+
+    eng_params.mem.node_num = TEST_TIER_NODES;
+    eng_params.mem.node_mem = node_mem;
+    eng_params.host_pages_info = host_pages_info;
+    eng_params.mig_quota = DEFAULT_MIG_QUOTA;
+
+    /* chains with odd number of nodes, a node remapped or unmapped are invalid */
+    CU_ASSERT_NOT_EQUAL(fill_test_node_pair(&eng_params, "0,2;2,4;1,3"), 0);
+    CU_ASSERT_NOT_EQUAL(fill_test_node_pair(&eng_params, "0,2,4"), 0);
+    CU_ASSERT_NOT_EQUAL(fill_test_node_pair(&eng_params, "0,2,4;1"), 0);
+
+    CU_ASSERT_EQUAL(fill_test_node_pair(&eng_params, "0,2,4;1,3"), 0);
+    CU_ASSERT_EQUAL(eng_params.node_map.cur_num, 3);
+    CU_ASSERT_EQUAL(eng_params.node_map.max_tier, 1);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[1].hot_node, 2);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[1].cold_node, 4);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[1].tier, 1);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[2].tier, 0);
+
+    /* quota and reserve of one hop */
+    CU_ASSERT_NOT_EQUAL(fill_hop_limit(&eng_params, strdup("0,4,1,1")), 0);
+    CU_ASSERT_NOT_EQUAL(fill_hop_limit(&eng_params, strdup("2,4,1")), 0);
+    CU_ASSERT_EQUAL(fill_hop_limit(&eng_params, strdup("2,4,512,256")), 0);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[1].mig_quota, 512);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[1].hot_reserve, 256);
+    CU_ASSERT_EQUAL(eng_params.node_map.pair[0].mig_quota, -1);
+
+    /* the hops of a chain share the free mem of the middle node */
+    for (i = 0; i < TEST_TIER_NODES; i++) {
+        node_mem[i].free = TEST_NODE_FREE;
+    }
+    CU_ASSERT_EQUAL(init_flow_ctrl(&ctrl, &eng_params), 0);
+    CU_ASSERT_PTR_EQUAL(ctrl.node_ctrl[0].cold_free, ctrl.node_ctrl[1].free);
+    CU_ASSERT_EQUAL(ctrl.node_ctrl[0].quota, (long long)DEFAULT_MIG_QUOTA * HUGE_1M_SIZE);
+    CU_ASSERT_EQUAL(ctrl.node_ctrl[1].quota, 512LL * HUGE_1M_SIZE);
+    ctrl.node_ctrl[0].hot_move_cap.used = TEST_NODE_FREE;
+    flow_cal_hot_can_prefetch(&ctrl);
+    CU_ASSERT_EQUAL(*ctrl.node_ctrl[1].free, 2 * TEST_NODE_FREE);
+    destroy_flow_ctrl(&ctrl);
+
+    destroy_node_map(&eng_params.node_map);
+}
+
+#define TEST_JOB_NUM    16
+
+static int g_job_done;
+
+static int count_job(struct cslide_job *job)
+{
+    __atomic_add_fetch(&g_job_done, 1, __ATOMIC_SEQ_CST);
+    return job->pair_index == TEST_JOB_NUM ? -1 : 0;
+}
+
+/* jobs of one phase all finish before cslide_run_jobs returns */
+static void test_etmem_cslide_run_jobs(void)
+{
+    struct cslide_eng_params eng_params = {0};
+    struct cslide_job jobs[TEST_JOB_NUM];
+    int i;
+
+    for (i = 0; i < TEST_JOB_NUM; i++) {
+        jobs[i].func = count_job;
+        jobs[i].pair_index = i;
+    }
+
+    /* without pool the jobs run in the caller */
+    g_job_done = 0;
+    CU_ASSERT_EQUAL(cslide_run_jobs(&eng_params, jobs, TEST_JOB_NUM), 0);
+    CU_ASSERT_EQUAL(g_job_done, TEST_JOB_NUM);
+
+    eng_params.pool = threadpool_create(3);
+    CU_ASSERT_PTR_NOT_NULL(eng_params.pool);
+    for (i = 0; i < 3; i++) {
+        g_job_done = 0;
+        CU_ASSERT_EQUAL(cslide_run_jobs(&eng_params, jobs, TEST_JOB_NUM), 0);
+        CU_ASSERT_EQUAL(g_job_done, TEST_JOB_NUM);
+    }
+
+    /* one failed job fails the phase */
+    jobs[TEST_JOB_NUM - 1].pair_index = TEST_JOB_NUM;
+    g_job_done = 0;
+    CU_ASSERT_EQUAL(cslide_run_jobs(&eng_params, jobs, TEST_JOB_NUM), -1);
+    CU_ASSERT_EQUAL(g_job_done, TEST_JOB_NUM);
+
+    CU_ASSERT_EQUAL(cslide_run_jobs(&eng_params, jobs, 0), 0);
+    threadpool_stop_and_destroy(&eng_params.pool);
+}
+
 static int init_env(void)
 {
     if (init_g_page_size() != 0) {
@@ -1078,6 +1426,14 @@ int main(int argc, const char **argv)
         CU_ADD_TEST(suite, test_etmem_cslide_mig_002) == NULL ||
         CU_ADD_TEST(suite, test_etmem_cslide_mig_003) == NULL ||
         CU_ADD_TEST(suite, test_etmem_cslide_mig_004) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_run_jobs) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_mem_type) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_node_chain) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_node_cache) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_sort_pages) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_hotness_decay) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_mig_pace) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_cslide_pair_mig_rate) == NULL ||
         CU_ADD_TEST(suite, test_etmem_add_cslide_0001) == NULL ||
         CU_ADD_TEST(suite, test_etmem_add_cslide_0002) == NULL ||
         CU_ADD_TEST(suite, test_etmem_del_cslide_0001) == NULL ||
@@ -0,0 +1,475 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a source file of the unit test for the damon engine config in etmemd.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+
+#include "etmemd_project.h"
+#include "etmemd_engine.h"
+#include "securec.h"
+
+#include "etmemd_damon.c"
+
+#define TEST_MIN_SIZE       4096
+#define TEST_MAX_SIZE       8192
+#define TEST_MAX_ACC        5
+#define TEST_MAX_AGE        10
+#define TEST_QUOTA_MS       10
+#define TEST_QUOTA_BYTES    1048576
+#define TEST_QUOTA_RESET    1000
+#define TEST_WMARK_INTERVAL 5000000
+#define TEST_WMARK_HIGH     500
+#define TEST_WMARK_MID      400
+#define TEST_WMARK_LOW      200
+
+/* INT_VAL items are passed by value in the pointer, STR_VAL items are freed by the fill functions */
+#define INT_ARG(v)  ((void *)(long long)(v))
+
+static struct damon_eng_params *damon_test_params(void)
+{
+    struct damon_eng_params *params = calloc(1, sizeof(struct damon_eng_params));
+
+    if (params == NULL) {
+        return NULL;
+    }
+
+    params->schemes = calloc(1, sizeof(struct damon_scheme));
+    if (params->schemes == NULL) {
+        free(params);
+        return NULL;
+    }
+    params->nr_schemes = 1;
+    return params;
+}
+
+static void test_fill_first_scheme(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+    struct damon_scheme *scheme = NULL;
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+    scheme = &params->schemes[0];
+
+    CU_ASSERT_EQUAL(fill_min_size(params, INT_ARG(TEST_MIN_SIZE)), 0);
+    CU_ASSERT_EQUAL(fill_max_size(params, INT_ARG(TEST_MAX_SIZE)), 0);
+    CU_ASSERT_EQUAL(fill_min_acc(params, INT_ARG(0)), 0);
+    CU_ASSERT_EQUAL(fill_max_acc(params, INT_ARG(TEST_MAX_ACC)), 0);
+    CU_ASSERT_EQUAL(fill_min_age(params, INT_ARG(1)), 0);
+    CU_ASSERT_EQUAL(fill_max_age(params, INT_ARG(TEST_MAX_AGE)), 0);
+    CU_ASSERT_EQUAL(fill_action(params, strdup("pageout")), 0);
+    CU_ASSERT_EQUAL(fill_quota_ms(params, INT_ARG(TEST_QUOTA_MS)), 0);
+    CU_ASSERT_EQUAL(fill_quota_bytes(params, INT_ARG(TEST_QUOTA_BYTES)), 0);
+    CU_ASSERT_EQUAL(fill_quota_reset_interval(params, INT_ARG(TEST_QUOTA_RESET)), 0);
+
+    CU_ASSERT_EQUAL(scheme->min_sz_region, TEST_MIN_SIZE);
+    CU_ASSERT_EQUAL(scheme->max_sz_region, TEST_MAX_SIZE);
+    CU_ASSERT_EQUAL(scheme->min_nr_accesses, 0);
+    CU_ASSERT_EQUAL(scheme->max_nr_accesses, TEST_MAX_ACC);
+    CU_ASSERT_EQUAL(scheme->min_age_region, 1);
+    CU_ASSERT_EQUAL(scheme->max_age_region, TEST_MAX_AGE);
+    CU_ASSERT_EQUAL(scheme->action, DAMOS_PAGEOUT);
+    CU_ASSERT_EQUAL(scheme->quota.ms, TEST_QUOTA_MS);
+    CU_ASSERT_EQUAL(scheme->quota.bytes, TEST_QUOTA_BYTES);
+    CU_ASSERT_EQUAL(scheme->quota.reset_interval, TEST_QUOTA_RESET);
+
+    CU_ASSERT_EQUAL(fill_action(params, strdup("nothing")), -1);
+    CU_ASSERT_EQUAL(scheme->action, DAMOS_PAGEOUT);
+
+    free_damon_eng_params(params);
+}
+
+static void test_fill_schemes(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+    params->schemes[0].quota.ms = TEST_QUOTA_MS;
+
+    /* a scheme without quota inherits the quota of the first scheme */
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("4096,8192,0,5,1,10,cold;0 0 0 0 0 0 hugepage 1 2 3")), 0);
+    CU_ASSERT_EQUAL(params->nr_schemes, 3);
+    if (params->nr_schemes != 3) {
+        free_damon_eng_params(params);
+        return;
+    }
+    CU_ASSERT_EQUAL(params->schemes[1].min_sz_region, TEST_MIN_SIZE);
+    CU_ASSERT_EQUAL(params->schemes[1].max_sz_region, TEST_MAX_SIZE);
+    CU_ASSERT_EQUAL(params->schemes[1].max_nr_accesses, TEST_MAX_ACC);
+    CU_ASSERT_EQUAL(params->schemes[1].max_age_region, TEST_MAX_AGE);
+    CU_ASSERT_EQUAL(params->schemes[1].action, DAMOS_COLD);
+    CU_ASSERT_EQUAL(params->schemes[1].quota.ms, TEST_QUOTA_MS);
+    CU_ASSERT_EQUAL(params->schemes[2].action, DAMOS_HUGEPAGE);
+    CU_ASSERT_EQUAL(params->schemes[2].quota.ms, 1);
+    CU_ASSERT_EQUAL(params->schemes[2].quota.bytes, 2);
+    CU_ASSERT_EQUAL(params->schemes[2].quota.reset_interval, 3);
+
+    /* too few fields, a part of the quota, too many fields, or an unknown action */
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("1,2,3")), -1);
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("0,0,0,0,0,0,cold,1")), -1);
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("0,0,0,0,0,0,cold,1,2,3,4")), -1);
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("0,0,0,0,0,0,nothing")), -1);
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("0,0,x,0,0,0,cold")), -1);
+    CU_ASSERT_EQUAL(params->nr_schemes, 3);
+
+    free_damon_eng_params(params);
+}
+
+static void test_fill_exclude_addr(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("0x1000-0x2000; 16384-32768")), 0);
+    CU_ASSERT_EQUAL(params->nr_exclude, 2);
+    if (params->nr_exclude == 2) {
+        CU_ASSERT_EQUAL(params->exclude[0].start, 0x1000);
+        CU_ASSERT_EQUAL(params->exclude[0].end, 0x2000);
+        CU_ASSERT_EQUAL(params->exclude[1].start, 16384);
+        CU_ASSERT_EQUAL(params->exclude[1].end, 32768);
+    }
+
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("0x2000-0x1000")), -1);
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("0x1000-0x1000")), -1);
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("0x1000")), -1);
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("0x1000-")), -1);
+    CU_ASSERT_EQUAL(fill_exclude_addr(params, strdup("abc-0x1000")), -1);
+    CU_ASSERT_EQUAL(params->nr_exclude, 2);
+
+    free_damon_eng_params(params);
+}
+
+static void test_fill_wmark(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+
+    CU_ASSERT_EQUAL(fill_wmark_metric(params, strdup("none")), 0);
+    CU_ASSERT_EQUAL(params->wmark.metric, DAMOS_WMARK_NONE);
+    CU_ASSERT_EQUAL(fill_wmark_metric(params, strdup("free_mem_rate")), 0);
+    CU_ASSERT_EQUAL(params->wmark.metric, DAMOS_WMARK_FREE_MEM_RATE);
+    CU_ASSERT_EQUAL(fill_wmark_metric(params, strdup("used_mem_rate")), -1);
+
+    CU_ASSERT_EQUAL(fill_wmark_interval(params, INT_ARG(TEST_WMARK_INTERVAL)), 0);
+    CU_ASSERT_EQUAL(fill_wmark_high(params, INT_ARG(TEST_WMARK_HIGH)), 0);
+    CU_ASSERT_EQUAL(fill_wmark_mid(params, INT_ARG(TEST_WMARK_MID)), 0);
+    CU_ASSERT_EQUAL(fill_wmark_low(params, INT_ARG(TEST_WMARK_LOW)), 0);
+    CU_ASSERT_EQUAL(params->wmark.interval, TEST_WMARK_INTERVAL);
+    CU_ASSERT_EQUAL(params->wmark.high, TEST_WMARK_HIGH);
+    CU_ASSERT_EQUAL(params->wmark.mid, TEST_WMARK_MID);
+    CU_ASSERT_EQUAL(params->wmark.low, TEST_WMARK_LOW);
+    CU_ASSERT_TRUE(is_wmark_valid(&params->wmark));
+
+    /* watermarks must be high >= mid >= low in permil */
+    params->wmark.mid = TEST_WMARK_HIGH + 1;
+    CU_ASSERT_FALSE(is_wmark_valid(&params->wmark));
+    params->wmark.mid = TEST_WMARK_LOW - 1;
+    CU_ASSERT_FALSE(is_wmark_valid(&params->wmark));
+    params->wmark.mid = TEST_WMARK_MID;
+    params->wmark.high = DAMOS_WMARK_PERMIL_MAX + 1;
+    CU_ASSERT_FALSE(is_wmark_valid(&params->wmark));
+
+    /* watermarks are not checked without a metric */
+    params->wmark.metric = DAMOS_WMARK_NONE;
+    CU_ASSERT_TRUE(is_wmark_valid(&params->wmark));
+
+    free_damon_eng_params(params);
+}
+
+static int count_fields(const char *line)
+{
+    char buf[PATH_MAX] = {0};
+    char *saveptr = NULL;
+    char *tok = NULL;
+    int num = 0;
+
+    if (strncpy_s(buf, sizeof(buf), line, strcspn(line, "\n")) != EOK) {
+        return -1;
+    }
+    for (tok = strtok_r(buf, " ", &saveptr); tok != NULL; tok = strtok_r(NULL, " ", &saveptr)) {
+        num++;
+    }
+    return num;
+}
+
+static void test_damon_schemes_str(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+    struct engine eng = {0};
+    struct project proj = {0};
+    char *schemes = NULL;
+    char *second = NULL;
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+    eng.params = params;
+    proj.engs = &eng;
+
+    /* the format of linux 5.15 without quotas or watermarks */
+    CU_ASSERT_EQUAL(fill_schemes(params, strdup("4096,8192,0,5,1,10,pageout")), 0);
+    CU_ASSERT_FALSE(use_schemes_ext(params));
+    schemes = get_damon_schemes_str(&proj);
+    CU_ASSERT_PTR_NOT_NULL(schemes);
+    if (schemes != NULL) {
+        CU_ASSERT_STRING_EQUAL(schemes, "0 0 0 0 0 0 0\n4096 8192 0 5 1 10 2\n");
+        free(schemes);
+    }
+
+    /* a quota of any scheme turns all of them to 18 fields */
+    params->schemes[1].quota.bytes = TEST_QUOTA_BYTES;
+    params->wmark.metric = DAMOS_WMARK_FREE_MEM_RATE;
+    params->wmark.interval = TEST_WMARK_INTERVAL;
+    params->wmark.high = TEST_WMARK_HIGH;
+    params->wmark.mid = TEST_WMARK_MID;
+    params->wmark.low = TEST_WMARK_LOW;
+    CU_ASSERT_TRUE(use_schemes_ext(params));
+    schemes = get_damon_schemes_str(&proj);
+    CU_ASSERT_PTR_NOT_NULL(schemes);
+    if (schemes == NULL) {
+        free_damon_eng_params(params);
+        return;
+    }
+    CU_ASSERT_EQUAL(count_fields(schemes), NUM_OF_SCHEMES_EXT);
+    second = strchr(schemes, '\n');
+    CU_ASSERT_PTR_NOT_NULL(second);
+    if (second != NULL) {
+        CU_ASSERT_EQUAL(count_fields(second + 1), NUM_OF_SCHEMES_EXT);
+        CU_ASSERT_STRING_EQUAL(second + 1, "4096 8192 0 5 1 10 2 0 1048576 0 0 1 1 1 5000000 500 400 200\n");
+    }
+    free(schemes);
+
+    free_damon_eng_params(params);
+}
+
+/* regions of 2, 1 and 2 pages from the hottest, the scheme matches all of them */
+static struct damon_eng_params *damon_user_test_params(struct damon_region *region, unsigned long page_size)
+{
+    struct damon_eng_params *params = damon_test_params();
+    struct damon_scheme *scheme = NULL;
+
+    if (params == NULL) {
+        return NULL;
+    }
+    params->charge = calloc(1, sizeof(struct damos_charge));
+    if (params->charge == NULL) {
+        free_damon_eng_params(params);
+        return NULL;
+    }
+
+    scheme = &params->schemes[0];
+    scheme->max_sz_region = ULONG_MAX;
+    scheme->max_nr_accesses = UINT_MAX;
+    scheme->max_age_region = UINT_MAX;
+    scheme->action = DAMOS_STAT;
+
+    region[0].start = page_size;
+    region[0].end = 3 * page_size;
+    region[0].nr_accesses = 2;
+    region[1].start = 3 * page_size;
+    region[1].end = 4 * page_size;
+    region[1].nr_accesses = 0;
+    region[2].start = 4 * page_size;
+    region[2].end = 6 * page_size;
+    region[2].nr_accesses = 1;
+    return params;
+}
+
+static void test_damon_user_quota(void)
+{
+    struct damon_region region[3] = {0};
+    struct damon_regions regions = {
+        .region = region,
+        .num = 3,
+        .max_nr_accesses = TEST_MAX_ACC,
+    };
+    struct damon_eng_params *params = NULL;
+    struct damon_scheme *scheme = NULL;
+    struct damos_charge *charge = NULL;
+    unsigned long page_size;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    page_size = (unsigned long)page_type_to_size(PTE_TYPE);
+    params = damon_user_test_params(region, page_size);
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    scheme = &params->schemes[0];
+    charge = &params->charge[0];
+
+    /* the colder regions go first, the one over the quota is cut at a page */
+    scheme->quota.bytes = 2 * page_size;
+    scheme->quota.reset_interval = TEST_QUOTA_RESET;
+    damon_user_apply_scheme(params, 0, -1, 0, &regions);
+    CU_ASSERT_EQUAL(charge->bytes, 2 * page_size);
+
+    /* nothing more is applied until the quota is reset */
+    damon_user_apply_scheme(params, 0, -1, 0, &regions);
+    CU_ASSERT_EQUAL(charge->bytes, 2 * page_size);
+
+    charge->reset_at -= TEST_QUOTA_RESET * USEC_PER_MSEC;
+    scheme->quota.bytes = 3 * page_size;
+    damon_user_apply_scheme(params, 0, -1, 0, &regions);
+    CU_ASSERT_EQUAL(charge->bytes, 3 * page_size);
+
+    /* the time quota is used up as well */
+    scheme->quota.bytes = 0;
+    scheme->quota.ms = TEST_QUOTA_MS;
+    charge->us = TEST_QUOTA_MS * USEC_PER_MSEC;
+    damon_user_apply_scheme(params, 0, -1, 0, &regions);
+    CU_ASSERT_EQUAL(charge->bytes, 3 * page_size);
+
+    /* without a reset interval the charge is reset each time, only the matched regions are applied */
+    scheme->quota.ms = 0;
+    scheme->quota.reset_interval = 0;
+    scheme->min_nr_accesses = 1;
+    damon_user_apply_scheme(params, 0, -1, 0, &regions);
+    CU_ASSERT_EQUAL(charge->bytes, 4 * page_size);
+
+    free(params->charge);
+    free_damon_eng_params(params);
+    etmemd_scan_exit();
+}
+
+static void test_damon_user_wmark(void)
+{
+    struct damon_eng_params *params = damon_test_params();
+    struct damos_wmark *wmark = NULL;
+    uint64_t now;
+
+    CU_ASSERT_PTR_NOT_NULL(params);
+    if (params == NULL) {
+        return;
+    }
+    wmark = &params->wmark;
+
+    /* schemes always run without a metric */
+    CU_ASSERT_TRUE(damon_user_wmark_active(params, damon_now_us()));
+
+    /* free_mem_rate is within [low, mid] */
+    wmark->metric = DAMOS_WMARK_FREE_MEM_RATE;
+    wmark->interval = TEST_WMARK_INTERVAL;
+    wmark->high = DAMOS_WMARK_PERMIL_MAX;
+    wmark->mid = DAMOS_WMARK_PERMIL_MAX;
+    wmark->low = 0;
+    now = damon_now_us();
+    CU_ASSERT_TRUE(damon_user_wmark_active(params, now));
+
+    /* the result is kept within the interval */
+    wmark->low = DAMOS_WMARK_PERMIL_MAX;
+    CU_ASSERT_TRUE(damon_user_wmark_active(params, now + TEST_WMARK_INTERVAL - 1));
+
+    /* free_mem_rate is below low, the schemes stop */
+    now += TEST_WMARK_INTERVAL;
+    CU_ASSERT_FALSE(damon_user_wmark_active(params, now));
+
+    /* within [low, high] but above mid, the schemes do not restart yet */
+    wmark->low = 0;
+    wmark->mid = 0;
+    now += TEST_WMARK_INTERVAL;
+    CU_ASSERT_FALSE(damon_user_wmark_active(params, now));
+
+    wmark->mid = DAMOS_WMARK_PERMIL_MAX;
+    now += TEST_WMARK_INTERVAL;
+    CU_ASSERT_TRUE(damon_user_wmark_active(params, now));
+
+    free_damon_eng_params(params);
+}
+
+typedef enum {
+    CUNIT_SCREEN = 0,
+    CUNIT_XMLFILE,
+    CUNIT_CONSOLE
+} cu_run_mode;
+
+int main(int argc, const char **argv)
+{
+    CU_pSuite suite;
+    unsigned int num_failures;
+    cu_run_mode cunit_mode = CUNIT_SCREEN;
+    int error_num;
+
+    if (argc > 1) {
+        cunit_mode = atoi(argv[1]);
+    }
+
+    if (CU_initialize_registry() != CUE_SUCCESS) {
+        return -CU_get_error();
+    }
+
+    suite = CU_add_suite("etmem_damon_ops", NULL, NULL);
+    if (suite == NULL) {
+        goto ERROR;
+    }
+
+    if (CU_ADD_TEST(suite, test_fill_first_scheme) == NULL ||
+        CU_ADD_TEST(suite, test_fill_schemes) == NULL ||
+        CU_ADD_TEST(suite, test_fill_exclude_addr) == NULL ||
+        CU_ADD_TEST(suite, test_fill_wmark) == NULL ||
+        CU_ADD_TEST(suite, test_damon_schemes_str) == NULL ||
+        CU_ADD_TEST(suite, test_damon_user_quota) == NULL ||
+        CU_ADD_TEST(suite, test_damon_user_wmark) == NULL) {
+            printf("CU_ADD_TEST fail. \n");
+            goto ERROR;
+    }
+
+    switch (cunit_mode) {
+        case CUNIT_SCREEN:
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            break;
+        case CUNIT_XMLFILE:
+            CU_set_output_filename("etmemd_damon.c");
+            CU_automated_run_tests();
+            break;
+        case CUNIT_CONSOLE:
+            CU_console_run_tests();
+            break;
+        default:
+            printf("not support cunit mode, only support: "
+                   "0 for CUNIT_SCREEN, 1 for CUNIT_XMLFILE, 2 for CUNIT_CONSOLE\n");
+            goto ERROR;
+    }
+
+    num_failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    return num_failures;
+
+ERROR:
+    error_num = CU_get_error();
+    CU_cleanup_registry();
+    return -error_num;
+}
@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a source file of the unit test for the dynamic feedback engine in etmemd.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+
+#include "etmemd_project.h"
+#include "etmemd_task.h"
+#include "etmemd_engine.h"
+#include "etmemd_scan.h"
+#include "securec.h"
+
+#include "etmemd_dynamic_fb.c"
+
+#define PID_NOT_EXIST   4194304     /* the limit of pid_max, never used as a pid */
+
+struct dynamic_fb_test {
+    struct page_scan scan;
+    struct project proj;
+    struct engine eng;
+    struct task tk;
+    struct task_pid tk_pid;
+    struct dynamic_fb_params params;
+    struct dynamic_fb_pid_params pid_params;
+};
+
+static void dynamic_fb_test_init(struct dynamic_fb_test *test)
+{
+    (void)memset_s(test, sizeof(*test), 0, sizeof(*test));
+    test->scan.loop = 1;
+    test->proj.scan_param = &test->scan;
+    test->eng.proj = &test->proj;
+    test->tk.eng = &test->eng;
+    test->tk.params = &test->params;
+    test->tk_pid.tk = &test->tk;
+    test->tk_pid.params = &test->pid_params;
+    test->tk_pid.pid = (unsigned int)getpid();
+    test->tk_pid.mem_snap.status_fd = -1;
+    test->pid_params.stat_fd = -1;
+}
+
+static void test_sort_pid_params(void)
+{
+    struct dynamic_fb_test test;
+    struct page_refs page = {0};
+    struct page_refs *page_refs = &page;
+    struct page_sort *page_sort = NULL;
+
+    dynamic_fb_test_init(&test);
+    page.possibility = 0.5;
+
+    /* the task has no dram_percent, the tuned dram_percent of the pid decides to sort the pages */
+    test.params.slide.swap_threshold = 50;
+    test.pid_params.slide.dram_percent = 50;
+    page_sort = sort_page_refs(&page_refs, &test.tk_pid, &test.pid_params.slide);
+    CU_ASSERT_PTR_NOT_NULL(page_sort);
+    if (page_sort == NULL) {
+        return;
+    }
+    CU_ASSERT_PTR_NULL(page_refs);
+    CU_ASSERT_PTR_EQUAL(page_sort->page_refs_sort[sort_by_possibility(page.possibility)], &page);
+    free(page_sort->page_refs_sort);
+    free(page_sort);
+
+    /* and a pid tuned without dram_percent keeps the pages as scanned */
+    page_refs = &page;
+    page.next = NULL;
+    test.pid_params.slide.dram_percent = 0;
+    page_sort = sort_page_refs(&page_refs, &test.tk_pid, &test.pid_params.slide);
+    CU_ASSERT_PTR_NOT_NULL(page_sort);
+    if (page_sort == NULL) {
+        return;
+    }
+    CU_ASSERT_PTR_EQUAL(page_refs, &page);
+    CU_ASSERT_PTR_EQUAL(page_sort->page_refs, &page_refs);
+    free(page_sort->page_refs_sort);
+    free(page_sort);
+}
+
+static void test_tune_step(void)
+{
+    struct dynamic_fb_test test;
+    struct slide_params *slide = &test.pid_params.slide;
+
+    dynamic_fb_test_init(&test);
+    test.params.swapin_target = 100;
+    test.params.tune_step = 5;
+    test.params.min_dram_percent = 10;
+    slide->t = 50;
+    slide->dram_percent = 30;
+
+    /* above the target T goes down and dram_percent up by twice the step */
+    test.tk_pid.rt_swapin_rate = 150;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 40);
+    CU_ASSERT_EQUAL(slide->dram_percent, 40);
+
+    /* between half the target and the target nothing changes */
+    test.tk_pid.rt_swapin_rate = 60;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 40);
+    CU_ASSERT_EQUAL(slide->dram_percent, 40);
+    test.tk_pid.rt_swapin_rate = 100;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 40);
+    CU_ASSERT_EQUAL(slide->dram_percent, 40);
+
+    /* under half the target they move back by one step */
+    test.tk_pid.rt_swapin_rate = 10;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 45);
+    CU_ASSERT_EQUAL(slide->dram_percent, 35);
+
+    /* T and dram_percent stay in [0, 100] */
+    slide->t = 3;
+    slide->dram_percent = 95;
+    test.tk_pid.rt_swapin_rate = 1000;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 0);
+    CU_ASSERT_EQUAL(slide->dram_percent, 100);
+    slide->t = 98;
+    test.tk_pid.rt_swapin_rate = 0;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->t, 100);
+}
+
+static void test_tune_min_dram_percent(void)
+{
+    struct dynamic_fb_test test;
+    struct slide_params *slide = &test.pid_params.slide;
+
+    dynamic_fb_test_init(&test);
+    test.params.swapin_target = 100;
+    test.params.tune_step = 5;
+    test.params.min_dram_percent = 10;
+    slide->t = 50;
+    slide->dram_percent = 12;
+
+    /* dram_percent never goes under min_dram_percent */
+    test.tk_pid.rt_swapin_rate = 0;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->dram_percent, 10);
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->dram_percent, 10);
+
+    /* a pid without dram_percent is only tuned by T */
+    slide->dram_percent = 0;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->dram_percent, 0);
+    test.tk_pid.rt_swapin_rate = 1000;
+    dynamic_fb_tune(&test.tk_pid, &test.params, &test.pid_params);
+    CU_ASSERT_EQUAL(slide->dram_percent, 0);
+}
+
+static void dynamic_fb_test_release(struct dynamic_fb_test *test)
+{
+    if (test->pid_params.stat_fd >= 0) {
+        close(test->pid_params.stat_fd);
+        test->pid_params.stat_fd = -1;
+    }
+    etmemd_mem_snapshot_release(&test->tk_pid.mem_snap);
+}
+
+static void test_probe_swapin_source(void)
+{
+    struct dynamic_fb_test test;
+
+    /* a running pid always gets one of the counters, at least pswpin of vmstat */
+    dynamic_fb_test_init(&test);
+    CU_ASSERT_EQUAL(probe_swapin_source(&test.tk_pid, &test.pid_params), 0);
+    CU_ASSERT_NOT_EQUAL(test.pid_params.source, SWAPIN_SRC_NONE);
+    if (test.pid_params.source != SWAPIN_SRC_STATUS) {
+        CU_ASSERT_TRUE(test.pid_params.stat_fd >= 0);
+    }
+
+    /* the first sample is only the base of the rate, the next one gives the rate */
+    CU_ASSERT_EQUAL(update_swapin_rate(&test.tk_pid, &test.pid_params), -1);
+    CU_ASSERT_TRUE(test.pid_params.sampled);
+    usleep(10000);
+    etmemd_mem_snapshot_invalidate(&test.tk_pid.mem_snap);
+    CU_ASSERT_EQUAL(update_swapin_rate(&test.tk_pid, &test.pid_params), 0);
+    CU_ASSERT_TRUE(test.tk_pid.rt_swapin_rate >= 0);
+    dynamic_fb_test_release(&test);
+
+    /* nothing of a pid not running can be read but the system wide counter */
+    dynamic_fb_test_init(&test);
+    test.tk_pid.pid = PID_NOT_EXIST;
+    CU_ASSERT_EQUAL(probe_swapin_source(&test.tk_pid, &test.pid_params), 0);
+    CU_ASSERT_EQUAL(test.pid_params.source, SWAPIN_SRC_VMSTAT);
+    CU_ASSERT_TRUE(test.pid_params.stat_fd >= 0);
+    dynamic_fb_test_release(&test);
+}
+
+typedef enum {
+    CUNIT_SCREEN = 0,
+    CUNIT_XMLFILE,
+    CUNIT_CONSOLE
+} cu_run_mode;
+
+int main(int argc, const char **argv)
+{
+    CU_pSuite suite;
+    unsigned int num_failures;
+    cu_run_mode cunit_mode = CUNIT_SCREEN;
+    int error_num;
+
+    if (argc > 1) {
+        cunit_mode = atoi(argv[1]);
+    }
+
+    if (CU_initialize_registry() != CUE_SUCCESS) {
+        return -CU_get_error();
+    }
+
+    suite = CU_add_suite("etmem_dynamic_fb_ops", NULL, NULL);
+    if (suite == NULL) {
+        goto ERROR;
+    }
+
+    if (CU_ADD_TEST(suite, test_sort_pid_params) == NULL ||
+        CU_ADD_TEST(suite, test_tune_step) == NULL ||
+        CU_ADD_TEST(suite, test_tune_min_dram_percent) == NULL ||
+        CU_ADD_TEST(suite, test_probe_swapin_source) == NULL) {
+            printf("CU_ADD_TEST fail. \n");
+            goto ERROR;
+    }
+
+    switch (cunit_mode) {
+        case CUNIT_SCREEN:
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            break;
+        case CUNIT_XMLFILE:
+            CU_set_output_filename("etmemd_dynamic_fb.c");
+            CU_automated_run_tests();
+            break;
+        case CUNIT_CONSOLE:
+            CU_console_run_tests();
+            break;
+        default:
+            printf("not support cunit mode, only support: "
+                   "0 for CUNIT_SCREEN, 1 for CUNIT_XMLFILE, 2 for CUNIT_CONSOLE\n");
+            goto ERROR;
+    }
+
+    num_failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    return num_failures;
+
+ERROR:
+    error_num = CU_get_error();
+    CU_cleanup_registry();
+    return -error_num;
+}
@@ -0,0 +1,395 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a source file of the unit test for the historical feedback engine in etmemd.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+
+#include "etmemd_project.h"
+#include "etmemd_task.h"
+#include "etmemd_engine.h"
+#include "etmemd_scan.h"
+#include "securec.h"
+
+#include "etmemd_historical_fb.c"
+
+#define PID_NOT_EXIST 4194304
+#define HISTORY_TEST_DIR "/tmp/etmem_history_XXXXXX"
+
+struct historical_fb_test {
+    struct page_scan scan;
+    struct project proj;
+    struct engine eng;
+    struct task tk;
+    struct task_pid tk_pid;
+    struct historical_fb_params params;
+    struct historical_fb_pid_params pid_params;
+};
+
+static void historical_fb_test_init(struct historical_fb_test *test)
+{
+    (void)memset_s(test, sizeof(*test), 0, sizeof(*test));
+    test->scan.loop = 1;
+    test->proj.scan_param = &test->scan;
+    test->eng.proj = &test->proj;
+    test->tk.eng = &test->eng;
+    test->tk.params = &test->params;
+    test->tk_pid.tk = &test->tk;
+    test->tk_pid.params = &test->pid_params;
+    test->tk_pid.pid = (unsigned int)getpid();
+    test->tk_pid.pidfd = -1;
+    test->tk_pid.mem_snap.status_fd = -1;
+}
+
+static void test_sort_task_params(void)
+{
+    struct historical_fb_test test;
+    struct page_refs page = {0};
+    struct page_refs *page_refs = &page;
+    struct page_sort *page_sort = NULL;
+
+    historical_fb_test_init(&test);
+    page.possibility = 0.5;
+
+    /* tk->params is a struct historical_fb_params, pages are sorted by the slide params in it */
+    test.params.predict_threshold = HISTORY_DEFAULT_PREDICT;
+    test.params.slide.dram_percent = 50;
+    page_sort = sort_page_refs(&page_refs, &test.tk_pid, &test.params.slide);
+    CU_ASSERT_PTR_NOT_NULL(page_sort);
+    if (page_sort == NULL) {
+        return;
+    }
+    CU_ASSERT_PTR_NULL(page_refs);
+    CU_ASSERT_PTR_EQUAL(page_sort->page_refs_sort[sort_by_possibility(page.possibility)], &page);
+    free(page_sort->page_refs_sort);
+    free(page_sort);
+}
+
+static void test_fold_score(void)
+{
+    uint8_t score = HISTORY_SCORE_MAX;
+    int i;
+
+    CU_ASSERT_EQUAL(fold_score(0, false), 0);
+    CU_ASSERT_EQUAL(fold_score(0, true), HISTORY_SCORE_GAIN);
+    CU_ASSERT_EQUAL(fold_score(1, false), 0);
+    CU_ASSERT_EQUAL(fold_score(4, false), 3);
+    CU_ASSERT_EQUAL(fold_score(HISTORY_SCORE_MAX, true), HISTORY_SCORE_MAX);
+
+    /* a score which is never used again decays to 0 */
+    for (i = 0; i < HISTORY_SCORE_MAX && score != 0; i++) {
+        score = fold_score(score, false);
+    }
+    CU_ASSERT_EQUAL(score, 0);
+}
+
+static void test_history_record(void)
+{
+    struct history_table table = {0};
+    uint64_t first[] = {1, 3};
+    uint64_t second[] = {2, 3, 5};
+
+    CU_ASSERT_EQUAL(history_record(&table, first, 2), 0);
+    CU_ASSERT_EQUAL(table.header.nr_regions, 2);
+
+    /* regions are merged in order, known regions are not duplicated */
+    CU_ASSERT_EQUAL(history_record(&table, second, 3), 0);
+    CU_ASSERT_EQUAL(table.header.nr_regions, 4);
+    if (table.header.nr_regions != 4) {
+        history_table_destroy(&table);
+        return;
+    }
+    CU_ASSERT_EQUAL(table.regions[0].addr, 1);
+    CU_ASSERT_EQUAL(table.regions[1].addr, 2);
+    CU_ASSERT_EQUAL(table.regions[2].addr, 3);
+    CU_ASSERT_EQUAL(table.regions[3].addr, 5);
+    CU_ASSERT_TRUE(table.touched[0] && table.touched[1] && table.touched[2] && table.touched[3]);
+
+    CU_ASSERT_EQUAL(history_record(&table, NULL, 0), 0);
+    CU_ASSERT_EQUAL(table.header.nr_regions, 4);
+    history_table_destroy(&table);
+}
+
+static void test_history_roll_hour(void)
+{
+    struct history_table table = {0};
+    uint64_t addrs[] = {1, 2};
+    uint64_t touched_again[] = {2};
+    int hour;
+
+    CU_ASSERT_EQUAL(history_record(&table, addrs, 2), 0);
+    table.touched[0] = false;
+
+    /* only the touched region scores in the hour it is rolled from */
+    history_roll_hour(&table, 1, 1);
+    CU_ASSERT_EQUAL(table.header.cur_hour, 1);
+    CU_ASSERT_EQUAL(table.header.nr_regions, 1);
+    CU_ASSERT_EQUAL(table.regions[0].addr, 2);
+    CU_ASSERT_EQUAL(table.regions[0].score[0], HISTORY_SCORE_GAIN);
+    CU_ASSERT_FALSE(table.touched[0]);
+
+    CU_ASSERT_EQUAL(history_record(&table, touched_again, 1), 0);
+    history_roll_hour(&table, 2, 2);
+    CU_ASSERT_EQUAL(table.regions[0].score[1], HISTORY_SCORE_GAIN);
+
+    /* a region is dropped once every hour decays to 0 */
+    for (hour = 3; table.header.nr_regions != 0 && hour < HISTORY_HOURS * HISTORY_SCORE_MAX; hour++) {
+        history_roll_hour(&table, hour % HISTORY_HOURS, hour);
+    }
+    CU_ASSERT_EQUAL(table.header.nr_regions, 0);
+    history_table_destroy(&table);
+}
+
+static void test_history_roll_missed_hours(void)
+{
+    struct history_table table = {0};
+    uint64_t addrs[] = {1};
+
+    CU_ASSERT_EQUAL(history_record(&table, addrs, 1), 0);
+    if (table.header.nr_regions != 1) {
+        history_table_destroy(&table);
+        return;
+    }
+    table.regions[0].score[1] = HISTORY_SCORE_GAIN;
+    table.regions[0].score[2] = HISTORY_SCORE_GAIN;
+    table.regions[0].score[3] = HISTORY_SCORE_GAIN;
+
+    /* hours 1 and 2 pass unwatched, they decay as hours without access, the new hour 3 does not */
+    history_roll_hour(&table, 3, 3);
+    CU_ASSERT_EQUAL(table.header.cur_hour, 3);
+    CU_ASSERT_EQUAL(table.header.hour_stamp, 3);
+    CU_ASSERT_EQUAL(table.regions[0].score[0], HISTORY_SCORE_GAIN);
+    CU_ASSERT_EQUAL(table.regions[0].score[1], fold_score(HISTORY_SCORE_GAIN, false));
+    CU_ASSERT_EQUAL(table.regions[0].score[2], fold_score(HISTORY_SCORE_GAIN, false));
+    CU_ASSERT_EQUAL(table.regions[0].score[3], HISTORY_SCORE_GAIN);
+
+    /* the history does not outlive a stop longer than the decay of the max score */
+    table.regions[0].score[0] = HISTORY_SCORE_MAX;
+    history_roll_hour(&table, 3, 3 + (int64_t)HISTORY_HOURS * HISTORY_DECAY_DAYS * 2);
+    CU_ASSERT_EQUAL(table.header.nr_regions, 0);
+    history_table_destroy(&table);
+}
+
+static void history_test_make_table(struct history_table *table, uint64_t start_time)
+{
+    uint64_t addrs[] = {1, 7};
+
+    (void)memset_s(table, sizeof(*table), 0, sizeof(*table));
+    table->header.magic = HISTORY_MAGIC;
+    table->header.version = HISTORY_VERSION;
+    table->header.region_shift = HISTORY_REGION_SHIFT;
+    table->header.start_time = start_time;
+    table->header.cur_hour = 0;
+    table->header.hour_stamp = 0;
+    CU_ASSERT_EQUAL(history_record(table, addrs, 2), 0);
+    history_roll_hour(table, 1, 1);
+}
+
+static bool history_test_exists(const struct historical_fb_params *params, unsigned int pid)
+{
+    char path[PATH_MAX] = {0};
+
+    return get_history_path(params, pid, path, "") == 0 && access(path, F_OK) == 0;
+}
+
+static void test_history_save_load(void)
+{
+    struct historical_fb_test test;
+    struct history_table table;
+    struct history_table loaded = {0};
+    unsigned int pid = (unsigned int)getpid();
+    uint64_t touched[] = {1};
+    uint64_t start_time = 0;
+
+    historical_fb_test_init(&test);
+    CU_ASSERT_EQUAL(strcpy_s(test.params.history_dir, PATH_MAX, HISTORY_TEST_DIR), EOK);
+    CU_ASSERT_PTR_NOT_NULL(mkdtemp(test.params.history_dir));
+    CU_ASSERT_EQUAL(get_pid_start_time(pid, &start_time), 0);
+    history_test_make_table(&table, start_time);
+    CU_ASSERT_EQUAL(history_record(&table, touched, 1), 0);
+
+    CU_ASSERT_EQUAL(history_save(&test.params, pid, &table), 0);
+    CU_ASSERT_TRUE(history_test_exists(&test.params, pid));
+
+    /* the regions touched in the current hour are kept for the roll after the load */
+    loaded.header.start_time = start_time;
+    CU_ASSERT_EQUAL(history_load(&test.params, pid, &loaded), 0);
+    CU_ASSERT_EQUAL(loaded.header.nr_regions, table.header.nr_regions);
+    CU_ASSERT_EQUAL(loaded.header.cur_hour, 1);
+    CU_ASSERT_EQUAL(loaded.header.hour_stamp, 1);
+    if (loaded.header.nr_regions == table.header.nr_regions) {
+        CU_ASSERT_EQUAL(memcmp(loaded.regions, table.regions,
+                               sizeof(struct history_region) * table.header.nr_regions), 0);
+        CU_ASSERT_TRUE(loaded.touched[0]);
+        CU_ASSERT_FALSE(loaded.touched[1]);
+    }
+    history_table_destroy(&loaded);
+
+    /* the pid is reused by another process, its history is dropped */
+    loaded.header.start_time = start_time + 1;
+    CU_ASSERT_EQUAL(history_load(&test.params, pid, &loaded), -1);
+    CU_ASSERT_FALSE(history_test_exists(&test.params, pid));
+
+    history_table_destroy(&loaded);
+    history_table_destroy(&table);
+    CU_ASSERT_EQUAL(rmdir(test.params.history_dir), 0);
+}
+
+static void test_history_remove_exited(void)
+{
+    struct historical_fb_test test;
+    struct historical_fb_pid_params *pid_params = NULL;
+    struct task_pid *tk_pid = NULL;
+    struct history_table table;
+    unsigned int pid = (unsigned int)getpid();
+    uint64_t start_time = 0;
+
+    historical_fb_test_init(&test);
+    tk_pid = &test.tk_pid;
+    CU_ASSERT_EQUAL(strcpy_s(test.params.history_dir, PATH_MAX, HISTORY_TEST_DIR), EOK);
+    CU_ASSERT_PTR_NOT_NULL(mkdtemp(test.params.history_dir));
+    CU_ASSERT_EQUAL(get_pid_start_time(pid, &start_time), 0);
+
+    /* the history of a live process is kept, the one of an exited process is pruned */
+    history_test_make_table(&table, start_time);
+    CU_ASSERT_EQUAL(history_save(&test.params, pid, &table), 0);
+    CU_ASSERT_EQUAL(history_save(&test.params, PID_NOT_EXIST, &table), 0);
+    history_table_destroy(&table);
+    history_dir_prune(&test.params);
+    CU_ASSERT_TRUE(history_test_exists(&test.params, pid));
+    CU_ASSERT_FALSE(history_test_exists(&test.params, PID_NOT_EXIST));
+
+    /* the history is saved when the task stops watching a live pid */
+    CU_ASSERT_EQUAL(historical_fb_alloc_pid_params(&test.eng, &tk_pid), 0);
+    pid_params = (struct historical_fb_pid_params *)tk_pid->params;
+    CU_ASSERT_PTR_NOT_NULL(pid_params);
+    if (pid_params == NULL) {
+        return;
+    }
+    CU_ASSERT_EQUAL(pid_params->table.header.nr_regions, 2);
+    pid_params->dirty = true;
+    historical_fb_free_pid_params(&test.eng, &tk_pid);
+    CU_ASSERT_PTR_NULL(tk_pid->params);
+    CU_ASSERT_TRUE(history_test_exists(&test.params, pid));
+
+    /* and removed with the pid */
+    CU_ASSERT_EQUAL(historical_fb_alloc_pid_params(&test.eng, &tk_pid), 0);
+    tk_pid->exited = true;
+    historical_fb_free_pid_params(&test.eng, &tk_pid);
+    CU_ASSERT_FALSE(history_test_exists(&test.params, pid));
+
+    CU_ASSERT_EQUAL(rmdir(test.params.history_dir), 0);
+}
+
+static void test_check_history_dir(void)
+{
+    char base[PATH_MAX] = HISTORY_TEST_DIR;
+    char dir[PATH_MAX] = {0};
+    char file[PATH_MAX] = {0};
+    int fd;
+
+    CU_ASSERT_PTR_NOT_NULL(mkdtemp(base));
+
+    /* the missing parents are created as well */
+    CU_ASSERT_TRUE(snprintf_s(dir, PATH_MAX, PATH_MAX - 1, "%s/etmem/history", base) > 0);
+    CU_ASSERT_EQUAL(check_history_dir(dir), 0);
+    CU_ASSERT_EQUAL(check_history_dir(dir), 0);
+
+    CU_ASSERT_TRUE(snprintf_s(file, PATH_MAX, PATH_MAX - 1, "%s/file", base) > 0);
+    fd = open(file, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    CU_ASSERT_TRUE(fd >= 0);
+    if (fd >= 0) {
+        close(fd);
+    }
+    CU_ASSERT_EQUAL(check_history_dir(file), -1);
+
+    CU_ASSERT_EQUAL(unlink(file), 0);
+    CU_ASSERT_EQUAL(rmdir(dir), 0);
+    CU_ASSERT_TRUE(snprintf_s(dir, PATH_MAX, PATH_MAX - 1, "%s/etmem", base) > 0);
+    CU_ASSERT_EQUAL(rmdir(dir), 0);
+    CU_ASSERT_EQUAL(rmdir(base), 0);
+}
+
+typedef enum {
+    CUNIT_SCREEN = 0,
+    CUNIT_XMLFILE,
+    CUNIT_CONSOLE
+} cu_run_mode;
+
+int main(int argc, const char **argv)
+{
+    CU_pSuite suite;
+    unsigned int num_failures;
+    cu_run_mode cunit_mode = CUNIT_SCREEN;
+    int error_num;
+
+    if (argc > 1) {
+        cunit_mode = atoi(argv[1]);
+    }
+
+    if (CU_initialize_registry() != CUE_SUCCESS) {
+        return -CU_get_error();
+    }
+
+    suite = CU_add_suite("etmem_historical_fb_ops", NULL, NULL);
+    if (suite == NULL) {
+        goto ERROR;
+    }
+
+    if (CU_ADD_TEST(suite, test_sort_task_params) == NULL ||
+        CU_ADD_TEST(suite, test_fold_score) == NULL ||
+        CU_ADD_TEST(suite, test_history_record) == NULL ||
+        CU_ADD_TEST(suite, test_history_roll_hour) == NULL ||
+        CU_ADD_TEST(suite, test_history_roll_missed_hours) == NULL ||
+        CU_ADD_TEST(suite, test_check_history_dir) == NULL ||
+        CU_ADD_TEST(suite, test_history_save_load) == NULL ||
+        CU_ADD_TEST(suite, test_history_remove_exited) == NULL) {
+            printf("CU_ADD_TEST fail. \n");
+            goto ERROR;
+    }
+
+    switch (cunit_mode) {
+        case CUNIT_SCREEN:
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            break;
+        case CUNIT_XMLFILE:
+            CU_set_output_filename("etmemd_historical_fb.c");
+            CU_automated_run_tests();
+            break;
+        case CUNIT_CONSOLE:
+            CU_console_run_tests();
+            break;
+        default:
+            printf("not support cunit mode, only support: "
+                   "0 for CUNIT_SCREEN, 1 for CUNIT_XMLFILE, 2 for CUNIT_CONSOLE\n");
+            goto ERROR;
+    }
+
+    num_failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    return num_failures;
+
+ERROR:
+    error_num = CU_get_error();
+    CU_cleanup_registry();
+    return -error_num;
+}
@@ -17,6 +17,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <numa.h>
 
 #include "etmemd.h"
 #include "etmemd_migrate.h"
@@ -40,6 +42,17 @@ int get_mem_from_proc_file(const char *pid, const char *file_name,
     return 0;
 }
 
+int get_mem_from_meminfo(struct proc_mem_key *keys, int key_num)
+{
+    int i;
+
+    for (i = 0; i < key_num; i++) {
+        *keys[i].value = 100;
+        keys[i].found = true;
+    }
+    return 0;
+}
+
 void init_task_pid_param(struct task_pid *param)
 {
     param->pid = 1;
@@ -58,7 +71,7 @@ static struct memory_grade *get_memory_grade(void)
     init_g_page_size();
     vmas = get_vmas(pid);
     CU_ASSERT_PTR_NOT_NULL(vmas);
-    CU_ASSERT_EQUAL(get_page_refs(vmas, pid, &page_refs, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(get_page_refs(vmas, pid, &page_refs, NULL, NULL, SCAN_SRC_IDLE_PAGES, 0, 0), 0);
     free(vmas);
     vmas = NULL;
 
@@ -109,6 +122,68 @@ static void test_etmem_migrate_ok(void)
     CU_ASSERT_PTR_NULL(memory_grade);
 }
 
+static void test_etmem_migrate_node(void)
+{
+    struct page_refs page_refs = {0};
+    unsigned long free_kb = 0;
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *buf = NULL;
+
+    if (numa_available() < 0) {
+        return;
+    }
+
+    CU_ASSERT_EQUAL(etmemd_node_free_mem(0, &free_kb), 0);
+    CU_ASSERT_NOT_EQUAL(free_kb, 0);
+    CU_ASSERT_EQUAL(etmemd_node_free_mem(numa_max_node() + 1, &free_kb), -1);
+
+    CU_ASSERT_EQUAL(etmemd_migrate_node(getpid(), NULL, 0), 0);
+
+    buf = aligned_alloc(page_size, page_size);
+    CU_ASSERT_PTR_NOT_NULL(buf);
+    buf[0] = 1;
+    page_refs.addr = (uint64_t)buf;
+    CU_ASSERT_EQUAL(etmemd_migrate_node(getpid(), &page_refs, 0), 1);
+    CU_ASSERT_EQUAL(etmemd_migrate_node(getpid(), &page_refs, numa_max_node() + 1), -1);
+    free(buf);
+}
+
+static void test_etmem_take_node_pages(void)
+{
+    struct page_refs page_refs = {0};
+    struct page_refs *list = NULL;
+    struct page_refs *on_node = NULL;
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *buf = NULL;
+
+    if (numa_available() < 0) {
+        return;
+    }
+
+    CU_ASSERT_EQUAL(etmemd_take_node_pages(getpid(), &list, 0, &on_node), 0);
+
+    buf = aligned_alloc(page_size, page_size);
+    CU_ASSERT_PTR_NOT_NULL(buf);
+    if (buf == NULL) {
+        return;
+    }
+    buf[0] = 1;
+    page_refs.addr = (uint64_t)buf;
+
+    /* the page is not on the node, it is kept in the list */
+    list = &page_refs;
+    CU_ASSERT_EQUAL(etmemd_take_node_pages(getpid(), &list, numa_max_node() + 1, &on_node), 0);
+    CU_ASSERT_PTR_EQUAL(list, &page_refs);
+    CU_ASSERT_PTR_NULL(on_node);
+
+    /* the page is moved to node 0 first, then it is taken out of the list */
+    CU_ASSERT_EQUAL(etmemd_migrate_node(getpid(), &page_refs, 0), 1);
+    CU_ASSERT_EQUAL(etmemd_take_node_pages(getpid(), &list, 0, &on_node), 1);
+    CU_ASSERT_PTR_NULL(list);
+    CU_ASSERT_PTR_EQUAL(on_node, &page_refs);
+    free(buf);
+}
+
 static void test_etmemd_reclaim_swapcache_error(void)
 {
     struct project proj = {0};
@@ -190,6 +265,8 @@ int main(int argc, const char **argv)
 
     if (CU_ADD_TEST(suite, test_etmem_migrate_error) == NULL ||
         CU_ADD_TEST(suite, test_etmem_migrate_ok) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_migrate_node) == NULL ||
+        CU_ADD_TEST(suite, test_etmem_take_node_pages) == NULL ||
         CU_ADD_TEST(suite, test_etmemd_reclaim_swapcache_error) == NULL ||
         CU_ADD_TEST(suite, test_etmemd_reclaim_swapcache_ok) == NULL) {
             printf("CU_ADD_TEST fail. \n");
@@ -0,0 +1,382 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: This is a source file of the unit test for the region sampler in etmemd.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+
+#include "etmemd_scan.h"
+#include "securec.h"
+
+#include "etmemd_region_sampler.c"
+
+#define TEST_VMA_START      0x100000
+#define TEST_VMA_PAGES      64
+#define TEST_MIN_REGIONS    10
+#define TEST_MAX_REGIONS    40
+#define TEST_MAX_ACCESSES   20
+#define TEST_HOT_ACCESSES   10
+#define TEST_SEED           1
+
+/* the backend is never read by the cases, it only marks the target alive */
+static int g_test_backend;
+static int g_test_reported;
+
+static struct region_sampler *test_sampler(unsigned long min_nr_regions, unsigned long max_nr_regions)
+{
+    struct region_sampler *sampler = NULL;
+    uint64_t page_size = sampler_page_size();
+    struct vma vma = {0};
+    struct vmas vmas = {1, &vma};
+
+    sampler = calloc(1, sizeof(struct region_sampler));
+    if (sampler == NULL) {
+        return NULL;
+    }
+    sampler->target = calloc(1, sizeof(struct sampler_target));
+    if (sampler->target == NULL) {
+        free(sampler);
+        return NULL;
+    }
+    sampler->nr_targets = 1;
+    sampler->attrs.min_nr_regions = min_nr_regions;
+    sampler->attrs.max_nr_regions = max_nr_regions;
+    sampler->max_nr_accesses = TEST_MAX_ACCESSES;
+    sampler->seed = TEST_SEED;
+    sampler->target->backend.priv = &g_test_backend;
+
+    vma.start = TEST_VMA_START;
+    vma.end = TEST_VMA_START + TEST_VMA_PAGES * page_size;
+    if (sampler_set_regions(sampler->target, &vmas) != 0) {
+        free(sampler->target);
+        free(sampler);
+        return NULL;
+    }
+    return sampler;
+}
+
+static void free_test_sampler(struct region_sampler *sampler)
+{
+    free(sampler->target->region);
+    free(sampler->target);
+    free(sampler);
+}
+
+/* the regions cover the vma without holes, and are aligned to pages */
+static bool is_vma_covered(const struct sampler_target *target)
+{
+    uint64_t page_size = sampler_page_size();
+    uint64_t addr = TEST_VMA_START;
+    int i;
+
+    for (i = 0; i < target->num; i++) {
+        if (target->region[i].start != addr || target->region[i].end <= target->region[i].start ||
+            (target->region[i].end & (page_size - 1)) != 0) {
+            return false;
+        }
+        addr = target->region[i].end;
+    }
+    return addr == TEST_VMA_START + TEST_VMA_PAGES * page_size;
+}
+
+static void test_sampler_split_evenly(void)
+{
+    struct region_sampler *sampler = NULL;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(TEST_MIN_REGIONS, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    CU_ASSERT_EQUAL(sampler->target->num, 1);
+
+    /* the vma is split into min_nr_regions at least at start */
+    CU_ASSERT_EQUAL(sampler_split_evenly(sampler->target, sampler_sz_limit(sampler)), 0);
+    CU_ASSERT_TRUE(sampler->target->num >= TEST_MIN_REGIONS);
+    CU_ASSERT_TRUE(sampler->target->num <= TEST_MAX_REGIONS);
+    CU_ASSERT_TRUE(is_vma_covered(sampler->target));
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+static void test_sampler_split(void)
+{
+    struct region_sampler *sampler = NULL;
+    int num;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(TEST_MIN_REGIONS, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    CU_ASSERT_EQUAL(sampler_split_evenly(sampler->target, sampler_sz_limit(sampler)), 0);
+
+    /* far fewer than max_nr_regions, each region is split in 3 at most */
+    num = sampler->target->num;
+    sampler_split(sampler);
+    CU_ASSERT_TRUE(sampler->target->num > num);
+    CU_ASSERT_TRUE(sampler->target->num <= num * SAMPLER_SPLIT_MAX_SUBS);
+    CU_ASSERT_TRUE(is_vma_covered(sampler->target));
+
+    /* regions are not split once they are more than half of max_nr_regions */
+    sampler->attrs.max_nr_regions = (unsigned long)sampler->target->num;
+    num = sampler->target->num;
+    sampler_split(sampler);
+    CU_ASSERT_EQUAL(sampler->target->num, num);
+
+    /* a region of one page can not be split */
+    sampler->attrs.min_nr_regions = TEST_VMA_PAGES;
+    sampler->attrs.max_nr_regions = TEST_VMA_PAGES * SAMPLER_SPLIT_MAX_SUBS * 2;
+    CU_ASSERT_EQUAL(sampler_split_evenly(sampler->target, sampler_sz_limit(sampler)), 0);
+    CU_ASSERT_EQUAL(sampler->target->num, TEST_VMA_PAGES);
+    sampler_split(sampler);
+    CU_ASSERT_EQUAL(sampler->target->num, TEST_VMA_PAGES);
+    CU_ASSERT_TRUE(is_vma_covered(sampler->target));
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+static void test_sampler_merge(void)
+{
+    struct region_sampler *sampler = NULL;
+    struct sampler_target *target = NULL;
+    int i;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(TEST_MIN_REGIONS, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    target = sampler->target;
+    sampler->attrs.min_nr_regions = 2;
+    sampler->attrs.max_nr_regions = TEST_VMA_PAGES;
+    CU_ASSERT_EQUAL(sampler_split_evenly(target, sampler_page_size()), 0);
+    CU_ASSERT_EQUAL(target->num, TEST_VMA_PAGES);
+
+    /* adjacent regions of the same frequency are merged up to the size limit of min_nr_regions */
+    for (i = 0; i < target->num; i++) {
+        target->region[i].nr_accesses = i < TEST_VMA_PAGES / 2 ? TEST_HOT_ACCESSES : 0;
+    }
+    sampler_merge(sampler);
+    CU_ASSERT_EQUAL(target->num, 2);
+    CU_ASSERT_EQUAL(target->region[0].nr_accesses, TEST_HOT_ACCESSES);
+    CU_ASSERT_EQUAL(target->region[1].nr_accesses, 0);
+    CU_ASSERT_TRUE(is_vma_covered(target));
+
+    /* the threshold is raised until the regions are within max_nr_regions, weighted by size */
+    sampler->attrs.min_nr_regions = 1;
+    sampler->attrs.max_nr_regions = 1;
+    sampler_merge(sampler);
+    CU_ASSERT_EQUAL(target->num, 1);
+    CU_ASSERT_EQUAL(target->region[0].nr_accesses, TEST_HOT_ACCESSES / 2);
+    CU_ASSERT_TRUE(is_vma_covered(target));
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+static void test_sampler_merge_bound(void)
+{
+    struct region_sampler *sampler = NULL;
+    struct sampler_target *target = NULL;
+    int i;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(TEST_MIN_REGIONS, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    target = sampler->target;
+    CU_ASSERT_EQUAL(sampler_split_evenly(target, sampler_page_size()), 0);
+
+    /* alternate frequencies are merged as the threshold grows, but not below min_nr_regions */
+    for (i = 0; i < target->num; i++) {
+        target->region[i].nr_accesses = (i % 2 == 0) ? TEST_HOT_ACCESSES : 0;
+    }
+    sampler_merge(sampler);
+    CU_ASSERT_TRUE(target->num >= TEST_MIN_REGIONS);
+    CU_ASSERT_TRUE(target->num <= TEST_MAX_REGIONS);
+    CU_ASSERT_TRUE(is_vma_covered(target));
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+static void test_sampler_age(void)
+{
+    struct region_sampler *sampler = NULL;
+    struct sampler_target *target = NULL;
+    unsigned int thres = TEST_HOT_ACCESSES / 2;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(2, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    target = sampler->target;
+    CU_ASSERT_EQUAL(sampler_split_evenly(target, sampler_sz_limit(sampler)), 0);
+    CU_ASSERT_EQUAL(target->num, 2);
+
+    /* a region gets older while its frequency stays, and is reset once it changes more than thres */
+    target->region[0].age = 1;
+    target->region[0].last_nr_accesses = TEST_HOT_ACCESSES;
+    target->region[0].nr_accesses = TEST_HOT_ACCESSES - thres;
+    target->region[1].age = 1;
+    target->region[1].last_nr_accesses = TEST_HOT_ACCESSES;
+    target->region[1].nr_accesses = 0;
+    sampler_age_regions(target, thres);
+    CU_ASSERT_EQUAL(target->region[0].age, 2);
+    CU_ASSERT_EQUAL(target->region[1].age, 0);
+
+    /* the age of merged regions is weighted by their sizes */
+    target->region[0].age = TEST_HOT_ACCESSES;
+    target->region[1].age = 0;
+    target->region[1].nr_accesses = target->region[0].nr_accesses;
+    sampler_merge_regions(target, thres, TEST_VMA_PAGES * sampler_page_size());
+    CU_ASSERT_EQUAL(target->num, 1);
+    CU_ASSERT_EQUAL(target->region[0].age, TEST_HOT_ACCESSES / 2);
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+static void test_aggr_fn(void *arg, unsigned int pid, const struct damon_regions *regions)
+{
+    g_test_reported = regions->num;
+}
+
+static void test_sampler_aggregate(void)
+{
+    struct region_sampler *sampler = NULL;
+    struct sampler_target *target = NULL;
+    int num;
+    int i;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    sampler = test_sampler(TEST_MIN_REGIONS, TEST_MAX_REGIONS);
+    CU_ASSERT_PTR_NOT_NULL(sampler);
+    if (sampler == NULL) {
+        etmemd_scan_exit();
+        return;
+    }
+    target = sampler->target;
+    sampler->aggr_fn = test_aggr_fn;
+    CU_ASSERT_EQUAL(sampler_split_evenly(target, sampler_sz_limit(sampler)), 0);
+    for (i = 0; i < target->num; i++) {
+        target->region[i].nr_accesses = (unsigned int)i * TEST_MAX_ACCESSES / target->num;
+    }
+
+    /* the merged regions are reported, and the frequency of this aggregation is kept to age them */
+    g_test_reported = 0;
+    sampler_aggregate(sampler);
+    CU_ASSERT_TRUE(g_test_reported >= TEST_MIN_REGIONS);
+    CU_ASSERT_TRUE(target->num >= g_test_reported);
+    CU_ASSERT_TRUE(target->num <= TEST_MAX_REGIONS);
+    for (i = 0; i < target->num; i++) {
+        CU_ASSERT_EQUAL(target->region[i].nr_accesses, 0);
+    }
+    CU_ASSERT_TRUE(is_vma_covered(target));
+
+    /* a target whose pid exits is not reported, nor split */
+    target->backend.priv = NULL;
+    num = target->num;
+    g_test_reported = 0;
+    sampler_aggregate(sampler);
+    CU_ASSERT_EQUAL(g_test_reported, 0);
+    CU_ASSERT_TRUE(target->num <= num);
+
+    free_test_sampler(sampler);
+    etmemd_scan_exit();
+}
+
+typedef enum {
+    CUNIT_SCREEN = 0,
+    CUNIT_XMLFILE,
+    CUNIT_CONSOLE
+} cu_run_mode;
+
+int main(int argc, const char **argv)
+{
+    CU_pSuite suite;
+    unsigned int num_failures;
+    cu_run_mode cunit_mode = CUNIT_SCREEN;
+    int error_num;
+
+    if (argc > 1) {
+        cunit_mode = atoi(argv[1]);
+    }
+
+    if (CU_initialize_registry() != CUE_SUCCESS) {
+        return -CU_get_error();
+    }
+
+    suite = CU_add_suite("etmem_region_sampler_ops", NULL, NULL);
+    if (suite == NULL) {
+        goto ERROR;
+    }
+
+    if (CU_ADD_TEST(suite, test_sampler_split_evenly) == NULL ||
+        CU_ADD_TEST(suite, test_sampler_split) == NULL ||
+        CU_ADD_TEST(suite, test_sampler_merge) == NULL ||
+        CU_ADD_TEST(suite, test_sampler_merge_bound) == NULL ||
+        CU_ADD_TEST(suite, test_sampler_age) == NULL ||
+        CU_ADD_TEST(suite, test_sampler_aggregate) == NULL) {
+            printf("CU_ADD_TEST fail. \n");
+            goto ERROR;
+    }
+
+    switch (cunit_mode) {
+        case CUNIT_SCREEN:
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            break;
+        case CUNIT_XMLFILE:
+            CU_set_output_filename("etmemd_region_sampler.c");
+            CU_automated_run_tests();
+            break;
+        case CUNIT_CONSOLE:
+            CU_console_run_tests();
+            break;
+        default:
+            printf("not support cunit mode, only support: "
+                   "0 for CUNIT_SCREEN, 1 for CUNIT_XMLFILE, 2 for CUNIT_CONSOLE\n");
+            goto ERROR;
+    }
+
+    num_failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    return num_failures;
+
+ERROR:
+    error_num = CU_get_error();
+    CU_cleanup_registry();
+    return -error_num;
+}
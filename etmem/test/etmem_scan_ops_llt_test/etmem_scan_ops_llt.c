@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
 
 #include <CUnit/Basic.h>
 #include <CUnit/Automated.h>
@@ -23,6 +26,8 @@
 #include "etmemd_scan.h"
 #include "etmemd_project.h"
 #include "etmemd_engine.h"
+#include "etmemd_damon.h"
+#include "etmemd_scan_backend.h"
 
 static struct task_pid *alloc_tkpid(unsigned int pid, struct task *tk)
 {
@@ -31,6 +36,7 @@ static struct task_pid *alloc_tkpid(unsigned int pid, struct task *tk)
     tpid = (struct task_pid *)calloc(1, sizeof(struct task_pid));
     CU_ASSERT_PTR_NOT_NULL(tpid);
     tpid->pid = pid;
+    tpid->pidfd = -1;
     tpid->tk = tk;
 
     return tpid;
@@ -249,7 +255,7 @@ static void test_get_page_refs_valid()
 
     unsigned long use_rss;
 
-    CU_ASSERT_EQUAL(get_page_refs(vmas, pid, &page_refs, &use_rss, NULL), 0);
+    CU_ASSERT_EQUAL(get_page_refs(vmas, pid, &page_refs, &use_rss, NULL, SCAN_SRC_IDLE_PAGES, 0, 0), 0);
     CU_ASSERT_PTR_NOT_NULL(page_refs);
     CU_ASSERT_NOT_EQUAL(use_rss, 0);
 
@@ -275,8 +281,8 @@ static void test_scan_error(void)
     tk = alloc_tk(loop, sleep);
     tpid = alloc_tkpid(pid_error, tk);
 
-    CU_ASSERT_PTR_NULL(etmemd_do_scan(tpid, NULL));
-    CU_ASSERT_PTR_NULL(etmemd_do_scan(tpid, tk));
+    CU_ASSERT_PTR_NULL(etmemd_do_scan(tpid, NULL, 0));
+    CU_ASSERT_PTR_NULL(etmemd_do_scan(tpid, tk, 0));
 
     free(tk->eng->proj->scan_param);
     free(tk->eng->proj);
@@ -299,7 +305,7 @@ static void test_etmem_scan_ok(void)
 
     CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
 
-    page_refs = etmemd_do_scan(tpid, tk);
+    page_refs = etmemd_do_scan(tpid, tk, 0);
     CU_ASSERT_PTR_NOT_NULL(page_refs);
     free(tk->eng->proj->scan_param);
     free(tk->eng->proj);
@@ -321,7 +327,7 @@ static void test_add_pg_to_mem_grade()
     CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
 
     vma = get_vmas(pid);
-    CU_ASSERT_EQUAL(get_page_refs(vma, pid, &page_refs, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(get_page_refs(vma, pid, &page_refs, NULL, NULL, SCAN_SRC_IDLE_PAGES, 0, 0), 0);
     page_refs = add_page_refs_into_memory_grade(page_refs, &list);
     CU_ASSERT_PTR_NOT_NULL(page_refs);
     CU_ASSERT_PTR_NOT_NULL(list);
@@ -332,6 +338,187 @@ static void test_add_pg_to_mem_grade()
     etmemd_scan_exit();
 }
 
+static int count_region_page_refs(const struct page_refs *pf, int count)
+{
+    int num = 0;
+
+    for (; pf != NULL; pf = pf->next) {
+        if (pf->count == count) {
+            num++;
+        }
+    }
+    return num;
+}
+
+static void test_walk_regions(void)
+{
+    struct damon_region region[] = {
+        {.start = 0x1000, .end = 0x5000, .nr_accesses = 20, .age = 1},
+        {.start = 0x5000, .end = 0x9000, .nr_accesses = 0, .age = 1},
+    };
+    struct damon_regions regions = {
+        .region = region,
+        .num = 2,
+        .max_nr_accesses = 20,
+    };
+    struct walk_address walk_address = {0, 0, 0};
+    struct region_walk walk = {-1, ULONG_MAX, PTE_TYPE};
+    struct page_refs *first = NULL;
+    struct page_refs *second = NULL;
+    int cursor = 0;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+
+    /* the first region is split by the end of the first vma */
+    walk_address.walk_start = 0;
+    walk_address.walk_end = 0x3000;
+    CU_ASSERT_PTR_NOT_NULL(walk_regions(&regions, &cursor, &walk_address, 4, &walk, &first));
+    CU_ASSERT_EQUAL(cursor, 0);
+    CU_ASSERT_EQUAL(count_region_page_refs(first, 4), 2);
+    CU_ASSERT_EQUAL(first->addr, 0x1000);
+    CU_ASSERT_DOUBLE_EQUAL(first->possibility, 1.0, 0.001);
+
+    walk_address.walk_start = 0x3000;
+    walk_address.walk_end = 0x8000;
+    CU_ASSERT_PTR_NOT_NULL(walk_regions(&regions, &cursor, &walk_address, 4, &walk, &second));
+    CU_ASSERT_EQUAL(cursor, 1);
+    CU_ASSERT_EQUAL(count_region_page_refs(second, 4), 2);
+    CU_ASSERT_EQUAL(count_region_page_refs(second, 0), 3);
+    CU_ASSERT_EQUAL(second->addr, 0x3000);
+
+    etmemd_free_page_refs(first);
+    etmemd_free_page_refs(second);
+    etmemd_scan_exit();
+}
+
+/* the pages of hugetlb vmas are built at the huge page size */
+static void test_walk_regions_huge(void)
+{
+    struct damon_region region = {.nr_accesses = 20, .age = 1};
+    struct damon_regions regions = {
+        .region = &region,
+        .num = 1,
+        .max_nr_accesses = 20,
+    };
+    struct walk_address walk_address = {0, 0, 0};
+    struct region_walk walk = {-1, ULONG_MAX, PMD_TYPE};
+    struct page_refs *pf = NULL;
+    uint64_t huge_size;
+    int cursor = 0;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    huge_size = (uint64_t)page_type_to_size(PMD_TYPE);
+    region.start = huge_size;
+    region.end = 3 * huge_size;
+    walk_address.walk_start = region.start;
+    walk_address.walk_end = region.end;
+
+    CU_ASSERT_PTR_NOT_NULL(walk_regions(&regions, &cursor, &walk_address, 4, &walk, &pf));
+    CU_ASSERT_EQUAL(count_region_page_refs(pf, 4), 2);
+    if (pf != NULL && pf->next != NULL) {
+        CU_ASSERT_EQUAL(pf->type, PMD_TYPE);
+        CU_ASSERT_EQUAL(pf->next->addr, region.start + huge_size);
+    }
+    etmemd_free_page_refs(pf);
+    etmemd_scan_exit();
+}
+
+#define TEST_REGION_PAGES 4
+
+/* only the present pages of a region are built, and no more than the budget */
+static void test_walk_regions_present(void)
+{
+    struct damon_region region = {0};
+    struct damon_regions regions = {
+        .region = &region,
+        .num = 1,
+        .max_nr_accesses = 20,
+    };
+    struct walk_address walk_address = {0, 0, 0};
+    struct region_walk walk;
+    struct page_refs *pf = NULL;
+    char pid[PID_STR_MAX_LEN] = {0};
+    unsigned long page_size;
+    char *buf = NULL;
+    int cursor = 0;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    page_size = get_pagesize();
+    buf = mmap(NULL, TEST_REGION_PAGES * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CU_ASSERT_NOT_EQUAL(buf, MAP_FAILED);
+    if (buf == MAP_FAILED) {
+        etmemd_scan_exit();
+        return;
+    }
+    buf[0] = 1;
+    buf[2 * page_size] = 1;
+
+    region.start = (uint64_t)(uintptr_t)buf;
+    region.end = region.start + TEST_REGION_PAGES * page_size;
+    region.nr_accesses = regions.max_nr_accesses;
+    walk_address.walk_start = region.start;
+    walk_address.walk_end = region.end;
+
+    (void)snprintf(pid, PID_STR_MAX_LEN, "%d", getpid());
+    region_walk_open(&walk, pid, PTE_TYPE);
+    CU_ASSERT_TRUE(walk.pagemap_fd >= 0);
+    CU_ASSERT_TRUE(walk.budget >= 2);
+    CU_ASSERT_PTR_NOT_NULL(walk_regions(&regions, &cursor, &walk_address, 4, &walk, &pf));
+    CU_ASSERT_EQUAL(count_region_page_refs(pf, 4), 2);
+    if (pf != NULL && pf->next != NULL) {
+        CU_ASSERT_EQUAL(pf->addr, region.start);
+        CU_ASSERT_EQUAL(pf->next->addr, region.start + 2 * page_size);
+    }
+    etmemd_free_page_refs(pf);
+    pf = NULL;
+
+    /* the walk stops when the budget runs out */
+    cursor = 0;
+    walk.budget = 1;
+    CU_ASSERT_PTR_NOT_NULL(walk_regions(&regions, &cursor, &walk_address, 4, &walk, &pf));
+    CU_ASSERT_EQUAL(count_region_page_refs(pf, 4), 1);
+    CU_ASSERT_EQUAL(walk.budget, 0);
+    etmemd_free_page_refs(pf);
+    region_walk_close(&walk);
+    CU_ASSERT_EQUAL(walk.pagemap_fd, -1);
+
+    munmap(buf, TEST_REGION_PAGES * page_size);
+    etmemd_scan_exit();
+}
+
+static void test_page_idle_backend(void)
+{
+    struct scan_backend backend;
+    char pid[PID_STR_MAX_LEN] = {0};
+    char *page = NULL;
+    unsigned long page_size;
+
+    CU_ASSERT_EQUAL(etmemd_scan_init(), 0);
+    CU_ASSERT_NOT_EQUAL(scan_backend_open(&backend, SCAN_SRC_PAGE_IDLE, "0", NULL), 0);
+
+    (void)snprintf(pid, PID_STR_MAX_LEN, "%d", getpid());
+    if (access(PAGE_IDLE_BITMAP, R_OK | W_OK) != 0) {
+        CU_ASSERT_NOT_EQUAL(scan_backend_open(&backend, SCAN_SRC_PAGE_IDLE, pid, NULL), 0);
+        etmemd_scan_exit();
+        return;
+    }
+
+    page_size = get_pagesize();
+    page = (char *)aligned_alloc(page_size, page_size);
+    CU_ASSERT_PTR_NOT_NULL(page);
+    page[0] = 1;
+
+    CU_ASSERT_EQUAL(scan_backend_open(&backend, SCAN_SRC_PAGE_IDLE, pid, NULL), 0);
+    /* the first read sets the page idle, the access after that is seen by the next read */
+    CU_ASSERT_NOT_EQUAL(sample_page_access(&backend, (uint64_t)(uintptr_t)page), -1);
+    page[0] = 0;
+    CU_ASSERT_EQUAL(sample_page_access(&backend, (uint64_t)(uintptr_t)page), 1);
+    scan_backend_close(&backend);
+
+    free(page);
+    etmemd_scan_exit();
+}
+
 typedef enum {
     CUNIT_SCREEN = 0,
     CUNIT_XMLFILE,
@@ -363,7 +550,11 @@ int main(int argc, const char **argv)
         CU_ADD_TEST(suite, test_get_page_refs) == NULL ||
         CU_ADD_TEST(suite, test_scan_error) == NULL ||
         CU_ADD_TEST(suite, test_etmem_scan_ok) == NULL ||
-        CU_ADD_TEST(suite, test_add_pg_to_mem_grade) == NULL) {
+        CU_ADD_TEST(suite, test_add_pg_to_mem_grade) == NULL ||
+        CU_ADD_TEST(suite, test_walk_regions) == NULL ||
+        CU_ADD_TEST(suite, test_walk_regions_huge) == NULL ||
+        CU_ADD_TEST(suite, test_walk_regions_present) == NULL ||
+        CU_ADD_TEST(suite, test_page_idle_backend) == NULL) {
             goto ERROR;
     }
 
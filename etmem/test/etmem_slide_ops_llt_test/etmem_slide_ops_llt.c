@@ -31,6 +31,7 @@
 #include "etmemd_slide.h"
 #include "etmemd_cslide.h"
 #include "etmemd_rpc.h"
+#include "etmemd_rank.h"
 #include "securec.h"
 
 #include "test_common.h"
@@ -276,7 +277,7 @@ static void test_etmem_task_swap_flag_error(void)
     destroy_slide_task_config(config);
 
     /* run slide_do_migrate fail */
-    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL), -1);
+    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL, NULL), -1);
 
     task_test_fini();
 }
@@ -353,7 +354,7 @@ static void test_etmem_task_swap_threshold_error(void)
     destroy_slide_task_config(config);
 
     /* run slide_do_migrate fail */
-    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL), -1);
+    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL, NULL), -1);
 
     task_test_fini();
 }
@@ -566,7 +567,7 @@ static void test_task_slide_invalid_config(void)
     destroy_slide_task_config(config);
 
     /* run slide_do_migrate fail */
-    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL), -1);
+    CU_ASSERT_EQUAL(slide_do_migrate(1, NULL, NULL), -1);
 }
 
 void test_etmem_slide_task_002(void)
@@ -579,6 +580,95 @@ void test_etmem_slide_task_002(void)
     task_test_fini();
 }
 
+static void test_rank_cutoff(void)
+{
+    struct project proj = {0};
+    struct engine eng = {0};
+    struct task tk = {0};
+    struct task_pid pid1 = {0};
+    struct task_pid pid2 = {0};
+    struct slide_params params = {0};
+    struct rank_cutoff cutoff;
+    unsigned long hist[RANK_BIN_NUM] = {0};
+
+    proj.global_dram_percent = 50;
+    CU_ASSERT_EQUAL(etmemd_rank_init(&proj), 0);
+    eng.proj = &proj;
+    tk.eng = &eng;
+    pid1.tk = &tk;
+    pid2.tk = &tk;
+
+    CU_ASSERT_EQUAL(etmemd_rank_bin(0.0), 0);
+    CU_ASSERT_EQUAL(etmemd_rank_bin(0.5), 50);
+    CU_ASSERT_EQUAL(etmemd_rank_bin(1.0), RANK_BIN_NUM - 1);
+
+    /* nothing published, nothing to swap */
+    etmemd_rank_cutoff(&proj, &cutoff);
+    CU_ASSERT_EQUAL(cutoff.bin, 0);
+    CU_ASSERT_EQUAL(cutoff.fraction, 0);
+
+    hist[0] = 100;
+    hist[50] = 100;
+    CU_ASSERT_EQUAL(etmemd_rank_publish(&pid1, hist, 200, 0), 0);
+    hist[0] = 0;
+    hist[50] = 0;
+    hist[10] = 200;
+    CU_ASSERT_EQUAL(etmemd_rank_publish(&pid2, hist, 200, 0), 0);
+
+    /* 200KB over the target: all of bin 0 and half of bin 10 */
+    etmemd_rank_cutoff(&proj, &cutoff);
+    CU_ASSERT_EQUAL(cutoff.bin, 10);
+    CU_ASSERT_EQUAL(cutoff.fraction, 0.5);
+
+    /* republish replaces the old histogram of the pid, 100KB over the target */
+    CU_ASSERT_EQUAL(etmemd_rank_publish(&pid2, hist, 200, 200), 0);
+    etmemd_rank_cutoff(&proj, &cutoff);
+    CU_ASSERT_EQUAL(cutoff.bin, 0);
+    CU_ASSERT_EQUAL(cutoff.fraction, 1.0);
+
+    etmemd_rank_pid_release(&pid2);
+    CU_ASSERT_PTR_NULL(pid2.rank);
+    etmemd_rank_cutoff(&proj, &cutoff);
+    CU_ASSERT_EQUAL(cutoff.bin, 0);
+    CU_ASSERT_EQUAL(cutoff.fraction, 1.0);
+
+    /* dram_percent of the task still protects each pid */
+    CU_ASSERT_EQUAL(rank_pid_floor(200, 0, &params), 200);
+    params.dram_percent = 80;
+    CU_ASSERT_EQUAL(rank_pid_floor(200, 0, &params), 40);
+    CU_ASSERT_EQUAL(rank_pid_floor(100, 100, &params), 0);
+
+    etmemd_rank_pid_release(&pid1);
+    etmemd_rank_free(&proj);
+    CU_ASSERT_PTR_NULL(proj.rank);
+}
+
+static void test_evict_cost(void)
+{
+    struct slide_params params = {0};
+    struct page_refs clean = {0};
+    struct page_refs dirty = {0};
+
+    clean.possibility = 0.1;
+    dirty.possibility = 0.1;
+    dirty.dirty = 2;
+
+    /* the possibility alone without dirty_weight */
+    CU_ASSERT_DOUBLE_EQUAL(slide_evict_cost(&dirty, &params, 4), 0.1, 0.001);
+
+    /* dirty in half of the loops costs half of the weight more */
+    params.dirty_weight = 40;
+    CU_ASSERT_DOUBLE_EQUAL(slide_evict_cost(&clean, &params, 4), 0.1, 0.001);
+    CU_ASSERT_DOUBLE_EQUAL(slide_evict_cost(&dirty, &params, 4), 0.3, 0.001);
+    CU_ASSERT_TRUE(sort_by_possibility(slide_evict_cost(&clean, &params, 4)) <
+                   sort_by_possibility(slide_evict_cost(&dirty, &params, 4)));
+
+    dirty.possibility = 0.9;
+    dirty.dirty = 4;
+    CU_ASSERT_DOUBLE_EQUAL(slide_evict_cost(&dirty, &params, 4), 1.0, 0.001);
+    CU_ASSERT_DOUBLE_EQUAL(slide_evict_cost(&dirty, &params, 0), 0.9, 0.001);
+}
+
 typedef enum {
     CUNIT_SCREEN = 0,
     CUNIT_XMLFILE,
@@ -619,6 +709,8 @@ int main(int argc, const char **argv)
         CU_ADD_TEST(suite, test_etmem_task_swap_flag_ok) == NULL ||
         CU_ADD_TEST(suite, test_etmem_task_swap_threshold_error) == NULL ||
         CU_ADD_TEST(suite, test_etmem_task_swap_threshold_ok) == NULL ||
+        CU_ADD_TEST(suite, test_rank_cutoff) == NULL ||
+        CU_ADD_TEST(suite, test_evict_cost) == NULL ||
         CU_ADD_TEST(suite, test_slide) == NULL) {
             printf("CU_ADD_TEST fail. \n");
             goto ERROR;
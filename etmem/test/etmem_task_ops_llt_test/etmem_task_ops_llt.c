@@ -15,6 +15,7 @@
 
 #include <sys/file.h>
 #include <sys/prctl.h>
+#include <sys/wait.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -31,6 +32,8 @@
 #include "etmemd_slide.h"
 #include "etmemd_cslide.h"
 #include "etmemd_rpc.h"
+#include "etmemd_proc.h"
+#include "etmemd_cgroup.h"
 #include "securec.h"
 
 #define PID_STR_MAX_LEN         10
@@ -38,6 +41,8 @@
 #define PID_PROCESS_MEM         5000
 #define PID_PROCESS_SLEEP_TIME  60
 #define WATER_LINT_TEMP         3
+#define PID_EXIT_WAIT_TIME      10
+#define CGROUP_LINE_MAX_LEN     512
 
 static void get_task_pids_errinput(char *pid_val, char *pid_type, int exp)
 {
@@ -232,6 +237,153 @@ static void test_get_pid_ok(void)
     free(tk);
 }
 
+static void test_proc_snapshot(void)
+{
+    struct proc_snapshot *snap = NULL;
+    struct proc_snapshot *snap_again = NULL;
+    const struct proc_child *children = NULL;
+    char comm[PROC_COMM_LEN] = {0};
+    unsigned int pid = 0;
+    bool found = false;
+    size_t nr;
+    size_t i;
+
+    snap = etmemd_proc_snapshot_get();
+    CU_ASSERT_PTR_NOT_NULL(snap);
+
+    /* tasks in the same tick share the snapshot */
+    snap_again = etmemd_proc_snapshot_get();
+    CU_ASSERT_PTR_EQUAL(snap, snap_again);
+    etmemd_proc_snapshot_put(snap_again);
+
+    CU_ASSERT_EQUAL(prctl(PR_GET_NAME, comm, NULL, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(etmemd_proc_snapshot_find_name(snap, comm, &pid), 0);
+    CU_ASSERT_TRUE(pid <= (unsigned int)getpid());
+    CU_ASSERT_EQUAL(etmemd_proc_snapshot_find_name(snap, "no_such_proc", &pid), -1);
+
+    nr = etmemd_proc_snapshot_children(snap, (unsigned int)getppid(), &children);
+    for (i = 0; i < nr; i++) {
+        if (i > 0) {
+            CU_ASSERT_TRUE(children[i - 1].pid < children[i].pid);
+        }
+        if (children[i].pid == (unsigned int)getpid()) {
+            found = true;
+        }
+    }
+    CU_ASSERT_TRUE(found);
+
+    /* the invalidated snapshot is still valid for its holder */
+    etmemd_proc_snapshot_invalidate();
+    CU_ASSERT_EQUAL(etmemd_proc_snapshot_find_name(snap, comm, &pid), 0);
+    etmemd_proc_snapshot_put(snap);
+}
+
+static void test_task_pid_exited(void)
+{
+    char pid_val[PID_STR_MAX_LEN] = {0};
+    struct task *tk = NULL;
+    pid_t pid;
+
+    pid = fork();
+    CU_ASSERT_NOT_EQUAL(pid, -1);
+    if (pid == 0) {
+        sleep(1);
+        exit(0);
+    }
+
+    CU_ASSERT_NOT_EQUAL(snprintf_s(pid_val, PID_STR_MAX_LEN, PID_STR_MAX_LEN - 1, "%d", pid), -1);
+    tk = alloc_task("pid", pid_val);
+    CU_ASSERT_PTR_NOT_NULL(tk);
+
+    CU_ASSERT_EQUAL(etmemd_get_task_pids(tk, false), 0);
+    CU_ASSERT_PTR_NOT_NULL(tk->pids);
+    CU_ASSERT_FALSE(etmemd_task_pid_exited(tk->pids));
+
+    /* without pidfd the exit is only known by the proc event listener */
+    if (tk->pids->pidfd >= 0) {
+        CU_ASSERT_TRUE(etmemd_task_pid_sleep(tk->pids, PID_EXIT_WAIT_TIME));
+        CU_ASSERT_TRUE(etmemd_task_pid_exited(tk->pids));
+    }
+    waitpid(pid, NULL, 0);
+
+    etmemd_free_task_pids(tk);
+    etmemd_free_task_struct(&tk);
+    CU_ASSERT_PTR_NULL(tk);
+}
+
+static void test_cgroup_path_valid(void)
+{
+    CU_ASSERT_TRUE(etmemd_cgroup_path_valid("system.slice/mysql.service"));
+    CU_ASSERT_TRUE(etmemd_cgroup_path_valid("/sys/fs/cgroup/kubepods/pod-1"));
+    CU_ASSERT_FALSE(etmemd_cgroup_path_valid(""));
+    CU_ASSERT_FALSE(etmemd_cgroup_path_valid("a/../../etc"));
+    CU_ASSERT_FALSE(etmemd_cgroup_path_valid("a b"));
+    CU_ASSERT_FALSE(etmemd_cgroup_path_valid(NULL));
+}
+
+/* the cgroup v2 path of the current process, NULL if it is in the root or cgroup v2 is not used */
+static char *get_self_cgroup(void)
+{
+    char line[CGROUP_LINE_MAX_LEN] = {0};
+    char *path = NULL;
+    FILE *fp = NULL;
+
+    fp = fopen("/proc/self/cgroup", "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    while (fgets(line, CGROUP_LINE_MAX_LEN, fp) != NULL) {
+        if (strncmp(line, "0::/", strlen("0::/")) != 0) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        if (strlen(line) > strlen("0::/")) {
+            path = strdup(line + strlen("0::/"));
+        }
+        break;
+    }
+
+    fclose(fp);
+    return path;
+}
+
+static void test_get_task_withcgroup_ok(void)
+{
+    struct task_pid *tk_pid = NULL;
+    struct task *tk = NULL;
+    unsigned long rss;
+    unsigned long swap;
+    bool found = false;
+    char *path = NULL;
+
+    path = get_self_cgroup();
+    if (path == NULL || access(CGROUP2_ROOT "/cgroup.controllers", F_OK) != 0) {
+        free(path);
+        return;
+    }
+
+    tk = alloc_task("cgroup", path);
+    CU_ASSERT_PTR_NOT_NULL(tk);
+    free(path);
+    CU_ASSERT_EQUAL(etmemd_cgroup_task_init(tk), 0);
+
+    CU_ASSERT_EQUAL(etmemd_get_task_pids(tk, true), 0);
+    for (tk_pid = tk->pids; tk_pid != NULL; tk_pid = tk_pid->next) {
+        CU_ASSERT_FALSE(tk_pid->root);
+        if (tk_pid->pid == (unsigned int)getpid()) {
+            found = true;
+        }
+    }
+    CU_ASSERT_TRUE(found);
+    CU_ASSERT_EQUAL(etmemd_task_pid_mem_usage(tk->pids, &rss, &swap), 0);
+    CU_ASSERT_NOT_EQUAL(rss, 0);
+
+    etmemd_free_task_pids(tk);
+    etmemd_free_task_struct(&tk);
+    CU_ASSERT_PTR_NULL(tk);
+}
+
 static void test_free_task_pids(void)
 {
     struct task *tk = NULL;
@@ -245,6 +397,7 @@ static void test_free_task_pids(void)
     tk_pid = (struct task_pid *)calloc(1, sizeof(struct task_pid));
     CU_ASSERT_PTR_NOT_NULL(tk_pid);
     tk_pid->pid = 1;
+    tk_pid->pidfd = -1;
 
     s_param = (struct slide_params *)calloc(1, sizeof(struct slide_params));
     CU_ASSERT_PTR_NOT_NULL(s_param);
@@ -300,6 +453,10 @@ int main(int argc, const char **argv)
         CU_ADD_TEST(suite, test_get_task_withname_ok) == NULL ||
         CU_ADD_TEST(suite, test_get_pid_error) == NULL ||
         CU_ADD_TEST(suite, test_get_pid_ok) == NULL ||
+        CU_ADD_TEST(suite, test_proc_snapshot) == NULL ||
+        CU_ADD_TEST(suite, test_task_pid_exited) == NULL ||
+        CU_ADD_TEST(suite, test_cgroup_path_valid) == NULL ||
+        CU_ADD_TEST(suite, test_get_task_withcgroup_ok) == NULL ||
         CU_ADD_TEST(suite, test_free_task_pids) == NULL) {
             printf("CU_ADD_TEST fail. \n");
             goto ERROR;
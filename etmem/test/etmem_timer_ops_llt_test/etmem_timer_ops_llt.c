@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <CUnit/Basic.h>
@@ -27,6 +28,7 @@
 #include "etmemd_threadtimer.h"
 
 static int g_timer_exec_time = 0;
+static int g_timer_refresh_time = 0;
 
 typedef void *(*timer_exector)(void *);
 
@@ -120,6 +122,90 @@ static void test_timer_stop(void)
     thread_timer_destroy(&timer);
 }
 
+static void *threadtimer_refresher(void *str)
+{
+    g_timer_refresh_time++;
+    return NULL;
+}
+
+static void test_timer_refresh(void)
+{
+    char *timer_args = "for timer refresh test.\n";
+    timer_exector exector = threadtimer_exector;
+    timer_thread *timer = NULL;
+    int exec_time;
+
+    thread_timer_refresh(timer);
+
+    timer = thread_timer_create(60);
+    CU_ASSERT_PTR_NOT_NULL(timer);
+
+    /* a refresh without refresher does nothing */
+    CU_ASSERT_EQUAL(thread_timer_start(timer, exector, timer_args), 0);
+    exec_time = g_timer_exec_time;
+    thread_timer_refresh(timer);
+    sleep(1);
+    CU_ASSERT_EQUAL(g_timer_exec_time, exec_time);
+    thread_timer_stop(timer);
+    thread_timer_destroy(&timer);
+
+    timer = thread_timer_create(60);
+    CU_ASSERT_PTR_NOT_NULL(timer);
+
+    /* only the refresher runs, the executor waits for its interval */
+    thread_timer_set_refresher(timer, threadtimer_refresher);
+    CU_ASSERT_EQUAL(thread_timer_start(timer, exector, timer_args), 0);
+    thread_timer_refresh(timer);
+    sleep(1);
+    CU_ASSERT_EQUAL(g_timer_refresh_time, 1);
+    CU_ASSERT_EQUAL(g_timer_exec_time, exec_time);
+
+    thread_timer_stop(timer);
+    thread_timer_destroy(&timer);
+}
+
+static void *threadtimer_slow_exector(void *str)
+{
+    g_timer_exec_time++;
+    sleep(1);
+    return NULL;
+}
+
+static void test_timer_refresh_running(void)
+{
+    char *timer_args = "for timer refresh running test.\n";
+    timer_thread *timer = NULL;
+    struct timespec start;
+    struct timespec end;
+    int refresh_time;
+
+    timer = thread_timer_create(60);
+    CU_ASSERT_PTR_NOT_NULL(timer);
+    if (timer == NULL) {
+        return;
+    }
+
+    thread_timer_set_refresher(timer, threadtimer_refresher);
+    CU_ASSERT_EQUAL(thread_timer_start(timer, threadtimer_slow_exector, timer_args), 0);
+    refresh_time = g_timer_refresh_time;
+    thread_timer_kick(timer);
+    usleep(200000);
+
+    /* a refresh does not wait for the running executor, and runs once it finishes */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    thread_timer_refresh(timer);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    CU_ASSERT_TRUE(end.tv_sec - start.tv_sec < 1);
+    sleep(2);
+    CU_ASSERT_EQUAL(g_timer_refresh_time, refresh_time + 1);
+
+    /* the timer is stopped while the executor is running */
+    thread_timer_kick(timer);
+    usleep(200000);
+    thread_timer_stop(timer);
+    thread_timer_destroy(&timer);
+}
+
 typedef enum {
     CUNIT_SCREEN = 0,
     CUNIT_XMLFILE,
@@ -150,7 +236,9 @@ int main(int argc, const char **argv)
     if (CU_ADD_TEST(suite, test_timer_create_delete) == NULL ||
         CU_ADD_TEST(suite, test_timer_start_error) == NULL ||
         CU_ADD_TEST(suite, test_timer_start_ok) == NULL ||
-        CU_ADD_TEST(suite, test_timer_stop) == NULL) {
+        CU_ADD_TEST(suite, test_timer_stop) == NULL ||
+        CU_ADD_TEST(suite, test_timer_refresh) == NULL ||
+        CU_ADD_TEST(suite, test_timer_refresh_running) == NULL) {
             goto ERROR;
     }
 
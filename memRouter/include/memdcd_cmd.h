@@ -15,7 +15,31 @@
 #ifndef MEMDCD_CMD_H
 #define MEMDCD_CMD_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "memdcd_ring.h"
+
+/* frames received on one connection, the tail of buf may be a frame not complete yet */
+struct memdcd_stream {
+    char *buf;
+    size_t size;
+    size_t len;
+
+    uint16_t version;   /* protocol version of the client */
+    uint32_t seq;       /* seq of the last frame handled */
+    uint32_t acked;     /* seq of the last frame acknowledged */
+    uint32_t failed;    /* frames failed since the last ack */
+
+    int fds[MEMDCD_RING_FDS];   /* fds received for the ring setup */
+    int nr_fds;
+    struct memdcd_ring_conn ring;
+};
+
 int handle_recv_buffer(const void *buf, int msg_len);
+int handle_recv_compact(const void *buffer, size_t msg_len);
+int handle_recv_stream(struct memdcd_stream *stream);
+int handle_recv_ring(struct memdcd_stream *stream);
+void release_recv_stream(struct memdcd_stream *stream);
 
 #endif // MEMDCD_H
 
@@ -71,5 +71,85 @@ struct memdcd_message {
     };
 };
 
+#define MEMDCD_FRAME_MAGIC 0x4d444344U /* "MDCD" */
+/* version 1 sends struct memdcd_message as it is, version 2 sends the compact message */
+#define MEMDCD_PROTO_VERSION_FIXED 1
+#define MEMDCD_PROTO_VERSION 2
+/* frames a client may send on a connection before it waits for the ack of them */
+#define MEMDCD_FRAME_WINDOW 16
+
+enum memdcd_frame_type {
+    MEMDCD_FRAME_MSG,
+    MEMDCD_FRAME_ACK,
+    MEMDCD_FRAME_RING_SETUP,
+};
+
+/*
+ * a connection to memdcd is kept by the client, every message on it is prefixed by a frame header.
+ * seq starts from 1 on each connection, length is the count of bytes following the header.
+ */
+struct memdcd_frame_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t seq;
+    uint32_t length;
+};
+
+/*
+ * payload of a MEMDCD_CMD_MEM message since version 2, followed by the runs of its pages.
+ * a run is the pages of the same size and count which are contiguous, encoded as four varints:
+ * zigzag of the distance from the end of the previous run (from 0 for the first run), the size
+ * of each page, the count, and the number of pages. distances and sizes are in MEMDCD_PAGE_UNIT.
+ */
+#define MEMDCD_PAGE_UNIT_SHIFT 12
+#define MEMDCD_PAGE_UNIT (1ULL << MEMDCD_PAGE_UNIT_SHIFT)
+#define MEMDCD_VARINT_MAX_LEN 10
+#define MEMDCD_RUN_MAX_LEN (MEMDCD_VARINT_MAX_LEN * 4)
+
+struct memdcd_compact_message {
+    uint32_t cmd_type;
+    int32_t pid;
+    uint32_t enable_uswap;
+    uint32_t status;
+    uint64_t total_length;
+    uint32_t count;     /* pages in the runs, no more than MAX_VMA_NUM */
+    uint32_t runs;
+};
+
+/* payload of MEMDCD_FRAME_ACK, all frames up to seq of its header are handled, failed of them in error */
+struct memdcd_frame_ack {
+    uint32_t failed;
+};
+
+/*
+ * payload of MEMDCD_FRAME_RING_SETUP, sent with the fds of a memfd and an eventfd by SCM_RIGHTS.
+ * the memfd is struct memdcd_ring followed by size bytes of records. after the setup is acked, the
+ * client puts the compact messages into the records instead of the socket and writes the eventfd,
+ * memdcd handles the messages in place, moves tail and acks them on the socket as before.
+ */
+struct memdcd_ring_setup {
+    uint32_t size;
+};
+
+#define MEMDCD_RING_FDS 2
+#define MEMDCD_RING_MIN_SIZE (1U << 16)
+#define MEMDCD_RING_MAX_SIZE (1U << 26)
+#define MEMDCD_RING_ALIGN 8
+#define MEMDCD_RING_PAD UINT32_MAX /* length of a record which skips to the start of the ring */
+
+/* head and tail count the bytes ever put and taken, the offset of a record is head & (size - 1) */
+struct memdcd_ring {
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    unsigned char data[] __attribute__((aligned(64)));
+};
+
+/* records are aligned to MEMDCD_RING_ALIGN and never wrap, a pad record fills the end of the ring */
+struct memdcd_ring_record {
+    uint32_t seq;
+    uint32_t length;
+};
+
 #endif
 
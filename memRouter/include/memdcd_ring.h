@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem/memRouter licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: consumer of the shared memory ring set up by a client.
+ ******************************************************************************/
+#ifndef MEMDCD_RING_H
+#define MEMDCD_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "memdcd_message.h"
+
+struct memdcd_ring_conn {
+    struct memdcd_ring *ring;   /* NULL if no ring is set up */
+    size_t map_len;
+    uint32_t size;
+    uint64_t head;              /* head seen last time */
+    uint64_t tail;              /* tail not published yet */
+    int event_fd;
+};
+
+/* map the ring in mem_fd, which is closed after, event_fd is owned by conn on success */
+int memdcd_ring_attach(struct memdcd_ring_conn *conn, int mem_fd, int event_fd, uint32_t size);
+void memdcd_ring_detach(struct memdcd_ring_conn *conn);
+void memdcd_ring_clear_event(struct memdcd_ring_conn *conn);
+/* get the next message of the ring in place, return 1 if got, 0 if the ring is empty, -1 if it is broken */
+int memdcd_ring_next(struct memdcd_ring_conn *conn, struct memdcd_ring_record *record, const void **msg);
+/* give the space of the messages got back to the client */
+void memdcd_ring_commit(struct memdcd_ring_conn *conn);
+
+#endif
@@ -20,8 +20,10 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <limits.h>
 
 #include "memdcd_process.h"
+#include "memdcd_message.h"
 #include "memdcd_log.h"
 #include "memdcd_cmd.h"
 
@@ -90,4 +92,222 @@ int handle_recv_buffer(const void *buffer, int msg_len)
             return -1;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+static int read_varint(const unsigned char **pos, const unsigned char *end, uint64_t *val)
+{
+    uint64_t v = 0;
+    unsigned int shift = 0;
+    unsigned char byte;
+
+    while (*pos < end && shift < 64) {
+        byte = *(*pos)++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *val = v;
+            return 0;
+        }
+        shift += 7;
+    }
+    return -1;
+}
+
+/* expand the runs of a compact message into the pages of msg */
+static int decode_compact_message(const void *buffer, size_t msg_len, struct memory_message *msg)
+{
+    struct memdcd_compact_message header;
+    const unsigned char *pos = (const unsigned char *)buffer + sizeof(header);
+    const unsigned char *end = (const unsigned char *)buffer + msg_len;
+    uint64_t addr = 0;
+    uint64_t gap, size, count, nr;
+    uint32_t i, filled = 0;
+
+    if (msg_len < sizeof(header)) {
+        memdcd_log(_LOG_ERROR, "Invalid compact message length %lu.", msg_len);
+        return -1;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (header.count > MAX_VMA_NUM || header.status > MEMDCD_SEND_END) {
+        memdcd_log(_LOG_ERROR, "Invalid compact message of %u pages, status %u.", header.count, header.status);
+        return -1;
+    }
+
+    msg->pid = header.pid;
+    msg->enable_uswap = header.enable_uswap;
+    msg->vma.type = SWAP_TYPE_VMA_ADDR;
+    msg->vma.status = (enum MEMDCD_MESSAGE_STATUS)header.status;
+    msg->vma.total_length = header.total_length;
+
+    for (i = 0; i < header.runs; i++) {
+        if (read_varint(&pos, end, &gap) != 0 || read_varint(&pos, end, &size) != 0 ||
+            read_varint(&pos, end, &count) != 0 || read_varint(&pos, end, &nr) != 0) {
+            memdcd_log(_LOG_ERROR, "Run %u of compact message is truncated.", i);
+            return -1;
+        }
+        if (nr == 0 || nr > header.count - filled || count > INT_MAX) {
+            memdcd_log(_LOG_ERROR, "Invalid run %u of compact message: %lu pages, count %lu.", i, nr, count);
+            return -1;
+        }
+
+        /* zigzag decoding, the distance is negative if the pages are not sorted */
+        addr += (gap >> 1) ^ (~(gap & 1) + 1);
+        for (; nr > 0; nr--, filled++) {
+            msg->vma.vma_addrs[filled].vma.start_addr = addr << MEMDCD_PAGE_UNIT_SHIFT;
+            msg->vma.vma_addrs[filled].vma.vma_len = size << MEMDCD_PAGE_UNIT_SHIFT;
+            msg->vma.vma_addrs[filled].count = (int)count;
+            addr += size;
+        }
+    }
+
+    if (filled != header.count || pos != end) {
+        memdcd_log(_LOG_ERROR, "Compact message has %u pages in %lu bytes, expect %u pages in %lu bytes.",
+            filled, msg_len - (size_t)(end - pos), header.count, msg_len);
+        return -1;
+    }
+    msg->vma.length = filled * sizeof(struct vma_addr_with_count);
+    return 0;
+}
+
+int handle_recv_compact(const void *buffer, size_t msg_len)
+{
+    struct memory_message msg;
+    uint32_t cmd_type;
+
+    if (msg_len < sizeof(uint32_t)) {
+        memdcd_log(_LOG_ERROR, "Invalid recv message length %lu.", msg_len);
+        return -1;
+    }
+    memcpy(&cmd_type, buffer, sizeof(uint32_t));
+    memdcd_log(_LOG_DEBUG, "Type: %u.", cmd_type);
+
+    switch (cmd_type) {
+        case MEMDCD_CMD_MEM:
+            if (decode_compact_message(buffer, msg_len, &msg) != 0)
+                return -1;
+            return handle_mem_message(&msg);
+        default:
+            memdcd_log(_LOG_ERROR, "Invalid cmd type.");
+            return -1;
+    }
+    return 0;
+}
+
+static int check_frame_header(const struct memdcd_frame_header *header, size_t max_length)
+{
+    if (header->magic != MEMDCD_FRAME_MAGIC) {
+        memdcd_log(_LOG_ERROR, "Invalid frame magic %#x.", header->magic);
+        return -1;
+    }
+    if (header->version != MEMDCD_PROTO_VERSION && header->version != MEMDCD_PROTO_VERSION_FIXED) {
+        memdcd_log(_LOG_ERROR, "Unsupported protocol version %u, expect %u.", header->version, MEMDCD_PROTO_VERSION);
+        return -1;
+    }
+    if (header->type != MEMDCD_FRAME_MSG && header->type != MEMDCD_FRAME_RING_SETUP) {
+        memdcd_log(_LOG_ERROR, "Invalid frame type %u.", header->type);
+        return -1;
+    }
+    if (header->length > max_length) {
+        memdcd_log(_LOG_ERROR, "Frame length %u exceeds the limit %lu.", header->length, max_length);
+        return -1;
+    }
+    return 0;
+}
+
+static void close_stream_fds(struct memdcd_stream *stream)
+{
+    int i;
+
+    for (i = 0; i < stream->nr_fds; i++)
+        close(stream->fds[i]);
+    stream->nr_fds = 0;
+}
+
+static int handle_ring_setup(struct memdcd_stream *stream, const void *buffer, size_t msg_len)
+{
+    struct memdcd_ring_setup setup;
+    int ret = -1;
+
+    if (msg_len != sizeof(setup) || stream->nr_fds != MEMDCD_RING_FDS || stream->ring.ring != NULL) {
+        memdcd_log(_LOG_ERROR, "Invalid ring setup with %d fds.", stream->nr_fds);
+        goto close_fds;
+    }
+    memcpy(&setup, buffer, sizeof(setup));
+
+    ret = memdcd_ring_attach(&stream->ring, stream->fds[0], stream->fds[1], setup.size);
+    if (ret == 0) {
+        stream->nr_fds = 0;
+        return 0;
+    }
+
+close_fds:
+    close_stream_fds(stream);
+    return ret;
+}
+
+/*
+ * handle the complete frames in the buffer of stream, and move the partial frame left to the head of it,
+ * so the next recv appends to the frame. return -1 if the stream is broken and the connection should be closed.
+ */
+int handle_recv_stream(struct memdcd_stream *stream)
+{
+    struct memdcd_frame_header header;
+    size_t max_length = stream->size - sizeof(struct memdcd_frame_header);
+    size_t offset = 0;
+    int ret;
+
+    while (stream->len - offset >= sizeof(struct memdcd_frame_header)) {
+        memcpy(&header, stream->buf + offset, sizeof(struct memdcd_frame_header));
+        if (check_frame_header(&header, max_length) != 0)
+            return -1;
+        if (stream->len - offset - sizeof(struct memdcd_frame_header) < header.length)
+            break;
+
+        offset += sizeof(struct memdcd_frame_header);
+        /* the ack is in the version of the client, which may be an old one */
+        stream->version = header.version;
+        if (header.type == MEMDCD_FRAME_RING_SETUP)
+            ret = handle_ring_setup(stream, stream->buf + offset, header.length);
+        else if (header.version == MEMDCD_PROTO_VERSION_FIXED)
+            ret = handle_recv_buffer(stream->buf + offset, header.length);
+        else
+            ret = handle_recv_compact(stream->buf + offset, header.length);
+        if (ret < 0) {
+            memdcd_log(_LOG_DEBUG, "Error handling message of frame %u.", header.seq);
+            stream->failed++;
+        }
+        stream->seq = header.seq;
+        offset += header.length;
+    }
+
+    if (offset != 0) {
+        memmove(stream->buf, stream->buf + offset, stream->len - offset);
+        stream->len -= offset;
+    }
+    return 0;
+}
+
+/* handle the messages put into the ring since the last call, they are acknowledged as the frames */
+int handle_recv_ring(struct memdcd_stream *stream)
+{
+    struct memdcd_ring_record record;
+    const void *msg = NULL;
+    int ret;
+
+    memdcd_ring_clear_event(&stream->ring);
+    while ((ret = memdcd_ring_next(&stream->ring, &record, &msg)) > 0) {
+        if (handle_recv_compact(msg, record.length) < 0) {
+            memdcd_log(_LOG_DEBUG, "Error handling message of record %u.", record.seq);
+            stream->failed++;
+        }
+        stream->seq = record.seq;
+    }
+    /* the space must be given back before the ack, the client waits for the ack when the ring is full */
+    memdcd_ring_commit(&stream->ring);
+    return ret;
+}
+
+void release_recv_stream(struct memdcd_stream *stream)
+{
+    close_stream_fds(stream);
+    memdcd_ring_detach(&stream->ring);
+}
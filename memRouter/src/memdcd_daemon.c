@@ -20,15 +20,95 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "memdcd_log.h"
 #include "memdcd_process.h"
 #include "memdcd_cmd.h"
+#include "memdcd_message.h"
 #include "memdcd_daemon.h"
 
 #define MAX_PENDING_QUEUE_LENGTH 64
 #define MAX_SOCK_PATH_LENGTH 108
 
+#define MEMDCD_WORKER_NUM 4
+#define MEMDCD_MAX_EVENTS 64
+#define MEMDCD_EPOLL_TIMEOUT_MS 1000   /* wake up to check the exit flag */
+#define MEMDCD_RECV_BUDGET 16          /* recvs of a connection in one job, so others are not starved */
+
+enum memdcd_watch_type {
+    MEMDCD_WATCH_LISTEN,
+    MEMDCD_WATCH_CLOSE,
+    MEMDCD_WATCH_SOCK,
+    MEMDCD_WATCH_RING,
+};
+
+/* what an fd in epoll stands for */
+struct memdcd_watch {
+    enum memdcd_watch_type type;
+    struct memdcd_conn *conn;
+};
+
+struct memdcd_ack_frame {
+    struct memdcd_frame_header header;
+    struct memdcd_frame_ack ack;
+};
+
+/*
+ * fds of a connection are in epoll with EPOLLONESHOT, an event is dispatched to a worker as a job and
+ * the fd is armed again when the job is done. lock keeps a connection served by one worker at a time,
+ * so its messages are handled in order.
+ */
+struct memdcd_conn {
+    int fd;
+    int refs;               /* one of the event loop, one of each job queued */
+    pthread_mutex_t lock;
+    bool closing;
+    bool ring_added;        /* eventfd of the ring is in epoll */
+    struct memdcd_watch sock_watch;
+    struct memdcd_watch ring_watch;
+    struct memdcd_stream stream;
+
+    struct memdcd_ack_frame ack;    /* ack not sent completely */
+    size_t ack_off;
+    size_t ack_len;
+
+    struct memdcd_conn *prev;       /* connections of the event loop */
+    struct memdcd_conn *next;
+    struct memdcd_conn *close_next;
+};
+
+struct memdcd_job {
+    struct memdcd_watch *watch;
+    struct memdcd_job *next;
+};
+
+struct memdcd_loop {
+    int epfd;
+    int close_efd;              /* workers ask the event loop to close connections by it */
+    struct memdcd_watch listen_watch;
+    struct memdcd_watch close_watch;
+    struct memdcd_conn conns;
+    pthread_mutex_t close_lock;
+    struct memdcd_conn *close_list;
+
+    pthread_mutex_t job_lock;
+    pthread_cond_t job_cond;
+    struct memdcd_job *job_head;
+    struct memdcd_job *job_tail;
+    bool stop;
+    pthread_t workers[MEMDCD_WORKER_NUM];
+    int nr_workers;
+};
+
+static struct memdcd_loop g_loop;
+
 static volatile sig_atomic_t g_sock_fd;
 static volatile sig_atomic_t g_exit_signal;
 
@@ -153,51 +233,475 @@ static int check_socket_permission(int sock_fd)
     return 0;
 }
 
-static int memdcd_accept(char *recv_buf)
+static void memdcd_conn_put(struct memdcd_conn *conn)
 {
-    int accp_fd = -1;
-    int ret = 0;
-    ssize_t rc;
+    if (__atomic_sub_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    release_recv_stream(&conn->stream);
+    free(conn->stream.buf);
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->lock);
+    free(conn);
+}
+
+static struct memdcd_conn *memdcd_conn_alloc(int fd)
+{
+    struct memdcd_conn *conn = (struct memdcd_conn *)calloc(1, sizeof(struct memdcd_conn));
+    if (conn == NULL)
+        return NULL;
+
+    conn->stream.buf = (char *)malloc(sizeof(char) * MAX_MESSAGE_LENGTH);
+    if (conn->stream.buf == NULL) {
+        free(conn);
+        return NULL;
+    }
+    if (pthread_mutex_init(&conn->lock, NULL) != 0) {
+        free(conn->stream.buf);
+        free(conn);
+        return NULL;
+    }
+    conn->stream.size = MAX_MESSAGE_LENGTH;
+    conn->stream.ring.event_fd = -1;
+    conn->fd = fd;
+    conn->refs = 1;
+    conn->sock_watch.type = MEMDCD_WATCH_SOCK;
+    conn->sock_watch.conn = conn;
+    conn->ring_watch.type = MEMDCD_WATCH_RING;
+    conn->ring_watch.conn = conn;
+    return conn;
+}
+
+static int memdcd_epoll_ctl(int op, int fd, uint32_t events, struct memdcd_watch *watch)
+{
+    struct epoll_event ev = {
+        .events = events,
+        .data.ptr = watch,
+    };
     char error_str[ERROR_STR_MAX_LEN] = {0};
 
-    accp_fd = accept(g_sock_fd, NULL, NULL);
-    if (accp_fd < 0) {
-        memdcd_log(_LOG_ERROR, "Accept message failed. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+    if (epoll_ctl(g_loop.epfd, op, fd, &ev) != 0) {
+        memdcd_log(_LOG_ERROR, "Epoll ctl %d of fd %d failed. err: %s", op, fd,
+            strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
         return -1;
     }
+    return 0;
+}
 
-    rc = check_socket_permission(accp_fd);
-    if (rc != 0) {
-        ret = rc;
-        goto close_fd;
+static int memdcd_arm_sock(struct memdcd_conn *conn)
+{
+    uint32_t events = EPOLLIN | EPOLLONESHOT;
+
+    if (conn->ack_off < conn->ack_len)
+        events |= EPOLLOUT;
+    return memdcd_epoll_ctl(EPOLL_CTL_MOD, conn->fd, events, &conn->sock_watch);
+}
+
+/* called with the lock of conn, the event loop removes it from epoll and puts it */
+static void memdcd_request_close(struct memdcd_conn *conn)
+{
+    uint64_t val = 1;
+
+    conn->closing = true;
+    pthread_mutex_lock(&g_loop.close_lock);
+    conn->close_next = g_loop.close_list;
+    g_loop.close_list = conn;
+    pthread_mutex_unlock(&g_loop.close_lock);
+
+    if (write(g_loop.close_efd, &val, sizeof(val)) != sizeof(val))
+        memdcd_log(_LOG_ERROR, "Notify event loop to close connection failed.");
+}
+
+/*
+ * send the ack of the frames handled without blocking. an ack not sent completely is kept and
+ * sent when the socket is writable, acks are cumulative so a newer one is sent after it.
+ */
+static int memdcd_flush_ack(struct memdcd_conn *conn)
+{
+    struct memdcd_stream *stream = &conn->stream;
+    ssize_t rc;
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    for (;;) {
+        if (conn->ack_off == conn->ack_len) {
+            if (stream->seq == stream->acked)
+                return 0;
+
+            conn->ack.header.magic = MEMDCD_FRAME_MAGIC;
+            conn->ack.header.version = stream->version;
+            conn->ack.header.type = MEMDCD_FRAME_ACK;
+            conn->ack.header.seq = stream->seq;
+            conn->ack.header.length = sizeof(struct memdcd_frame_ack);
+            conn->ack.ack.failed = stream->failed;
+            conn->ack_off = 0;
+            conn->ack_len = sizeof(struct memdcd_ack_frame);
+            stream->acked = stream->seq;
+            stream->failed = 0;
+        }
+
+        rc = send(conn->fd, (char *)&conn->ack + conn->ack_off, conn->ack_len - conn->ack_off,
+            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            memdcd_log(_LOG_WARN, "Socket send ack to client fail. err: %s",
+                strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+            return -1;
+        }
+        conn->ack_off += rc;
     }
+}
 
-    rc = recv(accp_fd, recv_buf, MAX_MESSAGE_LENGTH, 0);
-    if (rc <= 0) {
-        memdcd_log(_LOG_WARN, "Socket recive from client fail. err: %s", \
-            strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
-        ret = -1;
-        goto close_fd;
+/* recv the bytes of frames, and the fds passed with them */
+static ssize_t memdcd_recv_stream(int conn_fd, struct memdcd_stream *stream)
+{
+    char control[CMSG_SPACE(sizeof(int) * MEMDCD_RING_FDS)];
+    struct iovec iov = {
+        .iov_base = stream->buf + stream->len,
+        .iov_len = stream->size - stream->len,
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr *cmsg = NULL;
+    ssize_t rc;
+    int nr, i, fd;
+
+    rc = recvmsg(conn_fd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if (rc <= 0)
+        return rc;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        nr = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (i = 0; i < nr; i++) {
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (stream->nr_fds < MEMDCD_RING_FDS)
+                stream->fds[stream->nr_fds++] = fd;
+            else
+                close(fd);
+        }
+    }
+    if ((msg.msg_flags & MSG_CTRUNC) != 0)
+        memdcd_log(_LOG_WARN, "Fds passed by client are truncated.");
+
+    stream->len += rc;
+    return rc;
+}
+
+/* return 0 if the connection goes on, -1 if it should be closed */
+static int memdcd_serve_sock(struct memdcd_conn *conn)
+{
+    ssize_t rc;
+    int budget;
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    for (budget = 0; budget < MEMDCD_RECV_BUDGET; budget++) {
+        rc = memdcd_recv_stream(conn->fd, &conn->stream);
+        if (rc == 0) {
+            memdcd_log(_LOG_DEBUG, "Connection closed by client.");
+            return -1;
+        }
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            memdcd_log(_LOG_WARN, "Socket recive from client fail. err: %s",
+                strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+            return -1;
+        }
+        if (handle_recv_stream(&conn->stream) != 0) {
+            memdcd_log(_LOG_ERROR, "Invalid frame from client, close the connection.");
+            return -1;
+        }
+    }
+
+    /* the rest is left for the next job, epoll reports the socket again once it is armed */
+    return 0;
+}
+
+static void memdcd_run_job(struct memdcd_watch *watch)
+{
+    struct memdcd_conn *conn = watch->conn;
+    int ret;
+
+    pthread_mutex_lock(&conn->lock);
+    if (conn->closing)
+        goto unlock;
+
+    if (watch->type == MEMDCD_WATCH_RING) {
+        ret = handle_recv_ring(&conn->stream);
+        if (ret != 0)
+            memdcd_log(_LOG_ERROR, "Invalid ring from client, close the connection.");
+    } else {
+        ret = memdcd_serve_sock(conn);
+    }
+    if (ret == 0 && conn->stream.ring.ring != NULL && !conn->ring_added) {
+        ret = memdcd_epoll_ctl(EPOLL_CTL_ADD, conn->stream.ring.event_fd, EPOLLIN | EPOLLONESHOT,
+            &conn->ring_watch);
+        conn->ring_added = (ret == 0);
+    }
+    if (ret == 0)
+        ret = memdcd_flush_ack(conn);
+
+    if (ret == 0 && watch->type == MEMDCD_WATCH_RING)
+        ret = memdcd_epoll_ctl(EPOLL_CTL_MOD, conn->stream.ring.event_fd, EPOLLIN | EPOLLONESHOT,
+            &conn->ring_watch);
+    if (ret == 0 && (watch->type == MEMDCD_WATCH_SOCK || conn->ack_off < conn->ack_len))
+        ret = memdcd_arm_sock(conn);
+    if (ret != 0)
+        memdcd_request_close(conn);
+
+unlock:
+    pthread_mutex_unlock(&conn->lock);
+    memdcd_conn_put(conn);
+}
+
+static void *memdcd_worker(void *arg)
+{
+    struct memdcd_job *job = NULL;
+    sigset_t set;
+
+    (void)arg;
+    /* signals are left to the event loop */
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    for (;;) {
+        pthread_mutex_lock(&g_loop.job_lock);
+        while (g_loop.job_head == NULL && !g_loop.stop)
+            pthread_cond_wait(&g_loop.job_cond, &g_loop.job_lock);
+        if (g_loop.job_head == NULL) {
+            pthread_mutex_unlock(&g_loop.job_lock);
+            break;
+        }
+        job = g_loop.job_head;
+        g_loop.job_head = job->next;
+        if (g_loop.job_head == NULL)
+            g_loop.job_tail = NULL;
+        pthread_mutex_unlock(&g_loop.job_lock);
+
+        memdcd_run_job(job->watch);
+        free(job);
+    }
+    return NULL;
+}
+
+static void memdcd_dispatch(struct memdcd_watch *watch)
+{
+    struct memdcd_conn *conn = watch->conn;
+    struct memdcd_job *job = (struct memdcd_job *)malloc(sizeof(struct memdcd_job));
+
+    if (job == NULL) {
+        memdcd_log(_LOG_ERROR, "Failed to alloc job, close the connection.");
+        pthread_mutex_lock(&conn->lock);
+        memdcd_request_close(conn);
+        pthread_mutex_unlock(&conn->lock);
+        return;
     }
 
-    if (rc > MAX_MESSAGE_LENGTH) {
-        memdcd_log(_LOG_WARN, "Buffer sent to memdcd is too long, should be less than %d.", MAX_MESSAGE_LENGTH);
-        ret = -1;
-        goto close_fd;
+    /* the event loop holds its reference until the connection is removed from epoll */
+    __atomic_add_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL);
+    job->watch = watch;
+    job->next = NULL;
+    pthread_mutex_lock(&g_loop.job_lock);
+    if (g_loop.job_tail == NULL)
+        g_loop.job_head = job;
+    else
+        g_loop.job_tail->next = job;
+    g_loop.job_tail = job;
+    pthread_cond_signal(&g_loop.job_cond);
+    pthread_mutex_unlock(&g_loop.job_lock);
+}
+
+static void memdcd_remove_conn(struct memdcd_conn *conn)
+{
+    pthread_mutex_lock(&conn->lock);
+    (void)epoll_ctl(g_loop.epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    if (conn->ring_added)
+        (void)epoll_ctl(g_loop.epfd, EPOLL_CTL_DEL, conn->stream.ring.event_fd, NULL);
+    conn->ring_added = false;
+    pthread_mutex_unlock(&conn->lock);
+
+    conn->prev->next = conn->next;
+    conn->next->prev = conn->prev;
+    memdcd_conn_put(conn);
+}
+
+static void memdcd_close_requested(void)
+{
+    struct memdcd_conn *conn = NULL;
+    struct memdcd_conn *next = NULL;
+    uint64_t val;
+
+    if (read(g_loop.close_efd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+        memdcd_log(_LOG_DEBUG, "Read close eventfd failed.");
+
+    pthread_mutex_lock(&g_loop.close_lock);
+    conn = g_loop.close_list;
+    g_loop.close_list = NULL;
+    pthread_mutex_unlock(&g_loop.close_lock);
+
+    for (; conn != NULL; conn = next) {
+        next = conn->close_next;
+        memdcd_remove_conn(conn);
     }
+}
+
+static void memdcd_accept(void)
+{
+    struct memdcd_conn *conn = NULL;
+    int accp_fd;
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    for (;;) {
+        accp_fd = accept4(g_sock_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (accp_fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                memdcd_log(_LOG_ERROR, "Accept message failed. err: %s",
+                    strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+            return;
+        }
 
-    memdcd_log(_LOG_DEBUG, "Memdcd got one connection.");
-    ret = rc;
+        if (check_socket_permission(accp_fd) != 0) {
+            close(accp_fd);
+            continue;
+        }
 
-close_fd:
-    close(accp_fd);
-    return ret;
+        conn = memdcd_conn_alloc(accp_fd);
+        if (conn == NULL) {
+            memdcd_log(_LOG_ERROR, "Failed to alloc connection.");
+            close(accp_fd);
+            continue;
+        }
+        if (memdcd_epoll_ctl(EPOLL_CTL_ADD, accp_fd, EPOLLIN | EPOLLONESHOT, &conn->sock_watch) != 0) {
+            memdcd_conn_put(conn);
+            continue;
+        }
+        conn->next = g_loop.conns.next;
+        conn->prev = &g_loop.conns;
+        g_loop.conns.next->prev = conn;
+        g_loop.conns.next = conn;
+        memdcd_log(_LOG_DEBUG, "Memdcd got one connection.");
+    }
+}
+
+static int memdcd_loop_init(int sock_fd)
+{
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    memset(&g_loop, 0, sizeof(g_loop));
+    g_loop.conns.prev = &g_loop.conns;
+    g_loop.conns.next = &g_loop.conns;
+    g_loop.listen_watch.type = MEMDCD_WATCH_LISTEN;
+    g_loop.close_watch.type = MEMDCD_WATCH_CLOSE;
+    pthread_mutex_init(&g_loop.close_lock, NULL);
+    pthread_mutex_init(&g_loop.job_lock, NULL);
+    pthread_cond_init(&g_loop.job_cond, NULL);
+
+    g_loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_loop.epfd < 0) {
+        memdcd_log(_LOG_ERROR, "Create epoll failed. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+        return -1;
+    }
+    g_loop.close_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_loop.close_efd < 0) {
+        memdcd_log(_LOG_ERROR, "Create eventfd failed. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+        goto close_epfd;
+    }
+
+    if (fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL) | O_NONBLOCK) != 0 ||
+        memdcd_epoll_ctl(EPOLL_CTL_ADD, sock_fd, EPOLLIN, &g_loop.listen_watch) != 0 ||
+        memdcd_epoll_ctl(EPOLL_CTL_ADD, g_loop.close_efd, EPOLLIN, &g_loop.close_watch) != 0)
+        goto close_efd;
+
+    for (g_loop.nr_workers = 0; g_loop.nr_workers < MEMDCD_WORKER_NUM; g_loop.nr_workers++) {
+        if (pthread_create(&g_loop.workers[g_loop.nr_workers], NULL, memdcd_worker, NULL) != 0) {
+            memdcd_log(_LOG_ERROR, "Create worker failed.");
+            break;
+        }
+    }
+    if (g_loop.nr_workers == 0)
+        goto close_efd;
+    return 0;
+
+close_efd:
+    close(g_loop.close_efd);
+close_epfd:
+    close(g_loop.epfd);
+    return -1;
+}
+
+static void memdcd_loop_exit(void)
+{
+    int i;
+
+    pthread_mutex_lock(&g_loop.job_lock);
+    g_loop.stop = true;
+    pthread_cond_broadcast(&g_loop.job_cond);
+    pthread_mutex_unlock(&g_loop.job_lock);
+    for (i = 0; i < g_loop.nr_workers; i++)
+        pthread_join(g_loop.workers[i], NULL);
+
+    memdcd_close_requested();
+    while (g_loop.conns.next != &g_loop.conns)
+        memdcd_remove_conn(g_loop.conns.next);
+
+    close(g_loop.close_efd);
+    close(g_loop.epfd);
+}
+
+/*
+ * the event loop accepts the clients and dispatches their events to the workers, all sockets are
+ * non-blocking, so a slow or stalled client never holds the others.
+ */
+static void memdcd_loop_run(void)
+{
+    struct epoll_event events[MEMDCD_MAX_EVENTS];
+    struct memdcd_watch *watch = NULL;
+    int nr, i;
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    while (g_exit_signal == 0) {
+        nr = epoll_wait(g_loop.epfd, events, MEMDCD_MAX_EVENTS, MEMDCD_EPOLL_TIMEOUT_MS);
+        if (nr < 0) {
+            if (errno == EINTR)
+                continue;
+            memdcd_log(_LOG_ERROR, "Epoll wait failed. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+            break;
+        }
+
+        for (i = 0; i < nr; i++) {
+            watch = (struct memdcd_watch *)events[i].data.ptr;
+            switch (watch->type) {
+                case MEMDCD_WATCH_LISTEN:
+                    memdcd_accept();
+                    break;
+                case MEMDCD_WATCH_CLOSE:
+                    break;
+                default:
+                    memdcd_dispatch(watch);
+                    break;
+            }
+        }
+        /* connections are removed after the events of them got by this wait are dispatched */
+        memdcd_close_requested();
+    }
 }
 
 void *memdcd_daemon_start(const char *sock_path)
 {
-    char *recv_buf = NULL;
-    int msg_len;
     int sock_fd;
     char error_str[ERROR_STR_MAX_LEN] = {0};
 
@@ -212,46 +716,31 @@ void *memdcd_daemon_start(const char *sock_path)
     if (sock_fd < 0)
         return NULL;
 
-    recv_buf = (char *)malloc(sizeof(char) * MAX_MESSAGE_LENGTH);
-    if (recv_buf == NULL) {
-        memdcd_log(_LOG_ERROR, "Failed to alloc buffer to receive message.");
-        close(sock_fd);
-        sock_fd = -1;
-        return NULL;
-    }
-
     /* allow RPC_CLIENT_MAX clients to connect at the same time */
     if (listen(sock_fd, MAX_PENDING_QUEUE_LENGTH) != 0) {
         memdcd_log(_LOG_ERROR, "Error listening on socket %s. err: %s",
             sock_path, strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
         close(sock_fd);
-        sock_fd = -1;
-        goto free_buf;
+        return NULL;
     }
 
     if (g_sock_fd < 0) {
         close(sock_fd);
-        sock_fd = -1;
-        goto free_buf;
+        return NULL;
+    }
+    if (memdcd_loop_init(sock_fd) != 0) {
+        close(sock_fd);
+        return NULL;
     }
     g_sock_fd = sock_fd;
     memdcd_log(_LOG_INFO, "Start listening on %s.", sock_path);
-    while (g_exit_signal == 0) {
-        msg_len = memdcd_accept(recv_buf);
-        if (msg_len < 0) {
-            memdcd_log(_LOG_ERROR, "Error accepting message. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
-            continue;
-        }
-        if (handle_recv_buffer(recv_buf, msg_len) < 0)
-            memdcd_log(_LOG_DEBUG, "Error handling message.");
-    }
+    memdcd_loop_run();
+    memdcd_loop_exit();
     migrate_process_exit();
 
     if (g_sock_fd > 0) {
         close(g_sock_fd);
         g_sock_fd = -1;
     }
-free_buf:
-    free(recv_buf);
     return NULL;
 }
@@ -16,7 +16,8 @@
 #include <numa.h>
 #include <numaif.h>
 #include <errno.h>
-#include <sys/time.h>
+#include <stdbool.h>
+#include <time.h>
 #include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
@@ -29,64 +30,177 @@
 #define PID_MAX_FILE "/proc/sys/kernel/pid_max"
 #define PID_MAX_LEN 256
 
+#define MIGRATE_PROCESS_HASH_BITS 10
+#define MIGRATE_PROCESS_HASH_SIZE (1 << MIGRATE_PROCESS_HASH_BITS)
+#define MIGRATE_TIMER_SLOTS 64      /* one slot for each second, a round of the timer wheel */
+
 struct migrate_process {
     int pid;
+    int refs;                   /* one of the table, one of each user */
+    pthread_mutex_t lock;       /* page_list and offset */
+    bool hashed;                /* hashed and migrating are protected by the lock of the bucket */
+    bool migrating;             /* pages are migrated by a worker, no more pages are taken */
 
     struct migrate_page_list *page_list;
     uint64_t offset;
-    struct timeval timestamp;
+    time_t timestamp;           /* last time pages are collected */
 
-    pthread_t worker;
+    bool timer_armed;           /* the timer fields are protected by the lock of the timer wheel */
+    time_t expire;
 
     struct migrate_process *prev;
     struct migrate_process *next;
+    struct migrate_process *timer_prev;
+    struct migrate_process *timer_next;
+};
+
+struct migrate_process_bucket {
+    pthread_mutex_t lock;
+    struct migrate_process head;
 };
 
-struct migrate_process g_process_head = {
-    .prev = &g_process_head,
-    .next = &g_process_head,
+/*
+ * a process is put in the slot of its deadline. the deadline is not moved when pages are collected,
+ * it is checked again when the slot expires, so the wheel is only locked to add and expire processes.
+ */
+struct migrate_timer_wheel {
+    pthread_mutex_t lock;
+    time_t now;                 /* slots are expired up to now */
+    struct migrate_process slots[MIGRATE_TIMER_SLOTS];
 };
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct migrate_process_bucket g_process_table[MIGRATE_PROCESS_HASH_SIZE];
+static struct migrate_timer_wheel g_timer;
+static pthread_once_t g_process_once = PTHREAD_ONCE_INIT;
+
+/* workers are detached, migrate_process_exit waits for them by the count */
+static int g_nr_workers;
+static pthread_mutex_t g_worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_worker_cond = PTHREAD_COND_INITIALIZER;
 
 time_t collect_page_timeout = DEFAULT_COLLECT_PAGE_TIMEOUT;
 
-static void migrate_process_free(struct migrate_process *p)
+static time_t migrate_now(void)
 {
-    p->prev->next = p->next;
-    p->next->prev = p->prev;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static void migrate_process_table_init(void)
+{
+    int i;
+
+    for (i = 0; i < MIGRATE_PROCESS_HASH_SIZE; i++) {
+        pthread_mutex_init(&g_process_table[i].lock, NULL);
+        g_process_table[i].head.prev = &g_process_table[i].head;
+        g_process_table[i].head.next = &g_process_table[i].head;
+    }
+    pthread_mutex_init(&g_timer.lock, NULL);
+    for (i = 0; i < MIGRATE_TIMER_SLOTS; i++) {
+        g_timer.slots[i].timer_prev = &g_timer.slots[i];
+        g_timer.slots[i].timer_next = &g_timer.slots[i];
+    }
+    g_timer.now = migrate_now();
+}
+
+static struct migrate_process_bucket *migrate_process_bucket(int pid)
+{
+    pthread_once(&g_process_once, migrate_process_table_init);
+    return &g_process_table[(unsigned int)pid & (MIGRATE_PROCESS_HASH_SIZE - 1)];
+}
+
+static void migrate_process_get(struct migrate_process *p)
+{
+    __atomic_add_fetch(&p->refs, 1, __ATOMIC_ACQ_REL);
+}
+
+static void migrate_process_put(struct migrate_process *p)
+{
+    if (__atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
 
     if (p->page_list)
         free(p->page_list);
+    pthread_mutex_destroy(&p->lock);
     free(p);
 }
 
-static void migrate_process_remove(int pid)
+/* called with the lock of the timer wheel */
+static void migrate_timer_insert(struct migrate_process *p, time_t expire)
 {
-    struct migrate_process *cur;
+    struct migrate_process *slot = NULL;
+
+    if (expire <= g_timer.now)
+        expire = g_timer.now + 1;
+    slot = &g_timer.slots[expire % MIGRATE_TIMER_SLOTS];
+    p->expire = expire;
+    p->timer_next = slot->timer_next;
+    p->timer_prev = slot;
+    slot->timer_next->timer_prev = p;
+    slot->timer_next = p;
+    p->timer_armed = true;
+}
 
-    cur = g_process_head.next;
+/* called with the lock of the timer wheel */
+static void migrate_timer_del(struct migrate_process *p)
+{
+    if (!p->timer_armed)
+        return;
+    p->timer_prev->timer_next = p->timer_next;
+    p->timer_next->timer_prev = p->timer_prev;
+    p->timer_armed = false;
+}
 
-    memdcd_log(_LOG_DEBUG, "Remove process %d.", pid);
-    while (cur != &g_process_head) {
-        if (cur->pid == pid)
-            break;
-        cur = cur->next;
-    }
-    if (cur == &g_process_head) {
-        memdcd_log(_LOG_DEBUG, "Failed to remove process %d: not exist.", pid);
+static void migrate_timer_arm(struct migrate_process *p)
+{
+    if (collect_page_timeout == 0)
         return;
-    }
 
-    migrate_process_free(cur);
-    memdcd_log(_LOG_DEBUG, "End free process %d.", pid);
+    pthread_mutex_lock(&g_timer.lock);
+    migrate_timer_del(p);
+    migrate_timer_insert(p, __atomic_load_n(&p->timestamp, __ATOMIC_RELAXED) + collect_page_timeout);
+    pthread_mutex_unlock(&g_timer.lock);
+}
+
+/* called with the lock of the bucket, drop the reference of the table */
+static void migrate_process_unhash(struct migrate_process *p)
+{
+    p->prev->next = p->next;
+    p->next->prev = p->prev;
+    p->hashed = false;
+
+    pthread_mutex_lock(&g_timer.lock);
+    migrate_timer_del(p);
+    pthread_mutex_unlock(&g_timer.lock);
+
+    migrate_process_put(p);
+}
+
+static void migrate_process_remove(struct migrate_process *p)
+{
+    struct migrate_process_bucket *bucket = migrate_process_bucket(p->pid);
+
+    memdcd_log(_LOG_DEBUG, "Remove process %d.", p->pid);
+    pthread_mutex_lock(&bucket->lock);
+    if (!p->hashed) {
+        pthread_mutex_unlock(&bucket->lock);
+        memdcd_log(_LOG_DEBUG, "Failed to remove process %d: not exist.", p->pid);
+        return;
+    }
+    migrate_process_unhash(p);
+    pthread_mutex_unlock(&bucket->lock);
 }
 
+/* called with the lock of the bucket of pid */
 static struct migrate_process *migrate_process_search(int pid)
 {
+    struct migrate_process *head = &migrate_process_bucket(pid)->head;
     struct migrate_process *cur;
 
-    cur = g_process_head.next;
-    while (cur != &g_process_head) {
+    cur = head->next;
+    while (cur != head) {
         if (cur->pid == pid) {
             return cur;
         }
@@ -96,11 +210,13 @@ static struct migrate_process *migrate_process_search(int pid)
     return NULL;
 }
 
+/* called with the lock of the bucket of pid */
 static struct migrate_process *migrate_process_add(int pid, uint64_t len)
 {
+    struct migrate_process *head = &migrate_process_bucket(pid)->head;
     struct migrate_process *process = NULL;
 
-    process = (struct migrate_process *)malloc(sizeof(struct migrate_process));
+    process = (struct migrate_process *)calloc(1, sizeof(struct migrate_process));
     if (process == NULL)
         return NULL;
 
@@ -110,109 +226,160 @@ static struct migrate_process *migrate_process_add(int pid, uint64_t len)
         free(process);
         return NULL;
     }
+    if (pthread_mutex_init(&process->lock, NULL) != 0) {
+        free(process->page_list);
+        free(process);
+        return NULL;
+    }
 
     process->pid = pid;
+    process->refs = 1;
     process->page_list->length = len;
     process->offset = 0;
-    process->worker = 0;
+    process->timestamp = migrate_now();
 
-    process->next = g_process_head.next;
+    process->next = head->next;
     process->next->prev = process;
-    g_process_head.next = process;
-    process->prev = &g_process_head;
+    head->next = process;
+    process->prev = head;
+    process->hashed = true;
+    migrate_timer_arm(process);
 
     memdcd_log(_LOG_INFO, "Add new process %d.", pid);
 
     return process;
 }
 
+/* expire the slots passed since the last time, a process which got pages meanwhile is put in its new slot */
 static void migrate_process_recycle(void)
 {
-    static struct timeval last = {0};
-    struct timeval now;
-    struct migrate_process *iter = g_process_head.next, *next = NULL;
-    time_t time_lag;
+    struct migrate_process *expired = NULL, *iter = NULL, *next = NULL, *slot = NULL;
+    struct migrate_process_bucket *bucket = NULL;
+    time_t now, tick, deadline;
 
     if (collect_page_timeout == 0)
         return;
 
-    gettimeofday(&now, NULL);
-    if (last.tv_sec == 0 || now.tv_sec - last.tv_sec < collect_page_timeout) {
-        last = now;
+    pthread_once(&g_process_once, migrate_process_table_init);
+    now = migrate_now();
+    if (now <= __atomic_load_n(&g_timer.now, __ATOMIC_RELAXED))
+        return;
+    /* another thread is expiring the slots */
+    if (pthread_mutex_trylock(&g_timer.lock) != 0)
         return;
+
+    for (tick = g_timer.now + 1; tick <= now && tick <= g_timer.now + MIGRATE_TIMER_SLOTS; tick++) {
+        slot = &g_timer.slots[tick % MIGRATE_TIMER_SLOTS];
+        for (iter = slot->timer_next; iter != slot; iter = next) {
+            next = iter->timer_next;
+            if (iter->expire > now)
+                continue;
+
+            migrate_timer_del(iter);
+            /* a migrating process is removed by its worker */
+            if (__atomic_load_n(&iter->migrating, __ATOMIC_RELAXED))
+                continue;
+            deadline = __atomic_load_n(&iter->timestamp, __ATOMIC_RELAXED) + collect_page_timeout;
+            if (deadline > now) {
+                migrate_timer_insert(iter, deadline);
+                continue;
+            }
+            migrate_process_get(iter);
+            iter->timer_next = expired;
+            expired = iter;
+        }
     }
-    last = now;
-
-    pthread_mutex_lock(&mutex);
-    while (iter != &g_process_head) {
-        next = iter->next;
-        time_lag = now.tv_sec - iter->timestamp.tv_sec;
-        if (time_lag > collect_page_timeout && !(iter->worker && pthread_tryjoin_np(iter->worker, NULL) == EBUSY)) {
-            memdcd_log(_LOG_WARN, "Process exceed collect page timeout %ld: %ld.", time_lag, collect_page_timeout);
-            migrate_process_free(iter);
+    __atomic_store_n(&g_timer.now, now, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_timer.lock);
+
+    for (iter = expired; iter != NULL; iter = next) {
+        next = iter->timer_next;
+        bucket = migrate_process_bucket(iter->pid);
+        pthread_mutex_lock(&bucket->lock);
+        if (iter->hashed && !iter->migrating) {
+            deadline = __atomic_load_n(&iter->timestamp, __ATOMIC_RELAXED) + collect_page_timeout;
+            if (deadline > now) {
+                migrate_timer_arm(iter);
+            } else {
+                memdcd_log(_LOG_WARN, "Process %d exceed collect page timeout %ld: %ld.", iter->pid,
+                    now - iter->timestamp, collect_page_timeout);
+                migrate_process_unhash(iter);
+            }
         }
-        iter = next;
+        pthread_mutex_unlock(&bucket->lock);
+        migrate_process_put(iter);
     }
-    pthread_mutex_unlock(&mutex);
-
-}
-
-static pthread_t get_active_tid(void)
-{
-    pthread_mutex_lock(&mutex);
-    struct migrate_process *iter = g_process_head.next;
-    pthread_t tid = iter->worker;
-    pthread_mutex_unlock(&mutex);
-    return (iter == &g_process_head) ? 0 : tid;
 }
 
 void migrate_process_exit(void)
 {
-    pthread_t tid;
-    migrate_process_recycle();
-    while ((tid = get_active_tid()) != 0) {
-        pthread_join(tid, NULL);
+    struct migrate_process *head = NULL;
+    int i;
+
+    pthread_mutex_lock(&g_worker_lock);
+    while (g_nr_workers > 0)
+        pthread_cond_wait(&g_worker_cond, &g_worker_lock);
+    pthread_mutex_unlock(&g_worker_lock);
+
+    /* pages of the processes not collected completely are dropped */
+    pthread_once(&g_process_once, migrate_process_table_init);
+    for (i = 0; i < MIGRATE_PROCESS_HASH_SIZE; i++) {
+        head = &g_process_table[i].head;
+        pthread_mutex_lock(&g_process_table[i].lock);
+        while (head->next != head)
+            migrate_process_unhash(head->next);
+        pthread_mutex_unlock(&g_process_table[i].lock);
     }
 }
 
-static struct migrate_process *migrate_process_collect_pages(int pid, const struct swap_vma_with_count *vma)
+/*
+ * return 0 if the pages are collected, and -1 if they are dropped. when all pages of the process are
+ * collected, it is returned by ready with a reference for the migration.
+ */
+static int migrate_process_collect_pages(int pid, const struct swap_vma_with_count *vma,
+    struct migrate_process **ready)
 {
     uint64_t count = vma->length / sizeof(struct vma_addr_with_count);
+    struct migrate_process_bucket *bucket = migrate_process_bucket(pid);
     struct migrate_process *process = NULL;
+    bool dropped = false, complete = false;
     uint64_t i;
 
+    *ready = NULL;
     migrate_process_recycle();
 
-    pthread_mutex_lock(&mutex);
+    pthread_mutex_lock(&bucket->lock);
     process = migrate_process_search(pid);
     if (process != NULL) {
-        if (process->worker != 0 && pthread_tryjoin_np(process->worker, NULL) == EBUSY) {
+        if (process->migrating) {
             memdcd_log(_LOG_DEBUG, "Previous send work of process %d has been doing. discard pages.", pid);
-            pthread_mutex_unlock(&mutex);
-            return NULL;
+            pthread_mutex_unlock(&bucket->lock);
+            return -1;
         }
 
         if (vma->status == MEMDCD_SEND_START) {
             memdcd_log(_LOG_DEBUG, "Previous send work of process %d is interrupted.", pid);
-            migrate_process_remove(pid);
+            migrate_process_unhash(process);
             process = NULL;
         }
     }
     if (process == NULL) {
         if (vma->status != MEMDCD_SEND_START) {
             memdcd_log(_LOG_DEBUG, "Current send work of process %d is incomplete.", pid);
-            pthread_mutex_unlock(&mutex);
-            return NULL;
+            pthread_mutex_unlock(&bucket->lock);
+            return -1;
         }
 
         process = migrate_process_add(pid, vma->total_length);
         if (process == NULL) {
             memdcd_log(_LOG_ERROR, "Cannot allocate space for process %d.", pid);
-            pthread_mutex_unlock(&mutex);
-            return NULL;
+            pthread_mutex_unlock(&bucket->lock);
+            return -1;
         }
     }
-    pthread_mutex_unlock(&mutex);
+    migrate_process_get(process);
+    pthread_mutex_lock(&process->lock);
+    pthread_mutex_unlock(&bucket->lock);
 
     memdcd_log(_LOG_DEBUG, "Collect %d pages for process %d; %lu has been collected; total %lu.", count, pid,
         process->offset, process->page_list->length);
@@ -220,8 +387,8 @@ static struct migrate_process *migrate_process_collect_pages(int pid, const stru
     if (process->offset + count > process->page_list->length) {
         memdcd_log(_LOG_ERROR, "Collected pages of process %d is greater than total count: %lu %lu %lu.", pid,
             process->offset, count, process->page_list->length);
-        migrate_process_remove(pid);
-        return NULL;
+        dropped = true;
+        goto unlock;
     }
 
     for (i = 0; i < count; i++) {
@@ -230,20 +397,38 @@ static struct migrate_process *migrate_process_collect_pages(int pid, const stru
         process->page_list->pages[process->offset + i].visit_count = vma->vma_addrs[i].count;
     }
     process->offset += count;
-    gettimeofday(&process->timestamp, NULL);
+    __atomic_store_n(&process->timestamp, migrate_now(), __ATOMIC_RELAXED);
 
     if (vma->status == MEMDCD_SEND_END && process->offset != process->page_list->length) {
         memdcd_log(_LOG_ERROR, "Count of pages of process %d is not equal to total count: %lu %lu.",
             pid, process->offset, process->page_list->length);
-        migrate_process_remove(pid);
-        return NULL;
+        dropped = true;
+        goto unlock;
     }
     if (vma->status != MEMDCD_SEND_PROCESS && process->offset == process->page_list->length) {
         memdcd_log(_LOG_INFO, "Collected %lu vmas for process %d.", process->page_list->length, pid);
-        return process;
+        complete = true;
     }
 
-    return NULL;
+unlock:
+    pthread_mutex_unlock(&process->lock);
+    if (dropped || complete) {
+        pthread_mutex_lock(&bucket->lock);
+        if (!process->hashed || process->migrating) {
+            /* removed or taken by another message meanwhile */
+            dropped = true;
+        } else if (dropped) {
+            migrate_process_unhash(process);
+        } else {
+            __atomic_store_n(&process->migrating, true, __ATOMIC_RELAXED);
+            *ready = process;
+        }
+        pthread_mutex_unlock(&bucket->lock);
+    }
+    if (*ready == NULL)
+        migrate_process_put(process);
+
+    return dropped ? -1 : 0;
 }
 
 void init_collect_pages_timeout(time_t timeout)
@@ -265,13 +450,13 @@ static void *memdcd_migrate(void *args)
     policy = get_policy();
     if (policy == NULL) {
         memdcd_log(_LOG_ERROR, "Policy not initialized.");
-        return NULL;
+        goto remove;
     }
 
     pages = (struct migrate_page_list *)malloc(sizeof(struct migrate_page_list) +
         sizeof(struct migrate_page) * process->page_list->length);
     if (pages == NULL)
-        return NULL;
+        goto remove;
     memcpy(pages, process->page_list,
         sizeof(struct migrate_page_list) + sizeof(struct migrate_page) * process->page_list->length);
 
@@ -291,9 +476,24 @@ static void *memdcd_migrate(void *args)
 free_pages:
     free(pages);
 
-    pthread_mutex_lock(&mutex);
-    migrate_process_remove(process->pid);
-    pthread_mutex_unlock(&mutex);
+remove:
+    migrate_process_remove(process);
+    migrate_process_put(process);
+    return NULL;
+}
+
+static void migrate_worker_done(void)
+{
+    pthread_mutex_lock(&g_worker_lock);
+    if (--g_nr_workers == 0)
+        pthread_cond_broadcast(&g_worker_cond);
+    pthread_mutex_unlock(&g_worker_lock);
+}
+
+static void *memdcd_migrate_worker(void *args)
+{
+    memdcd_migrate(args);
+    migrate_worker_done();
     return NULL;
 }
 
@@ -324,22 +524,35 @@ int migrate_process_get_pages(int pid, const struct swap_vma_with_count *vma)
 {
     char error_str[ERROR_STR_MAX_LEN] = {0};
     struct migrate_process *process = NULL;
+    pthread_attr_t attr;
+    pthread_t worker;
+    int ret;
+
     if (pid <= 0 || pid > get_pid_max()) {
         memdcd_log(_LOG_ERROR, "Invalid input pid:%d.\n ", pid);
         return -1;
     }
 
-    process = migrate_process_collect_pages(pid, vma);
+    if (migrate_process_collect_pages(pid, vma, &process) != 0)
+        return -1;
+    if (process == NULL)
+        return 0;
 
-    if (process != NULL) {
-        if (pthread_create(&process->worker, NULL, memdcd_migrate, (void *)process) != 0) {
-            memdcd_log(_LOG_ERROR, "Error creating pthread for process %d. err: %s",
-                process->pid, strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
-            return -1;
-        }
-    } else {
+    pthread_mutex_lock(&g_worker_lock);
+    g_nr_workers++;
+    pthread_mutex_unlock(&g_worker_lock);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&worker, &attr, memdcd_migrate_worker, (void *)process);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        memdcd_log(_LOG_ERROR, "Error creating pthread for process %d. err: %s",
+            process->pid, strerror_r(ret, error_str, ERROR_STR_MAX_LEN));
+        migrate_process_remove(process);
+        migrate_process_put(process);
+        migrate_worker_done();
         return -1;
     }
     return 0;
 }
-
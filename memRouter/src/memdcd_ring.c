@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem/memRouter licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: consumer of the shared memory ring set up by a client.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "memdcd_log.h"
+#include "memdcd_ring.h"
+
+#define RING_ALIGN_UP(x) (((x) + MEMDCD_RING_ALIGN - 1) & ~((uint64_t)MEMDCD_RING_ALIGN - 1))
+
+int memdcd_ring_attach(struct memdcd_ring_conn *conn, int mem_fd, int event_fd, uint32_t size)
+{
+    struct stat st;
+    size_t map_len = sizeof(struct memdcd_ring) + size;
+    void *addr = NULL;
+    char error_str[ERROR_STR_MAX_LEN] = {0};
+
+    if (size < MEMDCD_RING_MIN_SIZE || size > MEMDCD_RING_MAX_SIZE || (size & (size - 1)) != 0) {
+        memdcd_log(_LOG_ERROR, "Invalid ring size %u.", size);
+        return -1;
+    }
+    if (fstat(mem_fd, &st) != 0 || (size_t)st.st_size < map_len) {
+        memdcd_log(_LOG_ERROR, "Memory of ring is less than %lu.", map_len);
+        return -1;
+    }
+
+    addr = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (addr == MAP_FAILED) {
+        memdcd_log(_LOG_ERROR, "Map ring failed. err: %s", strerror_r(errno, error_str, ERROR_STR_MAX_LEN));
+        return -1;
+    }
+    close(mem_fd);
+
+    conn->ring = (struct memdcd_ring *)addr;
+    conn->map_len = map_len;
+    conn->size = size;
+    conn->tail = __atomic_load_n(&conn->ring->tail, __ATOMIC_ACQUIRE);
+    conn->head = conn->tail;
+    conn->event_fd = event_fd;
+    memdcd_log(_LOG_INFO, "Set up ring of %u bytes.", size);
+    return 0;
+}
+
+void memdcd_ring_detach(struct memdcd_ring_conn *conn)
+{
+    if (conn->ring == NULL)
+        return;
+
+    munmap(conn->ring, conn->map_len);
+    close(conn->event_fd);
+    conn->ring = NULL;
+    conn->event_fd = -1;
+}
+
+void memdcd_ring_clear_event(struct memdcd_ring_conn *conn)
+{
+    uint64_t val;
+
+    /* the client writes the eventfd after moving head, so nothing put after the read is missed */
+    if (read(conn->event_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+        memdcd_log(_LOG_DEBUG, "Read eventfd of ring failed.");
+}
+
+int memdcd_ring_next(struct memdcd_ring_conn *conn, struct memdcd_ring_record *record, const void **msg)
+{
+    uint64_t offset;
+
+    for (;;) {
+        if (conn->tail == conn->head) {
+            conn->head = __atomic_load_n(&conn->ring->head, __ATOMIC_ACQUIRE);
+            if (conn->head - conn->tail > conn->size) {
+                memdcd_log(_LOG_ERROR, "Head %lu of ring is beyond tail %lu.", conn->head, conn->tail);
+                return -1;
+            }
+            if (conn->tail == conn->head)
+                return 0;
+        }
+
+        offset = conn->tail & (conn->size - 1);
+        memcpy(record, conn->ring->data + offset, sizeof(struct memdcd_ring_record));
+        if (record->length == MEMDCD_RING_PAD) {
+            if (conn->size - offset > conn->head - conn->tail) {
+                memdcd_log(_LOG_ERROR, "Pad record at %lu exceeds the ring.", offset);
+                return -1;
+            }
+            conn->tail += conn->size - offset;
+            continue;
+        }
+        if (record->length > conn->size - offset - sizeof(struct memdcd_ring_record) ||
+            RING_ALIGN_UP(sizeof(struct memdcd_ring_record) + record->length) > conn->head - conn->tail) {
+            memdcd_log(_LOG_ERROR, "Record of %u bytes at %lu exceeds the ring.", record->length, offset);
+            return -1;
+        }
+
+        *msg = conn->ring->data + offset + sizeof(struct memdcd_ring_record);
+        conn->tail += RING_ALIGN_UP(sizeof(struct memdcd_ring_record) + record->length);
+        return 1;
+    }
+}
+
+void memdcd_ring_commit(struct memdcd_ring_conn *conn)
+{
+    __atomic_store_n(&conn->ring->tail, conn->tail, __ATOMIC_RELEASE);
+}
@@ -14,11 +14,17 @@
  * **************************************************************************** */
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
 #include <CUnit/Automated.h>
 #include "memdcd_log.h"
 #include "memdcd_message.h"
 #include "memdcd_migrate.h"
+#include "memdcd_cmd.h"
+#include "memdcd_daemon.h"
 #include "alloc_memory.h"
 
 static void test_memdcd_cmd(void)
@@ -53,6 +59,289 @@ static void test_memdcd_cmd(void)
     free(msg_num);
 }
 
+static size_t put_varint(unsigned char *buf, uint64_t val)
+{
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        buf[len++] = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    buf[len++] = (unsigned char)val;
+    return len;
+}
+
+/* one run of nr pages of 4KB from addr, return the length of the message */
+static size_t fill_compact(char *buf, uint64_t addr, uint32_t nr, uint32_t count, uint32_t status)
+{
+    struct memdcd_compact_message msg = {
+        .cmd_type = MEMDCD_CMD_MEM,
+        .pid = getpid(),
+        .enable_uswap = 1,
+        .status = status,
+        .total_length = count,
+        .count = count,
+        .runs = 1,
+    };
+    unsigned char *pos = (unsigned char *)buf + sizeof(msg);
+
+    memcpy(buf, &msg, sizeof(msg));
+    pos += put_varint(pos, (addr >> MEMDCD_PAGE_UNIT_SHIFT) << 1);
+    pos += put_varint(pos, 1);
+    pos += put_varint(pos, 1);
+    pos += put_varint(pos, nr);
+    return (size_t)(pos - (unsigned char *)buf);
+}
+
+static void test_memdcd_cmd_compact(void)
+{
+    char buf[sizeof(struct memdcd_compact_message) + MEMDCD_RUN_MAX_LEN];
+    size_t len;
+    int pagesize = getpagesize();
+    char *pages = NULL;
+
+    if (posix_memalign((void **)&pages, pagesize, pagesize * 3) != 0) {
+        printf("memalign allocate memmory failed");
+        return;
+    }
+    memset(pages, 1, pagesize * 3);
+
+    len = fill_compact(buf, (uint64_t)pages, 3, 3, MEMDCD_SEND_START);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len - 1), -1);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len + 1), -1);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, sizeof(struct memdcd_compact_message) - 1), -1);
+    /* pages in the runs are not equal to the count */
+    len = fill_compact(buf, (uint64_t)pages, 2, 3, MEMDCD_SEND_START);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len), -1);
+    len = fill_compact(buf, (uint64_t)pages, 4, 3, MEMDCD_SEND_START);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len), -1);
+    len = fill_compact(buf, (uint64_t)pages, 3, 3, MEMDCD_SEND_END + 1);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len), -1);
+    len = fill_compact(buf, (uint64_t)pages, MAX_VMA_NUM + 1, MAX_VMA_NUM + 1, MEMDCD_SEND_START);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len), -1);
+
+    len = fill_compact(buf, (uint64_t)pages, 3, 3, MEMDCD_SEND_START);
+    CU_ASSERT_EQUAL(handle_recv_compact(buf, len), 0);
+    free(pages);
+}
+
+static void fill_frame(char *buf, uint32_t seq, const struct memdcd_message *msg)
+{
+    struct memdcd_frame_header header = {
+        .magic = MEMDCD_FRAME_MAGIC,
+        .version = MEMDCD_PROTO_VERSION_FIXED,
+        .type = MEMDCD_FRAME_MSG,
+        .seq = seq,
+        .length = sizeof(struct memdcd_message),
+    };
+
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), msg, sizeof(struct memdcd_message));
+}
+
+static void test_memdcd_cmd_stream(void)
+{
+    size_t frame_len = sizeof(struct memdcd_frame_header) + sizeof(struct memdcd_message);
+    struct memdcd_message *msg = NULL;
+    struct memdcd_stream stream = {0};
+    char *frames = NULL;
+
+    msg = (struct memdcd_message *)calloc(1, sizeof(struct memdcd_message));
+    frames = (char *)malloc(frame_len * 2);
+    stream.size = MAX_MESSAGE_LENGTH;
+    stream.buf = (char *)malloc(stream.size);
+    if (msg == NULL || frames == NULL || stream.buf == NULL) {
+        printf("malloc error in test_memdcd_cmd_stream");
+        goto free_all;
+    }
+    /* invalid cmd type, each frame is handled and failed */
+    msg->cmd_type = 100;
+    fill_frame(frames, 1, msg);
+    fill_frame(frames + frame_len, 2, msg);
+
+    /* part of the header is kept until the rest comes */
+    memcpy(stream.buf, frames, sizeof(struct memdcd_frame_header) - 1);
+    stream.len = sizeof(struct memdcd_frame_header) - 1;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.seq, 0);
+    CU_ASSERT_EQUAL(stream.len, sizeof(struct memdcd_frame_header) - 1);
+
+    /* the first frame is complete and the second is partial */
+    memcpy(stream.buf + stream.len, frames + stream.len, frame_len + 1 - stream.len);
+    stream.len = frame_len + 1;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.seq, 1);
+    CU_ASSERT_EQUAL(stream.failed, 1);
+    CU_ASSERT_EQUAL(stream.len, 1);
+
+    memcpy(stream.buf + stream.len, frames + frame_len + 1, frame_len - 1);
+    stream.len = frame_len;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.seq, 2);
+    CU_ASSERT_EQUAL(stream.failed, 2);
+    CU_ASSERT_EQUAL(stream.len, 0);
+    CU_ASSERT_EQUAL(stream.version, MEMDCD_PROTO_VERSION_FIXED);
+
+    /* a frame of wrong magic or too long breaks the stream */
+    fill_frame(stream.buf, 3, msg);
+    ((struct memdcd_frame_header *)stream.buf)->magic = 0;
+    stream.len = frame_len;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), -1);
+    fill_frame(stream.buf, 3, msg);
+    ((struct memdcd_frame_header *)stream.buf)->length = MAX_MESSAGE_LENGTH;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), -1);
+
+free_all:
+    free(stream.buf);
+    free(frames);
+    free(msg);
+}
+
+static void test_memdcd_cmd_stream_pages(void)
+{
+    size_t frame_len = sizeof(struct memdcd_frame_header) + sizeof(struct memdcd_message);
+    struct memdcd_message *msg = NULL;
+    struct memdcd_stream stream = {0};
+    int msg_num = 0;
+    int i;
+
+    /* pages of one pid in three frames: start, process and end */
+    msg = alloc_memory(MAX_VMA_NUM * 2 + 1, &msg_num);
+    stream.size = MAX_MESSAGE_LENGTH;
+    stream.buf = (char *)malloc(stream.size);
+    if (msg == NULL || stream.buf == NULL) {
+        printf("malloc error in test_memdcd_cmd_stream_pages");
+        goto free_all;
+    }
+    CU_ASSERT_EQUAL(msg_num, 3);
+
+    /* frames before the end are collected, not failed */
+    for (i = 0; i < msg_num; i++) {
+        fill_frame(stream.buf, i + 1, &msg[i]);
+        stream.len = frame_len;
+        CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+        CU_ASSERT_EQUAL(stream.seq, i + 1);
+        CU_ASSERT_EQUAL(stream.failed, 0);
+        CU_ASSERT_EQUAL(stream.len, 0);
+    }
+    migrate_process_exit();
+
+    /* the rest of a pid without its start is dropped */
+    fill_frame(stream.buf, msg_num + 1, &msg[msg_num - 1]);
+    stream.len = frame_len;
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.failed, 1);
+
+free_all:
+    free(stream.buf);
+    if (msg != NULL)
+        free_memory(msg, msg_num);
+}
+
+static void put_record(struct memdcd_ring *ring, uint32_t size, uint32_t seq, uint32_t cmd_type)
+{
+    struct memdcd_ring_record record = {
+        .seq = seq,
+        .length = sizeof(cmd_type),
+    };
+    uint64_t offset = ring->head & (size - 1);
+
+    if (size - offset < sizeof(record) + sizeof(cmd_type) + MEMDCD_RING_ALIGN) {
+        record.length = MEMDCD_RING_PAD;
+        memcpy(ring->data + offset, &record, sizeof(record));
+        ring->head += size - offset;
+        offset = 0;
+        record.length = sizeof(cmd_type);
+    }
+    memcpy(ring->data + offset, &record, sizeof(record));
+    memcpy(ring->data + offset + sizeof(record), &cmd_type, sizeof(cmd_type));
+    ring->head += MEMDCD_RING_ALIGN * 2;
+}
+
+static void test_memdcd_cmd_ring(void)
+{
+    uint32_t size = MEMDCD_RING_MIN_SIZE;
+    size_t map_len = sizeof(struct memdcd_ring) + size;
+    struct {
+        struct memdcd_frame_header header;
+        struct memdcd_ring_setup setup;
+    } frame = {
+        .header = {
+            .magic = MEMDCD_FRAME_MAGIC,
+            .version = MEMDCD_PROTO_VERSION,
+            .type = MEMDCD_FRAME_RING_SETUP,
+            .seq = 1,
+            .length = sizeof(struct memdcd_ring_setup),
+        },
+        .setup = {
+            .size = size,
+        },
+    };
+    struct memdcd_stream stream = {0};
+    struct memdcd_ring *ring = NULL;
+    uint64_t val = 1;
+    int mem_fd;
+
+    stream.size = MAX_MESSAGE_LENGTH;
+    stream.buf = (char *)malloc(stream.size);
+    mem_fd = memfd_create("memdcd_ring_llt", MFD_CLOEXEC);
+    if (stream.buf == NULL || mem_fd < 0 || ftruncate(mem_fd, map_len) != 0) {
+        printf("prepare ring error in test_memdcd_cmd_ring");
+        goto free_buf;
+    }
+    ring = (struct memdcd_ring *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (ring == MAP_FAILED) {
+        printf("mmap error in test_memdcd_cmd_ring");
+        goto free_buf;
+    }
+    /* start from the end of the ring, so the second record wraps */
+    ring->head = size - MEMDCD_RING_ALIGN * 3;
+    ring->tail = ring->head;
+
+    /* setup without the fds fails, but the stream goes on */
+    memcpy(stream.buf, &frame, sizeof(frame));
+    stream.len = sizeof(frame);
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.failed, 1);
+    CU_ASSERT_PTR_NULL(stream.ring.ring);
+
+    stream.fds[0] = dup(mem_fd);
+    stream.fds[1] = eventfd(0, EFD_CLOEXEC);
+    stream.nr_fds = MEMDCD_RING_FDS;
+    frame.header.seq = 2;
+    memcpy(stream.buf, &frame, sizeof(frame));
+    stream.len = sizeof(frame);
+    CU_ASSERT_EQUAL(handle_recv_stream(&stream), 0);
+    CU_ASSERT_EQUAL(stream.seq, 2);
+    CU_ASSERT_EQUAL(stream.failed, 1);
+    CU_ASSERT_PTR_NOT_NULL(stream.ring.ring);
+    CU_ASSERT_EQUAL(stream.nr_fds, 0);
+    if (stream.ring.ring == NULL)
+        goto unmap;
+
+    /* invalid cmd type, each message is handled and failed */
+    put_record(ring, size, 3, 100);
+    put_record(ring, size, 4, 100);
+    CU_ASSERT_EQUAL(write(stream.ring.event_fd, &val, sizeof(val)), sizeof(val));
+    CU_ASSERT_EQUAL(handle_recv_ring(&stream), 0);
+    CU_ASSERT_EQUAL(stream.seq, 4);
+    CU_ASSERT_EQUAL(stream.failed, 3);
+    CU_ASSERT_EQUAL(ring->tail, ring->head);
+
+    /* head beyond the ring breaks it */
+    ring->head += size + MEMDCD_RING_ALIGN;
+    CU_ASSERT_EQUAL(write(stream.ring.event_fd, &val, sizeof(val)), sizeof(val));
+    CU_ASSERT_EQUAL(handle_recv_ring(&stream), -1);
+
+unmap:
+    release_recv_stream(&stream);
+    munmap(ring, map_len);
+free_buf:
+    if (mem_fd >= 0)
+        close(mem_fd);
+    free(stream.buf);
+}
+
 int add_tests(void)
 {
     /* add test case for memdcd_cmd */
@@ -65,6 +354,22 @@ int add_tests(void)
         return -1;
     }
 
+    if (CU_ADD_TEST(suite_memdcd_cmd, test_memdcd_cmd_stream) == NULL) {
+        return -1;
+    }
+
+    if (CU_ADD_TEST(suite_memdcd_cmd, test_memdcd_cmd_stream_pages) == NULL) {
+        return -1;
+    }
+
+    if (CU_ADD_TEST(suite_memdcd_cmd, test_memdcd_cmd_compact) == NULL) {
+        return -1;
+    }
+
+    if (CU_ADD_TEST(suite_memdcd_cmd, test_memdcd_cmd_ring) == NULL) {
+        return -1;
+    }
+
     CU_set_output_filename("memdcd");
     return 0;
 }
@@ -0,0 +1,218 @@
+/* *****************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ * etmem is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: etmem
+ * Create: 2026-10-19
+ * Description: Cunit test for the event loop of memdcd_daemon
+ * **************************************************************************** */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <CUnit/Automated.h>
+#include "memdcd_daemon.c"
+
+#define TEST_SNDBUF_LEN 4096
+#define TEST_JUNK_LEN 1024
+
+/* a connection of one end of a socketpair, put in the event loop as memdcd_accept does */
+static struct memdcd_conn *add_test_conn(int fd)
+{
+    struct memdcd_conn *conn = memdcd_conn_alloc(fd);
+
+    if (conn == NULL)
+        return NULL;
+    if (memdcd_epoll_ctl(EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLONESHOT, &conn->sock_watch) != 0) {
+        memdcd_conn_put(conn);
+        return NULL;
+    }
+    conn->next = g_loop.conns.next;
+    conn->prev = &g_loop.conns;
+    g_loop.conns.next->prev = conn;
+    g_loop.conns.next = conn;
+    return conn;
+}
+
+/* run the job of a socket event in place of a worker, which puts the reference dispatch takes */
+static void run_test_job(struct memdcd_conn *conn)
+{
+    __atomic_add_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL);
+    memdcd_run_job(&conn->sock_watch);
+}
+
+/* a frame of invalid cmd type, it is handled and failed */
+static int send_test_frame(int fd, uint32_t seq)
+{
+    struct {
+        struct memdcd_frame_header header;
+        struct memdcd_message msg;
+    } *frame = calloc(1, sizeof(*frame));
+    int ret;
+
+    if (frame == NULL)
+        return -1;
+    frame->header.magic = MEMDCD_FRAME_MAGIC;
+    frame->header.version = MEMDCD_PROTO_VERSION_FIXED;
+    frame->header.type = MEMDCD_FRAME_MSG;
+    frame->header.seq = seq;
+    frame->header.length = sizeof(struct memdcd_message);
+    frame->msg.cmd_type = 100;
+    ret = send(fd, frame, sizeof(*frame), MSG_NOSIGNAL) == sizeof(*frame) ? 0 : -1;
+    free(frame);
+    return ret;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    size_t off = 0;
+    ssize_t rc;
+
+    while (off < len) {
+        rc = recv(fd, (char *)buf + off, len - off, 0);
+        if (rc <= 0)
+            return -1;
+        off += rc;
+    }
+    return 0;
+}
+
+/* return whether the socket of conn is reported by epoll */
+static bool conn_polled(struct memdcd_conn *conn)
+{
+    struct epoll_event events[MEMDCD_MAX_EVENTS];
+    int nr, i;
+
+    nr = epoll_wait(g_loop.epfd, events, MEMDCD_MAX_EVENTS, 0);
+    for (i = 0; i < nr; i++) {
+        if (events[i].data.ptr == &conn->sock_watch)
+            return true;
+    }
+    return false;
+}
+
+static void test_memdcd_daemon_partial_ack(void)
+{
+    char junk[TEST_JUNK_LEN] = {0};
+    struct memdcd_ack_frame ack;
+    struct memdcd_conn *conn = NULL;
+    size_t junk_len = 0;
+    ssize_t rc;
+    int sndbuf = TEST_SNDBUF_LEN;
+    int listen_fd;
+    int sv[2];
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CU_ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+    CU_ASSERT_EQUAL(memdcd_loop_init(listen_fd), 0);
+    conn = add_test_conn(sv[0]);
+    CU_ASSERT_PTR_NOT_NULL(conn);
+    if (conn == NULL)
+        return;
+    CU_ASSERT_EQUAL(fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) & ~O_NONBLOCK), 0);
+
+    /* the client does not read, so the socket of memdcd is full and no ack can be sent */
+    CU_ASSERT_EQUAL(setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+    while ((rc = send(sv[0], junk, sizeof(junk), MSG_DONTWAIT)) > 0)
+        junk_len += rc;
+
+    CU_ASSERT_EQUAL(send_test_frame(sv[1], 1), 0);
+    run_test_job(conn);
+    CU_ASSERT_EQUAL(conn->stream.seq, 1);
+    CU_ASSERT_EQUAL(conn->stream.acked, 1);
+    CU_ASSERT_EQUAL(conn->ack_off, 0);
+    CU_ASSERT_EQUAL(conn->ack_len, sizeof(struct memdcd_ack_frame));
+    CU_ASSERT_FALSE(conn->closing);
+
+    /* a newer frame waits for the kept ack */
+    CU_ASSERT_EQUAL(send_test_frame(sv[1], 2), 0);
+    run_test_job(conn);
+    CU_ASSERT_EQUAL(conn->stream.seq, 2);
+    CU_ASSERT_EQUAL(conn->stream.acked, 1);
+    CU_ASSERT_EQUAL(conn->stream.failed, 1);
+    CU_ASSERT_FALSE(conn_polled(conn));
+
+    /* the socket is armed for writing, both acks are sent once the client reads */
+    while (junk_len > 0) {
+        rc = recv(sv[1], junk, junk_len < sizeof(junk) ? junk_len : sizeof(junk), 0);
+        if (rc <= 0)
+            break;
+        junk_len -= rc;
+    }
+    CU_ASSERT_EQUAL(junk_len, 0);
+    CU_ASSERT_TRUE(conn_polled(conn));
+    run_test_job(conn);
+    CU_ASSERT_EQUAL(conn->stream.acked, 2);
+    CU_ASSERT_EQUAL(conn->ack_off, conn->ack_len);
+
+    CU_ASSERT_EQUAL(recv_all(sv[1], &ack, sizeof(ack)), 0);
+    CU_ASSERT_EQUAL(ack.header.type, MEMDCD_FRAME_ACK);
+    CU_ASSERT_EQUAL(ack.header.seq, 1);
+    CU_ASSERT_EQUAL(ack.ack.failed, 1);
+    CU_ASSERT_EQUAL(recv_all(sv[1], &ack, sizeof(ack)), 0);
+    CU_ASSERT_EQUAL(ack.header.seq, 2);
+    CU_ASSERT_EQUAL(ack.ack.failed, 1);
+
+    memdcd_loop_exit();
+    close(sv[1]);
+    close(listen_fd);
+}
+
+static void test_memdcd_daemon_close_race(void)
+{
+    struct memdcd_conn *conn = NULL;
+    char buf[1];
+    int listen_fd;
+    int sv[2];
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CU_ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+    CU_ASSERT_EQUAL(memdcd_loop_init(listen_fd), 0);
+    conn = add_test_conn(sv[0]);
+    CU_ASSERT_PTR_NOT_NULL(conn);
+    if (conn == NULL)
+        return;
+    CU_ASSERT_EQUAL(fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) & ~O_NONBLOCK), 0);
+    CU_ASSERT_EQUAL(send_test_frame(sv[1], 1), 0);
+
+    /* the job is queued to a worker while another one asks to close the connection */
+    pthread_mutex_lock(&conn->lock);
+    memdcd_dispatch(&conn->sock_watch);
+    memdcd_request_close(conn);
+    pthread_mutex_unlock(&conn->lock);
+
+    /* the event loop removes it, the job skips it and puts the last reference */
+    memdcd_close_requested();
+    CU_ASSERT_PTR_EQUAL(g_loop.conns.next, &g_loop.conns);
+    memdcd_loop_exit();
+
+    /* the frame is not handled, so the client gets no ack before the close */
+    CU_ASSERT(recv(sv[1], buf, sizeof(buf), 0) <= 0);
+    close(sv[1]);
+    close(listen_fd);
+}
+
+int add_tests(void)
+{
+    /* add test case for the event loop of memdcd_daemon */
+    CU_pSuite suite_memdcd_daemon_loop = CU_add_suite("memdcd_daemon_loop", NULL, NULL);
+    if (suite_memdcd_daemon_loop == NULL) {
+        return -1;
+    }
+
+    if (CU_ADD_TEST(suite_memdcd_daemon_loop, test_memdcd_daemon_partial_ack) == NULL) {
+        return -1;
+    }
+
+    if (CU_ADD_TEST(suite_memdcd_daemon_loop, test_memdcd_daemon_close_race) == NULL) {
+        return -1;
+    }
+
+    CU_set_output_filename("memdcd");
+    return 0;
+}
@@ -37,8 +37,10 @@ static void test_memdcd_process(void)
     init_mem_policy("./config/policy_threshold_GB.json");
     CU_ASSERT_EQUAL(migrate_process_get_pages(-1, wrong_msg->memory_msg.vma.vma_addrs), -1);
     CU_ASSERT_EQUAL(migrate_process_get_pages(get_pid_max() + 1, wrong_msg->memory_msg.vma.vma_addrs), -1);
-    CU_ASSERT_EQUAL(migrate_process_get_pages(wrong_msg->memory_msg.pid, &(wrong_msg->memory_msg.vma)), -1);
+    CU_ASSERT_EQUAL(migrate_process_get_pages(wrong_msg->memory_msg.pid, &(wrong_msg[1].memory_msg.vma)), -1);
+    CU_ASSERT_EQUAL(migrate_process_get_pages(wrong_msg->memory_msg.pid, &(wrong_msg->memory_msg.vma)), 0);
     CU_ASSERT_EQUAL(migrate_process_get_pages(wrong_msg->memory_msg.pid, &(wrong_msg[1].memory_msg.vma)), 0);
+    migrate_process_exit();
     free_memory(wrong_msg, *msg_num);
     free(msg_num);
 }
@@ -58,37 +60,75 @@ static void test_memdcd_process_static(void)
         free(msg_num);
         return;
     }
-    struct migrate_process *process = migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma));
+    struct migrate_process *process = NULL;
+    CU_ASSERT_EQUAL(migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma), &process), 0);
     CU_ASSERT_PTR_NULL(process);
-    process = migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma));
+    CU_ASSERT_EQUAL(migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma), &process), 0);
     CU_ASSERT_PTR_NOT_NULL(process);
     CU_ASSERT_PTR_NOT_NULL(migrate_process_search(getpid()));
-    migrate_process_free(process);
+    /* pages are not taken while the process is migrating */
+    CU_ASSERT_EQUAL(migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma), &process), -1);
+    CU_ASSERT_PTR_NULL(process);
+    process = migrate_process_search(getpid());
+    migrate_process_remove(process);
+    migrate_process_put(process);
 
     CU_ASSERT_PTR_NULL(migrate_process_search(getpid()));
-    process = migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma));
-    process = migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma));
-    migrate_process_remove(getpid());
+    migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma), &process);
+    migrate_process_remove(migrate_process_search(getpid()));
     CU_ASSERT_PTR_NULL(migrate_process_search(getpid()));
-    process = NULL;
-    process = migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma));
-    process = migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma));
+    CU_ASSERT_EQUAL(migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma), &process), -1);
+    migrate_process_collect_pages(getpid(), &(msg[0].memory_msg.vma), &process);
+    migrate_process_collect_pages(getpid(), &(msg[1].memory_msg.vma), &process);
     CU_ASSERT_PTR_NOT_NULL(process);
     memdcd_migrate(NULL);
-    process->pid = get_pid_max() + 1;
     memdcd_migrate(process);
     CU_ASSERT_PTR_NULL(migrate_process_search(getpid()));
-    process->pid = getpid();
     process = NULL;
+    pthread_mutex_lock(&migrate_process_bucket(getpid())->lock);
     migrate_process_add(getpid(), 100);
     process = migrate_process_search(getpid());
+    pthread_mutex_unlock(&migrate_process_bucket(getpid())->lock);
     CU_ASSERT_PTR_NOT_NULL(process);
     CU_ASSERT_EQUAL(process->page_list->length, 100);
-    migrate_process_free(process);
+    migrate_process_remove(process);
     free_memory(msg, *msg_num);
     free(msg_num);
 }
 
+static void test_memdcd_process_table(void)
+{
+    struct migrate_process *p1 = NULL;
+    struct migrate_process *p2 = NULL;
+    int pid = getpid();
+    int other = pid + MIGRATE_PROCESS_HASH_SIZE;
+
+    /* pids in the same bucket */
+    pthread_mutex_lock(&migrate_process_bucket(pid)->lock);
+    p1 = migrate_process_add(pid, 1);
+    p2 = migrate_process_add(other, 1);
+    CU_ASSERT_PTR_EQUAL(migrate_process_search(pid), p1);
+    CU_ASSERT_PTR_EQUAL(migrate_process_search(other), p2);
+    pthread_mutex_unlock(&migrate_process_bucket(pid)->lock);
+
+    /* a process which got pages after it is put in the timer wheel is kept */
+    init_collect_pages_timeout(1);
+    __atomic_store_n(&g_timer.now, migrate_now() - MIGRATE_TIMER_SLOTS, __ATOMIC_RELAXED);
+    __atomic_store_n(&p1->timestamp, migrate_now() - 2, __ATOMIC_RELAXED);
+    __atomic_store_n(&p2->timestamp, migrate_now() - 2, __ATOMIC_RELAXED);
+    migrate_timer_arm(p1);
+    migrate_timer_arm(p2);
+    __atomic_store_n(&p2->timestamp, migrate_now(), __ATOMIC_RELAXED);
+    migrate_process_recycle();
+    pthread_mutex_lock(&migrate_process_bucket(pid)->lock);
+    CU_ASSERT_PTR_NULL(migrate_process_search(pid));
+    CU_ASSERT_PTR_EQUAL(migrate_process_search(other), p2);
+    pthread_mutex_unlock(&migrate_process_bucket(pid)->lock);
+
+    migrate_process_remove(p2);
+    init_collect_pages_timeout(DEFAULT_COLLECT_PAGE_TIMEOUT);
+}
+
 int add_tests(void)
 {
     /* add test case for interface of memdcd_process */
@@ -111,6 +151,10 @@ int add_tests(void)
         return -1;
     }
 
+    if (CU_ADD_TEST(suite_memdcd_process_static, test_memdcd_process_table) == NULL) {
+        return -1;
+    }
+
     CU_set_output_filename("memdcd");
     return 0;
 }
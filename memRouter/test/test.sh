@@ -22,6 +22,7 @@ cd ..
 chown $USER $pwd/config/*
 ./build/test_bin/memdcd_cmd_llt
 ./build/test_bin/memdcd_daemon_llt
+./build/test_bin/memdcd_daemon_loop_llt
 ./build/test_bin/memdcd_log_llt
 ./build/test_bin/memdcd_migrate_llt
 ./build/test_bin/memdcd_policy_llt